@@ -124,11 +124,26 @@
 #define HGFS_PATH_MAX HGFS_PACKET_MAX
 
 /*
- * Array of FileNodes for opening files.
+ * Number of FileNodes and searches allocated at once when a session runs
+ * out of them.
  */
 #define NUM_FILE_NODES 100
 #define NUM_SEARCHES 100
 
+/*
+ * Initial bucket count of the per session tables mapping an HGFS handle to
+ * its node or search.
+ */
+#define HGFS_HANDLE_TABLE_SIZE 256
+#define HGFS_HANDLE_TABLE_KEY(_handle) ((const void *)(uintptr_t)(_handle))
+
+/* Number of directory search entries whose attributes are fetched at once. */
+#define HGFS_SEARCH_ATTR_PREFETCH 256
+
+/* Initial capacity of a search's dirent store (entries and name bytes). */
+#define HGFS_DIRENT_STORE_MIN_DENTS 128
+#define HGFS_DIRENT_STORE_MIN_NAMES 4096
+
 /* Default maximum number of open nodes. */
 #define MAX_CACHED_FILENODES 30
 
@@ -154,6 +169,15 @@ static Atomic_uint32 gHgfsAsyncCounter = {0};
 static MXUserExclLock *gHgfsAsyncLock;
 static MXUserCondVar  *gHgfsAsyncVar;
 
+#ifdef VMX86_TOOLS
+/*
+ * Worker pool supplied by the embedder. When set, transports that support
+ * asynchronous processing have their REQ_ASYNC requests run on it.
+ */
+static HgfsServerExecutorFunc *gHgfsExecutor = NULL;
+static void *gHgfsExecutorData = NULL;
+#endif
+
 static HgfsServerStateLogger *hgfsMgrData = NULL;
 
 /*
@@ -433,6 +457,13 @@ HgfsServerTransportSessionPut(HgfsTransportSessionInfo *transportSession)   // I
       }
 
       MXUser_ReleaseExclLock(transportSession->sessionArrayLock);
+
+#ifdef VMX86_TOOLS
+      /* The queue runner holds a reference, so nothing can be pending. */
+      ASSERT(!DblLnkLst_IsLinked(&transportSession->asyncQueue));
+      MXUser_DestroyExclLock(transportSession->asyncQueueLock);
+      transportSession->asyncQueueLock = NULL;
+#endif
    }
 }
 
@@ -518,6 +549,65 @@ HgfsServerGetNextHandleCounter(void)
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsGetNodeAt --
+ *
+ *    Retrieve the file node at the given position in the session's node
+ *    chunks.
+ *
+ *    The session's nodeArrayLock should be acquired prior to calling this
+ *    function.
+ *
+ * Results:
+ *    The file node.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE HgfsFileNode *
+HgfsGetNodeAt(HgfsSessionInfo *session,  // IN: Session info
+              unsigned int i)            // IN: Position of the node
+{
+   ASSERT(i < session->numNodes);
+
+   return &session->nodeChunks[i / NUM_FILE_NODES][i % NUM_FILE_NODES];
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsGetSearchAt --
+ *
+ *    Retrieve the search at the given position in the session's search
+ *    chunks.
+ *
+ *    Caller should hold the session's searchArrayLock.
+ *
+ * Results:
+ *    The search.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE HgfsSearch *
+HgfsGetSearchAt(HgfsSessionInfo *session,  // IN: Session info
+                unsigned int i)            // IN: Position of the search
+{
+   ASSERT(i < session->numSearches);
+
+   return &session->searchChunks[i / NUM_SEARCHES][i % NUM_SEARCHES];
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -543,21 +633,18 @@ static HgfsFileNode *
 HgfsHandle2FileNode(HgfsHandle handle,        // IN: Hgfs file handle
                     HgfsSessionInfo *session) // IN: Session info
 {
-   unsigned int i;
-   HgfsFileNode *fileNode = NULL;
+   void *fileNode;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
-   /* XXX: This O(n) lookup can and should be optimized. */
-   for (i = 0; i < session->numNodes; i++) {
-      if (session->nodeArray[i].state != FILENODE_STATE_UNUSED &&
-          session->nodeArray[i].handle == handle) {
-         fileNode = &session->nodeArray[i];
-         break;
-      }
+   if (!HashTable_Lookup(session->nodeHandleTable,
+                         HGFS_HANDLE_TABLE_KEY(handle), &fileNode)) {
+      return NULL;
    }
 
+   ASSERT(((HgfsFileNode *)fileNode)->state != FILENODE_STATE_UNUSED);
+   ASSERT(((HgfsFileNode *)fileNode)->handle == handle);
+
    return fileNode;
 }
 
@@ -595,7 +682,7 @@ HgfsFileNode2Handle(HgfsFileNode const *fileNode) // IN
  *
  * HgfsDumpAllNodes --
  *
- *    Debugging routine; print all nodes in the nodeArray.
+ *    Debugging routine; print all nodes in the node pool.
  *
  *    The session's nodeArrayLock should be acquired prior to calling this
  *    function.
@@ -615,16 +702,17 @@ HgfsDumpAllNodes(HgfsSessionInfo *session)  // IN: session info
    unsigned int i;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    Log("Dumping all nodes\n");
    for (i = 0; i < session->numNodes; i++) {
+      HgfsFileNode *node = HgfsGetNodeAt(session, i);
+
       Log("handle %u, name \"%s\", localdev %"FMT64"u, localInum %"FMT64"u %u\n",
-          session->nodeArray[i].handle,
-          session->nodeArray[i].utf8Name ? session->nodeArray[i].utf8Name : "NULL",
-          session->nodeArray[i].localId.volumeId,
-          session->nodeArray[i].localId.fileId,
-          session->nodeArray[i].fileDesc);
+          node->handle,
+          node->utf8Name ? node->utf8Name : "NULL",
+          node->localId.volumeId,
+          node->localId.fileId,
+          node->fileDesc);
    }
    Log("Done\n");
 }
@@ -841,12 +929,11 @@ HgfsFileDesc2Handle(fileDesc fd,              // IN: OS handle (file descriptor)
    HgfsFileNode *existingFileNode = NULL;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
 
    for (i = 0; i < session->numNodes; i++) {
-      existingFileNode = &session->nodeArray[i];
+      existingFileNode = HgfsGetNodeAt(session, i);
       if ((existingFileNode->state == FILENODE_STATE_IN_USE_CACHED) &&
           (existingFileNode->fileDesc == fd)) {
          *handle = HgfsFileNode2Handle(existingFileNode);
@@ -1085,12 +1172,11 @@ HgfsFileHasServerLock(const char *utf8Name,             // IN: Name in UTF8
    ASSERT(utf8Name);
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
 
    for (i = 0; i < session->numNodes; i++) {
-      HgfsFileNode *existingFileNode = &session->nodeArray[i];
+      HgfsFileNode *existingFileNode = HgfsGetNodeAt(session, i);
 
       if ((existingFileNode->state == FILENODE_STATE_IN_USE_CACHED) &&
           (existingFileNode->serverLock != HGFS_LOCK_NONE) &&
@@ -1340,12 +1426,11 @@ HgfsUpdateNodeServerLock(fileDesc fd,                // IN: OS handle
    Bool updated = FALSE;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
 
    for (i = 0; i < session->numNodes; i++) {
-      existingFileNode = &session->nodeArray[i];
+      existingFileNode = HgfsGetNodeAt(session, i);
       if (existingFileNode->state != FILENODE_STATE_UNUSED) {
          if (existingFileNode->fileDesc == fd) {
             existingFileNode->serverLock = serverLock;
@@ -1483,7 +1568,7 @@ exit:
  *
  * HgfsDumpAllSearches --
  *
- *    Debugging routine; print all searches in the searchArray.
+ *    Debugging routine; print all searches in the search pool.
  *
  *    Caller should hold the session's searchArrayLock.
  *
@@ -1502,14 +1587,14 @@ HgfsDumpAllSearches(HgfsSessionInfo *session)   // IN: session info
    unsigned int i;
 
    ASSERT(session);
-   ASSERT(session->searchArray);
 
    Log("Dumping all searches\n");
    for (i = 0; i < session->numSearches; i++) {
+      HgfsSearch *search = HgfsGetSearchAt(session, i);
+
       Log("handle %u, baseDir \"%s\"\n",
-          session->searchArray[i].handle,
-          session->searchArray[i].utf8Dir ?
-          session->searchArray[i].utf8Dir : "(NULL)");
+          search->handle,
+          search->utf8Dir ? search->utf8Dir : "(NULL)");
    }
    Log("Done\n");
 }
@@ -1523,7 +1608,7 @@ HgfsDumpAllSearches(HgfsSessionInfo *session)   // IN: session info
  *    Remove a node from the free list and return it. Nodes on
  *    the free list should already be initialized.
  *
- *    If the free list is empty, reallocates more memory,
+ *    If the free list is empty, allocates a new chunk,
  *    initializes it appropriately, adds the new entries to the
  *    free list, and then returns one off the free list.
  *
@@ -1544,82 +1629,44 @@ static HgfsFileNode *
 HgfsGetNewNode(HgfsSessionInfo *session)  // IN: session info
 {
    HgfsFileNode *node;
-   HgfsFileNode *newMem;
-   unsigned int newNumNodes;
-   unsigned int i;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    LOG(4, ("%s: entered\n", __FUNCTION__));
 
    if (!DblLnkLst_IsLinked(&session->nodeFreeList)) {
+      HgfsFileNode **newChunks;
+      HgfsFileNode *newMem;
+      unsigned int i;
+
       /*
-       * This has to be unsigned and with maximum bit length. This is
-       * required to take care of "negative" differences as well.
+       * Existing nodes never move, so only the (small) array of chunk
+       * pointers may need to be reallocated here.
        */
-      uintptr_t ptrDiff;
-
-      if (DOLOG(4)) {
-         Log("Dumping nodes before realloc\n");
-         HgfsDumpAllNodes(session);
-      }
-
-      /* Try to get twice as much memory as we had */
-      newNumNodes = 2 * session->numNodes;
-      newMem = (HgfsFileNode *)realloc(session->nodeArray,
-                                       newNumNodes * sizeof *(session->nodeArray));
+      newMem = (HgfsFileNode *)calloc(NUM_FILE_NODES, sizeof *newMem);
       if (!newMem) {
-         LOG(4, ("%s: can't realloc more nodes\n", __FUNCTION__));
+         LOG(4, ("%s: can't allocate more nodes\n", __FUNCTION__));
 
          return NULL;
       }
 
-      ptrDiff = (char *)newMem - (char *)session->nodeArray;
-      if (ptrDiff) {
-         size_t const oldSize = session->numNodes * sizeof *(session->nodeArray);
-
-         /*
-          * The portion of memory that contains all our file nodes moved.
-          * All pointers that pointed inside the previous portion of memory
-          * must be updated to point to the new portion of memory.
-          *
-          * We'll need to lock this if we multithread.
-          */
-
-         LOG(4, ("Rebasing pointers, diff is %"FMTSZ"u, sizeof node is "
-                  "%"FMTSZ"u\n", ptrDiff, sizeof(HgfsFileNode)));
-         LOG(4, ("old: %p new: %p\n", session->nodeArray, newMem));
-         ASSERT(newMem == (HgfsFileNode *)((char*)session->nodeArray + ptrDiff));
-
-#define HgfsServerRebase(_ptr, _type)                                   \
-   if ((size_t)((char *)_ptr - (char *)session->nodeArray) < oldSize) { \
-      _ptr = (_type *)((char *)_ptr + ptrDiff);                         \
-   }
-
-         /*
-          * Rebase the links of all file nodes
-          */
-         for (i = 0; i < session->numNodes; i++) {
-            HgfsServerRebase(newMem[i].links.prev, DblLnkLst_Links)
-            HgfsServerRebase(newMem[i].links.next, DblLnkLst_Links)
-         }
-
-         /*
-          * There is no need to rebase the anchor of the file node free list
-          * because if we are here, it is empty.
-          */
-
-         /* Rebase the anchor of the cached file nodes list. */
-         HgfsServerRebase(session->nodeCachedList.prev, DblLnkLst_Links)
-         HgfsServerRebase(session->nodeCachedList.next, DblLnkLst_Links)
+      newChunks = (HgfsFileNode **)realloc(session->nodeChunks,
+                                           (session->numNodeChunks + 1) *
+                                           sizeof *newChunks);
+      if (!newChunks) {
+         LOG(4, ("%s: can't allocate more nodes\n", __FUNCTION__));
+         free(newMem);
 
-#undef HgfsServerRebase
+         return NULL;
       }
+      newChunks[session->numNodeChunks] = newMem;
+      session->nodeChunks = newChunks;
+      session->numNodeChunks++;
 
       /* Initialize the new nodes */
-      LOG(4, ("numNodes was %u, now is %u\n", session->numNodes, newNumNodes));
-      for (i = session->numNodes; i < newNumNodes; i++) {
+      LOG(4, ("numNodes was %u, now is %u\n", session->numNodes,
+              session->numNodes + NUM_FILE_NODES));
+      for (i = 0; i < NUM_FILE_NODES; i++) {
          DblLnkLst_Init(&newMem[i].links);
 
          newMem[i].state = FILENODE_STATE_UNUSED;
@@ -1630,11 +1677,10 @@ HgfsGetNewNode(HgfsSessionInfo *session)  // IN: session info
          /* Append at the end of the list */
          DblLnkLst_LinkLast(&session->nodeFreeList, &newMem[i].links);
       }
-      session->nodeArray = newMem;
-      session->numNodes = newNumNodes;
+      session->numNodes += NUM_FILE_NODES;
 
       if (DOLOG(4)) {
-         Log("Dumping nodes after pointer changes\n");
+         Log("Dumping nodes after growing the pool\n");
          HgfsDumpAllNodes(session);
       }
    }
@@ -1685,6 +1731,12 @@ HgfsRemoveFileNode(HgfsFileNode *node,        // IN: file node
       free(node->utf8Name);
    }
    node->utf8Name = NULL;
+
+   /* Nodes that never made it into use are not indexed by their handle. */
+   if (node->state != FILENODE_STATE_UNUSED) {
+      HashTable_Delete(session->nodeHandleTable,
+                       HGFS_HANDLE_TABLE_KEY(node->handle));
+   }
    node->state = FILENODE_STATE_UNUSED;
    ASSERT(node->fileCtx == NULL);
    node->fileCtx = NULL;
@@ -1859,6 +1911,15 @@ HgfsAddNewFileNode(HgfsFileOpenInfo *openInfo,  // IN: open info struct
    }
 
    newNode->serverLock = openInfo->acquiredLock;
+
+   if (!HashTable_Insert(session->nodeHandleTable,
+                         HGFS_HANDLE_TABLE_KEY(newNode->handle),
+                         newNode)) {
+      LOG(4, ("%s: handle %u is already in use\n", __FUNCTION__,
+              newNode->handle));
+      HgfsRemoveFileNode(newNode, session);
+      return NULL;
+   }
    newNode->state = FILENODE_STATE_IN_USE_NOT_CACHED;
    newNode->shareInfo.readPermissions = openInfo->shareInfo.readPermissions;
    newNode->shareInfo.writePermissions = openInfo->shareInfo.writePermissions;
@@ -2113,7 +2174,7 @@ HgfsIsServerLockAllowed(HgfsSessionInfo *session)  // IN: session info
  *    Remove a search from the free list and return it. Searches on
  *    the free list should already be initialized.
  *
- *    If the free list is empty, reallocates more memory,
+ *    If the free list is empty, allocates a new chunk,
  *    initializes it appropriately, adds the new entries to the
  *    free list, and then returns one off the free list.
  *
@@ -2133,80 +2194,42 @@ static HgfsSearch *
 HgfsGetNewSearch(HgfsSessionInfo *session)  // IN: session info
 {
    HgfsSearch *search;
-   HgfsSearch *newMem;
-   unsigned int newNumSearches;
-   unsigned int i;
 
    ASSERT(session);
-   ASSERT(session->searchArray);
 
    LOG(4, ("%s: entered\n", __FUNCTION__));
 
    if (!DblLnkLst_IsLinked(&session->searchFreeList)) {
-      /*
-       * This has to be unsigned and with maximum bit length. This is
-       * required to take care of "negative" differences as well.
-       */
-
-      uintptr_t ptrDiff;
-
-      if (DOLOG(4)) {
-         Log("Dumping searches before realloc\n");
-         HgfsDumpAllSearches(session);
-      }
+      HgfsSearch **newChunks;
+      HgfsSearch *newMem;
+      unsigned int i;
 
-      /* Try to get twice as much memory as we had */
-      newNumSearches = 2 * session->numSearches;
-      newMem = (HgfsSearch *)realloc(session->searchArray,
-                                     newNumSearches * sizeof *(session->searchArray));
+      /* Existing searches never move, see HgfsGetNewNode. */
+      newMem = (HgfsSearch *)calloc(NUM_SEARCHES, sizeof *newMem);
       if (!newMem) {
-         LOG(4, ("%s: can't realloc more searches\n", __FUNCTION__));
+         LOG(4, ("%s: can't allocate more searches\n", __FUNCTION__));
 
          return NULL;
       }
 
-      ptrDiff = (char *)newMem - (char *)session->searchArray;
-      if (ptrDiff) {
-         size_t const oldSize = session->numSearches * sizeof *(session->searchArray);
+      newChunks = (HgfsSearch **)realloc(session->searchChunks,
+                                         (session->numSearchChunks + 1) *
+                                         sizeof *newChunks);
+      if (!newChunks) {
+         LOG(4, ("%s: can't allocate more searches\n", __FUNCTION__));
+         free(newMem);
 
-         /*
-          * The portion of memory that contains all our searches moved.
-          * All pointers that pointed inside the previous portion of memory
-          * must be updated to point to the new portion of memory.
-          */
-
-         LOG(4, ("Rebasing pointers, diff is %"FMTSZ"u, sizeof search is "
-                 "%"FMTSZ"u\n", ptrDiff, sizeof(HgfsSearch)));
-         LOG(4, ("old: %p new: %p\n", session->searchArray, newMem));
-         ASSERT(newMem == (HgfsSearch*)((char*)session->searchArray + ptrDiff));
-
-#define HgfsServerRebase(_ptr, _type)                                     \
-   if ((size_t)((char *)_ptr - (char *)session->searchArray) < oldSize) { \
-      _ptr = (_type *)((char *)_ptr + ptrDiff);                           \
-   }
-
-         /*
-          * Rebase the links of all searches
-          */
-
-         for (i = 0; i < session->numSearches; i++) {
-            HgfsServerRebase(newMem[i].links.prev, DblLnkLst_Links)
-            HgfsServerRebase(newMem[i].links.next, DblLnkLst_Links)
-         }
-
-         /*
-          * There is no need to rebase the links of the search free list
-          * because if we are here, it is empty
-          */
-
-#undef HgfsServerRebase
+         return NULL;
       }
+      newChunks[session->numSearchChunks] = newMem;
+      session->searchChunks = newChunks;
+      session->numSearchChunks++;
 
       /* Initialize the new searches */
       LOG(4, ("numSearches was %u, now is %u\n", session->numSearches,
-               newNumSearches));
+              session->numSearches + NUM_SEARCHES));
 
-      for (i = session->numSearches; i < newNumSearches; i++) {
+      for (i = 0; i < NUM_SEARCHES; i++) {
          DblLnkLst_Init(&newMem[i].links);
          newMem[i].utf8Dir = NULL;
          newMem[i].utf8DirLen = 0;
@@ -2214,17 +2237,15 @@ HgfsGetNewSearch(HgfsSessionInfo *session)  // IN: session info
          newMem[i].utf8ShareNameLen = 0;
          newMem[i].shareInfo.rootDir = NULL;
          newMem[i].shareInfo.rootDirLen = 0;
-         newMem[i].dents = NULL;
-         newMem[i].numDents = 0;
+         HgfsDirentStoreInit(&newMem[i].dents);
 
          /* Append at the end of the list */
          DblLnkLst_LinkLast(&session->searchFreeList, &newMem[i].links);
       }
-      session->searchArray = newMem;
-      session->numSearches = newNumSearches;
+      session->numSearches += NUM_SEARCHES;
 
       if (DOLOG(4)) {
-         Log("Dumping searches after pointer changes\n");
+         Log("Dumping searches after growing the pool\n");
          HgfsDumpAllSearches(session);
       }
    }
@@ -2345,8 +2366,7 @@ HgfsGetSearchCopy(HgfsHandle handle,        // IN: Hgfs search handle
    copy->utf8ShareName[copy->utf8ShareNameLen] = '\0';
 
    /* No dents for the copy, they consume too much memory and aren't needed. */
-   copy->dents = NULL;
-   copy->numDents = 0;
+   HgfsDirentStoreInit(&copy->dents);
 
    copy->handle = original->handle;
    copy->type = original->type;
@@ -2398,11 +2418,19 @@ HgfsAddNewSearch(char const *utf8Dir,       // IN: UTF8 name of dir to search in
       return NULL;
    }
 
-   newSearch->dents = NULL;
-   newSearch->numDents = 0;
+   HgfsDirentStoreInit(&newSearch->dents);
    newSearch->type = type;
    newSearch->handle = HgfsServerGetNextHandleCounter();
 
+   if (!HashTable_Insert(session->searchHandleTable,
+                         HGFS_HANDLE_TABLE_KEY(newSearch->handle),
+                         newSearch)) {
+      LOG(4, ("%s: handle %u is already in use\n", __FUNCTION__,
+              newSearch->handle));
+      DblLnkLst_LinkFirst(&session->searchFreeList, &newSearch->links);
+      return NULL;
+   }
+
    newSearch->utf8DirLen = strlen(utf8Dir);
    newSearch->utf8Dir = Util_SafeStrdup(utf8Dir);
 
@@ -2418,12 +2446,164 @@ HgfsAddNewSearch(char const *utf8Dir,       // IN: UTF8 name of dir to search in
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsDirentStoreInit --
+ *
+ *    Initializes an empty directory entry store.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsDirentStoreInit(HgfsDirentStore *store)    // OUT: Store to initialize
+{
+   ASSERT(store);
+
+   memset(store, 0, sizeof *store);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsDirentStoreAdd --
+ *
+ *    Appends a name to the directory entry store. The names blob and the
+ *    offset index are grown geometrically so that building a store of n
+ *    entries only takes O(log n) reallocations.
+ *
+ * Results:
+ *    TRUE on success, FALSE if memory could not be allocated. The store
+ *    is left unchanged on failure.
+ *
+ * Side effects:
+ *    Memory allocation.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+HgfsDirentStoreAdd(HgfsDirentStore *store,     // IN/OUT: Store to add to
+                   char const *name,           // IN: Entry name
+                   size_t nameLen)             // IN: Length of name
+{
+   ASSERT(store);
+   ASSERT(name);
+
+   /* Prefetched attributes are sized for the old entries, drop them. */
+   free(store->attrs);
+   store->attrs = NULL;
+
+   if (store->numDents == store->maxDents) {
+      uint32 newMax = store->maxDents != 0 ? store->maxDents * 2 :
+                                             HGFS_DIRENT_STORE_MIN_DENTS;
+      size_t *newOffsets;
+
+      if (newMax <= store->maxDents) {
+         return FALSE;
+      }
+      newOffsets = realloc(store->offsets, newMax * sizeof *newOffsets);
+      if (newOffsets == NULL) {
+         return FALSE;
+      }
+      store->offsets = newOffsets;
+      store->maxDents = newMax;
+   }
+
+   if (store->namesSize - store->namesLen < nameLen + 1) {
+      size_t newSize = store->namesSize != 0 ? store->namesSize :
+                                               HGFS_DIRENT_STORE_MIN_NAMES;
+      char *newNames;
+
+      while (newSize - store->namesLen < nameLen + 1) {
+         newSize *= 2;
+      }
+      newNames = realloc(store->names, newSize);
+      if (newNames == NULL) {
+         return FALSE;
+      }
+      store->names = newNames;
+      store->namesSize = newSize;
+   }
+
+   memcpy(store->names + store->namesLen, name, nameLen);
+   store->names[store->namesLen + nameLen] = '\0';
+   store->offsets[store->numDents++] = store->namesLen;
+   store->namesLen += nameLen + 1;
+
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsDirentStoreName --
+ *
+ *    Returns the name of the entry at the given index of the store.
+ *
+ * Results:
+ *    Pointer into the store's names blob, valid until the store is next
+ *    modified.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE char const *
+HgfsDirentStoreName(HgfsDirentStore const *store, // IN: Store
+                    uint32 index)                 // IN: Entry index
+{
+   ASSERT(index < store->numDents);
+
+   return store->names + store->offsets[index];
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsDirentStoreDestroy --
+ *
+ *    Frees the memory held by a directory entry store and leaves it empty.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsDirentStoreDestroy(HgfsDirentStore *store) // IN/OUT: Store to free
+{
+   ASSERT(store);
+
+   free(store->names);
+   free(store->offsets);
+   free(store->attrs);
+   HgfsDirentStoreInit(store);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
  * HgfsFreeSearchDirents --
  *
- *    Frees all dirents and dirents pointer array.
+ *    Frees all dirents of the search.
  *
  *    Caller should hold the session's searchArrayLock.
  *
@@ -2439,14 +2619,8 @@ HgfsAddNewSearch(char const *utf8Dir,       // IN: UTF8 name of dir to search in
 static void
 HgfsFreeSearchDirents(HgfsSearch *search)       // IN/OUT: search
 {
-   unsigned int i;
-
-   if (search->dents) {
-      for (i = 0; i < search->numDents; i++) {
-         free(search->dents[i]);
-      }
-      free(search->dents);
-   }
+   HgfsDirentStoreDestroy(&search->dents);
+   search->dentsGeneration++;
 }
 
 
@@ -2475,70 +2649,303 @@ HgfsRemoveSearchInternal(HgfsSearch *search,       // IN: search
    ASSERT(search);
    ASSERT(session);
 
-   LOG(4, ("%s: handle %u, dir %s\n", __FUNCTION__,
-           HgfsSearch2SearchHandle(search), search->utf8Dir));
+   LOG(4, ("%s: handle %u, dir %s\n", __FUNCTION__,
+           HgfsSearch2SearchHandle(search), search->utf8Dir));
+
+   HashTable_Delete(session->searchHandleTable,
+                    HGFS_HANDLE_TABLE_KEY(search->handle));
+
+   HgfsFreeSearchDirents(search);
+   free(search->utf8Dir);
+   free(search->utf8ShareName);
+   free((char*)search->shareInfo.rootDir);
+
+   /* Prepend at the beginning of the list */
+   DblLnkLst_LinkFirst(&session->searchFreeList, &search->links);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsRemoveSearch --
+ *
+ *    Wrapper around HgfsRemoveSearchInternal that first takes the lock and
+ *    converts the handle to the search itself.
+ *
+ * Results:
+ *    TRUE if the search was freed successfully.
+ *    FALSE if the search could not be found.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+HgfsRemoveSearch(HgfsHandle handle,        // IN: search
+                 HgfsSessionInfo *session) // IN: session info
+{
+   HgfsSearch *search;
+   Bool success = FALSE;
+
+   MXUser_AcquireExclLock(session->searchArrayLock);
+
+   search = HgfsSearchHandle2Search(handle, session);
+   if (search != NULL) {
+      HgfsRemoveSearchInternal(search, session);
+      success = TRUE;
+   }
+
+   MXUser_ReleaseExclLock(session->searchArrayLock);
+
+   return success;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsGetSearchResult --
+ *
+ *    Returns a copy of the search result at the given offset. If remove is set
+ *    to TRUE, the existing result is also pruned and the remaining results
+ *    are shifted up in the result index.
+ *
+ * Results:
+ *    NULL if there was an error or no search results were left.
+ *    Non-NULL if result was found. Caller must free it.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+DirectoryEntry *
+HgfsGetSearchResult(HgfsHandle handle,         // IN: Handle to search
+                    HgfsSessionInfo *session,  // IN: Session info
+                    uint32 offset,             // IN: Offset to retrieve at
+                    Bool remove)               // IN: If true, removes the result
+{
+   HgfsSearch *search;
+   DirectoryEntry *dent = NULL;
+   char const *name;
+   size_t nameLen;
+   size_t dentLen;
+
+   MXUser_AcquireExclLock(session->searchArrayLock);
+
+   search = HgfsSearchHandle2Search(handle, session);
+   if (search == NULL || offset >= search->dents.numDents) {
+      goto out;
+   }
+
+   name = HgfsDirentStoreName(&search->dents, offset);
+   nameLen = strlen(name);
+
+   /*
+    * Start with the size of the DirectoryEntry struct, subtract the static
+    * length of the d_name buffer (256 in Linux, 1 in Solaris, etc) and add
+    * back just enough space for the UTF-8 name and nul terminator.
+    */
+   dentLen = sizeof *dent - sizeof dent->d_name + nameLen + 1;
+   dent = malloc(dentLen);
+   if (dent == NULL) {
+      goto out;
+   }
+
+   /*
+    * Yes, there are more members than this in a dirent. But if you look
+    * at the top of hgfsServerInt.h, you'll see that on Windows we only
+    * define d_reclen and d_name, as those are the only fields we need.
+    */
+   dent->d_reclen = (unsigned short)dentLen;
+   memcpy(dent->d_name, name, nameLen + 1);
+
+   if (remove) {
+      /*
+       * Shift up the remaining offsets. The name itself stays in the blob
+       * until the whole store is freed.
+       */
+      memmove(&search->dents.offsets[offset], &search->dents.offsets[offset + 1],
+              (search->dents.numDents - (offset + 1)) *
+              sizeof search->dents.offsets[0]);
+      if (search->dents.attrs != NULL) {
+         memmove(&search->dents.attrs[offset], &search->dents.attrs[offset + 1],
+                 (search->dents.numDents - (offset + 1)) *
+                 sizeof search->dents.attrs[0]);
+      }
+
+      /* Decrement the number of results */
+      search->dents.numDents--;
+      search->dentsGeneration++;
+   }
+
+  out:
+   MXUser_ReleaseExclLock(session->searchArrayLock);
+
+   return dent;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPrefetchSearchAttrs --
+ *
+ *    Fetches the attributes of up to HGFS_SEARCH_ATTR_PREFETCH entries of a
+ *    directory search, starting at the given offset, and caches them
+ *    alongside the dents. The platform stats the entries relative to the
+ *    searched directory, so no full path is built per entry.
+ *
+ *    The names are copied out so the stats run without the searchArrayLock
+ *    held.
+ *
+ * Results:
+ *    TRUE if attributes were cached, FALSE otherwise.
+ *
+ * Side effects:
+ *    Memory allocation.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+HgfsPrefetchSearchAttrs(HgfsHandle handle,              // IN: Handle to search
+                        HgfsSearch const *searchInfo,   // IN: Copy of the search
+                        HgfsShareOptions configOptions, // IN: Share config options
+                        HgfsSessionInfo *session,       // IN: Session info
+                        uint32 offset)                  // IN: First entry to fetch
+{
+   HgfsSearch *search;
+   HgfsFileAttrInfo *attrs = NULL;
+   char const **names = NULL;
+   char *namesCopy = NULL;
+   uint32 numDents = 0;
+   uint32 generation = 0;
+   uint32 count = 0;
+   uint32 i;
+   Bool cached = FALSE;
+
+   MXUser_AcquireExclLock(session->searchArrayLock);
+
+   search = HgfsSearchHandle2Search(handle, session);
+   if (search != NULL && offset < search->dents.numDents) {
+      size_t start;
+      size_t end;
+
+      numDents = search->dents.numDents;
+      generation = search->dentsGeneration;
+      count = MIN(numDents - offset, HGFS_SEARCH_ATTR_PREFETCH);
+
+      /* Names of consecutive entries are contiguous in the blob. */
+      start = search->dents.offsets[offset];
+      end = search->dents.offsets[offset + count - 1];
+      end += strlen(search->dents.names + end) + 1;
+
+      names = malloc(count * sizeof *names);
+      namesCopy = malloc(end - start);
+      if (names != NULL && namesCopy != NULL) {
+         memcpy(namesCopy, search->dents.names + start, end - start);
+         for (i = 0; i < count; i++) {
+            names[i] = namesCopy + (search->dents.offsets[offset + i] - start);
+         }
+      } else {
+         count = 0;
+      }
+   }
+
+   MXUser_ReleaseExclLock(session->searchArrayLock);
+
+   if (count == 0) {
+      goto exit;
+   }
+
+   attrs = malloc(count * sizeof *attrs);
+   if (attrs == NULL ||
+       HgfsPlatformGetattrFromDirents(searchInfo->utf8Dir, configOptions,
+                                      searchInfo->utf8ShareName, names, count,
+                                      attrs) != 0) {
+      goto exit;
+   }
+
+   MXUser_AcquireExclLock(session->searchArrayLock);
 
-   HgfsFreeSearchDirents(search);
-   free(search->utf8Dir);
-   free(search->utf8ShareName);
-   free((char*)search->shareInfo.rootDir);
+   /* The dents may have been refreshed or restarted in the meantime. */
+   search = HgfsSearchHandle2Search(handle, session);
+   if (search != NULL && search->dentsGeneration == generation) {
+      ASSERT(search->dents.numDents == numDents);
+      if (search->dents.attrs == NULL) {
+         search->dents.attrs = calloc(numDents, sizeof *search->dents.attrs);
+      }
+      if (search->dents.attrs != NULL) {
+         memcpy(&search->dents.attrs[offset], attrs, count * sizeof *attrs);
+         cached = TRUE;
+      }
+   }
 
-   /* Prepend at the beginning of the list */
-   DblLnkLst_LinkFirst(&session->searchFreeList, &search->links);
+   MXUser_ReleaseExclLock(session->searchArrayLock);
+
+  exit:
+   free(attrs);
+   free(namesCopy);
+   free(names);
+
+   return cached;
 }
 
 
 /*
  *-----------------------------------------------------------------------------
  *
- * HgfsRemoveSearch --
+ * HgfsDropSearchAttrs --
  *
- *    Wrapper around HgfsRemoveSearchInternal that first takes the lock and
- *    converts the handle to the search itself.
+ *    Drops the attributes cached for the entries of a directory search, so
+ *    that a search read starting over from the first entry reports the
+ *    current attributes.
  *
  * Results:
- *    TRUE if the search was freed successfully.
- *    FALSE if the search could not be found.
+ *    None
  *
  * Side effects:
- *    None
+ *    Prefetches in progress for the search are discarded.
  *
  *-----------------------------------------------------------------------------
  */
 
-Bool
-HgfsRemoveSearch(HgfsHandle handle,        // IN: search
-                 HgfsSessionInfo *session) // IN: session info
+static void
+HgfsDropSearchAttrs(HgfsHandle handle,          // IN: Handle to search
+                    HgfsSessionInfo *session)   // IN: Session info
 {
    HgfsSearch *search;
-   Bool success = FALSE;
 
    MXUser_AcquireExclLock(session->searchArrayLock);
 
    search = HgfsSearchHandle2Search(handle, session);
-   if (search != NULL) {
-      HgfsRemoveSearchInternal(search, session);
-      success = TRUE;
+   if (search != NULL && search->dents.attrs != NULL) {
+      free(search->dents.attrs);
+      search->dents.attrs = NULL;
+      search->dentsGeneration++;
    }
 
    MXUser_ReleaseExclLock(session->searchArrayLock);
-
-   return success;
 }
 
 
 /*
  *-----------------------------------------------------------------------------
  *
- * HgfsGetSearchResult --
+ * HgfsGetSearchResultAttr --
  *
- *    Returns a copy of the search result at the given offset. If remove is set
- *    to TRUE, the existing result is also pruned and the remaining results
- *    are shifted up in the result array.
+ *    Returns the attributes of the directory search entry at the given
+ *    offset from the search's attribute cache, prefetching the next batch
+ *    of entries if they haven't been fetched yet.
  *
  * Results:
- *    NULL if there was an error or no search results were left.
- *    Non-NULL if result was found. Caller must free it.
+ *    TRUE if the attributes were found, FALSE if the caller needs to get
+ *    them some other way.
  *
  * Side effects:
  *    None
@@ -2546,74 +2953,45 @@ HgfsRemoveSearch(HgfsHandle handle,        // IN: search
  *-----------------------------------------------------------------------------
  */
 
-DirectoryEntry *
-HgfsGetSearchResult(HgfsHandle handle,         // IN: Handle to search
-                    HgfsSessionInfo *session,  // IN: Session info
-                    uint32 offset,             // IN: Offset to retrieve at
-                    Bool remove)               // IN: If true, removes the result
-{
-   HgfsSearch *search;
-   DirectoryEntry *dent = NULL;
-
-   MXUser_AcquireExclLock(session->searchArrayLock);
-
-   search = HgfsSearchHandle2Search(handle, session);
-   if (search == NULL || search->dents == NULL) {
-      goto out;
-   }
-
-   if (offset >= search->numDents) {
-      goto out;
-   }
+static Bool
+HgfsGetSearchResultAttr(HgfsHandle handle,              // IN: Handle to search
+                        HgfsSearch const *searchInfo,   // IN: Copy of the search
+                        HgfsShareOptions configOptions, // IN: Share config options
+                        HgfsSessionInfo *session,       // IN: Session info
+                        uint32 offset,                  // IN: Entry to look up
+                        HgfsFileAttrInfo *attr)         // OUT: Entry attributes
+{
+   Bool prefetched = FALSE;
+   Bool found = FALSE;
 
-   /* If we're not removing the result, we need to make a copy of it. */
-   if (remove) {
-      /*
-       * We're going to shift the dents array, overwriting the dent pointer at
-       * offset, so first we need to save said pointer so that we can return it
-       * later to the caller.
-       */
-      dent = search->dents[offset];
+   for (;;) {
+      HgfsSearch *search;
 
-      /* Shift up the remaining results */
-      memmove(&search->dents[offset], &search->dents[offset + 1],
-              (search->numDents - (offset + 1)) * sizeof search->dents[0]);
+      MXUser_AcquireExclLock(session->searchArrayLock);
 
-      /* Decrement the number of results */
-      search->numDents--;
-   } else {
-      DirectoryEntry *originalDent;
-      size_t nameLen;
+      search = HgfsSearchHandle2Search(handle, session);
+      if (search != NULL &&
+          offset < search->dents.numDents &&
+          search->dents.attrs != NULL &&
+          search->dents.attrs[offset].mask != 0) {
+         HgfsOp savedOp = attr->requestType;
 
-      originalDent = search->dents[offset];
-      ASSERT(originalDent);
+         *attr = search->dents.attrs[offset];
+         attr->requestType = savedOp;
+         found = TRUE;
+      }
 
-      nameLen = strlen(originalDent->d_name);
-      /*
-       * Make sure the name will not overrun the d_name buffer, the end of
-       * which is also the end of the DirectoryEntry.
-       */
-      ASSERT(offsetof(DirectoryEntry, d_name) + nameLen < originalDent->d_reclen);
+      MXUser_ReleaseExclLock(session->searchArrayLock);
 
-      dent = malloc(originalDent->d_reclen);
-      if (dent == NULL) {
-         goto out;
+      if (found || prefetched ||
+          !HgfsPrefetchSearchAttrs(handle, searchInfo, configOptions, session,
+                                   offset)) {
+         break;
       }
-
-      /*
-       * Yes, there are more members than this in a dirent. But if you look
-       * at the top of hgfsServerInt.h, you'll see that on Windows we only
-       * define d_reclen and d_name, as those are the only fields we need.
-       */
-      dent->d_reclen = originalDent->d_reclen;
-      memcpy(dent->d_name, originalDent->d_name, nameLen);
-      dent->d_name[nameLen] = 0;
+      prefetched = TRUE;
    }
 
-  out:
-   MXUser_ReleaseExclLock(session->searchArrayLock);
-
-   return dent;
+   return found;
 }
 
 
@@ -2641,21 +3019,18 @@ HgfsSearch *
 HgfsSearchHandle2Search(HgfsHandle handle,         // IN: handle
                         HgfsSessionInfo *session)  // IN: session info
 {
-   unsigned int i;
-   HgfsSearch *search = NULL;
+   void *search;
 
    ASSERT(session);
-   ASSERT(session->searchArray);
 
-   /* XXX: This O(n) lookup can and should be optimized. */
-   for (i = 0; i < session->numSearches; i++) {
-      if (!DblLnkLst_IsLinked(&session->searchArray[i].links) &&
-          session->searchArray[i].handle == handle) {
-         search = &session->searchArray[i];
-         break;
-      }
+   if (!HashTable_Lookup(session->searchHandleTable,
+                         HGFS_HANDLE_TABLE_KEY(handle), &search)) {
+      return NULL;
    }
 
+   ASSERT(!DblLnkLst_IsLinked(&((HgfsSearch *)search)->links));
+   ASSERT(((HgfsSearch *)search)->handle == handle);
+
    return search;
 }
 
@@ -2691,14 +3066,13 @@ HgfsUpdateNodeNames(const char *oldLocalName,  // IN: Name of file to look for
    ASSERT(oldLocalName);
    ASSERT(newLocalName);
    ASSERT(session);
-   ASSERT(session->nodeArray);
 
    newBufferLen = strlen(newLocalName);
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
 
    for (i = 0; i < session->numNodes; i++) {
-      fileNode = &session->nodeArray[i];
+      fileNode = HgfsGetNodeAt(session, i);
 
       /* If the node is on the free list, skip it. */
       if (fileNode->state == FILENODE_STATE_UNUSED) {
@@ -2863,11 +3237,11 @@ static struct {
    { HgfsServerRename,           sizeof (HgfsRequestRenameV2),          REQ_SYNC },
 
    { HgfsServerOpen,             HGFS_SIZEOF_OP(HgfsRequestOpenV3),             REQ_SYNC },
-   { HgfsServerRead,             HGFS_SIZEOF_OP(HgfsRequestReadV3),             REQ_SYNC },
-   { HgfsServerWrite,            HGFS_SIZEOF_OP(HgfsRequestWriteV3),            REQ_SYNC },
+   { HgfsServerRead,             HGFS_SIZEOF_OP(HgfsRequestReadV3),             REQ_ASYNC },
+   { HgfsServerWrite,            HGFS_SIZEOF_OP(HgfsRequestWriteV3),            REQ_ASYNC },
    { HgfsServerClose,            HGFS_SIZEOF_OP(HgfsRequestCloseV3),            REQ_SYNC },
    { HgfsServerSearchOpen,       HGFS_SIZEOF_OP(HgfsRequestSearchOpenV3),       REQ_SYNC },
-   { HgfsServerSearchRead,       HGFS_SIZEOF_OP(HgfsRequestSearchReadV3),       REQ_SYNC },
+   { HgfsServerSearchRead,       HGFS_SIZEOF_OP(HgfsRequestSearchReadV3),       REQ_ASYNC },
    { HgfsServerSearchClose,      HGFS_SIZEOF_OP(HgfsRequestSearchCloseV3),      REQ_SYNC },
    { HgfsServerGetattr,          HGFS_SIZEOF_OP(HgfsRequestGetattrV3),          REQ_SYNC },
    { HgfsServerSetattr,          HGFS_SIZEOF_OP(HgfsRequestSetattrV3),          REQ_SYNC },
@@ -2886,12 +3260,12 @@ static struct {
     */
    { HgfsServerCreateSession,    offsetof(HgfsRequestCreateSessionV4, reserved),   REQ_SYNC},
    { HgfsServerDestroySession,   offsetof(HgfsRequestDestroySessionV4, reserved),  REQ_SYNC},
-   { HgfsServerRead,             sizeof (HgfsRequestReadV3),                       REQ_SYNC},
-   { HgfsServerWrite,            sizeof (HgfsRequestWriteV3),                      REQ_SYNC},
+   { HgfsServerRead,             sizeof (HgfsRequestReadV3),                       REQ_ASYNC},
+   { HgfsServerWrite,            sizeof (HgfsRequestWriteV3),                      REQ_ASYNC},
    { HgfsServerSetDirNotifyWatch,    sizeof (HgfsRequestSetWatchV4),               REQ_SYNC},
    { HgfsServerRemoveDirNotifyWatch, sizeof (HgfsRequestRemoveWatchV4),            REQ_SYNC},
    { NULL,                       0,                                                REQ_SYNC}, // No Op notify
-   { HgfsServerSearchRead,       sizeof (HgfsRequestSearchReadV4),                 REQ_SYNC},
+   { HgfsServerSearchRead,       sizeof (HgfsRequestSearchReadV4),                 REQ_ASYNC},
 
 };
 
@@ -2969,6 +3343,9 @@ HgfsServerCompleteRequest(HgfsInternalStatus status,   // IN: Status of the requ
          HgfsPackLegacyReplyHeader(status, input->id, reply);
       }
    }
+   HgfsServerStatsSample(input->op, status,
+                         input->metaPacketSize + input->dataBytesIn,
+                         replySize + input->dataBytesOut, input->startNS);
    if (!HgfsPacketSend(input->packet, packetOut, replySize,
                        input->transportSession, 0)) {
       /* Send failed. Drop the reply. */
@@ -3014,6 +3391,130 @@ HgfsServerProcessRequest(void *context)
 }
 
 
+#ifdef VMX86_TOOLS
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerRunAsyncQueue --
+ *
+ *    Worker side of asynchronous request processing in Tools. Runs the
+ *    queued requests of a transport session one after another until the
+ *    queue is empty, so that requests which depend on each other (e.g. an
+ *    open followed by a read of the returned handle) are seen in the order
+ *    the client sent them. Requests of different transport sessions run
+ *    in parallel on different workers.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    Drops the transport session reference taken by HgfsServerQueueRequest.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+HgfsServerRunAsyncQueue(void *context)  // IN: transport session
+{
+   HgfsTransportSessionInfo *transportSession = context;
+
+   for (;;) {
+      HgfsInputParam *input = NULL;
+
+      MXUser_AcquireExclLock(transportSession->asyncQueueLock);
+      if (DblLnkLst_IsLinked(&transportSession->asyncQueue)) {
+         input = DblLnkLst_Container(transportSession->asyncQueue.next,
+                                     HgfsInputParam, links);
+         DblLnkLst_Unlink1(&input->links);
+      } else {
+         transportSession->asyncQueueRunning = FALSE;
+      }
+      MXUser_ReleaseExclLock(transportSession->asyncQueueLock);
+
+      if (input == NULL) {
+         break;
+      }
+      HgfsServerProcessRequest(input);
+   }
+
+   HgfsServerTransportSessionPut(transportSession);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerAsyncQueueBusy --
+ *
+ *    Tells whether a worker is still running queued requests of the
+ *    transport session.
+ *
+ * Results:
+ *    TRUE if requests received now must be queued behind earlier ones.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+HgfsServerAsyncQueueBusy(HgfsTransportSessionInfo *transportSession)  // IN
+{
+   Bool busy;
+
+   MXUser_AcquireExclLock(transportSession->asyncQueueLock);
+   busy = transportSession->asyncQueueRunning;
+   MXUser_ReleaseExclLock(transportSession->asyncQueueLock);
+
+   return busy;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerQueueRequest --
+ *
+ *    Appends an asynchronous request to its transport session's queue and
+ *    hands the queue to the executor if no worker is draining it already.
+ *    If the executor refuses the work the queue is drained inline.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+HgfsServerQueueRequest(HgfsInputParam *input)  // IN: request
+{
+   HgfsTransportSessionInfo *transportSession = input->transportSession;
+   Bool schedule;
+
+   DblLnkLst_Init(&input->links);
+
+   MXUser_AcquireExclLock(transportSession->asyncQueueLock);
+   DblLnkLst_LinkLast(&transportSession->asyncQueue, &input->links);
+   schedule = !transportSession->asyncQueueRunning;
+   transportSession->asyncQueueRunning = TRUE;
+   MXUser_ReleaseExclLock(transportSession->asyncQueueLock);
+
+   if (schedule) {
+      HgfsServerTransportSessionGet(transportSession);
+      if (!gHgfsExecutor(gHgfsExecutorData, HgfsServerRunAsyncQueue,
+                         transportSession)) {
+         LOG(4, ("%s: executor busy, running request inline.\n", __FUNCTION__));
+         HgfsServerRunAsyncQueue(transportSession);
+      }
+   }
+}
+#endif
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -3071,6 +3572,7 @@ HgfsServerSessionReceive(HgfsPacket *packet,      // IN: Hgfs Packet
    }
 
    packet->id = input->id;
+   input->startNS = HgfsServerStatsStart();
    HGFS_ASSERT_MINIMUM_OP(input->op);
    if (HGFS_ERROR_SUCCESS == status) {
       HGFS_ASSERT_INPUT(input);
@@ -3082,6 +3584,18 @@ HgfsServerSessionReceive(HgfsPacket *packet,      // IN: Hgfs Packet
          /* Initial validation passed, process the client request now. */
          packet->processedAsync = packet->supportsAsync &&
                                          (handlers[input->op].reqType == REQ_ASYNC);
+#ifdef VMX86_TOOLS
+         /*
+          * Without a worker pool there is nobody to hand the request to.
+          * While the transport session still has queued requests, the
+          * synchronous ones are queued behind them too, so that they do
+          * not overtake requests they may depend on.
+          */
+         packet->processedAsync = packet->supportsAsync &&
+                                  gHgfsExecutor != NULL &&
+                                  (handlers[input->op].reqType == REQ_ASYNC ||
+                                   HgfsServerAsyncQueueBusy(transportSession));
+#endif
          if (packet->processedAsync) {
             LOG(4, ("%s: %d: @@Async\n", __FUNCTION__, __LINE__));
 #ifndef VMX86_TOOLS
@@ -3102,8 +3616,8 @@ HgfsServerSessionReceive(HgfsPacket *packet,      // IN: Hgfs Packet
                           1000,
                           NULL);
 #else
-            /* Tools code should never process request async. */
-            ASSERT(0);
+            Atomic_Inc(&gHgfsAsyncCounter);
+            HgfsServerQueueRequest(input);
 #endif
          } else {
             LOG(4, ("%s: %d: ##Sync\n", __FUNCTION__, __LINE__));
@@ -3754,6 +4268,20 @@ HgfsServerSessionConnect(void *transportData,                         // IN: tra
       return FALSE;
    }
 
+#ifdef VMX86_TOOLS
+   transportSession->asyncQueueLock =
+         MXUser_CreateExclLock("HgfsAsyncQueueLock",
+                               RANK_hgfsAsyncQueueLock);
+   if (transportSession->asyncQueueLock == NULL) {
+      LOG(4, ("%s: Could not create async queue mutex.\n", __FUNCTION__));
+      MXUser_DestroyExclLock(transportSession->sessionArrayLock);
+      free(transportSession);
+      return FALSE;
+   }
+   DblLnkLst_Init(&transportSession->asyncQueue);
+   transportSession->asyncQueueRunning = FALSE;
+#endif
+
    DblLnkLst_Init(&transportSession->sessionArray);
 
    transportSession->defaultSessionId = HGFS_INVALID_SESSION_ID;
@@ -3775,8 +4303,8 @@ HgfsServerSessionConnect(void *transportData,                         // IN: tra
  *
  *    Initialize a new Hgfs session.
  *
- *    Allocate HgfsSessionInfo and initialize it. Create the nodeArray and
- *    searchArray for the session.
+ *    Allocate HgfsSessionInfo and initialize it. The node and search pools
+ *    of the session start out empty.
  *
  * Results:
  *    TRUE on success, FALSE otherwise.
@@ -3792,7 +4320,6 @@ HgfsServerAllocateSession(HgfsTransportSessionInfo *transportSession, // IN:
                           uint32 channelCapabilities,                 // IN:
                           HgfsSessionInfo **sessionData)              // OUT:
 {
-   int i;
    HgfsSessionInfo *session;
 
    ASSERT(transportSession);
@@ -3847,19 +4374,15 @@ HgfsServerAllocateSession(HgfsTransportSessionInfo *transportSession, // IN:
    DblLnkLst_Init(&session->nodeFreeList);
    DblLnkLst_Init(&session->nodeCachedList);
 
-   /* Allocate array of FileNodes and add them to free list. */
-   session->numNodes = NUM_FILE_NODES;
-   session->nodeArray = Util_SafeCalloc(session->numNodes,
-                                        sizeof (HgfsFileNode));
+   /* FileNodes are allocated in chunks by HgfsGetNewNode on first use. */
+   session->nodeChunks = NULL;
+   session->numNodeChunks = 0;
+   session->numNodes = 0;
+   session->nodeHandleTable = HashTable_Alloc(HGFS_HANDLE_TABLE_SIZE,
+                                              HASH_INT_KEY, NULL);
    session->numCachedOpenNodes = 0;
    session->numCachedLockedNodes = 0;
 
-   for (i = 0; i < session->numNodes; i++) {
-      DblLnkLst_Init(&session->nodeArray[i].links);
-      /* Append at the end of the list. */
-      DblLnkLst_LinkLast(&session->nodeFreeList, &session->nodeArray[i].links);
-   }
-
    /*
     * Initialize the search handling components.
     */
@@ -3872,17 +4395,12 @@ HgfsServerAllocateSession(HgfsTransportSessionInfo *transportSession, // IN:
    /* Give our session a reference to hold while we are open. */
    HgfsServerSessionGet(session);
 
-   /* Allocate array of searches and add them to free list. */
-   session->numSearches = NUM_SEARCHES;
-   session->searchArray = Util_SafeCalloc(session->numSearches,
-                                          sizeof (HgfsSearch));
-
-   for (i = 0; i < session->numSearches; i++) {
-      DblLnkLst_Init(&session->searchArray[i].links);
-      /* Append at the end of the list. */
-      DblLnkLst_LinkLast(&session->searchFreeList,
-                         &session->searchArray[i].links);
-   }
+   /* Searches are allocated in chunks by HgfsGetNewSearch on first use. */
+   session->searchChunks = NULL;
+   session->numSearchChunks = 0;
+   session->numSearches = 0;
+   session->searchHandleTable = HashTable_Alloc(HGFS_HANDLE_TABLE_SIZE,
+                                                HASH_INT_KEY, NULL);
 
    /* Get common to all sessions capabiities. */
    HgfsServerGetDefaultCapabilities(session->hgfsSessionCapabilities,
@@ -3942,8 +4460,6 @@ HgfsDisconnectSessionInt(HgfsSessionInfo *session)    // IN: session context
 {
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
-   ASSERT(session->searchArray);
    if (session->activeNotification) {
       HgfsNotify_CleanupSession(session);
    }
@@ -3999,8 +4515,8 @@ HgfsServerSessionDisconnect(void *clientData)    // IN: session context
  *
  *    Closes a client session.
  *
- *    Remvoing the final reference will free the session's nodeArray
- *    and seachArrary, and finally free the session object.
+ *    Remvoing the final reference will free the session's node and
+ *    search pools, and finally free the session object.
  *
  * Results:
  *    None.
@@ -4031,7 +4547,7 @@ HgfsServerSessionClose(void *clientData)    // IN: session context
  *
  *    Destroys a session.
  *
- *    Free the session's nodeArray and seachArrary. Free the session.
+ *    Free the session's node and search pools. Free the session.
  *
  *    The caller must have previously acquired the global sessions lock.
  *
@@ -4050,8 +4566,6 @@ HgfsServerExitSessionInternal(HgfsSessionInfo *session)    // IN: session contex
    int i;
 
    ASSERT(session);
-   ASSERT(session->nodeArray);
-   ASSERT(session->searchArray);
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
 
@@ -4060,16 +4574,22 @@ HgfsServerExitSessionInternal(HgfsSessionInfo *session)    // IN: session contex
    for (i = 0; i < session->numNodes; i++) {
       HgfsHandle handle;
 
-      if (session->nodeArray[i].state == FILENODE_STATE_UNUSED) {
+      if (HgfsGetNodeAt(session, i)->state == FILENODE_STATE_UNUSED) {
          continue;
       }
 
-      handle = HgfsFileNode2Handle(&session->nodeArray[i]);
+      handle = HgfsFileNode2Handle(HgfsGetNodeAt(session, i));
       HgfsRemoveFromCacheInternal(handle, session);
       HgfsFreeFileNodeInternal(handle, session);
    }
-   free(session->nodeArray);
-   session->nodeArray = NULL;
+   for (i = 0; i < session->numNodeChunks; i++) {
+      free(session->nodeChunks[i]);
+   }
+   free(session->nodeChunks);
+   session->nodeChunks = NULL;
+   ASSERT(HashTable_GetNumElements(session->nodeHandleTable) == 0);
+   HashTable_Free(session->nodeHandleTable);
+   session->nodeHandleTable = NULL;
 
    MXUser_ReleaseExclLock(session->nodeArrayLock);
 
@@ -4081,13 +4601,19 @@ HgfsServerExitSessionInternal(HgfsSessionInfo *session)    // IN: session contex
    MXUser_AcquireExclLock(session->searchArrayLock);
 
    for (i = 0; i < session->numSearches; i++) {
-      if (DblLnkLst_IsLinked(&session->searchArray[i].links)) {
+      if (DblLnkLst_IsLinked(&HgfsGetSearchAt(session, i)->links)) {
          continue;
       }
-      HgfsRemoveSearchInternal(&session->searchArray[i], session);
+      HgfsRemoveSearchInternal(HgfsGetSearchAt(session, i), session);
    }
-   free(session->searchArray);
-   session->searchArray = NULL;
+   for (i = 0; i < session->numSearchChunks; i++) {
+      free(session->searchChunks[i]);
+   }
+   free(session->searchChunks);
+   session->searchChunks = NULL;
+   ASSERT(HashTable_GetNumElements(session->searchHandleTable) == 0);
+   HashTable_Free(session->searchHandleTable);
+   session->searchHandleTable = NULL;
 
    MXUser_ReleaseExclLock(session->searchArrayLock);
 
@@ -4232,6 +4758,47 @@ HgfsServer_Quiesce(Bool freeze)  // IN:
 }
 
 
+#ifdef VMX86_TOOLS
+/*
+ *----------------------------------------------------------------------------
+ *
+ * HgfsServer_SetExecutor --
+ *
+ *    Sets the worker pool used to run asynchronous requests in Tools. Only
+ *    requests received from transports that support asynchronous replies
+ *    are affected; the rest are still processed in the receive callback.
+ *
+ *    Passing a NULL executor reverts to synchronous processing and waits
+ *    for the requests already handed to the old executor to complete, so
+ *    the caller may tear the pool down afterwards.
+ *
+ * Results:
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *----------------------------------------------------------------------------
+ */
+
+void
+HgfsServer_SetExecutor(HgfsServerExecutorFunc *executor,  // IN: or NULL
+                       void *data)                        // IN: executor data
+{
+   gHgfsExecutor = executor;
+   gHgfsExecutorData = data;
+
+   if (executor == NULL && gHgfsInitialized) {
+      MXUser_AcquireExclLock(gHgfsAsyncLock);
+      while (Atomic_Read(&gHgfsAsyncCounter)) {
+         MXUser_WaitCondVarExclLock(gHgfsAsyncLock, gHgfsAsyncVar);
+      }
+      MXUser_ReleaseExclLock(gHgfsAsyncLock);
+   }
+}
+#endif
+
+
 /*
  *----------------------------------------------------------------------------
  *
@@ -4330,8 +4897,6 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
 
    ASSERT(shares);
    ASSERT(session);
-   ASSERT(session->nodeArray);
-   ASSERT(session->searchArray);
    LOG(4, ("%s: Beginning\n", __FUNCTION__));
 
    MXUser_AcquireExclLock(session->nodeArrayLock);
@@ -4344,13 +4909,13 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
       HgfsHandle handle;
       DblLnkLst_Links *l;
 
-      if (session->nodeArray[i].state == FILENODE_STATE_UNUSED) {
+      if (HgfsGetNodeAt(session, i)->state == FILENODE_STATE_UNUSED) {
          continue;
       }
 
-      handle = HgfsFileNode2Handle(&session->nodeArray[i]);
+      handle = HgfsFileNode2Handle(HgfsGetNodeAt(session, i));
       LOG(4, ("%s: Examining node with fd %d (%s)\n", __FUNCTION__,
-              handle, session->nodeArray[i].utf8Name));
+              handle, HgfsGetNodeAt(session, i)->utf8Name));
 
       /* For each share, is the node within the share? */
       for (l = shares->next; l != shares; l = l->next) {
@@ -4358,7 +4923,7 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
 
          share = DblLnkLst_Container(l, HgfsSharedFolder, links);
          ASSERT(share);
-         if (strcmp(session->nodeArray[i].shareInfo.rootDir, share->path) == 0) {
+         if (strcmp(HgfsGetNodeAt(session, i)->shareInfo.rootDir, share->path) == 0) {
             LOG(4, ("%s: Node is still valid\n", __FUNCTION__));
             break;
          }
@@ -4387,17 +4952,17 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
    for (i = 0; i < session->numSearches; i++) {
       DblLnkLst_Links *l;
 
-      if (DblLnkLst_IsLinked(&session->searchArray[i].links)) {
+      if (DblLnkLst_IsLinked(&HgfsGetSearchAt(session, i)->links)) {
          continue;
       }
 
-      if (HgfsSearchIsBaseNameSpace(&session->searchArray[i])) {
+      if (HgfsSearchIsBaseNameSpace(HgfsGetSearchAt(session, i))) {
          /* Skip search of the base name space. Maybe stale but it is okay. */
          continue;
       }
 
       LOG(4, ("%s: Examining search (%s)\n", __FUNCTION__,
-              session->searchArray[i].utf8Dir));
+              HgfsGetSearchAt(session, i)->utf8Dir));
 
       /* For each share, is the search within the share? */
       for (l = shares->next; l != shares; l = l->next) {
@@ -4405,7 +4970,7 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
 
          share = DblLnkLst_Container(l, HgfsSharedFolder, links);
          ASSERT(share);
-         if (strcmp(session->searchArray[i].shareInfo.rootDir, share->path) == 0) {
+         if (strcmp(HgfsGetSearchAt(session, i)->shareInfo.rootDir, share->path) == 0) {
             LOG(4, ("%s: Search is still valid\n", __FUNCTION__));
             break;
          }
@@ -4414,7 +4979,7 @@ HgfsInvalidateSessionObjects(DblLnkLst_Links *shares,  // IN: List of new shares
       /* If the node wasn't found in any share, remove it. */
       if (l == shares) {
          LOG(4, ("%s: Search is invalid, removing\n", __FUNCTION__));
-         HgfsRemoveSearchInternal(&session->searchArray[i], session);
+         HgfsRemoveSearchInternal(HgfsGetSearchAt(session, i), session);
       }
    }
 
@@ -4972,12 +5537,12 @@ HgfsServerDumpDents(HgfsHandle searchHandle,  // IN: Handle to dump dents from
 
    search = HgfsSearchHandle2Search(searchHandle, session);
    if (search != NULL) {
-      Log("%s: %u dents in \"%s\"\n", __FUNCTION__, search->numDents,
+      Log("%s: %u dents in \"%s\"\n", __FUNCTION__, search->dents.numDents,
           search->utf8Dir);
 
       Log("Dumping dents:\n");
-      for (i = 0; i < search->numDents; i++) {
-         Log("\"%s\"\n", search->dents[i]->d_name);
+      for (i = 0; i < search->dents.numDents; i++) {
+         Log("\"%s\"\n", HgfsDirentStoreName(&search->dents, i));
       }
    }
 
@@ -4992,12 +5557,12 @@ HgfsServerDumpDents(HgfsHandle searchHandle,  // IN: Handle to dump dents from
  * HgfsServerGetDents --
  *
  *    Get directory entry names from the given callback function, and
- *    build an array of DirectoryEntrys of all the names. Somewhat similar to
+ *    add all of them to the given dirent store. Somewhat similar to
  *    scandir(3) on linux, but more general.
  *
  * Results:
- *    On success, the number of directory entries found.
- *    On failure, negative error.
+ *    TRUE on success, the store holds the directory entries found.
+ *    FALSE on failure, the store is left empty.
  *
  * Side effects:
  *    Memory allocation.
@@ -5005,17 +5570,16 @@ HgfsServerDumpDents(HgfsHandle searchHandle,  // IN: Handle to dump dents from
  *-----------------------------------------------------------------------------
  */
 
-static int
+static Bool
 HgfsServerGetDents(HgfsGetNameFunc getName,     // IN: Function to get name
                    HgfsInitFunc initName,       // IN: Setup function
                    HgfsCleanupFunc cleanupName, // IN: Cleanup function
-                   DirectoryEntry ***dents)     // OUT: Array of DirectoryEntrys
+                   HgfsDirentStore *dents)      // OUT: Directory entries
 {
-   uint32 totalDents = 0;   // Number of allocated dents
-   uint32 numDents = 0;     // Current actual number of dents
-   DirectoryEntry **myDents = NULL; // So realloc is happy w/ zero numDents
    void *state;
 
+   HgfsDirentStoreInit(dents);
+
    state = initName();
    if (!state) {
       LOG(4, ("%s: Couldn't init state\n", __FUNCTION__));
@@ -5023,18 +5587,16 @@ HgfsServerGetDents(HgfsGetNameFunc getName,     // IN: Function to get name
    }
 
    for (;;) {
-      DirectoryEntry *pDirEntry;
       char const *name;
       size_t len;
       Bool done = FALSE;
-      size_t newDirEntryLen;
       size_t maxLen;
 
       /* Add '.' and ".." as the first dents. */
-      if (numDents == 0) {
+      if (dents->numDents == 0) {
          name = ".";
          len = 1;
-      } else if (numDents == 1) {
+      } else if (dents->numDents == 1) {
          name = "..";
          len = 2;
       } else {
@@ -5058,51 +5620,20 @@ HgfsServerGetDents(HgfsGetNameFunc getName,     // IN: Function to get name
        */
       maxLen = PATH_MAX;
 #else
-      maxLen = sizeof pDirEntry->d_name;
+      maxLen = sizeof ((DirectoryEntry *)0)->d_name;
 #endif
       if (len >= maxLen) {
          Log("%s: Error: Name \"%s\" is too long.\n", __FUNCTION__, name);
          continue;
       }
 
-      /* See if we need to allocate more memory */
-      if (numDents == totalDents) {
-         void *p;
-
-         if (totalDents != 0) {
-            totalDents *= 2;
-         } else {
-            totalDents = 100;
-         }
-         p = realloc(myDents, totalDents * sizeof *myDents);
-         if (!p) {
-            LOG(4, ("%s: Couldn't reallocate array memory\n", __FUNCTION__));
-            goto error;
-         }
-         myDents = (DirectoryEntry **)p;
-      }
-
       /* This file/directory can be added to the list. */
       LOG(4, ("%s: Nextfilename = \"%s\"\n", __FUNCTION__, name));
 
-      /*
-       * Start with the size of the DirectoryEntry struct, subtract the static
-       * length of the d_name buffer (256 in Linux, 1 in Solaris, etc) and add
-       * back just enough space for the UTF-8 name and nul terminator.
-       */
-
-      newDirEntryLen = sizeof *pDirEntry - sizeof pDirEntry->d_name + len + 1;
-      pDirEntry = (DirectoryEntry *)malloc(newDirEntryLen);
-      if (!pDirEntry) {
-         LOG(4, ("%s: Couldn't allocate dentry memory\n", __FUNCTION__));
+      if (!HgfsDirentStoreAdd(dents, name, len)) {
+         LOG(4, ("%s: Couldn't allocate dent memory\n", __FUNCTION__));
          goto error;
       }
-      pDirEntry->d_reclen = (unsigned short)newDirEntryLen;
-      memcpy(pDirEntry->d_name, name, len);
-      pDirEntry->d_name[len] = 0;
-
-      myDents[numDents] = pDirEntry;
-      numDents++;
    }
 
    /* We are done; cleanup the state */
@@ -5111,20 +5642,7 @@ HgfsServerGetDents(HgfsGetNameFunc getName,     // IN: Function to get name
       goto error_free;
    }
 
-   /* Trim extra memory off of dents */
-   {
-      void *p;
-
-      p = realloc(myDents, numDents * sizeof *myDents);
-      if (!p) {
-         LOG(4, ("%s: Couldn't realloc less array memory\n", __FUNCTION__));
-         *dents = myDents;
-      } else {
-         *dents = (DirectoryEntry **)p;
-      }
-   }
-
-   return numDents;
+   return TRUE;
 
 error:
    /* Cleanup the callback state */
@@ -5134,17 +5652,9 @@ error:
 
 error_free:
    /* Free whatever has been allocated so far */
-   {
-      unsigned int i;
-
-      for (i = 0; i < numDents; i++) {
-         free(myDents[i]);
-      }
-
-      free(myDents);
-   }
+   HgfsDirentStoreDestroy(dents);
 
-   return -1;
+   return FALSE;
 }
 
 
@@ -5183,7 +5693,6 @@ HgfsServerSearchRealDir(char const *baseDir,      // IN: Directory to search
    HgfsSearch *search = NULL;
    HgfsInternalStatus status = 0;
    HgfsNameStatus nameStatus;
-   int numDents;
    Bool followSymlinks;
    HgfsShareOptions configOptions;
 
@@ -5215,14 +5724,13 @@ HgfsServerSearchRealDir(char const *baseDir,      // IN: Directory to search
                                                       HGFS_SHARE_FOLLOW_SYMLINKS);
 
    status = HgfsServerScandir(baseDir, baseDirLen, followSymlinks,
-                              &search->dents, &numDents);
+                              &search->dents);
    if (status != 0) {
       LOG(4, ("%s: couldn't scandir\n", __FUNCTION__));
       HgfsRemoveSearchInternal(search, session);
       goto out;
    }
 
-   search->numDents = numDents;
    *handle = HgfsSearch2SearchHandle(search);
 
   out:
@@ -5262,7 +5770,6 @@ HgfsServerSearchVirtualDir(HgfsGetNameFunc *getName,     // IN: Name enumerator
 {
    HgfsInternalStatus status = 0;
    HgfsSearch *search = NULL;
-   int result = 0;
 
    ASSERT(getName);
    ASSERT(initName);
@@ -5278,15 +5785,13 @@ HgfsServerSearchVirtualDir(HgfsGetNameFunc *getName,     // IN: Name enumerator
       goto out;
    }
 
-   result = HgfsServerGetDents(getName, initName, cleanupName, &search->dents);
-   if (result < 0) {
+   if (!HgfsServerGetDents(getName, initName, cleanupName, &search->dents)) {
       LOG(4, ("%s: couldn't get dents\n", __FUNCTION__));
       HgfsRemoveSearchInternal(search, session);
       status = HGFS_ERROR_INTERNAL;
       goto out;
    }
 
-   search->numDents = result;
    *handle = HgfsSearch2SearchHandle(search);
 
   out:
@@ -5638,6 +6143,7 @@ HgfsServerRead(HgfsInputParam *input)  // IN: Input params
    HgfsHandle file;
    uint64 offset;
    uint32 requiredSize;
+   uint32 actualSize;
    size_t replyPayloadSize = 0;
 
    HGFS_ASSERT_INPUT(input);
@@ -5651,7 +6157,6 @@ HgfsServerRead(HgfsInputParam *input)  // IN: Input params
       case HGFS_OP_READ_FAST_V4:
       case HGFS_OP_READ_V3: {
             HgfsReplyReadV3 *reply;
-            void *payload;
             uint32 inlineDataSize =
                (HGFS_OP_READ_FAST_V4 == input->op) ? 0 : requiredSize;
 
@@ -5660,25 +6165,39 @@ HgfsServerRead(HgfsInputParam *input)  // IN: Input params
                                     input->session)) {
                status = HGFS_ERROR_PROTOCOL;
                LOG(4, ("%s: V3/V4 Failed to alloc reply -> PROTOCOL_ERROR.\n", __FUNCTION__));
-            } else {
-               if (HGFS_OP_READ_V3 == input->op) {
-                  payload = &reply->payload[0];
-               } else {
-                  payload = HSPU_GetDataPacketBuf(input->packet, BUF_WRITEABLE,
-                                                  input->transportSession);
-               }
-               if (payload) {
-                  status = HgfsPlatformReadFile(file, input->session, offset,
-                                                requiredSize, payload,
-                                                &reply->actualSize);
+            } else if (HGFS_OP_READ_FAST_V4 == input->op) {
+               HgfsVaIov iovBuf[HSPU_DATA_IOV_BUF_ENTRIES];
+               HgfsVaIov *iov;
+               uint32 iovCount;
+
+               /* Read straight into the guest pages, no contiguous copy. */
+               iov = HSPU_GetDataPacketIov(input->packet, BUF_WRITEABLE,
+                                           input->transportSession, iovBuf,
+                                           ARRAYSIZE(iovBuf), &iovCount);
+               if (iov) {
+                  status = HgfsPlatformReadFileV(file, input->session, offset,
+                                                 requiredSize, iov, iovCount,
+                                                 &actualSize);
+                  HSPU_PutDataPacketIov(input->packet, iov, iovCount, iovBuf,
+                                        input->transportSession);
                   if (HGFS_ERROR_SUCCESS == status) {
+                     reply->actualSize = actualSize;
                      reply->reserved = 0;
-                     replyPayloadSize = sizeof *reply +
-                                         ((inlineDataSize > 0) ? reply->actualSize : 0);
+                     replyPayloadSize = sizeof *reply;
+                     input->dataBytesOut = actualSize;
                   }
                } else {
                   status = HGFS_ERROR_PROTOCOL;
-                  LOG(4, ("%s: V3/V4 Failed to get payload -> PROTOCOL_ERROR.\n", __FUNCTION__));
+                  LOG(4, ("%s: V4 Failed to get payload -> PROTOCOL_ERROR.\n", __FUNCTION__));
+               }
+            } else {
+               status = HgfsPlatformReadFile(file, input->session, offset,
+                                             requiredSize, &reply->payload[0],
+                                             &actualSize);
+               if (HGFS_ERROR_SUCCESS == status) {
+                  reply->actualSize = actualSize;
+                  reply->reserved = 0;
+                  replyPayloadSize = sizeof *reply + reply->actualSize;
                }
             }
             break;
@@ -5690,8 +6209,9 @@ HgfsServerRead(HgfsInputParam *input)  // IN: Input params
                                    sizeof *reply + requiredSize, (void **)&reply,
                                    input->session)) {
                status = HgfsPlatformReadFile(file, input->session, offset, requiredSize,
-                                             reply->payload, &reply->actualSize);
+                                             reply->payload, &actualSize);
                if (HGFS_ERROR_SUCCESS == status) {
+                  reply->actualSize = actualSize;
                   replyPayloadSize = sizeof *reply + reply->actualSize;
                } else {
                   LOG(4, ("%s: V1 Failed to read-> %d.\n", __FUNCTION__, status));
@@ -5744,8 +6264,39 @@ HgfsServerWrite(HgfsInputParam *input)  // IN: Input params
 
    HGFS_ASSERT_INPUT(input);
 
-   if (HgfsUnpackWriteRequest(input, &file, &offset, &numberBytesToWrite,
-                              &flags, &dataToWrite)) {
+   if (HGFS_OP_WRITE_FAST_V4 == input->op) {
+      HgfsVaIov iovBuf[HSPU_DATA_IOV_BUF_ENTRIES];
+      HgfsVaIov *iov;
+      uint32 iovCount;
+
+      /* Write straight from the guest pages, no contiguous copy. */
+      if (!HgfsUnpackWriteFastPayloadV4((HgfsRequestWriteV3 *)input->payload,
+                                        input->payloadSize,
+                                        &file, &offset, &numberBytesToWrite,
+                                        &flags)) {
+         status = HGFS_ERROR_PROTOCOL;
+      } else if ((iov = HSPU_GetDataPacketIov(input->packet, BUF_READABLE,
+                                              input->transportSession, iovBuf,
+                                              ARRAYSIZE(iovBuf),
+                                              &iovCount)) == NULL) {
+         LOG(4, ("%s: Failed to get data in guest memory\n", __FUNCTION__));
+         status = HGFS_ERROR_PROTOCOL;
+      } else {
+         status = HgfsPlatformWriteFileV(file, input->session, offset,
+                                         numberBytesToWrite, flags, iov,
+                                         iovCount, &replyActualSize);
+         HSPU_PutDataPacketIov(input->packet, iov, iovCount, iovBuf,
+                               input->transportSession);
+         input->dataBytesIn = numberBytesToWrite;
+         if (HGFS_ERROR_SUCCESS == status &&
+             !HgfsPackWriteReply(input->packet, input->metaPacket, input->op,
+                                 replyActualSize, &replyPayloadSize,
+                                 input->session)) {
+            status = HGFS_ERROR_INTERNAL;
+         }
+      }
+   } else if (HgfsUnpackWriteRequest(input, &file, &offset, &numberBytesToWrite,
+                                     &flags, &dataToWrite)) {
 
       status = HgfsPlatformWriteFile(file, input->session, offset, numberBytesToWrite,
                                      flags, dataToWrite, &replyActualSize);
@@ -7721,6 +8272,15 @@ HgfsGetDirEntry(HgfsHandle hgfsSearchHandle,     // IN: ID for search data
                   LOG(4, ("%s: Reusing existing oplocked handle "
                           "to avoid oplock break deadlock\n", __FUNCTION__));
                   status = HgfsPlatformGetattrFromFd(fileDesc, session, attr);
+               } else if (HgfsGetSearchResultAttr(hgfsSearchHandle, search,
+                                                  configOptions, session,
+                                                  requestedIndex, attr)) {
+                  /*
+                   * The attributes prefetched for this batch of entries were
+                   * obtained relative to the directory, without a path lookup.
+                   */
+                  LOG(4, ("%s: using prefetched attributes for \"%s\"\n",
+                          __FUNCTION__, dent->d_name));
                } else {
                   status = HgfsPlatformGetattrFromName(fullName, configOptions,
                                                        search->utf8ShareName, attr, NULL);
@@ -8101,6 +8661,9 @@ HgfsServerSearchRead(HgfsInputParam *input)  // IN: Input params
                      LOG(4, ("%s: no matching share: %s.\n", __FUNCTION__,
                              search.utf8ShareName));
                      status = HGFS_ERROR_FILE_NOT_FOUND;
+                  } else if (0 == info.startIndex) {
+                     /* The client starts over, don't serve it stale attributes. */
+                     HgfsDropSearchAttrs(hgfsSearchHandle, input->session);
                   }
                } else if (0 == info.startIndex) {
                   HgfsSearch *rootSearch;
@@ -8111,15 +8674,12 @@ HgfsServerSearchRead(HgfsInputParam *input)  // IN: Input params
                   ASSERT(NULL != rootSearch);
                   HgfsFreeSearchDirents(rootSearch);
 
-                  rootSearch->numDents =
-                     HgfsServerGetDents(HgfsServerPolicy_GetShares,
-                                        HgfsServerPolicy_GetSharesInit,
-                                        HgfsServerPolicy_GetSharesCleanup,
-                                        &rootSearch->dents);
-                  if (((int) (rootSearch->numDents)) < 0) {
+                  if (!HgfsServerGetDents(HgfsServerPolicy_GetShares,
+                                          HgfsServerPolicy_GetSharesInit,
+                                          HgfsServerPolicy_GetSharesCleanup,
+                                          &rootSearch->dents)) {
                      ASSERT_DEVEL(0);
                      LOG(4, ("%s: couldn't get root dents\n", __FUNCTION__));
-                     rootSearch->numDents = 0;
                      status = HGFS_ERROR_INTERNAL;
                   }
 
@@ -75,6 +75,7 @@
 #include "hgfsUtil.h"   // for HgfsInternalStatus
 #include "vm_atomic.h"
 #include "userlock.h"
+#include "hashTable.h"
 
 #define HGFS_DEBUG_ASYNC   (0)
 
@@ -229,6 +230,37 @@ typedef struct HgfsFileNode {
 /* Whether this a shared folder open. */
 #define HGFS_FILE_NODE_SHARED_FOLDER_OPEN_FL   (1 << 2)
 
+/*
+ * Directory entries collected for a search.
+ *
+ * Rather than allocating a DirectoryEntry per name, the names are packed
+ * back to back (nul-terminated) into one growable blob and indexed by their
+ * offset within it. Both the blob and the index grow geometrically, so
+ * enumerating a directory costs O(log n) allocations instead of two per
+ * entry.
+ */
+typedef struct HgfsDirentStore {
+   /* Packed, nul-terminated entry names */
+   char *names;
+
+   /* Bytes of the names blob in use and allocated */
+   size_t namesLen;
+   size_t namesSize;
+
+   /* Offset of each entry's name within the blob */
+   size_t *offsets;
+
+   /*
+    * Attributes prefetched for the entries, parallel to offsets. Allocated
+    * on first use; an entry whose mask is zero has not been fetched yet.
+    */
+   struct HgfsFileAttrInfo *attrs;
+
+   /* Number of entries and number of offset slots allocated */
+   uint32 numDents;
+   uint32 maxDents;
+} HgfsDirentStore;
+
 /*
  * This struct represents a file search that a client initiated.
  *
@@ -256,10 +288,10 @@ typedef struct HgfsSearch {
    size_t utf8ShareNameLen;
 
    /* Directory entries for this search */
-   DirectoryEntry **dents;
+   HgfsDirentStore dents;
 
-   /* Number of dents */
-   uint32 numDents;
+   /* Bumped whenever the entries or their cached attributes are dropped */
+   uint32 dentsGeneration;
 
    /*
     * What type of search is this (what objects does it track)? This is
@@ -315,6 +347,16 @@ typedef struct HgfsTransportSessionInfo {
    Atomic_uint32 refCount;    /* Reference count for session. */
 
    uint32 channelCapabilities;
+
+#ifdef VMX86_TOOLS
+   /*
+    * Asynchronous requests waiting for a worker. Requests of one transport
+    * session are run in the order they were received.
+    */
+   MXUserExclLock *asyncQueueLock;
+   DblLnkLst_Links asyncQueue;
+   Bool asyncQueueRunning;
+#endif
 } HgfsTransportSessionInfo;
 
 typedef struct HgfsSessionInfo {
@@ -345,17 +387,26 @@ typedef struct HgfsSessionInfo {
    /*
     ** START NODE ARRAY **************************************************
     *
-    * Lock for the following 6 fields: the node array,
+    * Lock for the following 8 fields: the node chunks,
     * counters and lists for this session.
     */
    MXUserExclLock *nodeArrayLock;
 
-   /* Open file nodes of this session. */
-   HgfsFileNode *nodeArray;
+   /*
+    * Open file nodes of this session. Nodes are allocated in fixed size
+    * chunks which are never moved or freed until the session goes away.
+    */
+   HgfsFileNode **nodeChunks;
+
+   /* Number of chunks in nodeChunks. */
+   uint32 numNodeChunks;
 
-   /* Number of nodes in the nodeArray. */
+   /* Number of nodes in all the nodeChunks. */
    uint32 numNodes;
 
+   /* In use nodes keyed by HGFS handle. */
+   HashTable *nodeHandleTable;
+
    /* Free list of file nodes. LIFO to be cache-friendly. */
    DblLnkLst_Links nodeFreeList;
 
@@ -372,17 +423,23 @@ typedef struct HgfsSessionInfo {
    /*
     ** START SEARCH ARRAY ************************************************
     *
-    * Lock for the following three fields: for the search array
-    * and it's counter and list, for this session.
+    * Lock for the following five fields: for the search chunks
+    * and their counters, index and list, for this session.
     */
    MXUserExclLock *searchArrayLock;
 
-   /* Directory entry cache for this session. */
-   HgfsSearch *searchArray;
+   /* Directory entry cache for this session, allocated like nodeChunks. */
+   HgfsSearch **searchChunks;
+
+   /* Number of chunks in searchChunks. */
+   uint32 numSearchChunks;
 
-   /* Number of entries in searchArray. */
+   /* Number of entries in all the searchChunks. */
    uint32 numSearches;
 
+   /* In use searches keyed by HGFS handle. */
+   HashTable *searchHandleTable;
+
    /* Free list of searches. LIFO. */
    DblLnkLst_Links searchFreeList;
    /** END SEARCH ARRAY ****************************************************/
@@ -530,8 +587,22 @@ typedef struct HgfsInputParam {
    HgfsOp op;
    uint32 id;
    Bool v4header;
+   uint64 startNS;          // HgfsServerStatsStart(), 0 if not timed
+   uint32 dataBytesIn;      // Bytes taken from the data packet
+   uint32 dataBytesOut;     // Bytes returned in the data packet
+#ifdef VMX86_TOOLS
+   DblLnkLst_Links links;   // Link in the transport session's async queue
+#endif
 } HgfsInputParam;
 
+/* Per-op statistics, see hgfsServerStats.c. */
+uint64 HgfsServerStatsStart(void);
+void HgfsServerStatsSample(HgfsOp op,
+                           HgfsInternalStatus status,
+                           uint64 bytesIn,
+                           uint64 bytesOut,
+                           uint64 startNS);
+
 Bool
 HgfsCreateAndCacheFileNode(HgfsFileOpenInfo *openInfo, // IN: Open info struct
                            HgfsLocalId const *localId, // IN: Local unique file ID
@@ -557,6 +628,17 @@ void
 HgfsServerDumpDents(HgfsHandle searchHandle,   // IN: Handle to dump dents from
                     HgfsSessionInfo *session); // IN: Session info
 
+void
+HgfsDirentStoreInit(HgfsDirentStore *store);   // OUT: Store to initialize
+
+Bool
+HgfsDirentStoreAdd(HgfsDirentStore *store,     // IN/OUT: Store to add to
+                   char const *name,           // IN: Entry name
+                   size_t nameLen);            // IN: Length of name
+
+void
+HgfsDirentStoreDestroy(HgfsDirentStore *store); // IN/OUT: Store to free
+
 DirectoryEntry *
 HgfsGetSearchResult(HgfsHandle handle,        // IN: Handle to search
                     HgfsSessionInfo *session, // IN: Session info
@@ -593,8 +675,7 @@ HgfsInternalStatus
 HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
                   size_t baseDirLen,        // IN: Length of directory
                   Bool followSymlinks,      // IN: followSymlinks config option
-                  DirectoryEntry ***dents,  // OUT: Array of DirectoryEntrys
-                  int *numDents);           // OUT: Number of DirectoryEntrys
+                  HgfsDirentStore *dents);  // OUT: Directory entries
 
 HgfsInternalStatus
 HgfsServerSearchRealDir(char const *baseDir,      // IN: Directory to search
@@ -871,6 +952,13 @@ HgfsUnpackReadRequest(void const *packet,     // IN: HGFS request
                       uint64 *offset,         // OUT: offset to read from
                       uint32 *length);        // OUT: length of data to read
 Bool
+HgfsUnpackWriteFastPayloadV4(HgfsRequestWriteV3 *requestV3, // IN: payload
+                             size_t payloadSize,            // IN: request payload size
+                             HgfsHandle* file,              // OUT: HGFS handle write to
+                             uint64 *offset,                // OUT: offset to write to
+                             uint32 *length,                // OUT: size of data to write
+                             HgfsWriteFlags *flags);        // OUT: write flags
+Bool
 HgfsUnpackWriteRequest(HgfsInputParam *input,   // IN: Input params
                        HgfsHandle *file,        // OUT: Handle to write to
                        uint64 *offset,          // OUT: offset to write to
@@ -1121,6 +1209,13 @@ HgfsPlatformGetattrFromName(char *fileName,                 // IN: file name
                             HgfsFileAttrInfo *attr,         // OUT: file attributes
                             char **targetName);             // OUT: Symlink target
 HgfsInternalStatus
+HgfsPlatformGetattrFromDirents(char const *dirName,            // IN: directory of entries
+                               HgfsShareOptions configOptions, // IN: configuration options
+                               char *shareName,                // IN: share name
+                               char const **names,             // IN: entry names
+                               uint32 numNames,                // IN: number of names
+                               HgfsFileAttrInfo *attrs);       // OUT: attributes per name
+HgfsInternalStatus
 HgfsPlatformSearchDir(HgfsNameStatus nameStatus,       // IN: name status
                       char *dirName,                   // IN: relative directory name
                       uint32 dirNameLength,            // IN: length of dirName
@@ -1150,6 +1245,23 @@ HgfsPlatformWriteFile(HgfsHandle file,             // IN: Hgfs file handle
                       void* payload,               // IN: data to be written
                       uint32 *actualSize);         // OUT: actual length written
 HgfsInternalStatus
+HgfsPlatformReadFileV(HgfsHandle file,             // IN: Hgfs file handle
+                      HgfsSessionInfo *session,    // IN: session info
+                      uint64 offset,               // IN: file offset to read from
+                      uint32 requiredSize,         // IN: length of data to read
+                      HgfsVaIov *iov,              // OUT: buffers for the read data
+                      uint32 iovCount,             // IN: entries in iov
+                      uint32 *actualSize);         // OUT: actual length read
+HgfsInternalStatus
+HgfsPlatformWriteFileV(HgfsHandle file,             // IN: Hgfs file handle
+                       HgfsSessionInfo *session,    // IN: session info
+                       uint64 offset,               // IN: file offset to write to
+                       uint32 requiredSize,         // IN: length of data to write
+                       HgfsWriteFlags flags,        // IN: write flags
+                       HgfsVaIov *iov,              // IN: data to be written
+                       uint32 iovCount,             // IN: entries in iov
+                       uint32 *actualSize);         // OUT: actual length written
+HgfsInternalStatus
 HgfsPlatformWriteWin32Stream(HgfsHandle file,           // IN: packet header
                              char *dataToWrite,         // IN: data to write
                              size_t requiredSize,       // IN: data size
@@ -1246,6 +1358,17 @@ HSPU_GetDataPacketBuf(HgfsPacket *packet,        // IN/OUT: Hgfs Packet
                       MappingType mappingType,   // IN: Readable/ Writeable ?
                       HgfsTransportSessionInfo *transportSession); // IN: Session Info
 
+/* Size of the caller's iov buffer for HSPU_GetDataPacketIov. */
+#define HSPU_DATA_IOV_BUF_ENTRIES 32
+
+HgfsVaIov *
+HSPU_GetDataPacketIov(HgfsPacket *packet,        // IN/OUT: Hgfs Packet
+                      MappingType mappingType,   // IN: Readable/ Writeable ?
+                      HgfsTransportSessionInfo *transportSession, // IN: Session Info
+                      HgfsVaIov *iovBuf,         // IN: Caller's buffer
+                      uint32 iovBufCount,        // IN: Entries in iovBuf
+                      uint32 *iovCount);         // OUT: Entries in the iov
+
 void
 HSPU_PutPacket(HgfsPacket *packet,         // IN/OUT: Hgfs Packet
                HgfsTransportSessionInfo *transportSession);  // IN: Session Info
@@ -1263,6 +1386,13 @@ void
 HSPU_PutDataPacketBuf(HgfsPacket *packet,         // IN/OUT: Hgfs Packet
                       HgfsTransportSessionInfo *transportSession);  // IN: Session Info
 
+void
+HSPU_PutDataPacketIov(HgfsPacket *packet,         // IN/OUT: Hgfs Packet
+                      HgfsVaIov *iov,             // IN: Iov to be freed
+                      uint32 iovCount,            // IN: Entries in the iov
+                      HgfsVaIov *iovBuf,          // IN: Caller's buffer
+                      HgfsTransportSessionInfo *transportSession);  // IN: Session Info
+
 void
 HSPU_PutMetaPacket(HgfsPacket *packet,        // IN/OUT: Hgfs Packet
                    HgfsTransportSessionInfo *transportSession); // IN: Session Info
@@ -42,7 +42,9 @@
 #include <sys/syscall.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <dirent.h>
+#include <limits.h>
 
 #if defined(__FreeBSD__)
 #   include <sys/param.h>
@@ -64,7 +66,10 @@
 #include "su.h"
 #include "codeset.h"
 #include "unicodeOperations.h"
+#include "unicodeTransforms.h"
 #include "userlock.h"
+#include "mutexRankLib.h"
+#include "hashTable.h"
 
 #if defined(linux) && !defined(SYS_getdents64)
 /* For DT_UNKNOWN */
@@ -99,6 +104,26 @@
 #   include "sig.h"
 #endif
 
+/*
+ * preadv/pwritev appeared in glibc 2.10; elsewhere HgfsVectoredIO issues
+ * one positional call per vector entry.
+ */
+#if defined(__linux__) && defined(__GLIBC_PREREQ)
+#   if __GLIBC_PREREQ(2, 10)
+#      define HGFS_HAVE_PREADV
+#   endif
+#endif
+
+/* Maximum number of vector entries passed to a single system call. */
+#if defined(IOV_MAX)
+#   define HGFS_IOV_MAX IOV_MAX
+#else
+#   define HGFS_IOV_MAX 16
+#endif
+
+/* Vectors up to this many entries are converted on the stack. */
+#define HGFS_IOV_STACK_ENTRIES 32
+
 /*
  * On Linux, we must wrap getdents64, as glibc does not wrap it for us. We use getdents64
  * (rather than getdents) because with the latter, we'll get 64-bit offsets and inode
@@ -200,6 +225,13 @@ getdents_apple(DIR *fd,               // IN
 #define O_NOFOLLOW 0
 #endif
 
+/*
+ * Size of the buffer each getdents(2) call fills. The kernel returns as many
+ * records as fit, so a large buffer keeps the number of syscalls low on big
+ * directories.
+ */
+#define HGFS_GETDENTS_BUFSIZE (64 * 1024)
+
 
 #if defined(sun) || defined(linux) || \
     (defined(__FreeBSD_version) && __FreeBSD_version < 490000)
@@ -240,6 +272,30 @@ futimes(int fd, const struct timeval times[2])
 #undef STRLEN_OF_MAXINT_AS_STRING
 #endif
 
+/*
+ * Case-insensitive lookups are resolved using a cache of directory indices,
+ * keyed by directory path. Each index maps the case folded names of the
+ * entries of a directory to their real names, and is used for as long as
+ * the directory's inode and mtime don't change. Once the cache is full, the
+ * least recently used index is evicted to make room for a new one.
+ */
+#define HGFS_CASE_DIR_CACHE_SIZE  256   /* Initial size of the cache. */
+#define HGFS_CASE_DIR_CACHE_MAX   1024  /* Max number of cached directories. */
+#define HGFS_CASE_DIR_INDEX_SIZE  64    /* Initial size of an index. */
+
+typedef struct HgfsCaseDirIndex {
+   DblLnkLst_Links links;  /* Position in gHgfsCaseDirLru */
+   char *dirPath;          /* Key of the index in gHgfsCaseDirCache */
+   dev_t dev;
+   ino_t ino;
+   time_t mtime;
+   HashTable *names;  /* Case folded name -> real name */
+} HgfsCaseDirIndex;
+
+static MXUserExclLock *gHgfsCaseDirLock;
+static HashTable *gHgfsCaseDirCache;  /* Directory path -> HgfsCaseDirIndex */
+static DblLnkLst_Links gHgfsCaseDirLru;  /* Cached indices, most recent first */
+
 #if defined(__APPLE__)
 struct FInfoAttrBuf {
    uint32 length;
@@ -290,6 +346,8 @@ static int HgfsFStat(int fd,
                      struct stat *stats,
                      uint64 *creationTime);
 
+static void HgfsCaseDirIndexFree(void *data);
+
 static int HgfsConvertComponentCase(char *currentComponent,
                                     const char *dirPath,
                                     const char **convertedComponent,
@@ -603,6 +661,19 @@ HgfsServerPlatformInit(void)
    /* Register a signal handler to catch oplock break signals. */
    Sig_Callback(SIGIO, SIG_SAFE, HgfsServerSigOplockBreak, NULL);
 #endif
+
+   /*
+    * The case-insensitive lookup cache is optional: without it, lookups just
+    * read the directories every time.
+    */
+   DblLnkLst_Init(&gHgfsCaseDirLru);
+   gHgfsCaseDirLock = MXUser_CreateExclLock("HgfsCaseDirLock",
+                                            RANK_hgfsCaseDirLock);
+   if (gHgfsCaseDirLock != NULL) {
+      gHgfsCaseDirCache = HashTable_Alloc(HGFS_CASE_DIR_CACHE_SIZE,
+                                          HASH_STRING_KEY | HASH_FLAG_COPYKEY,
+                                          HgfsCaseDirIndexFree);
+   }
    return TRUE;
 }
 
@@ -630,6 +701,15 @@ HgfsServerPlatformDestroy(void)
    /* Tear down oplock state, so we no longer catch signals. */
    Sig_Callback(SIGIO, SIG_NOHANDLER, NULL, NULL);
 #endif
+
+   if (gHgfsCaseDirCache != NULL) {
+      HashTable_Free(gHgfsCaseDirCache);
+      gHgfsCaseDirCache = NULL;
+   }
+   if (gHgfsCaseDirLock != NULL) {
+      MXUser_DestroyExclLock(gHgfsCaseDirLock);
+      gHgfsCaseDirLock = NULL;
+   }
 }
 
 
@@ -1371,6 +1451,32 @@ HgfsGetattrResolveAlias(char const *fileName,       // IN:  Input filename
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsIsDotHiddenName --
+ *
+ *    Checks whether a file name (last path component only) is a "dot" file
+ *    that should be reported as hidden to Windows clients.
+ *
+ * Results:
+ *    TRUE if the name begins with a dot and is neither "." nor "..".
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+HgfsIsDotHiddenName(char const *baseName)      // IN: Last path component
+{
+   return baseName[0] == '.' &&
+          strcmp(baseName, ".") != 0 &&
+          strcmp(baseName, "..") != 0;
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -1401,10 +1507,7 @@ HgfsGetHiddenAttr(char const *fileName,         // IN:  Input filename
 
    baseName = strrchr(fileName, DIRSEPC);
 
-   if ((baseName != NULL) &&
-       (baseName[1] == '.') &&
-       (strcmp(&baseName[1], ".") != 0) &&
-       (strcmp(&baseName[1], "..") != 0)) {
+   if ((baseName != NULL) && HgfsIsDotHiddenName(&baseName[1])) {
       attr->mask |= HGFS_ATTR_VALID_FLAGS;
       attr->flags |= HGFS_ATTR_HIDDEN;
       /*
@@ -1432,6 +1535,156 @@ HgfsGetHiddenAttr(char const *fileName,         // IN:  Input filename
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsCaseDirIndexFree --
+ *
+ *    Frees a directory index built by HgfsCaseDirIndexCreate.
+ *
+ * Results:
+ *    None.
+ *
+ * Side effects:
+ *    Removes the index from the LRU list of the cache, if it is cached.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+HgfsCaseDirIndexFree(void *data)  // IN: HgfsCaseDirIndex
+{
+   HgfsCaseDirIndex *index = data;
+
+   DblLnkLst_Unlink1(&index->links);
+   HashTable_Free(index->names);
+   free(index->dirPath);
+   free(index);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsCaseDirIndexCreate --
+ *
+ *    Reads all the entries of a directory and builds a map from the case
+ *    folded name of each entry to its real name. If several entries only
+ *    differ in case, the first one returned by readdir wins.
+ *
+ * Results:
+ *    0 and the new index in 'index' on success, errno on failure.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+HgfsCaseDirIndexCreate(const char *dirPath,             // IN
+                       const struct stat *dirStat,      // IN
+                       HgfsCaseDirIndex **index)        // OUT
+{
+   struct dirent *dirent;
+   HgfsCaseDirIndex *myIndex;
+   DIR *dir;
+
+   dir = Posix_OpenDir(dirPath);
+   if (!dir) {
+      return errno;
+   }
+
+   myIndex = Util_SafeMalloc(sizeof *myIndex);
+   DblLnkLst_Init(&myIndex->links);
+   myIndex->dirPath = Util_SafeStrdup(dirPath);
+   myIndex->dev = dirStat->st_dev;
+   myIndex->ino = dirStat->st_ino;
+   myIndex->mtime = dirStat->st_mtime;
+   myIndex->names = HashTable_Alloc(HGFS_CASE_DIR_INDEX_SIZE,
+                                    HASH_STRING_KEY | HASH_FLAG_COPYKEY,
+                                    free);
+
+   while ((dirent = readdir(dir))) {
+      char *dentryName = dirent->d_name;
+      Unicode dentryNameU;
+      Unicode foldedName;
+      char *realName;
+
+      /*
+       * Unicode_FoldCase crashes with invalid unicode strings, validate and
+       * convert it appropriately before passing it to Unicode_* functions.
+       */
+      if (!Unicode_IsBufferValid(dentryName, strlen(dentryName),
+                                 STRING_ENCODING_DEFAULT)) {
+         /* Invalid unicode string, skip the entry. */
+         continue;
+      }
+
+      dentryNameU = Unicode_Alloc(dentryName, STRING_ENCODING_DEFAULT);
+      foldedName = Unicode_FoldCase(dentryNameU);
+      realName = Util_SafeStrdup(dentryName);
+
+      if (!HashTable_Insert(myIndex->names, foldedName, realName)) {
+         free(realName);
+      }
+
+      Unicode_Free(foldedName);
+      Unicode_Free(dentryNameU);
+   }
+
+   closedir(dir);
+   *index = myIndex;
+   return 0;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsCaseDirIndexLookup --
+ *
+ *    Looks up a case folded name in a directory index.
+ *
+ * Results:
+ *    0 and a copy of the real name of the entry in convertedComponent if it
+ *    exists, ENOENT otherwise.
+ *
+ * Side effects:
+ *    On success, allocated memory is returned in convertedComponent and needs
+ *    to be freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+HgfsCaseDirIndexLookup(HgfsCaseDirIndex *index,            // IN
+                       ConstUnicode foldedComponent,       // IN
+                       const char **convertedComponent,    // OUT
+                       size_t *convertedComponentSize)     // OUT
+{
+   char *realName;
+   char *myConvertedComponent;
+   size_t myConvertedComponentSize;
+
+   if (!HashTable_Lookup(index->names, foldedComponent, (void **)&realName)) {
+      return ENOENT;
+   }
+
+   myConvertedComponentSize = strlen(realName) + 1;
+   myConvertedComponent = malloc(myConvertedComponentSize);
+   if (myConvertedComponent == NULL) {
+      LOG(4, ("%s: failed to malloc myConvertedComponent.\n", __FUNCTION__));
+      return ENOMEM;
+   }
+   memcpy(myConvertedComponent, realName, myConvertedComponentSize);
+
+   *convertedComponent = myConvertedComponent;
+   *convertedComponentSize = myConvertedComponentSize;
+   return 0;
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -1440,6 +1693,10 @@ HgfsGetHiddenAttr(char const *fileName,         // IN:  Input filename
  *    Do a case insensitive search of a directory for the specified entry. If
  *    a matching entry is found, return it in the convertedComponent argument.
  *
+ *    The search uses a cached index of the directory entries when the
+ *    directory has not changed since the index was built; otherwise the
+ *    directory is read and the index (re)built.
+ *
  * Results:
  *    On Success:
  *    Returns 0 and the converted component name in the argument convertedComponent.
@@ -1462,12 +1719,9 @@ HgfsConvertComponentCase(char *currentComponent,           // IN
                          const char **convertedComponent,  // OUT
                          size_t *convertedComponentSize)   // OUT
 {
-   struct dirent *dirent;
-   DIR *dir = NULL;
-   char *dentryName;
-   size_t dentryNameLen;
-   char *myConvertedComponent = NULL;
-   size_t myConvertedComponentSize;
+   struct stat dirStat;
+   HgfsCaseDirIndex *index = NULL;
+   Unicode foldedComponent = NULL;
    int ret;
 
    ASSERT(currentComponent);
@@ -1475,15 +1729,17 @@ HgfsConvertComponentCase(char *currentComponent,           // IN
    ASSERT(convertedComponent);
    ASSERT(convertedComponentSize);
 
-   /* Open the specified directory. */
-   dir = Posix_OpenDir(dirPath);
-   if (!dir) {
+   if (Posix_Stat(dirPath, &dirStat) == -1) {
       ret = errno;
       goto exit;
    }
+   if (!S_ISDIR(dirStat.st_mode)) {
+      ret = ENOTDIR;
+      goto exit;
+   }
 
    /*
-    * Unicode_CompareIgnoreCase crashes with invalid unicode strings,
+    * Unicode_FoldCase crashes with invalid unicode strings,
     * validate it before passing it to Unicode_* functions.
     */
    if (!Unicode_IsBufferValid(currentComponent, -1, STRING_ENCODING_UTF8)) {
@@ -1492,64 +1748,58 @@ HgfsConvertComponentCase(char *currentComponent,           // IN
       goto exit;
    }
 
-   /*
-    * Read all of the directory entries. For each one, convert the name
-    * to lower case and then compare it to the lower case component.
-    */
-   while ((dirent = readdir(dir))) {
-      Unicode dentryNameU;
-      int cmpResult;
-
-      dentryName = dirent->d_name;
-      dentryNameLen = strlen(dentryName);
-
-      /*
-       * Unicode_CompareIgnoreCase crashes with invalid unicode strings,
-       * validate and convert it appropriately before passing it to Unicode_*
-       * functions.
-       */
-
-      if (!Unicode_IsBufferValid(dentryName, dentryNameLen,
-                                 STRING_ENCODING_DEFAULT)) {
-         /* Invalid unicode string, skip the entry. */
-         continue;
+   foldedComponent = Unicode_FoldCase(currentComponent);
+
+   if (gHgfsCaseDirCache != NULL) {
+      MXUser_AcquireExclLock(gHgfsCaseDirLock);
+      if (HashTable_Lookup(gHgfsCaseDirCache, dirPath, (void **)&index) &&
+          index->dev == dirStat.st_dev &&
+          index->ino == dirStat.st_ino &&
+          index->mtime == dirStat.st_mtime) {
+         DblLnkLst_Unlink1(&index->links);
+         DblLnkLst_LinkFirst(&gHgfsCaseDirLru, &index->links);
+         ret = HgfsCaseDirIndexLookup(index, foldedComponent,
+                                      convertedComponent,
+                                      convertedComponentSize);
+         MXUser_ReleaseExclLock(gHgfsCaseDirLock);
+         goto exit;
       }
+      MXUser_ReleaseExclLock(gHgfsCaseDirLock);
+   }
 
-      dentryNameU = Unicode_Alloc(dentryName, STRING_ENCODING_DEFAULT);
-
-      cmpResult = Unicode_CompareIgnoreCase(currentComponent, dentryNameU);
-      Unicode_Free(dentryNameU);
+   ret = HgfsCaseDirIndexCreate(dirPath, &dirStat, &index);
+   if (ret) {
+      goto exit;
+   }
 
-      if (cmpResult == 0) {
-         /*
-          * The current directory entry is a case insensitive match to
-          * the specified component. Malloc and copy the current directory entry.
-          */
-         myConvertedComponentSize = dentryNameLen + 1;
-         myConvertedComponent = malloc(myConvertedComponentSize);
-         if (myConvertedComponent == NULL) {
-            ret = errno;
-            LOG(4, ("%s: failed to malloc myConvertedComponent.\n",
-                    __FUNCTION__));
-            goto exit;
-         }
-         Str_Strcpy(myConvertedComponent, dentryName, myConvertedComponentSize);
+   ret = HgfsCaseDirIndexLookup(index, foldedComponent,
+                                convertedComponent, convertedComponentSize);
 
-         /* Success. Cleanup and exit. */
-         ret = 0;
-         *convertedComponentSize = myConvertedComponentSize;
-         *convertedComponent = myConvertedComponent;
-         goto exit;
+   /*
+    * Only cache the index if the directory was last modified at least a
+    * couple of seconds ago: mtime has a one second granularity, so a change
+    * made during the same second the index was built would go unnoticed.
+    */
+   if (gHgfsCaseDirCache != NULL && dirStat.st_mtime < time(NULL) - 1) {
+      MXUser_AcquireExclLock(gHgfsCaseDirLock);
+      if (HashTable_GetNumElements(gHgfsCaseDirCache) >= HGFS_CASE_DIR_CACHE_MAX &&
+          !HashTable_Lookup(gHgfsCaseDirCache, dirPath, NULL)) {
+         HgfsCaseDirIndex *oldest;
+
+         oldest = DblLnkLst_Container(gHgfsCaseDirLru.prev, HgfsCaseDirIndex,
+                                      links);
+         HashTable_Delete(gHgfsCaseDirCache, oldest->dirPath);
       }
+      /* Replacing an older index of the same directory frees it. */
+      HashTable_ReplaceOrInsert(gHgfsCaseDirCache, dirPath, index);
+      DblLnkLst_LinkFirst(&gHgfsCaseDirLru, &index->links);
+      MXUser_ReleaseExclLock(gHgfsCaseDirLock);
+   } else {
+      HgfsCaseDirIndexFree(index);
    }
 
-   /* We didn't find a match. Failure. */
-   ret = ENOENT;
-
 exit:
-   if (dir) {
-      closedir(dir);
-   }
+   Unicode_Free(foldedComponent);
    if (ret) {
       *convertedComponent = NULL;
       *convertedComponentSize = 0;
@@ -1695,9 +1945,11 @@ HgfsCaseInsensitiveLookup(const char *sharePath,           // IN
        * Try to match the current component against the one in curDir.
        * HgfsConvertComponentCase may return ENOENT. In that case return
        * the path case-converted uptil now (curDir) and append to it the
-       * rest of the unconverted path.
+       * rest of the unconverted path. The root share has an empty path,
+       * which stands for the root directory.
        */
-      error = HgfsConvertComponentCase(currentComponent, curDir,
+      error = HgfsConvertComponentCase(currentComponent,
+                                       *curDir != '\0' ? curDir : DIRSEPS,
                                        (const char **)&convertedComponent,
                                        &convertedComponentSize);
       /* Restore the path separator if we removed it earlier. */
@@ -2272,6 +2524,168 @@ exit:
    return status;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsEffectivePermissionsAt --
+ *
+ *    Same as HgfsEffectivePermissions, for an entry of an open directory.
+ *    faccessat(2) checks the entry the way access(2) does, so read-only
+ *    mounts, ACLs and immutable files are taken into account.
+ *
+ * Results:
+ *    The effective permissions.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#if defined(linux)
+static uint32
+HgfsEffectivePermissionsAt(int dirFd,           // IN: Directory of the entry
+                           char const *name,    // IN: Entry name
+                           Bool readOnlyShare)  // IN: Share is read only
+{
+   uint32 permissions = 0;
+
+   if (faccessat(dirFd, name, R_OK, 0) == 0) {
+      permissions |= HGFS_PERM_READ;
+   }
+   if (faccessat(dirFd, name, X_OK, 0) == 0) {
+      permissions |= HGFS_PERM_EXEC;
+   }
+   if (!readOnlyShare && faccessat(dirFd, name, W_OK, 0) == 0) {
+      permissions |= HGFS_PERM_WRITE;
+   }
+   return permissions;
+}
+#endif
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPlatformGetattrFromDirents --
+ *
+ *    Gets the attributes of a batch of entries of the same directory. The
+ *    directory is opened once and each entry is stat'ed relative to it with
+ *    fstatat(2), so no full path has to be built and walked per entry.
+ *
+ *    The attributes returned match what HgfsPlatformGetattrFromName reports
+ *    for the entry, including the hidden flag for dot files and the
+ *    effective permissions, which are checked with faccessat(2). An entry
+ *    that cannot be stat'ed gets the same default (regular file, type only)
+ *    that SEARCH_READ reports in that case.
+ *
+ *    Only implemented on Linux. Mac OS needs Finder alias resolution and
+ *    hidden xattrs per entry, which still require the full path.
+ *
+ * Results:
+ *    Zero on success, attrs holds one entry per name.
+ *    Non-zero on failure, attrs is untouched.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+HgfsInternalStatus
+HgfsPlatformGetattrFromDirents(char const *dirName,            // IN: Directory of entries
+                               HgfsShareOptions configOptions, // IN: Share config options
+                               char *shareName,                // IN: Share name
+                               char const **names,             // IN: Entry names
+                               uint32 numNames,                // IN: Number of names
+                               HgfsFileAttrInfo *attrs)        // OUT: One per name
+{
+#if defined(linux)
+   HgfsInternalStatus status = 0;
+   Bool followSymlinks;
+   Bool getEffectivePerms;
+   Bool readOnlyShare = FALSE;
+   HgfsOpenMode shareMode;
+   int openFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW;
+   int statFlags = AT_SYMLINK_NOFOLLOW;
+   int dirFd;
+   uint32 i;
+
+   ASSERT(dirName);
+   ASSERT(names);
+   ASSERT(attrs);
+
+   followSymlinks = HgfsServerPolicy_IsShareOptionSet(configOptions,
+                                                      HGFS_SHARE_FOLLOW_SYMLINKS);
+   if (followSymlinks) {
+      openFlags &= ~O_NOFOLLOW;
+      statFlags = 0;
+   }
+
+   /* Same as HgfsPlatformGetattrFromName: no share, no effective perms. */
+   getEffectivePerms =
+      HgfsServerPolicy_GetShareMode(shareName, strlen(shareName),
+                                    &shareMode) == HGFS_NAME_STATUS_COMPLETE;
+   if (getEffectivePerms) {
+      readOnlyShare = shareMode == HGFS_OPEN_MODE_READ_ONLY;
+   }
+
+   dirFd = Posix_Open(dirName, openFlags);
+   if (dirFd < 0) {
+      status = errno;
+      LOG(4, ("%s: error opening \"%s\": %s\n", __FUNCTION__, dirName,
+              strerror(status)));
+      return status;
+   }
+
+   for (i = 0; i < numNames; i++) {
+      HgfsFileAttrInfo *attr = &attrs[i];
+      struct stat stats;
+      uint64 creationTime;
+
+      memset(attr, 0, sizeof *attr);
+
+      if (fstatat(dirFd, names[i], &stats, statFlags) < 0) {
+         LOG(4, ("%s: stat FAILED %s (%d)\n", __FUNCTION__, names[i], errno));
+         attr->type = HGFS_FILE_TYPE_REGULAR;
+         attr->mask = HGFS_ATTR_VALID_TYPE;
+         continue;
+      }
+
+      if (S_ISDIR(stats.st_mode)) {
+         attr->type = HGFS_FILE_TYPE_DIRECTORY;
+      } else if (S_ISLNK(stats.st_mode)) {
+         attr->type = HGFS_FILE_TYPE_SYMLINK;
+      } else {
+         attr->type = HGFS_FILE_TYPE_REGULAR;
+      }
+
+      creationTime = HgfsGetCreationTime(&stats);
+      HgfsStatToFileAttr(&stats, &creationTime, attr);
+
+      if (HgfsIsDotHiddenName(names[i])) {
+         attr->mask |= HGFS_ATTR_VALID_FLAGS;
+         attr->flags |= HGFS_ATTR_HIDDEN | HGFS_ATTR_HIDDEN_FORCED;
+      }
+
+      if (getEffectivePerms && !S_ISLNK(stats.st_mode)) {
+         attr->effectivePerms = HgfsEffectivePermissionsAt(dirFd, names[i],
+                                                           readOnlyShare);
+         attr->mask |= HGFS_ATTR_VALID_EFFECTIVE_PERMS;
+      }
+   }
+
+   if (close(dirFd) < 0) {
+      LOG(4, ("%s: error in close: %s\n", __FUNCTION__, strerror(errno)));
+   }
+
+   return status;
+#else
+   return EOPNOTSUPP;
+#endif
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -3159,9 +3573,13 @@ HgfsConvertToUtf8FormC(char *buffer,         // IN/OUT: name to normalize
  *    there is no similar API available. Thus on Mac OS readdir is used that
  *    returns one directory entry at a time.
  *
+ *    The entry names are appended to the search's dirent store, which
+ *    packs them into a single blob and grows geometrically, so that large
+ *    directories don't cost an allocation per entry.
+ *
  * Results:
- *    Zero on success. numDents contains the number of directory entries found.
- *    Non-zero on error.
+ *    Zero on success. dents contains the directory entries found.
+ *    Non-zero on error, dents is left empty.
  *
  * Side effects:
  *    Memory allocation.
@@ -3173,8 +3591,7 @@ HgfsInternalStatus
 HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
                   size_t baseDirLen,        // IN: Ignored
                   Bool followSymlinks,      // IN: followSymlinks config option
-                  DirectoryEntry ***dents,  // OUT: Array of DirectoryEntrys
-                  int *numDents)            // OUT: Number of DirectoryEntrys
+                  HgfsDirentStore *dents)   // OUT: Directory entries
 {
 #if defined(__APPLE__)
    DIR *fd = NULL;
@@ -3183,15 +3600,10 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
    int openFlags = O_NONBLOCK | O_RDONLY | O_DIRECTORY | O_NOFOLLOW;
 #endif
    int result;
-   DirectoryEntry **myDents = NULL;
-   int myNumDents = 0;
    HgfsInternalStatus status = 0;
+   char *buffer = NULL;
 
-   /*
-    * XXX: glibc uses 8192 (BUFSIZ) when it can't get st_blksize from a stat.
-    * Should we follow its lead and use stat to get st_blksize?
-    */
-   char buffer[8192];
+   HgfsDirentStoreInit(dents);
 
 #if defined(__APPLE__)
    /*
@@ -3237,45 +3649,32 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
    fd = result;
 #endif
 
+   buffer = malloc(HGFS_GETDENTS_BUFSIZE);
+   if (buffer == NULL) {
+      status = ENOMEM;
+      goto exit;
+   }
+
    /*
     * Rather than read a single dent at a time, batch up multiple dents
     * in each call by using a buffer substantially larger than one dent.
     */
-   while ((result = getdents(fd, (void *)buffer, sizeof buffer)) > 0) {
+   while ((result = getdents(fd, (void *)buffer, HGFS_GETDENTS_BUFSIZE)) > 0) {
       size_t offset = 0;
       while (offset < result) {
-         DirectoryEntry *newDent, **newDents;
+         DirectoryEntry *newDent;
 
          newDent = (DirectoryEntry *)(buffer + offset);
 
          /* This dent had better fit in the actual space we've got left. */
          ASSERT(newDent->d_reclen <= result - offset);
 
-         /* Add another dent pointer to the dents array. */
-         newDents = realloc(myDents, sizeof *myDents * (myNumDents + 1));
-         if (newDents == NULL) {
-            status = ENOMEM;
-            goto exit;
-         }
-         myDents = newDents;
-
-         /*
-          * Allocate the new dent and set it up. We do a straight memcpy of
-          * the entire record to avoid dealing with platform-specific fields.
-          */
-         myDents[myNumDents] = malloc(newDent->d_reclen);
-         if (myDents[myNumDents] == NULL) {
-            status = ENOMEM;
-            goto exit;
-         }
-
          if (HgfsConvertToUtf8FormC(newDent->d_name, sizeof newDent->d_name)) {
-            memcpy(myDents[myNumDents], newDent, newDent->d_reclen);
-            /*
-             * Dent is done. Bump the offset to the batched buffer to process the
-             * next dent within it.
-             */
-            myNumDents++;
+            if (!HgfsDirentStoreAdd(dents, newDent->d_name,
+                                    strlen(newDent->d_name))) {
+               status = ENOMEM;
+               goto exit;
+            }
          } else {
             /*
              * XXX:
@@ -3285,8 +3684,9 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
              *    Need to change this to a more reasonable behavior, similar
              *    to name escaping which is used to deal with illegal file names.
              */
-            free(myDents[myNumDents]);
          }
+
+         /* Bump the offset to the batched buffer to process the next dent. */
          offset += newDent->d_reclen;
       }
    }
@@ -3309,19 +3709,11 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
               strerror(status)));
    }
 
-   /*
-    * On error, free all allocated dents. On success, set the dents pointer
-    * given to us by the client.
-    */
+   free(buffer);
+
+   /* On error, free all collected dents. */
    if (status != 0) {
-      size_t i;
-      for (i = 0; i < myNumDents; i++) {
-         free(myDents[i]);
-      }
-      free(myDents);
-   } else {
-      *dents = myDents;
-      *numDents = myNumDents;
+      HgfsDirentStoreDestroy(dents);
    }
    return status;
 }
@@ -3372,9 +3764,69 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
 /*
  *-----------------------------------------------------------------------------
  *
- * HgfsPlatformReadFile --
+ * HgfsVectoredIO --
  *
- *    Reads data from a file.
+ *    Reads into or writes from an I/O vector with a single system call where
+ *    the platform allows it, the file offset is used only if requested.
+ *
+ * Results:
+ *    Number of bytes transferred on success.
+ *    -1 on failure, errno is set.
+ *
+ * Side effects:
+ *    The file position is changed for non positional I/O.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static ssize_t
+HgfsVectoredIO(int fd,                     // IN: file descriptor
+               Bool isWrite,               // IN: write or read the file
+               Bool useOffset,             // IN: positional I/O?
+               uint64 offset,              // IN: file offset if useOffset
+               const struct iovec *iov,    // IN: I/O vector
+               int iovCount)               // IN: entries in iov
+{
+#if !defined(HGFS_HAVE_PREADV)
+   ssize_t total = 0;
+   int i;
+#endif
+
+   if (!useOffset) {
+      return isWrite ? writev(fd, iov, iovCount) : readv(fd, iov, iovCount);
+   }
+
+#if defined(HGFS_HAVE_PREADV)
+   return isWrite ? pwritev(fd, iov, iovCount, offset) :
+                    preadv(fd, iov, iovCount, offset);
+#else
+   /* Still no bounce buffer, but one system call per entry. */
+   for (i = 0; i < iovCount; i++) {
+      ssize_t res = isWrite ?
+         pwrite(fd, iov[i].iov_base, iov[i].iov_len, offset + total) :
+         pread(fd, iov[i].iov_base, iov[i].iov_len, offset + total);
+
+      if (res < 0) {
+         return total > 0 ? total : -1;
+      }
+      total += res;
+      if (res < iov[i].iov_len) {
+         break;
+      }
+   }
+
+   return total;
+#endif
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPlatformFileIOV --
+ *
+ *    Performs actual reading or writing of a file directly into or from
+ *    an I/O vector.
  *
  * Results:
  *    Zero on success.
@@ -3386,27 +3838,32 @@ HgfsServerScandir(char const *baseDir,      // IN: Directory to search in
  *-----------------------------------------------------------------------------
  */
 
-HgfsInternalStatus
-HgfsPlatformReadFile(HgfsHandle file,             // IN: Hgfs file handle
-                     HgfsSessionInfo *session,    // IN: session info
-                     uint64 offset,               // IN: file offset to read from
-                     uint32 requiredSize,         // IN: length of data to read
-                     void* payload,               // OUT: buffer for the read data
-                     uint32 *actualSize)          // OUT: actual length read
+static HgfsInternalStatus
+HgfsPlatformFileIOV(HgfsHandle file,             // IN: Hgfs file handle
+                    HgfsSessionInfo *session,    // IN: session info
+                    Bool isWrite,                // IN: write or read the file
+                    Bool append,                 // IN: file opened to append
+                    uint64 offset,               // IN: file offset
+                    uint32 requiredSize,         // IN: length of data
+                    HgfsVaIov *iov,              // IN/OUT: data buffers
+                    uint32 iovCount,             // IN: entries in iov
+                    uint32 *actualSize)          // OUT: actual length
 {
    int fd;
-   int error;
+   ssize_t error = 0;
    HgfsInternalStatus status;
    Bool sequentialOpen;
+   struct iovec stackEntries[HGFS_IOV_STACK_ENTRIES];
+   struct iovec *entries = stackEntries;
+   int numEntries = 0;
+   uint32 i;
+   uint32 done = 0;
 
    ASSERT(session);
-
-
-   LOG(4, ("%s: read fh %u, offset %"FMT64"u, count %u\n", __FUNCTION__,
-           file, offset, requiredSize));
+   ASSERT(iov || iovCount == 0);
 
    /* Get the file descriptor from the cache */
-   status = HgfsPlatformGetFd(file, session, FALSE, &fd);
+   status = HgfsPlatformGetFd(file, session, append, &fd);
 
    if (status != 0) {
       LOG(4, ("%s: Could not get file descriptor\n", __FUNCTION__));
@@ -3414,28 +3871,31 @@ HgfsPlatformReadFile(HgfsHandle file,             // IN: Hgfs file handle
    }
 
    if (!HgfsHandleIsSequentialOpen(file, session, &sequentialOpen)) {
-      LOG(4, ("%s: Could not get sequenial open status\n", __FUNCTION__));
+      LOG(4, ("%s: Could not get sequential open status\n", __FUNCTION__));
       return EBADF;
    }
 
-#if defined(__linux__) || defined(__APPLE__)
-   /* Read from the file. */
-   if (sequentialOpen) {
-      error = read(fd, payload, requiredSize);
-   } else {
-      error = pread(fd, payload, requiredSize, offset);
+   /* Only transfer up to requiredSize bytes. */
+   if (iovCount > ARRAYSIZE(stackEntries)) {
+      entries = Util_SafeMalloc(iovCount * sizeof *entries);
    }
-#else
+   for (i = 0; i < iovCount && done < requiredSize; i++) {
+      entries[numEntries].iov_base = iov[i].va;
+      entries[numEntries].iov_len = MIN(iov[i].len, requiredSize - done);
+      done += entries[numEntries].iov_len;
+      numEntries++;
+   }
+   done = 0;
+
+#if !defined(__linux__) && !defined(__APPLE__)
    /*
-    * Seek to the offset and read from the file. Grab the IO lock to make
-    * this and the subsequent read atomic.
+    * Seek to the offset and transfer the data. Grab the IO lock to make
+    * this and the subsequent reads or writes atomic.
     */
 
    MXUser_AcquireExclLock(session->fileIOLock);
 
-   if (sequentialOpen) {
-      error = 0; // No error from seek
-   } else {
+   if (!sequentialOpen) {
 #   ifdef linux
       {
          uint64 res;
@@ -3450,28 +3910,137 @@ HgfsPlatformReadFile(HgfsHandle file,             // IN: Hgfs file handle
 #   endif
    }
 
-   if (error >= 0) {
-      error = read(fd, payload, requiredSize);
-   } else {
+   if (error < 0) {
       LOG(4, ("%s: could not seek to %"FMT64"u: %s\n", __FUNCTION__,
-         offset, strerror(status)));
+              offset, strerror(errno)));
    }
 
-   MXUser_ReleaseExclLock(session->fileIOLock);
+   /* The file position now is where the data goes. */
+   sequentialOpen = TRUE;
 #endif
+
+   /*
+    * The vector may be longer than a single call accepts, transfer it in
+    * batches and stop at the first short read or write.
+    */
+   for (i = 0; error >= 0 && i < numEntries; i += HGFS_IOV_MAX) {
+      int batch = MIN(numEntries - i, HGFS_IOV_MAX);
+      size_t batchSize = 0;
+      int j;
+
+      for (j = 0; j < batch; j++) {
+         batchSize += entries[i + j].iov_len;
+      }
+
+      error = HgfsVectoredIO(fd, isWrite, !sequentialOpen, offset + done,
+                             &entries[i], batch);
+      if (error >= 0) {
+         done += error;
+         if (error < batchSize) {
+            break;
+         }
+      } else if (done > 0) {
+         /* Report what was transferred before the failure. */
+         error = 0;
+         break;
+      }
+   }
+
+#if !defined(__linux__) && !defined(__APPLE__)
+   {
+      int savedErr = errno;
+      MXUser_ReleaseExclLock(session->fileIOLock);
+      errno = savedErr;
+   }
+#endif
+
+   if (entries != stackEntries) {
+      free(entries);
+   }
+
    if (error < 0) {
       status = errno;
-      LOG(4, ("%s: error reading from file: %s\n", __FUNCTION__,
-              strerror(status)));
+      LOG(4, ("%s: error %s file: %s\n", __FUNCTION__,
+              isWrite ? "writing to" : "reading from", strerror(status)));
    } else {
-      LOG(4, ("%s: read %d bytes\n", __FUNCTION__, error));
-      *actualSize = error;
+      LOG(4, ("%s: %s %u bytes\n", __FUNCTION__,
+              isWrite ? "wrote" : "read", done));
+      *actualSize = done;
    }
 
    return status;
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPlatformReadFile --
+ *
+ *    Reads data from a file.
+ *
+ * Results:
+ *    Zero on success.
+ *    Non-zero on failure.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+HgfsInternalStatus
+HgfsPlatformReadFile(HgfsHandle file,             // IN: Hgfs file handle
+                     HgfsSessionInfo *session,    // IN: session info
+                     uint64 offset,               // IN: file offset to read from
+                     uint32 requiredSize,         // IN: length of data to read
+                     void* payload,               // OUT: buffer for the read data
+                     uint32 *actualSize)          // OUT: actual length read
+{
+   HgfsVaIov iov;
+
+   iov.va = payload;
+   iov.len = requiredSize;
+
+   return HgfsPlatformReadFileV(file, session, offset, requiredSize, &iov, 1,
+                                actualSize);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPlatformReadFileV --
+ *
+ *    Reads data from a file directly into the buffers of an I/O vector.
+ *
+ * Results:
+ *    Zero on success.
+ *    Non-zero on failure.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+HgfsInternalStatus
+HgfsPlatformReadFileV(HgfsHandle file,             // IN: Hgfs file handle
+                      HgfsSessionInfo *session,    // IN: session info
+                      uint64 offset,               // IN: file offset to read from
+                      uint32 requiredSize,         // IN: length of data to read
+                      HgfsVaIov *iov,              // OUT: buffers for the read data
+                      uint32 iovCount,             // IN: entries in iov
+                      uint32 *actualSize)          // OUT: actual length read
+{
+   LOG(4, ("%s: read fh %u, offset %"FMT64"u, count %u, iov %u\n", __FUNCTION__,
+           file, offset, requiredSize, iovCount));
+
+   return HgfsPlatformFileIOV(file, session, FALSE, FALSE, offset, requiredSize,
+                              iov, iovCount, actualSize);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -3498,81 +4067,50 @@ HgfsPlatformWriteFile(HgfsHandle file,             // IN: Hgfs file handle
                       void* payload,               // IN: data to be written
                       uint32 *actualSize)          // OUT: actual length written
 {
-   HgfsInternalStatus status;
-   int fd;
-   int error = 0;
-   Bool sequentialOpen;
-
-   LOG(4, ("%s: write fh %u, offset %"FMT64"u, count %u\n",
-           __FUNCTION__, file, offset, requiredSize));
+   HgfsVaIov iov;
 
-   /* Get the file desriptor from the cache */
-   status = HgfsPlatformGetFd(file, session,
-                              ((flags & HGFS_WRITE_APPEND) ? TRUE : FALSE),
-                              &fd);
-
-   if (status != 0) {
-      LOG(4, ("%s: Could not get file descriptor\n", __FUNCTION__));
-      return status;
-   }
+   iov.va = payload;
+   iov.len = requiredSize;
 
-   if (!HgfsHandleIsSequentialOpen(file, session, &sequentialOpen)) {
-      LOG(4, ("%s: Could not get sequential open status\n", __FUNCTION__));
-      return EBADF;
-   }
+   return HgfsPlatformWriteFileV(file, session, offset, requiredSize, flags,
+                                 &iov, 1, actualSize);
+}
 
-#if defined(__linux__) || defined(__APPLE__)
-   /* Write to the file. */
-   if (sequentialOpen) {
-      error = write(fd, payload, requiredSize);
-   } else {
-      error = pwrite(fd, payload, requiredSize, offset);
-   }
-#else
-   /*
-    * Seek to the offset and write from the file. Grab the IO lock to make
-    * this and the subsequent write atomic.
-    */
 
-   MXUser_AcquireExclLock(session->fileIOLock);
-   if (!sequentialOpen) {
-#   ifdef linux
-      {
-         uint64 res;
-#      if !defined(VM_X86_64)
-         error = _llseek(fd, offset >> 32, offset & 0xFFFFFFFF, &res, 0);
-#      else
-         error = llseek(fd, offset >> 32, offset & 0xFFFFFFFF, &res, 0);
-#      endif
-      }
-#   else
-      error = lseek(fd, offset, 0);
-#   endif
-
-   }
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsPlatformWriteFileV --
+ *
+ *    Performs actual writing data to a file directly from the buffers of
+ *    an I/O vector.
+ *
+ * Results:
+ *    Zero on success.
+ *    Non-zero on failure.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-   if (error < 0) {
-      LOG(4, ("%s: could not seek to %"FMT64"u: %s\n", __FUNCTION__,
-              offset, strerror(errno)));
-   } else {
-      error = write(fd, payload, requiredSize);
-   }
-   {
-      int savedErr = errno;
-      MXUser_ReleaseExclLock(session->fileIOLock);
-      errno = savedErr;
-   }
-#endif
+HgfsInternalStatus
+HgfsPlatformWriteFileV(HgfsHandle file,             // IN: Hgfs file handle
+                       HgfsSessionInfo *session,    // IN: session info
+                       uint64 offset,               // IN: file offset to write to
+                       uint32 requiredSize,         // IN: length of data to write
+                       HgfsWriteFlags flags,        // IN: write flags
+                       HgfsVaIov *iov,              // IN: data to be written
+                       uint32 iovCount,             // IN: entries in iov
+                       uint32 *actualSize)          // OUT: actual length written
+{
+   LOG(4, ("%s: write fh %u, offset %"FMT64"u, count %u, iov %u\n",
+           __FUNCTION__, file, offset, requiredSize, iovCount));
 
-   if (error < 0) {
-      status = errno;
-      LOG(4, ("%s: error writing to file: %s\n", __FUNCTION__, 
-         strerror(status)));
-   } else {
-      LOG(4, ("%s: wrote %d bytes\n", __FUNCTION__, error));
-      *actualSize = error;
-   }
-   return status;
+   return HgfsPlatformFileIOV(file, session, TRUE,
+                              (flags & HGFS_WRITE_APPEND) ? TRUE : FALSE,
+                              offset, requiredSize, iov, iovCount, actualSize);
 }
 
 
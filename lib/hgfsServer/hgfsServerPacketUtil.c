@@ -164,24 +164,94 @@ HSPU_GetMetaPacket(HgfsPacket *packet,        // IN/OUT: Hgfs Packet
  * HSPU_GetDataPacketIov --
  *
  *    Get a data packet in an iov form given an hgfs packet.
- *    Guest mappings will be established.
+ *    Guest mappings will be established for every entry covering the data
+ *    packet, unlike HSPU_GetDataPacketBuf no contiguous buffer is allocated
+ *    so data can be transferred directly to or from guest memory.
+ *
+ *    The last entry is trimmed so the entries add up to the data packet size.
+ *    The entries are stored in the caller's buffer if they fit in it.
  *
  * Results:
- *    Pointer to data packet iov.
+ *    Pointer to data packet iov, must be released with HSPU_PutDataPacketIov.
+ *    NULL if the mappings could not be established.
  *
  * Side effects:
- *    Buffer may be allocated.
+ *    Iov array is allocated if iovBuf is too small.
  *-----------------------------------------------------------------------------
  */
 
-void *
+HgfsVaIov *
 HSPU_GetDataPacketIov(HgfsPacket *packet,       // IN/OUT: Hgfs Packet
+                      MappingType mappingType,  // IN: Writeable/Readable
                       HgfsTransportSessionInfo *transportSession, // IN: Session Info
-                      HgfsVaIov iov)            // OUT: I/O vector
+                      HgfsVaIov *iovBuf,        // IN: Caller's buffer
+                      uint32 iovBufCount,       // IN: Entries in iovBuf
+                      uint32 *iovCount)         // OUT: Entries in the iov
 {
-   NOT_IMPLEMENTED();
-   return NULL;
+   HgfsVaIov *iov;
+   uint32 i;
+   uint32 numMapped = 0;
+   size_t remainingSize = packet->dataPacketSize;
+   void* (*func)(uint64, uint32, char **);
+
+   ASSERT(iovCount);
+
+   *iovCount = 0;
+   if (remainingSize == 0 || !transportSession->channelCbTable) {
+      return NULL;
+   }
+
+   if (mappingType == BUF_WRITEABLE ||
+       mappingType == BUF_READWRITEABLE) {
+      func = transportSession->channelCbTable->getWriteVa;
+   } else {
+      ASSERT(mappingType == BUF_READABLE);
+      func = transportSession->channelCbTable->getReadVa;
+   }
+
+   /* Looks like we are in the middle of poweroff. */
+   if (func == NULL || transportSession->channelCbTable->putVa == NULL) {
+      return NULL;
+   }
 
+   if (packet->iovCount - packet->dataPacketIovIndex <= iovBufCount) {
+      iov = iovBuf;
+   } else {
+      iov = Util_SafeMalloc((packet->iovCount - packet->dataPacketIovIndex) *
+                            sizeof *iov);
+   }
+
+   /* Establish guest memory mappings */
+   for (i = packet->dataPacketIovIndex;
+        i < packet->iovCount && remainingSize > 0;
+        i++) {
+      packet->iov[i].token = NULL;
+
+      /* Debugging check: Iov in VMCI should never cross page boundary */
+      ASSERT_DEVEL(packet->iov[i].len <=
+                   (PAGE_SIZE - PAGE_OFFSET(packet->iov[i].pa)));
+
+      packet->iov[i].va = func(packet->iov[i].pa, packet->iov[i].len,
+                               &packet->iov[i].token);
+      ASSERT_DEVEL(packet->iov[i].va);
+      if (packet->iov[i].va == NULL) {
+         /* Guest probably passed us bad physical address */
+         HSPU_PutDataPacketIov(packet, iov, numMapped, iovBuf,
+                               transportSession);
+
+         return NULL;
+      }
+
+      iov[numMapped].va = packet->iov[i].va;
+      iov[numMapped].len = MIN(packet->iov[i].len, remainingSize);
+      remainingSize -= iov[numMapped].len;
+      numMapped++;
+   }
+
+   LOG(10, ("%s: Hgfs mapped %u data iov entries\n", __FUNCTION__, numMapped));
+   *iovCount = numMapped;
+
+   return iov;
 }
 
 
@@ -370,7 +440,8 @@ HSPU_PutMetaPacket(HgfsPacket *packet,       // IN/OUT: Hgfs Packet
  *
  * HSPU_PutDataPacketIov --
  *
- *    Free data packet Iov if allocated.
+ *    Free data packet Iov returned by HSPU_GetDataPacketIov. iovBuf is the
+ *    buffer that was passed to HSPU_GetDataPacketIov.
  *
  * Results:
  *    void.
@@ -381,9 +452,29 @@ HSPU_PutMetaPacket(HgfsPacket *packet,       // IN/OUT: Hgfs Packet
  */
 
 void
-HSPU_PutDataPacketIov()
+HSPU_PutDataPacketIov(HgfsPacket *packet,       // IN/OUT: Hgfs Packet
+                      HgfsVaIov *iov,           // IN: Iov to be freed
+                      uint32 iovCount,          // IN: Entries in the iov
+                      HgfsVaIov *iovBuf,        // IN: Caller's buffer
+                      HgfsTransportSessionInfo *transportSession) // IN: Session Info
 {
-   NOT_IMPLEMENTED();
+   uint32 i;
+
+   if (iov == NULL) {
+      return;
+   }
+
+   LOG(4, ("%s Hgfs Putting Data packet iov\n", __FUNCTION__));
+   for (i = 0; i < iovCount; i++) {
+      uint32 index = packet->dataPacketIovIndex + i;
+
+      ASSERT_DEVEL(packet->iov[index].token);
+      transportSession->channelCbTable->putVa(&packet->iov[index].token);
+      packet->iov[index].va = NULL;
+   }
+   if (iov != iovBuf) {
+      free(iov);
+   }
 }
 
 
@@ -0,0 +1,393 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * hgfsServerStats.c --
+ *
+ *    Per-op counters and latency histograms for the HGFS server.
+ *
+ *    Collection is off by default. When it is off the only cost is a check
+ *    of a global flag when a request is received. When it is on, each
+ *    completed request updates a handful of atomic counters of its op; no
+ *    locks are taken so workers processing requests in parallel do not
+ *    serialize on the statistics.
+ *
+ *    Latencies are bucketed the same way as the MXUser lock histograms
+ *    (see MXUserHistoIndex in lib/lock/ulStats.c): the bin index is the
+ *    fixed point log10 of the sample scaled by a number of bins per decade,
+ *    so the histogram covers several orders of magnitude with a small,
+ *    constant number of bins.
+ */
+
+#include <string.h>
+
+#include "vmware.h"
+#include "str.h"
+#include "hgfsServerInt.h"
+#include "hgfsServer.h"
+#include "hostinfo.h"
+#include "logFixed.h"
+#include "vm_atomic.h"
+
+#define LOGLEVEL_MODULE hgfs
+#include "loglevel_user.h"
+
+/*
+ * Histograms cover 1us to 10s with 10 bins per decade. Faster samples are
+ * summed in the first bin, slower ones in the last.
+ */
+#define HGFS_STATS_MIN_NS            1000
+#define HGFS_STATS_DECADES           7
+#define HGFS_STATS_BINS_PER_DECADE   10
+#define HGFS_STATS_NUM_BINS          (HGFS_STATS_BINS_PER_DECADE * \
+                                      HGFS_STATS_DECADES)
+
+typedef struct HgfsOpStats {
+   Atomic_uint64 count;                      // Completed requests
+   Atomic_uint64 errors;                     // Requests replied with an error
+   Atomic_uint64 bytesIn;                    // Request and data bytes received
+   Atomic_uint64 bytesOut;                   // Reply and data bytes sent
+   Atomic_uint64 totalNS;                    // Sum of the latencies
+   Atomic_uint64 maxNS;                      // Largest latency seen
+   Atomic_uint64 bins[HGFS_STATS_NUM_BINS];  // Latency histogram
+} HgfsOpStats;
+
+static Bool hgfsStatsEnabled = FALSE;
+static HgfsOpStats hgfsOpStats[HGFS_OP_MAX];
+
+/* Names of the ops in the dump, indexed by HgfsOp. */
+static const char *hgfsOpNames[] = {
+   "OPEN",
+   "READ",
+   "WRITE",
+   "CLOSE",
+   "SEARCH_OPEN",
+   "SEARCH_READ",
+   "SEARCH_CLOSE",
+   "GETATTR",
+   "SETATTR",
+   "CREATE_DIR",
+   "DELETE_FILE",
+   "DELETE_DIR",
+   "RENAME",
+   "QUERY_VOLUME_INFO",
+   "OPEN_V2",
+   "GETATTR_V2",
+   "SETATTR_V2",
+   "SEARCH_READ_V2",
+   "CREATE_SYMLINK",
+   "SERVER_LOCK_CHANGE",
+   "CREATE_DIR_V2",
+   "DELETE_FILE_V2",
+   "DELETE_DIR_V2",
+   "RENAME_V2",
+   "OPEN_V3",
+   "READ_V3",
+   "WRITE_V3",
+   "CLOSE_V3",
+   "SEARCH_OPEN_V3",
+   "SEARCH_READ_V3",
+   "SEARCH_CLOSE_V3",
+   "GETATTR_V3",
+   "SETATTR_V3",
+   "CREATE_DIR_V3",
+   "DELETE_FILE_V3",
+   "DELETE_DIR_V3",
+   "RENAME_V3",
+   "QUERY_VOLUME_INFO_V3",
+   "CREATE_SYMLINK_V3",
+   "SERVER_LOCK_CHANGE_V3",
+   "WRITE_WIN32_STREAM_V3",
+   "CREATE_SESSION_V4",
+   "DESTROY_SESSION_V4",
+   "READ_FAST_V4",
+   "WRITE_FAST_V4",
+   "SET_WATCH_V4",
+   "REMOVE_WATCH_V4",
+   "NOTIFY_V4",
+   "SEARCH_READ_V4",
+   "OPEN_V4",
+   "ENUMERATE_STREAMS_V4",
+   "GETATTR_V4",
+   "SETATTR_V4",
+   "DELETE_V4",
+   "LINKMOVE_V4",
+   "FSCTL_V4",
+   "ACCESS_CHECK_V4",
+   "FSYNC_V4",
+   "QUERY_VOLUME_INFO_V4",
+   "OPLOCK_ACQUIRE_V4",
+   "OPLOCK_BREAK_V4",
+   "LOCK_BYTE_RANGE_V4",
+   "UNLOCK_BYTE_RANGE_V4",
+   "QUERY_EAS_V4",
+   "SET_EAS_V4",
+};
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerStatsIndex --
+ *
+ *    Return the histogram bin of a latency sample.
+ *
+ * Results:
+ *    (uint32) (HGFS_STATS_BINS_PER_DECADE * log10(durationNS / min)),
+ *    clamped to the histogram.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static uint32
+HgfsServerStatsIndex(uint64 durationNS)  // IN:
+{
+   uint32 numerator = 0;
+   uint32 denominator = 0;
+   uint32 index;
+
+   if (durationNS < HGFS_STATS_MIN_NS) {
+      return 0;
+   }
+
+   LogFixed_Base10(durationNS / HGFS_STATS_MIN_NS, &numerator, &denominator);
+   index = (HGFS_STATS_BINS_PER_DECADE * numerator) / denominator;
+
+   return MIN(index, HGFS_STATS_NUM_BINS - 1);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerStatsStart --
+ *
+ *    Timestamp for a request that is about to be processed.
+ *
+ * Results:
+ *    The current time in ns, or 0 if statistics are not being collected in
+ *    which case the request will not be accounted for.
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+uint64
+HgfsServerStatsStart(void)
+{
+   if (!hgfsStatsEnabled) {
+      return 0;
+   }
+   return Hostinfo_SystemTimerNS();
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerStatsSample --
+ *
+ *    Accounts for a completed request.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    Updates the statistics of the op.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsServerStatsSample(HgfsOp op,                  // IN: request op
+                      HgfsInternalStatus status,  // IN: reply status
+                      uint64 bytesIn,             // IN: request + data in
+                      uint64 bytesOut,            // IN: reply + data out
+                      uint64 startNS)             // IN: HgfsServerStatsStart
+{
+   HgfsOpStats *stats;
+   uint64 durationNS;
+   uint64 maxNS;
+
+   if (startNS == 0 || op >= ARRAYSIZE(hgfsOpStats)) {
+      return;
+   }
+
+   stats = &hgfsOpStats[op];
+   durationNS = Hostinfo_SystemTimerNS() - startNS;
+
+   Atomic_Inc64(&stats->count);
+   if (status != HGFS_ERROR_SUCCESS) {
+      Atomic_Inc64(&stats->errors);
+   }
+   Atomic_Add64(&stats->bytesIn, bytesIn);
+   Atomic_Add64(&stats->bytesOut, bytesOut);
+   Atomic_Add64(&stats->totalNS, durationNS);
+   Atomic_Inc64(&stats->bins[HgfsServerStatsIndex(durationNS)]);
+
+   maxNS = Atomic_Read64(&stats->maxNS);
+   while (durationNS > maxNS) {
+      uint64 prev = Atomic_ReadIfEqualWrite64(&stats->maxNS, maxNS,
+                                              durationNS);
+      if (prev == maxNS) {
+         break;
+      }
+      maxNS = prev;
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServer_EnableStats --
+ *
+ *    Starts or stops collecting per-op statistics. Counters are kept when
+ *    collection stops, and resume from where they were when it restarts.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsServer_EnableStats(Bool enable)  // IN:
+{
+   hgfsStatsEnabled = enable;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServer_ResetStats --
+ *
+ *    Zeroes the per-op statistics. Requests completing concurrently may be
+ *    partially accounted for.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsServer_ResetStats(void)
+{
+   uint32 op;
+
+   for (op = 0; op < ARRAYSIZE(hgfsOpStats); op++) {
+      HgfsOpStats *stats = &hgfsOpStats[op];
+      uint32 i;
+
+      Atomic_Write64(&stats->count, 0);
+      Atomic_Write64(&stats->errors, 0);
+      Atomic_Write64(&stats->bytesIn, 0);
+      Atomic_Write64(&stats->bytesOut, 0);
+      Atomic_Write64(&stats->totalNS, 0);
+      Atomic_Write64(&stats->maxNS, 0);
+      for (i = 0; i < HGFS_STATS_NUM_BINS; i++) {
+         Atomic_Write64(&stats->bins[i], 0);
+      }
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServer_DumpStats --
+ *
+ *    Reports the statistics of every op that completed at least one
+ *    request since the last reset, one line of counters and one line of
+ *    histogram per op. Histogram lines list the non-empty bins as
+ *    "bin-count" pairs; bin N holds latencies from
+ *    min * 10^(N / binsPerDecade) ns.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    Calls logFn once per line.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+HgfsServer_DumpStats(HgfsServerStatsLogFunc *logFn,  // IN: line printer
+                     void *data)                     // IN: logFn data
+{
+   char line[2048];
+   uint32 op;
+
+   ASSERT(logFn);
+
+   Str_Sprintf(line, sizeof line,
+               "HGFS stats: %s, histogram min=%uns binsPerDecade=%u\n",
+               hgfsStatsEnabled ? "enabled" : "disabled",
+               HGFS_STATS_MIN_NS, HGFS_STATS_BINS_PER_DECADE);
+   logFn(data, line);
+
+   ASSERT_ON_COMPILE(ARRAYSIZE(hgfsOpNames) == HGFS_OP_MAX);
+
+   for (op = 0; op < ARRAYSIZE(hgfsOpStats); op++) {
+      HgfsOpStats *stats = &hgfsOpStats[op];
+      uint64 count = Atomic_Read64(&stats->count);
+      size_t len;
+      uint32 i;
+
+      if (count == 0) {
+         continue;
+      }
+
+      Str_Sprintf(line, sizeof line,
+                  "%s: count=%"FMT64"u errors=%"FMT64"u "
+                  "bytesIn=%"FMT64"u bytesOut=%"FMT64"u "
+                  "avg=%"FMT64"uns max=%"FMT64"uns\n",
+                  hgfsOpNames[op], count, Atomic_Read64(&stats->errors),
+                  Atomic_Read64(&stats->bytesIn),
+                  Atomic_Read64(&stats->bytesOut),
+                  Atomic_Read64(&stats->totalNS) / count,
+                  Atomic_Read64(&stats->maxNS));
+      logFn(data, line);
+
+      len = Str_Sprintf(line, sizeof line, "%s: h", hgfsOpNames[op]);
+      for (i = 0; i < HGFS_STATS_NUM_BINS; i++) {
+         uint64 binCount = Atomic_Read64(&stats->bins[i]);
+
+         if (binCount != 0 && len < sizeof line - 32) {
+            len += Str_Sprintf(line + len, sizeof line - len,
+                               " %u-%"FMT64"u", i, binCount);
+         }
+      }
+      Str_Strcat(line, "\n", sizeof line);
+      logFn(data, line);
+   }
+}
@@ -31,6 +31,7 @@
 #endif
 
 #include "vmware.h"
+#include "hashTable.h"
 #include "hgfsServerPolicy.h"
 
 #define LOGLEVEL_MODULE hgfs
@@ -43,8 +44,25 @@ typedef struct HgfsServerPolicyState {
     * requests" policy --hpreg
     */
    DblLnkLst_Links shares;
+
+   /*
+    * Indices over the shares, by exact and by case insensitive name, so
+    * that looking up a share doesn't walk the list. They are rebuilt
+    * whenever the list changes. The keys are the shares' names.
+    */
+   HashTable *exactIndex;
+   HashTable *foldedIndex;
 } HgfsServerPolicyState;
 
+/* Initial number of buckets of the share indices. */
+#define HGFS_POLICY_INDEX_SIZE 8
+
+/*
+ * Names up to this length are NUL terminated on the stack for a lookup,
+ * longer ones in a heap buffer.
+ */
+#define HGFS_POLICY_NAME_BUF_SIZE 256
+
 
 static HgfsServerPolicyState myState;
 
@@ -107,6 +125,82 @@ HgfsServerPolicyDestroyShares(DblLnkLst_Links *head) // IN
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerPolicyDestroyIndex --
+ *
+ *    Free the share indices.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+HgfsServerPolicyDestroyIndex(HgfsServerPolicyState *state) // IN
+{
+   ASSERT(state);
+
+   if (state->exactIndex) {
+      HashTable_Free(state->exactIndex);
+      state->exactIndex = NULL;
+   }
+   if (state->foldedIndex) {
+      HashTable_Free(state->foldedIndex);
+      state->foldedIndex = NULL;
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HgfsServerPolicyBuildIndex --
+ *
+ *    (Re)build the share indices from the list of shares. When several
+ *    share names collide, the index keeps the first one in the list.
+ *
+ * Results:
+ *    None
+ *
+ * Side effects:
+ *    None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+HgfsServerPolicyBuildIndex(HgfsServerPolicyState *state) // IN
+{
+   DblLnkLst_Links *l;
+
+   ASSERT(state);
+
+   HgfsServerPolicyDestroyIndex(state);
+
+   state->exactIndex = HashTable_Alloc(HGFS_POLICY_INDEX_SIZE,
+                                       HASH_STRING_KEY, NULL);
+   state->foldedIndex = HashTable_Alloc(HGFS_POLICY_INDEX_SIZE,
+                                        HASH_ISTRING_KEY, NULL);
+
+   for (l = state->shares.next; l != &state->shares; l = l->next) {
+      HgfsSharedFolder *share;
+
+      share = DblLnkLst_Container(l, HgfsSharedFolder, links);
+      ASSERT(share);
+
+      /* A failed insert means an earlier share has the name, keep it. */
+      HashTable_Insert(state->exactIndex, share->name, share);
+      HashTable_Insert(state->foldedIndex, share->name, share);
+   }
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -165,6 +259,8 @@ HgfsServerPolicy_Init(HgfsInvalidateObjectsFunc *invalidateObjects,  // Unused
    /* Add the root node to the end of the list */
    DblLnkLst_LinkLast(&myState.shares, &rootShare->links);
 
+   HgfsServerPolicyBuildIndex(&myState);
+
    return TRUE;
 }
 
@@ -189,6 +285,7 @@ HgfsServerPolicy_Init(HgfsInvalidateObjectsFunc *invalidateObjects,  // Unused
 Bool
 HgfsServerPolicy_Cleanup(void)
 {
+   HgfsServerPolicyDestroyIndex(&myState);
    HgfsServerPolicyDestroyShares(&myState.shares);
 
    return TRUE;
@@ -217,66 +314,47 @@ HgfsServerPolicyGetShare(HgfsServerPolicyState *state, // IN
                          char const *nameIn,           // IN: Name to check
                          size_t nameInLen)             // IN: Length of nameIn
 {
-   DblLnkLst_Links *l;
+   char nameBuf[HGFS_POLICY_NAME_BUF_SIZE];
+   char *name = nameBuf;
+   void *share = NULL;
 
    ASSERT(state);
    ASSERT(nameIn);
 
-   /*
-    * First try to find a share that matches the given name exactly.
-    * This is to handle the case where 2 share names differ in case only.
-    */
-
-   for (l = state->shares.next; l != &state->shares; l = l->next) {
-      HgfsSharedFolder *share;
+   /* No share name contains a NUL, so such a name can't match any. */
+   if (state->exactIndex == NULL || memchr(nameIn, '\0', nameInLen)) {
+      return NULL;
+   }
 
-      share = DblLnkLst_Container(l, HgfsSharedFolder, links);
-      ASSERT(share);
-      if (nameInLen == share->nameLen &&
-          !memcmp(nameIn, share->name, nameInLen)) {
-         return share;
+   /* The index keys are NUL terminated, terminate the input name too. */
+   if (nameInLen >= sizeof nameBuf) {
+      name = (char *)malloc(nameInLen + 1);
+      if (!name) {
+         LOG(4, ("HgfsServerPolicyGetShare: couldn't allocate name\n"));
+         return NULL;
       }
    }
+   memcpy(name, nameIn, nameInLen);
+   name[nameInLen] = '\0';
 
    /*
-    * There was no match. As a fall back try a case insensitive match.
-    * This is because some Windows applications uppercase or lowercase the
-    * entire path before sending the request.
+    * First try to find a share that matches the given name exactly.
+    * This is to handle the case where 2 share names differ in case only.
+    *
+    * If there is no match, fall back to a case insensitive match. This is
+    * because some Windows applications uppercase or lowercase the entire
+    * path before sending the request.
     */
 
-   for (l = state->shares.next; l != &state->shares; l = l->next) {
-      HgfsSharedFolder *share;
-      char *tempName;
-
-      /*
-       * Null terminate the input name before a case insensitive comparison.
-       * This is just to protect against bad implementations of strnicmp.
-       */
-
-      if (!(tempName = (char *)malloc(nameInLen + 1))) {
-         LOG(4, ("HgfsServerPolicyGetShare: couldn't allocate tempName\n"));
-         return NULL;
-      }
-
-      memcpy(tempName, nameIn, nameInLen);
-      tempName[nameInLen] = 0;
-
-      share = DblLnkLst_Container(l, HgfsSharedFolder, links);
-      ASSERT(share);
-      if (nameInLen == share->nameLen &&
-#ifdef _WIN32
-          !strnicmp(tempName, share->name, nameInLen)) {
-#else
-          !strncasecmp(tempName, share->name, nameInLen)) {
-#endif
-         free(tempName);
-         return share;
-      }
+   if (!HashTable_Lookup(state->exactIndex, name, &share)) {
+      HashTable_Lookup(state->foldedIndex, name, &share);
+   }
 
-      free(tempName);
+   if (name != nameBuf) {
+      free(name);
    }
 
-   return NULL;
+   return share;
 }
 
 
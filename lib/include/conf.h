@@ -87,12 +87,61 @@
  */
 #define CONFNAME_GUESTINFO_POLLINTERVAL "poll-interval"
 
+/**
+ * Define how often disk information is gathered (in seconds). It is rounded
+ * to a multiple of the poll interval.
+ *
+ * @param int   User-defined disk info interval.
+ */
+#define CONFNAME_GUESTINFO_DISKINFOINTERVAL "diskinfo-interval"
+
+/**
+ * Define how often NIC information is gathered (in seconds) when the guest
+ * can notify the plugin of network configuration changes. Without change
+ * notifications NIC information is gathered on every poll.
+ *
+ * @param int   User-defined NIC info interval.
+ */
+#define CONFNAME_GUESTINFO_NICINFOINTERVAL "nicinfo-interval"
+
 /*
  * END GuestInfo goodies.
  ******************************************************************************
  */
 
 
+/*
+ ******************************************************************************
+ * BEGIN HGFS server goodies.
+ */
+
+/**
+ * Defines the string used for the HGFS server config file group.
+ */
+#define CONFGROUPNAME_HGFSSERVER "hgfsServer"
+
+/**
+ * Lets users collect per-op HGFS request statistics, reported when the
+ * service dumps its state.
+ *
+ * @param boolean Set to TRUE to collect statistics. Defaults to FALSE.
+ */
+#define CONFNAME_HGFSSERVER_STATS "stats"
+
+/**
+ * Lets users zero the HGFS request statistics after each state dump, so
+ * that each dump covers the interval since the previous one.
+ *
+ * @param boolean Set to TRUE to reset on dump. Defaults to FALSE.
+ */
+#define CONFNAME_HGFSSERVER_STATSRESETONDUMP "stats.resetOnDump"
+
+/*
+ * END HGFS server goodies.
+ ******************************************************************************
+ */
+
+
 /*
  ******************************************************************************
  * BEGIN Unity goodies.
@@ -48,6 +48,9 @@ typedef int (*HashTableForEachCallback)(const char *key,
 /*
  * The flag bits are ored into the type field.
  * Atomic hash tables only support insert, lookup, and replace.
+ *
+ * All hash tables grow as elements are inserted; the size given to
+ * HashTable_Alloc is only the initial number of buckets.
  */
 
 #define HASH_TYPE_MASK		7
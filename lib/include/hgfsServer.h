@@ -192,4 +192,33 @@ HgfsSharedFolderHandle HgfsServer_RegisterSharedFolder(const char *shareName,
                                                        Bool addFolder);
 void HgfsServer_Quiesce(Bool freeze);
 
+/*
+ * Per-op request statistics. The dump function passes each formatted,
+ * newline terminated line to the given printer.
+ */
+typedef void
+HgfsServerStatsLogFunc(void *data,          // IN
+                       const char *line);   // IN
+
+void HgfsServer_EnableStats(Bool enable);
+void HgfsServer_ResetStats(void);
+void HgfsServer_DumpStats(HgfsServerStatsLogFunc *logFn, void *data);
+
+#ifdef VMX86_TOOLS
+/*
+ * Function used to hand an asynchronous request off to a worker thread.
+ * Returns FALSE if the request could not be queued, in which case the
+ * server runs it inline.
+ */
+typedef void
+HgfsServerRequestFunc(void *request);       // IN
+
+typedef Bool
+HgfsServerExecutorFunc(void *data,                  // IN
+                       HgfsServerRequestFunc *fn,   // IN
+                       void *request);              // IN
+
+void HgfsServer_SetExecutor(HgfsServerExecutorFunc *executor, void *data);
+#endif
+
 #endif // _HGFS_SERVER_H_
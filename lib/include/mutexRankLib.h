@@ -54,11 +54,13 @@
  * hgfs locks
  */
 #define RANK_hgfsSessionArrayLock    (RANK_libLockBase + 0x4010)
+#define RANK_hgfsAsyncQueueLock      (RANK_libLockBase + 0x4020)
 #define RANK_hgfsSharedFolders       (RANK_libLockBase + 0x4030)
 #define RANK_hgfsNotifyLock          (RANK_libLockBase + 0x4040)
 #define RANK_hgfsFileIOLock          (RANK_libLockBase + 0x4050)
 #define RANK_hgfsSearchArrayLock     (RANK_libLockBase + 0x4060)
 #define RANK_hgfsNodeArrayLock       (RANK_libLockBase + 0x4070)
+#define RANK_hgfsCaseDirLock         (RANK_libLockBase + 0x4080)
 
 /*
  * SLPv2 global lock
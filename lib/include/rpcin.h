@@ -27,6 +27,8 @@
 #ifndef __RPCIN_H__
 #   define __RPCIN_H__
 
+#include "vm_basic_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -35,6 +37,17 @@ typedef void RpcIn_ErrorFunc(void *clientData, char const *status);
 
 typedef struct RpcIn RpcIn;
 
+/* Number of buckets of the dispatch latency histogram (powers of 2, in ms). */
+#define RPCIN_LATENCY_BUCKETS 8
+
+/* Counters kept by the RpcIn loop since the channel was last started. */
+typedef struct RpcInStats {
+   uint64 polls;         /* Number of times the host was polled */
+   uint64 emptyPolls;    /* Polls that did not return a message */
+   /* Dispatched messages; bucket i counts dispatches taking < 2^i ms. */
+   uint64 latency[RPCIN_LATENCY_BUCKETS];
+} RpcInStats;
+
 #if defined(VMTOOLS_USE_GLIB) /* { */
 
 #include "vmware/tools/guestrpc.h"
@@ -84,6 +97,9 @@ unsigned int RpcIn_SetRetVals(char const **result, size_t *resultLen,
 
 void RpcIn_Destruct(RpcIn *in);
 void RpcIn_stop(RpcIn *in);
+void RpcIn_SetSchedule(RpcIn *in, unsigned int minDelay,
+                       unsigned int maxDelay, unsigned int burst);
+void RpcIn_GetStats(RpcIn *in, RpcInStats *stats);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -40,6 +40,27 @@ typedef HANDLE SyncDriverHandle;
 
 typedef struct SyncHandle * SyncDriverHandle;
 
+/*
+ * Timing of a freeze / thaw cycle, for diagnostics. Times are in
+ * microseconds; "frozen" times are 0 until the file systems are thawed.
+ */
+
+typedef struct SyncDriverMountStats {
+   char *path;
+   int wave;           /* Stacked file systems are frozen in earlier waves. */
+   uint64 freezeUS;    /* Time taken by the freeze. */
+   uint64 frozenUS;    /* From the start of the freeze to the end of the thaw. */
+} SyncDriverMountStats;
+
+typedef struct SyncDriverStats {
+   size_t mountCnt;
+   SyncDriverMountStats *mounts;
+   int waveCnt;
+   uint64 freezeUS;    /* From the first freeze started to the last one done. */
+   uint64 thawUS;      /* From the start of the thaw to the last one done. */
+   uint64 frozenUS;    /* From the first freeze started to the last thaw done. */
+} SyncDriverStats;
+
 #endif /* } */
 
 typedef enum {
@@ -55,5 +76,10 @@ SyncDriverStatus SyncDriver_QueryStatus(const SyncDriverHandle handle,
                                         int32 timeout);
 void SyncDriver_CloseHandle(SyncDriverHandle *handle);
 
+#if !defined(_WIN32)
+SyncDriverStats *SyncDriver_GetStats(const SyncDriverHandle handle);
+void SyncDriver_FreeStats(SyncDriverStats *stats);
+#endif
+
 #endif
 
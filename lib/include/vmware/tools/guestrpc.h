@@ -251,6 +251,18 @@ RpcChannel_UnregisterCallback(RpcChannel *chan,
 RpcChannel *
 BackdoorChannel_New(void);
 
+void
+BackdoorChannel_SetSchedule(RpcChannel *chan,
+                            guint minDelay,
+                            guint maxDelay,
+                            guint burst);
+
+struct RpcInStats;
+
+gboolean
+BackdoorChannel_GetStats(RpcChannel *chan,
+                         struct RpcInStats *stats);
+
 G_END_DECLS
 
 /** @} */
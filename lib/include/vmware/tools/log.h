@@ -66,6 +66,13 @@
  * can also affect other running applications that need to send messages to the
  * host. Do not use this logger unless explicitly instructed to do so.
  *
+ * By default messages are written by the thread logging them. Setting
+ * "async" to true in the "[logging]" group makes a separate thread write
+ * them instead; "asyncBufferSize" limits how much data (in KB, default 1024)
+ * may be waiting to be written, and messages logged while the limit is
+ * reached are dropped (the number of dropped messages is logged). Fatal
+ * messages are always written immediately.
+ *
  * Logging configuration should be under the "[logging]" group in the
  * application's configuration file.
  *
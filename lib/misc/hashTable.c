@@ -21,6 +21,13 @@
  *
  *      An implementation of hashtable with no removals.
  *      For string keys.
+ *
+ *      Tables start with the number of buckets given to HashTable_Alloc
+ *      and grow automatically once the load factor exceeds
+ *      HASH_MAX_LOAD. Non-atomic tables are rehashed in place. Atomic
+ *      tables can't move entries under lock-free readers, so they grow
+ *      by freezing the current bucket array and stacking a larger one
+ *      on top of it; lookups walk the arrays from newest to oldest.
  */
 
 #include <stdio.h>
@@ -39,7 +46,17 @@
 #include "vm_atomic.h"
 
 
-#define HASH_ROTATE     5
+/*
+ * Grow once there are more than HASH_MAX_LOAD elements per bucket. Atomic
+ * tables grow by a larger factor since every generation adds a bucket to
+ * walk on lookup.
+ */
+
+#define HASH_MAX_LOAD           2
+#define HASH_GROW_SHIFT         1
+#define HASH_ATOMIC_GROW_SHIFT  2
+
+#define HASH_MULTIPLIER CONST64U(0x9E3779B97F4A7C15)
 
 
 /*
@@ -54,7 +71,17 @@
 
 typedef Atomic_Ptr HashTableLink;
 
-#define ENTRY(l) ((HashTableEntry *) Atomic_ReadPtr(&(l)))
+/*
+ * Bucket heads of a retired generation of an atomic table carry the
+ * HASH_FROZEN tag so that inserts can no longer land there. Entries are
+ * at least pointer aligned, so the low bit is free.
+ */
+
+#define HASH_FROZEN ((uintptr_t) 1)
+#define IS_FROZEN(e) (((uintptr_t) (e) & HASH_FROZEN) != 0)
+
+#define ENTRY(l) \
+   ((HashTableEntry *) ((uintptr_t) Atomic_ReadPtr(&(l)) & ~HASH_FROZEN))
 #define SETENTRY(l, e) Atomic_WritePtr(&(l), e)
 #ifdef NO_ATOMIC_HASHTABLE
 #define SETENTRYATOMIC(l, old, new) (Atomic_WritePtr(&(l), new), TRUE)
@@ -70,25 +97,38 @@ typedef Atomic_Ptr HashTableLink;
 typedef struct HashTableEntry {
    HashTableLink     next;
    const void       *keyStr;
+   uint32            hash;
    Atomic_Ptr        clientData;
 } HashTableEntry;
 
+/*
+ * A bucket array. Non-atomic tables only ever have one; atomic tables
+ * chain the frozen arrays they outgrew through 'older'.
+ */
+
+typedef struct HashTableBuckets {
+   uint32                    numEntries;
+   Atomic_uint32             numElements;  // atomic tables only
+   HashTableLink            *links;
+   struct HashTableBuckets  *older;
+} HashTableBuckets;
+
 /*
  * The hashtable structure.
  */
 
 struct HashTable {
-   uint32                 numEntries;
-   uint32                 numBits;
    int                    keyType;
    Bool                   atomic;
    Bool                   copyKey;
    HashTableFreeEntryFn   freeEntryFn;
-   HashTableLink         *buckets;
+   Atomic_Ptr             buckets;     // newest HashTableBuckets
 
    size_t                 numElements;
 };
 
+#define BUCKETS(ht) ((HashTableBuckets *) Atomic_ReadPtr(&(ht)->buckets))
+
 
 /*
  * Local functions
@@ -98,6 +138,9 @@ static HashTableEntry *HashTableLookup(HashTable *ht,
                                        const void *keyStr, 
                                        uint32 hash);
 
+static void HashTableGrow(HashTable *ht,
+                          HashTableBuckets *buckets);
+
 HashTableEntry *HashTableLookupOrInsert(HashTable *ht,
                                         const void *keyStr,
                                         void *clientData);
@@ -106,9 +149,43 @@ HashTableEntry *HashTableLookupOrInsert(HashTable *ht,
 /*
  *-----------------------------------------------------------------------------
  *
- * HashTableComputeHash --
+ * HashTableMix --
  *
- *      Compute hash value based on key type and hash size.
+ *      Final avalanche step of the hash functions (the MurmurHash3 64-bit
+ *      finalizer), so that every bit of the input affects the low bits
+ *      used to pick a bucket.
+ *
+ * Results:
+ *      The mixed value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE uint32
+HashTableMix(uint64 h)  // IN:
+{
+   h ^= h >> 33;
+   h *= CONST64U(0xff51afd7ed558ccd);
+   h ^= h >> 33;
+   h *= CONST64U(0xc4ceb9fe1a85ec53);
+   h ^= h >> 33;
+
+   return (uint32) h;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HashTableHashString --
+ *
+ *      Hash a string eight bytes at a time.
+ *
+ *      Case-insensitive keys are folded with tolower() to stay consistent
+ *      with the Str_Strcasecmp used to compare them.
  *
  * Results:
  *      The hash value.
@@ -120,57 +197,126 @@ HashTableEntry *HashTableLookupOrInsert(HashTable *ht,
  */
 
 static INLINE uint32
-HashTableComputeHash(HashTable *ht,  // IN: hash table
-                     const void *s)  // IN: string to hash
+HashTableHashString(const char *s,  // IN: string to hash
+                    Bool foldCase)  // IN: hash case-insensitively
 {
-   uint32 h = 0;
+   size_t len = strlen(s);
+   uint64 h = len * HASH_MULTIPLIER;
 
-   switch (ht->keyType) {
-   case HASH_STRING_KEY: {
-         int c;
-         unsigned char *keyPtr = (unsigned char *) s;
+   while (len > 0) {
+      size_t n = MIN(len, sizeof (uint64));
+      uint64 w = 0;
 
-         while ((c = *keyPtr++)) {
-            h ^= c;
-            h = h << HASH_ROTATE | h >> (32 - HASH_ROTATE);
-         }
-      }
-      break;
-   case HASH_ISTRING_KEY: {
-         int c;
-         unsigned char *keyPtr = (unsigned char *) s;
-
-         while ((c = tolower(*keyPtr++))) {
-            h ^= c;
-            h = h << HASH_ROTATE | h >> (32 - HASH_ROTATE);
-         }
-      }
-      break;
-   case HASH_INT_KEY:
-      ASSERT_ON_COMPILE(sizeof s == 4 || sizeof s == 8);
+      if (foldCase) {
+         unsigned char folded[sizeof w];
+         size_t i;
 
-      if (sizeof s == 4) {
-         h = (uint32) (uintptr_t) s;
+         for (i = 0; i < n; i++) {
+            folded[i] = tolower((unsigned char) s[i]);
+         }
+         memcpy(&w, folded, n);
       } else {
-         h = (uint32) (uintptr_t) s ^ (uint32) ((uint64) (uintptr_t) s >> 32);
+         memcpy(&w, s, n);
       }
-      h *= 48271;  // http://www.google.com/search?q=48271+pseudorandom
-      break;
+
+      h = (h ^ w) * HASH_MULTIPLIER;
+      h ^= h >> 32;
+
+      s += n;
+      len -= n;
+   }
+
+   return HashTableMix(h);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HashTableComputeHash --
+ *
+ *      Compute hash value based on key type. The bucket is picked from
+ *      the low bits, see HashTableBucket.
+ *
+ * Results:
+ *      The hash value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE uint32
+HashTableComputeHash(const HashTable *ht,  // IN: hash table
+                     const void *s)        // IN: string to hash
+{
+   switch (ht->keyType) {
+   case HASH_STRING_KEY:
+      return HashTableHashString((const char *) s, FALSE);
+   case HASH_ISTRING_KEY:
+      return HashTableHashString((const char *) s, TRUE);
+   case HASH_INT_KEY:
+      return HashTableMix((uint64) (uintptr_t) s);
    default:
       NOT_REACHED();
    }
+}
 
-   {
-      int numBits = ht->numBits;
-      uint32 mask = MASK(numBits);
 
-      for (; h > mask; h = (h & mask) ^ (h >> numBits)) {
-      }
-   }
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HashTableBucket --
+ *
+ *      Find the bucket a hash value falls into.
+ *
+ * Results:
+ *      The bucket's link.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static INLINE HashTableLink *
+HashTableBucket(const HashTableBuckets *buckets,  // IN: bucket array
+                uint32 hash)                      // IN: hash value
+{
+   return &buckets->links[hash & (buckets->numEntries - 1)];
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * HashTableAllocBuckets --
+ *
+ *      Allocate an empty bucket array.
+ *
+ * Results:
+ *      The new bucket array.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-   ASSERT(h < ht->numEntries);
+static HashTableBuckets *
+HashTableAllocBuckets(uint32 numEntries)  // IN: must be a power of 2
+{
+   HashTableBuckets *buckets = Util_SafeMalloc(sizeof *buckets);
+
+   ASSERT(numEntries > 0 && (numEntries & (numEntries - 1)) == 0);
+
+   buckets->numEntries = numEntries;
+   Atomic_Write(&buckets->numElements, 0);
+   buckets->links = Util_SafeCalloc(numEntries, sizeof *buckets->links);
+   buckets->older = NULL;
 
-   return h;
+   return buckets;
 }
 
 
@@ -213,7 +359,8 @@ HashTableEqualKeys(HashTable *ht,     // IN: hash table
  *
  * HashTable_Alloc --
  *
- *      Create a hash table.
+ *      Create a hash table. numEntries is the initial number of buckets,
+ *      the table grows as elements are inserted.
  *
  * Results:
  *      The new hashtable.
@@ -225,7 +372,7 @@ HashTableEqualKeys(HashTable *ht,     // IN: hash table
  */
 
 HashTable *
-HashTable_Alloc(uint32 numEntries,        // IN: must be a power of 2
+HashTable_Alloc(uint32 numEntries,        // IN: initial size, power of 2
                 int keyType,              // IN: whether keys are strings
                 HashTableFreeEntryFn fn)  // IN: free entry function
 {
@@ -245,13 +392,11 @@ HashTable_Alloc(uint32 numEntries,        // IN: must be a power of 2
    ht = Util_SafeMalloc(sizeof *ht);
    ASSERT_MEM_ALLOC(ht);
 
-   ht->numBits = lssb32_0(numEntries);
-   ht->numEntries = numEntries;
    ht->keyType = keyType & HASH_TYPE_MASK;
    ht->atomic = (keyType & HASH_FLAG_ATOMIC) != 0;
    ht->copyKey = (keyType & HASH_FLAG_COPYKEY) != 0;
    ht->freeEntryFn = fn;
-   ht->buckets = Util_SafeCalloc(ht->numEntries, sizeof *ht->buckets);
+   Atomic_WritePtr(&ht->buckets, HashTableAllocBuckets(numEntries));
    ht->numElements = 0;
 
 #ifndef NO_ATOMIC_HASHTABLE
@@ -283,7 +428,7 @@ HashTable_Alloc(uint32 numEntries,        // IN: must be a power of 2
 
 HashTable *
 HashTable_AllocOnce(Atomic_Ptr *var,          // IN/OUT: the atomic var
-                    uint32 numEntries,        // IN: must be a power of 2
+                    uint32 numEntries,        // IN: initial size, power of 2
                     int keyType,              // IN: whether keys are strings
                     HashTableFreeEntryFn fn)  // IN: free entry function
 {
@@ -328,27 +473,64 @@ HashTable_AllocOnce(Atomic_Ptr *var,          // IN/OUT: the atomic var
 static void
 HashTableClearInternal(HashTable *ht)  // IN/OUT:
 {
-   int i;
+   HashTableBuckets *buckets;
 
    ht->numElements = 0;
 
-   for (i = 0; i < ht->numEntries; i++) {
-      HashTableEntry *entry;
-
-      while ((entry = ENTRY(ht->buckets[i])) != NULL) {
-         SETENTRY(ht->buckets[i], ENTRY(entry->next));
-         if (ht->copyKey) {
-            free((void *) entry->keyStr);
-         }
-         if (ht->freeEntryFn) {
-            ht->freeEntryFn(Atomic_ReadPtr(&entry->clientData));
+   for (buckets = BUCKETS(ht); buckets != NULL; buckets = buckets->older) {
+      uint32 i;
+
+      for (i = 0; i < buckets->numEntries; i++) {
+         HashTableEntry *entry;
+
+         while ((entry = ENTRY(buckets->links[i])) != NULL) {
+            SETENTRY(buckets->links[i], ENTRY(entry->next));
+            if (ht->copyKey) {
+               free((void *) entry->keyStr);
+            }
+            if (ht->freeEntryFn) {
+               ht->freeEntryFn(Atomic_ReadPtr(&entry->clientData));
+            }
+            free(entry);
          }
-         free(entry);
       }
+      Atomic_Write(&buckets->numElements, 0);
    }
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashTableFreeBuckets --
+ *
+ *      Free the (empty) bucket arrays of a hash table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+HashTableFreeBuckets(HashTable *ht)  // IN/OUT:
+{
+   HashTableBuckets *buckets = BUCKETS(ht);
+
+   while (buckets != NULL) {
+      HashTableBuckets *older = buckets->older;
+
+      free(buckets->links);
+      free(buckets);
+      buckets = older;
+   }
+   Atomic_WritePtr(&ht->buckets, NULL);
+}
+
+
 void
 HashTable_Clear(HashTable *ht)  // IN/OUT:
 {
@@ -384,7 +566,7 @@ HashTable_Free(HashTable *ht)  // IN/OUT:
 
    HashTableClearInternal(ht);
 
-   free(ht->buckets);
+   HashTableFreeBuckets(ht);
    free(ht);
 }
 
@@ -414,7 +596,7 @@ HashTable_FreeUnsafe(HashTable *ht)  // IN/OUT:
 
    HashTableClearInternal(ht);
 
-   free(ht->buckets);
+   HashTableFreeBuckets(ht);
    free(ht);
 }
 
@@ -424,7 +606,8 @@ HashTable_FreeUnsafe(HashTable *ht)  // IN/OUT:
  *
  * HashTableLookup --
  *
- *      Core of the lookup function.
+ *      Core of the lookup function. Walks the bucket arrays from newest
+ *      to oldest; only atomic tables ever have more than one.
  *
  * Results:
  *      A pointer to the found HashTableEntry or NULL if not found
@@ -440,13 +623,18 @@ HashTableLookup(HashTable *ht,       // IN:
                 const void *keyStr,  // IN:
                 uint32 hash)         // IN:
 {
-   HashTableEntry *entry;
+   HashTableBuckets *buckets;
+
+   for (buckets = BUCKETS(ht); buckets != NULL; buckets = buckets->older) {
+      HashTableEntry *entry;
 
-   for (entry = ENTRY(ht->buckets[hash]);
-        entry != NULL;
-        entry = ENTRY(entry->next)) {
-      if (HashTableEqualKeys(ht, entry->keyStr, keyStr)) {
-         return entry;
+      for (entry = ENTRY(*HashTableBucket(buckets, hash));
+           entry != NULL;
+           entry = ENTRY(entry->next)) {
+         if (entry->hash == hash &&
+             HashTableEqualKeys(ht, entry->keyStr, keyStr)) {
+            return entry;
+         }
       }
    }
 
@@ -548,10 +736,11 @@ HashTable_LookupAndDelete(HashTable *ht,       // IN/OUT: the hash table
 
    ASSERT(!ht->atomic);
 
-   for (linkp = &ht->buckets[hash];
+   for (linkp = HashTableBucket(BUCKETS(ht), hash);
         (entry = ENTRY(*linkp)) != NULL;
         linkp = &entry->next) {
-      if (HashTableEqualKeys(ht, entry->keyStr, keyStr)) {
+      if (entry->hash == hash &&
+          HashTableEqualKeys(ht, entry->keyStr, keyStr)) {
          SETENTRY(*linkp, ENTRY(entry->next));
          ht->numElements--;
          if (ht->copyKey) {
@@ -765,10 +954,14 @@ HashTableLookupOrInsert(HashTable *ht,       // IN/OUT:
    uint32 hash = HashTableComputeHash(ht, keyStr);
    HashTableEntry *entry = NULL;
    HashTableEntry *oldEntry = NULL;
+   HashTableBuckets *buckets;
+   HashTableLink *link;
    HashTableEntry *head;
 
 again:
-   head = ENTRY(ht->buckets[hash]);
+   buckets = BUCKETS(ht);
+   link = HashTableBucket(buckets, hash);
+   head = Atomic_ReadPtr(link);
 
    oldEntry = HashTableLookup(ht, keyStr, hash);
    if (oldEntry != NULL) {
@@ -782,6 +975,16 @@ again:
       return oldEntry;
    }
 
+   /*
+    * The bucket array is being retired by HashTableGrow in another
+    * thread; wait for the new one to be published.
+    */
+   if (IS_FROZEN(head)) {
+      ASSERT(ht->atomic);
+      PAUSE();
+      goto again;
+   }
+
    if (entry == NULL) {
       entry = Util_SafeMalloc(sizeof *entry);
       if (ht->copyKey) {
@@ -789,23 +992,116 @@ again:
       } else {
          entry->keyStr = keyStr;
       }
+      entry->hash = hash;
       Atomic_WritePtr(&entry->clientData, clientData);
    }
    SETENTRY(entry->next, head);
    if (ht->atomic) {
-      if (!SETENTRYATOMIC(ht->buckets[hash], head, entry)) {
+      if (!SETENTRYATOMIC(*link, head, entry)) {
          goto again;
       }
    } else {
-      SETENTRY(ht->buckets[hash], entry);
+      SETENTRY(*link, entry);
    }
 
    ht->numElements++;
 
+   if (ht->atomic) {
+      /* Exactly one inserter sees the count cross the threshold. */
+      if (Atomic_ReadInc32(&buckets->numElements) + 1 ==
+          buckets->numEntries * HASH_MAX_LOAD) {
+         HashTableGrow(ht, buckets);
+      }
+   } else if (ht->numElements > buckets->numEntries * HASH_MAX_LOAD) {
+      HashTableGrow(ht, buckets);
+   }
+
    return NULL;
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashTableGrow --
+ *
+ *      Grow a hash table whose load factor got too high.
+ *
+ *      A non-atomic table is rehashed into a larger bucket array.
+ *
+ *      Entries of an atomic table can't be relinked while lock-free
+ *      readers may be walking them. Instead, every bucket of the current
+ *      array is frozen, so no insert can land there anymore, and a larger
+ *      empty array is published in front of it. Only then can an insert
+ *      go to the new array, and its lookup will see everything inserted
+ *      into the frozen one, so no key is ever inserted twice.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+HashTableGrow(HashTable *ht,               // IN/OUT:
+              HashTableBuckets *buckets)   // IN: current bucket array
+{
+   HashTableBuckets *newBuckets;
+   uint32 i;
+
+   if (ht->atomic) {
+#ifdef NO_ATOMIC_HASHTABLE
+      NOT_REACHED();
+#else
+      if (buckets->numEntries << HASH_ATOMIC_GROW_SHIFT <= buckets->numEntries) {
+         return;
+      }
+      newBuckets = HashTableAllocBuckets(buckets->numEntries <<
+                                         HASH_ATOMIC_GROW_SHIFT);
+      newBuckets->older = buckets;
+
+      for (i = 0; i < buckets->numEntries; i++) {
+         HashTableEntry *head;
+
+         do {
+            head = Atomic_ReadPtr(&buckets->links[i]);
+            ASSERT(!IS_FROZEN(head));
+         } while (Atomic_ReadIfEqualWritePtr(&buckets->links[i], head,
+                     (void *) ((uintptr_t) head | HASH_FROZEN)) != head);
+      }
+
+      /* Only the one inserter that crossed the threshold gets here. */
+      ASSERT(Atomic_ReadPtr(&ht->buckets) == buckets);
+      Atomic_WritePtr(&ht->buckets, newBuckets);
+#endif
+   } else {
+      if (buckets->numEntries << HASH_GROW_SHIFT <= buckets->numEntries) {
+         return;
+      }
+      newBuckets = HashTableAllocBuckets(buckets->numEntries << HASH_GROW_SHIFT);
+
+      for (i = 0; i < buckets->numEntries; i++) {
+         HashTableEntry *entry;
+
+         while ((entry = ENTRY(buckets->links[i])) != NULL) {
+            HashTableLink *link = HashTableBucket(newBuckets, entry->hash);
+
+            SETENTRY(buckets->links[i], ENTRY(entry->next));
+            SETENTRY(entry->next, ENTRY(*link));
+            SETENTRY(*link, entry);
+         }
+      }
+
+      Atomic_WritePtr(&ht->buckets, newBuckets);
+      free(buckets->links);
+      free(buckets);
+   }
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -859,6 +1155,7 @@ HashTable_KeyArray(const HashTable *ht,  // IN:
                    const void ***keys,   // OUT:
                    size_t *size)         // OUT:
 {
+   HashTableBuckets *buckets;
    uint32 i;
    size_t j;
 
@@ -879,10 +1176,11 @@ HashTable_KeyArray(const HashTable *ht,  // IN:
    *keys = Util_SafeMalloc(*size * sizeof **keys);
 
    /* fill array */
-   for (i = 0, j = 0; i < ht->numEntries; i++) {
+   buckets = BUCKETS(ht);
+   for (i = 0, j = 0; i < buckets->numEntries; i++) {
       HashTableEntry *entry;
 
-      for (entry = ENTRY(ht->buckets[i]);
+      for (entry = ENTRY(buckets->links[i]);
            entry != NULL;
            entry = ENTRY(entry->next)) {
          (*keys)[j++] = entry->keyStr;
@@ -915,6 +1213,7 @@ HashTable_ToArray(const HashTable *ht,  // IN:
                   void ***clientDatas,  // OUT:
                   size_t *size)         // OUT:
 {
+   HashTableBuckets *buckets;
    uint32 i;
    size_t j;
 
@@ -935,10 +1234,11 @@ HashTable_ToArray(const HashTable *ht,  // IN:
    *clientDatas = Util_SafeMalloc(*size * sizeof **clientDatas);
 
    /* fill array */
-   for (i = 0, j = 0; i < ht->numEntries; i++) {
+   buckets = BUCKETS(ht);
+   for (i = 0, j = 0; i < buckets->numEntries; i++) {
       HashTableEntry *entry;
 
-      for (entry = ENTRY(ht->buckets[i]);
+      for (entry = ENTRY(buckets->links[i]);
            entry != NULL;
            entry = ENTRY(entry->next)) {
          (*clientDatas)[j++] = Atomic_ReadPtr(&entry->clientData);
@@ -971,22 +1271,27 @@ HashTable_ForEach(const HashTable *ht,          // IN:
                   HashTableForEachCallback cb,  // IN:
                   void *clientData)             // IN:
 {
-   int i;
+   HashTableBuckets *buckets;
 
    ASSERT(ht);
    ASSERT(cb);
 
-   for (i = 0; i < ht->numEntries; i++) {
-      HashTableEntry *entry;
+   for (buckets = BUCKETS(ht); buckets != NULL; buckets = buckets->older) {
+      uint32 i;
 
-      for (entry = ENTRY(ht->buckets[i]);
-           entry != NULL;
-           entry = ENTRY(entry->next)) {
-         int result = (*cb)(entry->keyStr, Atomic_ReadPtr(&entry->clientData),
-                            clientData);
+      for (i = 0; i < buckets->numEntries; i++) {
+         HashTableEntry *entry;
+
+         for (entry = ENTRY(buckets->links[i]);
+              entry != NULL;
+              entry = ENTRY(entry->next)) {
+            int result = (*cb)(entry->keyStr,
+                               Atomic_ReadPtr(&entry->clientData),
+                               clientData);
 
-         if (result) {
-            return result;
+            if (result) {
+               return result;
+            }
          }
       }
    }
@@ -1015,18 +1320,19 @@ HashTable_ForEach(const HashTable *ht,          // IN:
 void
 HashPrint(HashTable *ht) // IN
 {
+   HashTableBuckets *buckets = BUCKETS(ht);
    int i;
 
-   for (i = 0; i < ht->numEntries; i++) {
+   for (i = 0; i < buckets->numEntries; i++) {
       HashTableEntry *entry;
 
-      if (ht->buckets[i] == NULL) {
+      if (ENTRY(buckets->links[i]) == NULL) {
          continue;
       }
 
       printf("%4d: \n", i);
 
-      for (entry = ENTRY(ht->buckets[i]);
+      for (entry = ENTRY(buckets->links[i]);
            entry != NULL;
            entry = ENTRY(entry->next)) {
          if (ht->keyType == HASH_INT_KEY) {
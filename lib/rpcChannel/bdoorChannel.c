@@ -39,6 +39,9 @@ typedef struct BackdoorChannel {
    RpcOut        *out;
    gboolean       inStarted;
    gboolean       outStarted;
+   guint          minDelay;
+   guint          maxDelay;
+   guint          burst;
 } BackdoorChannel;
 
 
@@ -89,7 +92,11 @@ RpcInStart(RpcChannel *chan)
    }
 
    if (bdoor->in != NULL) {
-      ret = RpcIn_start(bdoor->in, RPCIN_MAX_DELAY, RpcChannel_Error, chan);
+      ret = RpcIn_start(bdoor->in, bdoor->maxDelay, RpcChannel_Error, chan);
+      if (ret) {
+         RpcIn_SetSchedule(bdoor->in, bdoor->minDelay, bdoor->maxDelay,
+                           bdoor->burst);
+      }
    }
    if (ret) {
       ret = RpcOut_start(bdoor->out);
@@ -274,6 +281,9 @@ BackdoorChannel_New(void)
 
    bdoor->inStarted = FALSE;
    bdoor->outStarted = FALSE;
+   bdoor->minDelay = 0;
+   bdoor->maxDelay = RPCIN_MAX_DELAY;
+   bdoor->burst = 0;
 
    ret->start = RpcInStart;
    ret->stop = RpcInStop;
@@ -285,3 +295,58 @@ BackdoorChannel_New(void)
    return ret;
 }
 
+
+/**
+ * Configures how the RpcIn loop of a backdoor channel polls the host. Delays
+ * are in .01s; when idle the loop backs off exponentially from @a minDelay to
+ * @a maxDelay, and after a message it keeps polling immediately for up to
+ * @a burst empty polls. Takes effect the next time the channel is started.
+ *
+ * @param[in]  chan        A channel created by BackdoorChannel_New().
+ * @param[in]  minDelay    Min delay between polls when idle.
+ * @param[in]  maxDelay    Max delay between polls (0 uses the default).
+ * @param[in]  burst       Number of immediate re-polls after a message.
+ */
+
+void
+BackdoorChannel_SetSchedule(RpcChannel *chan,
+                            guint minDelay,
+                            guint maxDelay,
+                            guint burst)
+{
+   BackdoorChannel *bdoor = chan->_private;
+
+   bdoor->maxDelay = (maxDelay > 0) ? maxDelay : RPCIN_MAX_DELAY;
+   bdoor->minDelay = MIN(minDelay, bdoor->maxDelay);
+   bdoor->burst = burst;
+}
+
+
+/**
+ * Returns the counters of the RpcIn loop of a backdoor channel, gathered
+ * since the channel was last started.
+ *
+ * @param[in]  chan     The RPC channel.
+ * @param[out] stats    Where to store the counters.
+ *
+ * @return FALSE if @a chan is not a started backdoor channel.
+ */
+
+gboolean
+BackdoorChannel_GetStats(RpcChannel *chan,
+                         RpcInStats *stats)
+{
+   BackdoorChannel *bdoor;
+
+   if (chan->start != RpcInStart) {
+      return FALSE;
+   }
+
+   bdoor = chan->_private;
+   if (bdoor->in == NULL || !bdoor->inStarted) {
+      return FALSE;
+   }
+
+   RpcIn_GetStats(bdoor->in, stats);
+   return TRUE;
+}
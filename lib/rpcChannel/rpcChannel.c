@@ -27,7 +27,6 @@
 #include "dynxdr.h"
 #include "rpcChannelInt.h"
 #include "str.h"
-#include "strutil.h"
 #include "vmxrpc.h"
 #include "xdrutil.h"
 
@@ -50,6 +49,9 @@ typedef struct RpcChannelInt {
 /** Max number of times to attempt a channel restart. */
 #define RPCIN_MAX_RESTARTS 60
 
+/** RPC names shorter than this are looked up without a heap copy. */
+#define RPCCHANNEL_NAME_BUF_SIZE 64
+
 static gboolean
 RpcChannelPing(RpcInData *data);
 
@@ -350,19 +352,34 @@ RpcChannel_Create(void)
 gboolean
 RpcChannel_Dispatch(RpcInData *data)
 {
+   char nameBuf[RPCCHANNEL_NAME_BUF_SIZE];
    char *name = NULL;
-   unsigned int index = 0;
+   const char *start;
    size_t nameLen;
    Bool status;
    RpcChannelCallback *rpc = NULL;
    RpcChannelInt *chan = data->clientData;
 
-   name = StrUtil_GetNextToken(&index, data->args, " ");
-   if (name == NULL) {
+   /*
+    * Same tokenization as StrUtil_GetNextToken(), but the name of the RPC
+    * is only copied to the heap when it doesn't fit in nameBuf: this runs
+    * for every message the host sends.
+    */
+   start = data->args + strspn(data->args, " ");
+   nameLen = strcspn(start, " ");
+   if (nameLen == 0) {
       status = RPCIN_SETRETVALS(data, "Bad command", FALSE);
       goto exit;
    }
 
+   if (nameLen < sizeof nameBuf) {
+      name = nameBuf;
+   } else {
+      name = g_malloc(nameLen + 1);
+   }
+   memcpy(name, start, nameLen);
+   name[nameLen] = '\0';
+
    if (chan->rpcs != NULL) {
       rpc = g_hash_table_lookup(chan->rpcs, name);
    }
@@ -373,7 +390,6 @@ RpcChannel_Dispatch(RpcInData *data)
    }
 
    /* Adjust the RPC arguments. */
-   nameLen = strlen(name);
    data->name = name;
    data->args = data->args + nameLen;
    data->argsSize -= nameLen;
@@ -390,7 +406,9 @@ RpcChannel_Dispatch(RpcInData *data)
 
 exit:
    data->name = NULL;
-   free(name);
+   if (name != nameBuf) {
+      g_free(name);
+   }
    return status;
 }
 
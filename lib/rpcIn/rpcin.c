@@ -52,6 +52,7 @@
 #include "vmware.h"
 #include "message.h"
 #include "rpcin.h"
+#include "hostinfo.h"
 
 #if defined(VMTOOLS_USE_GLIB)
 
@@ -64,20 +65,23 @@
 #else /* VMTOOLS_USE_GLIB */
 
 #include "eventManager.h"
+#include "hashTable.h"
 
 /* Which event queue should RPC events be added to? */
 static DblLnkLst_Links *gTimerEventQueue;
 
+/* Initial size of the table of TCLO command callbacks (it grows as needed). */
+#define RPCIN_CALLBACK_TABLE_SIZE 64
+
 /*
  * The RpcIn object
  */
 
-/* The list of TCLO command callbacks we support */
+/* A TCLO command callback we support, indexed by name in RpcIn.callbacks */
 typedef struct RpcInCallbackList {
    const char *name;
    size_t length; /* Length of name so we don't have to strlen a lot */
    RpcIn_Callback callback;
-   struct RpcInCallbackList *next;
    void *clientData;
 } RpcInCallbackList;
 
@@ -90,13 +94,17 @@ struct RpcIn {
    RpcIn_Callback dispatch;
    gpointer clientData;
 #else
-   RpcInCallbackList *callbacks;
+   HashTable *callbacks;   /* RpcInCallbackList, keyed by command name */
    Event *nextEvent;
 #endif
 
    Message_Channel *channel;
    unsigned int delay;   /* The delay of the previous iteration of RpcInLoop */
+   unsigned int minDelay;  /* The minimum delay to schedule when idle */
    unsigned int maxDelay;  /* The maximum delay to schedule in RpcInLoop */
+   unsigned int burst;     /* Immediate re-polls to do after a message */
+   unsigned int burstLeft; /* Re-polls left in the current burst */
+   RpcInStats stats;
    RpcIn_ErrorFunc *errorFunc;
    void *errorData;
 
@@ -164,6 +172,32 @@ RpcInPingCallback(char const **result,     // OUT
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RpcInFreeCallback --
+ *
+ *      Frees a callback struct when it is removed from the callback table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RpcInFreeCallback(void *clientData)    // IN
+{
+   RpcInCallbackList *p = clientData;
+
+   free((void *) p->name);
+   free(p);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -186,6 +220,12 @@ RpcIn_Construct(DblLnkLst_Links *eventQueue)
    RpcIn *result;
    result = (RpcIn *)calloc(1, sizeof(RpcIn));
 
+   if (result != NULL) {
+      result->callbacks = HashTable_Alloc(RPCIN_CALLBACK_TABLE_SIZE,
+                                          HASH_STRING_KEY,
+                                          RpcInFreeCallback);
+   }
+
    gTimerEventQueue = result? eventQueue: NULL;
    return result;
 }
@@ -196,7 +236,7 @@ RpcIn_Construct(DblLnkLst_Links *eventQueue)
  *
  * RpcInLookupCallback --
  *
- *      Lookup a callback struct in our list.
+ *      Lookup a callback struct in our table.
  *
  * Results:
  *      The callback if found
@@ -212,18 +252,16 @@ static RpcInCallbackList *
 RpcInLookupCallback(RpcIn *in,        // IN
                     const char *name) // IN
 {
-   RpcInCallbackList *p;
+   void *p;
 
    ASSERT(in);
    ASSERT(name);
 
-   for (p = in->callbacks; p; p = p->next) {
-      if (strcmp(name, p->name) == 0) {
-         return p;
-      }
+   if (!HashTable_Lookup(in->callbacks, name, &p)) {
+      return NULL;
    }
 
-   return NULL;
+   return p;
 }
 
 
@@ -243,7 +281,8 @@ RpcInLookupCallback(RpcIn *in,        // IN
  *      None
  *
  * Side effects:
- *      None
+ *      Logs a warning and ignores the callback if one is already
+ *      registered for 'name'.
  *
  *-----------------------------------------------------------------------------
  */
@@ -261,19 +300,21 @@ RpcIn_RegisterCallback(RpcIn *in,               // IN
    ASSERT(in);
    ASSERT(name);
    ASSERT(cb);
-   ASSERT(RpcInLookupCallback(in, name) == NULL); // not there yet
 
    p = (RpcInCallbackList *) malloc(sizeof(RpcInCallbackList));
    ASSERT_NOT_IMPLEMENTED(p);
 
    p->length = strlen(name);
    p->name = strdup(name);
+   ASSERT_NOT_IMPLEMENTED(p->name);
    p->callback = cb;
    p->clientData = clientData;
 
-   p->next = in->callbacks;
-
-   in->callbacks = p;
+   /* The first registration of a name wins. */
+   if (!HashTable_Insert(in->callbacks, p->name, p)) {
+      Warning("RpcIn: callback '%s' is already registered\n", name);
+      RpcInFreeCallback(p);
+   }
 }
 
 
@@ -297,29 +338,18 @@ void
 RpcIn_UnregisterCallback(RpcIn *in,               // IN
                          const char *name)        // IN
 {
-   RpcInCallbackList *cur, *prev;
-
    ASSERT(in);
    ASSERT(name);
 
    Debug("Unregistering callback '%s'\n", name);
 
-   for (cur = in->callbacks, prev = NULL; cur && strcmp(cur->name, name);
-        prev = cur, cur = cur->next);
-
    /*
     * If we called UnregisterCallback on a name that doesn't exist, we
     * have a problem.
     */
-   ASSERT(cur != NULL);
-
-   if (prev == NULL) {
-      in->callbacks = cur->next;
-   } else {
-      prev->next = cur->next;
+   if (!HashTable_Delete(in->callbacks, name)) {
+      NOT_REACHED();
    }
-   free((void *)cur->name);
-   free(cur);
 }
 
 
@@ -399,13 +429,8 @@ RpcIn_Destruct(RpcIn *in) // IN
    ASSERT(in->mustSend == FALSE);
 
 #if !defined(VMTOOLS_USE_GLIB)
-   while (in->callbacks) {
-      RpcInCallbackList *p;
-
-      p = in->callbacks->next;
-      free((void *) in->callbacks->name);
-      free(in->callbacks);
-      in->callbacks = p;
+   if (in->callbacks != NULL) {
+      HashTable_Free(in->callbacks);
    }
 
    gTimerEventQueue = NULL;
@@ -504,6 +529,14 @@ RpcInStop(RpcIn *in) // IN
       }
 
       in->channel = NULL;
+
+      Debug("RpcIn: %"FMT64"u polls, %"FMT64"u empty, dispatch latency (ms) "
+            "<1:%"FMT64"u <2:%"FMT64"u <4:%"FMT64"u <8:%"FMT64"u "
+            "<16:%"FMT64"u <32:%"FMT64"u <64:%"FMT64"u >=64:%"FMT64"u\n",
+            in->stats.polls, in->stats.emptyPolls,
+            in->stats.latency[0], in->stats.latency[1], in->stats.latency[2],
+            in->stats.latency[3], in->stats.latency[4], in->stats.latency[5],
+            in->stats.latency[6], in->stats.latency[7]);
    }
 }
 
@@ -535,6 +568,38 @@ RpcIn_stop(RpcIn *in) // IN
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RpcInAccountDispatch --
+ *
+ *      Records how long it took to dispatch a message in the latency
+ *      histogram of the channel.
+ *
+ * Results:
+ *      None
+ *
+ * Side effects:
+ *      None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RpcInAccountDispatch(RpcIn *in,          // IN
+                     VmTimeType usecs)   // IN
+{
+   VmTimeType msecs = usecs / 1000;
+   unsigned int bucket = 0;
+
+   while (msecs > 0 && bucket < RPCIN_LATENCY_BUCKETS - 1) {
+      msecs >>= 1;
+      bucket++;
+   }
+   in->stats.latency[bucket]++;
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -612,6 +677,8 @@ RpcInLoop(void *clientData) // IN
       goto error;
    }
 
+   in->stats.polls++;
+
    if (repLen) {
       unsigned int status;
       char const *statusStr;
@@ -619,6 +686,7 @@ RpcInLoop(void *clientData) // IN
       char *result;
       size_t resultLen;
       Bool freeResult = FALSE;
+      VmTimeType start = Hostinfo_SystemTimerUS();
 
       /*
        * Execute the RPC
@@ -658,6 +726,8 @@ RpcInLoop(void *clientData) // IN
       }
 #endif
 
+      RpcInAccountDispatch(in, Hostinfo_SystemTimerUS() - start);
+
       if (status) {
          statusStr = "OK ";
          statusLen = 3;
@@ -681,9 +751,12 @@ RpcInLoop(void *clientData) // IN
 
       /*
        * Run the event pump (in case VMware sends a long sequence of RPCs and
-       * perfoms a time-consuming job) and continue to loop immediately
+       * perfoms a time-consuming job) and continue to loop immediately. The
+       * host usually sends several messages in a row, so keep polling without
+       * delay for a few more iterations before starting to back off.
        */
       in->delay = 0;
+      in->burstLeft = in->burst;
    } else {
       /*
        * Nothing to execute
@@ -693,13 +766,19 @@ RpcInLoop(void *clientData) // IN
       ASSERT(in->last_result == NULL);
       ASSERT(in->last_resultLen == 0);
 
+      in->stats.emptyPolls++;
+
       /*
        * Continue to loop in a while. Use an exponential back-off, doubling
        * the time to wait each time there isn't a new message, up to the max
-       * delay.
+       * delay. While a burst is in progress, poll again right away (or after
+       * the min delay).
        */
 
-      if (in->delay < in->maxDelay) {
+      if (in->burstLeft > 0) {
+         in->burstLeft--;
+         in->delay = in->minDelay;
+      } else if (in->delay < in->maxDelay) {
          if (in->delay > 0) {
             /*
              * Catch overflow.
@@ -708,6 +787,7 @@ RpcInLoop(void *clientData) // IN
          } else {
             in->delay = 1;
          }
+         in->delay = MAX(in->delay, in->minDelay);
          in->delay = MIN(in->delay, in->maxDelay);
       }
    }
@@ -793,7 +873,11 @@ RpcIn_start(RpcIn *in,                    // IN
    ASSERT(in);
 
    in->delay = 0;
+   in->minDelay = 0;
    in->maxDelay = delay;
+   in->burst = 0;
+   in->burstLeft = 0;
+   memset(&in->stats, 0, sizeof in->stats);
    in->errorFunc = errorFunc;
    in->errorData = errorData;
 
@@ -838,6 +922,68 @@ error:
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RpcIn_SetSchedule --
+ *
+ *      Tunes how often the RpcIn loop polls the host (delays are in .01s).
+ *      When idle, the loop backs off exponentially from minDelay up to
+ *      maxDelay; after each message it polls again right away, and keeps
+ *      doing so for up to 'burst' empty polls before backing off again.
+ *
+ * Results:
+ *      None
+ *
+ * Side effects:
+ *      Takes effect the next time the loop is scheduled.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+RpcIn_SetSchedule(RpcIn *in,                 // IN
+                  unsigned int minDelay,     // IN
+                  unsigned int maxDelay,     // IN
+                  unsigned int burst)        // IN
+{
+   ASSERT(in);
+   ASSERT(minDelay <= maxDelay);
+
+   in->minDelay = minDelay;
+   in->maxDelay = maxDelay;
+   in->burst = burst;
+   in->burstLeft = MIN(in->burstLeft, burst);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RpcIn_GetStats --
+ *
+ *      Returns the loop counters gathered since the channel was started.
+ *
+ * Results:
+ *      The counters in 'stats'.
+ *
+ * Side effects:
+ *      None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+RpcIn_GetStats(RpcIn *in,            // IN
+               RpcInStats *stats)    // OUT
+{
+   ASSERT(in);
+   ASSERT(stats);
+
+   *stats = in->stats;
+}
+
+
 #if !defined(VMTOOLS_USE_GLIB)
 /*
  *-----------------------------------------------------------------------------
@@ -20,6 +20,10 @@
  * @file net.c
  *
  *	Parses assorted /proc/net nodes.
+ *
+ *	Each node is read whole into one buffer and tokenized in place, and
+ *	the results are allocated in as few blocks as the public interfaces
+ *	allow: route tables are read often, and can be large.
  */
 
 
@@ -27,6 +31,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <net/if.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -50,21 +55,17 @@
 
 
 /**
- * @brief Evaluate an expression with a regular expression match.
- *
- * Convenience wrapper to fetch a regular expression match result, evaluate
- * it as an argument in some expression, and then free it.
- *
- * @param[in] matchInfo  GMatchInfo RE context.
- * @param[in] matchIndex Match index.
- * @param[in] expr       Expression to evaluate.  Must contain @c MATCH as
- *                       placeholder where matched value will be inserted.
+ * Initial size of the buffer /proc/net nodes are read into.  The buffer grows
+ * as needed; route tables can be a lot larger than this.
  */
-#define MATCHEXPR(matchInfo, matchIndex, expr) do {                     \
-   gchar *MATCH = g_match_info_fetch(matchInfo, matchIndex);            \
-   expr;                                                                \
-   g_free(MATCH);                                                       \
-} while(0)
+#define PROC_NET_BUFSIZE 8192
+
+
+/**
+ * Number of interface name to index mappings remembered while parsing
+ * @c /proc/net/ipv6_route.
+ */
+#define IFINDEX_CACHE_SIZE 8
 
 
 /**
@@ -95,11 +96,16 @@ static const char *pathToNetRoute6 = PROC_NET_ROUTE6;
  * Private function prototypes.
  */
 
-static void Ip6StringToIn6Addr(const char *ip6String,
-                               struct in6_addr *in6_addr);
-static guint64 MatchToGuint64(const GMatchInfo *matchInfo,
-                              const gint matchIndex,
-                              gint base);
+static char *ReadProcFile(const char *path, size_t *size);
+static guint CountLines(const char *buf, size_t size);
+static Bool ParseEol(const char **p);
+static Bool ParseToken(const char **p, const char **token, size_t *len);
+static Bool ParseHex(const char **p, unsigned int digits, guint64 *value);
+static Bool ParseDec(const char **p, guint64 *value);
+static Bool ParseIn6Addr(const char **p, struct in6_addr *in6_addr);
+static gpointer NewCounter(const char *prefix, size_t prefixLen,
+                           const char *name, size_t nameLen,
+                           guint64 value, const char **key);
 
 
 /*
@@ -107,7 +113,6 @@ static guint64 MatchToGuint64(const GMatchInfo *matchInfo,
  */
 
 
-#ifdef VMX86_DEVEL
 /*
  ******************************************************************************
  * SlashProcNetSetPathSnmp --                                           */ /**
@@ -180,7 +185,6 @@ SlashProcNetSetPathRoute6(const char *newPathToNetRoute6)
 {
    pathToNetRoute6 = newPathToNetRoute6 ? newPathToNetRoute6 : PROC_NET_ROUTE6;
 }
-#endif // ifdef VMX86_DEVEL
 
 
 /*
@@ -203,11 +207,9 @@ SlashProcNetSetPathRoute6(const char *newPathToNetRoute6)
  *
  * @note        Caller should free the returned @c GHashTable with
  *              @c g_hash_table_destroy.
- * @note        This routine creates persistent GLib GRegexs.
  *
  * @return      On failure, NULL.  On success, a valid @c GHashTable.
  * @todo        Provide a case-insensitive key comparison function.
- * @todo        Consider init/cleanup routines to not "leak" GRegexs.
  *
  ******************************************************************************
  */
@@ -216,33 +218,20 @@ GHashTable *
 SlashProcNet_GetSnmp(void)
 {
    GHashTable *myHashTable = NULL;
-   GIOChannel *myChannel = NULL;
-   GIOStatus keyIoStatus;
-   GIOStatus valIoStatus;
-   gchar *myKeyLine = NULL;
-   gchar *myValLine = NULL;
+   const char *keyLine;
+   char *buf;
+   size_t size;
    Bool parseError = FALSE;
-   int fd = -1;
-
-   static GRegex *myKeyRegex = NULL;
-   static GRegex *myValRegex = NULL;
-
-   if (myKeyRegex == NULL) {
-      myKeyRegex = g_regex_new("^(\\w+): (\\w+ )*(\\w+)$", G_REGEX_OPTIMIZE,
-                               0, NULL);
-      myValRegex = g_regex_new("^(\\w+): (-?\\d+ )*(-?\\d+)$", G_REGEX_OPTIMIZE,
-                               0, NULL);
-      ASSERT(myKeyRegex);
-      ASSERT(myValRegex);
-   }
 
-   if ((fd = g_open(pathToNetSnmp, O_RDONLY)) == -1) {
+   if ((buf = ReadProcFile(pathToNetSnmp, &size)) == NULL) {
       return NULL;
    }
 
-   myChannel = g_io_channel_unix_new(fd);
-
-   myHashTable = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+   /*
+    * Each value shares its allocation with its key (see NewCounter), so the
+    * table only frees values.
+    */
+   myHashTable = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
 
    /*
     * Expected format:
@@ -253,127 +242,79 @@ SlashProcNet_GetSnmp(void)
     * pfxN: ...
     */
 
-   while ((keyIoStatus = g_io_channel_read_line(myChannel, &myKeyLine, NULL, NULL,
-                                                NULL)) == G_IO_STATUS_NORMAL &&
-          (valIoStatus = g_io_channel_read_line(myChannel, &myValLine, NULL, NULL,
-                                                NULL)) == G_IO_STATUS_NORMAL) {
-
-      GMatchInfo *keyMatchInfo = NULL;
-      GMatchInfo *valMatchInfo = NULL;
-
-      gchar **myKeys = NULL;
-      gchar **myVals = NULL;
-
-      gchar **myKey = NULL;
-      gchar **myVal = NULL;
-
-      gchar *keyPrefix = NULL;
-      gchar *valPrefix = NULL;
+   keyLine = buf;
+   while (*keyLine != '\0') {
+      const char *keyPrefix;
+      const char *valPrefix;
+      const char *kp = keyLine;
+      const char *vp;
+      size_t keyPrefixLen;
+      size_t valPrefixLen;
 
       /*
        * Per format above, we expect a pair of lines with a matching prefix.
        */
-      {
-         if (!g_regex_match(myKeyRegex, myKeyLine, 0, &keyMatchInfo) ||
-             !g_regex_match(myValRegex, myValLine, 0, &valMatchInfo)) {
-            parseError = TRUE;
-            goto badIteration;
-         }
-
-         keyPrefix = g_match_info_fetch(keyMatchInfo, 1);
-         valPrefix = g_match_info_fetch(valMatchInfo, 1);
-
-         ASSERT(keyPrefix);
-         ASSERT(valPrefix);
-
-         if (strcmp(keyPrefix, valPrefix)) {
-            parseError = TRUE;
-            goto badIteration;
-         }
+      if ((vp = strchr(keyLine, '\n')) == NULL) {
+         parseError = TRUE;
+         break;
       }
+      vp++;
 
-      myKeys = g_strsplit(myKeyLine, " ", 0);
-      myVals = g_strsplit(myValLine, " ", 0);
+      if (!ParseToken(&kp, &keyPrefix, &keyPrefixLen) ||
+          !ParseToken(&vp, &valPrefix, &valPrefixLen) ||
+          keyPrefixLen < 2 || keyPrefix[keyPrefixLen - 1] != ':' ||
+          keyPrefixLen != valPrefixLen ||
+          memcmp(keyPrefix, valPrefix, keyPrefixLen) != 0) {
+         parseError = TRUE;
+         break;
+      }
+      keyPrefixLen--;
 
       /*
-       * Iterate over the columns, combining the column keys with the prefix
+       * Walk both lines in step, combining the column keys with the prefix
        * to form the new key name.  (I.e., "Ip: InDiscards" => "IpInDiscards".)
+       * If our input contains duplicate keys, which I really don't see
+       * happening, the latter value overrides the former.
        */
-      for (myKey = &myKeys[1], myVal = &myVals[1];
-           *myKey && *myVal;
-           myKey++, myVal++) {
-         gchar *hashKey;
-         guint64 *myIntVal = NULL;
-
-         hashKey = g_strjoin(NULL, keyPrefix, *myKey, NULL);
-         g_strstrip(hashKey);
-
-         /*
-          * By virtue of having matched the above regex, this conversion
-          * must hold.
-          */
-         myIntVal = g_new(guint64, 1);
-         *myIntVal = g_ascii_strtoull(*myVal, NULL, 10);
-
-         /*
-          * If our input contains duplicate keys, which I really don't see
-          * happening, the latter value overrides the former.
-          *
-          * NB: myHashTable claims ownership of hashKey.
-          */
-         g_hash_table_insert(myHashTable, hashKey, myIntVal);
+      while (!ParseEol(&kp)) {
+         const char *myKey;
+         const char *hashKey;
+         size_t myKeyLen;
+         guint64 myVal;
+         gpointer counter;
+
+         if (!ParseToken(&kp, &myKey, &myKeyLen) || !ParseDec(&vp, &myVal)) {
+            parseError = TRUE;
+            break;
+         }
+
+         counter = NewCounter(keyPrefix, keyPrefixLen, myKey, myKeyLen, myVal,
+                              &hashKey);
+         g_hash_table_replace(myHashTable, (gpointer)hashKey, counter);
       }
 
       /*
-       * Make sure the column counts matched.  If we succeeded, both pointers
-       * should now be NULL.
+       * Make sure the column counts matched.
        */
-      if (*myKey || *myVal) {
+      if (parseError || !ParseEol(&vp)) {
          parseError = TRUE;
-      }
-
-badIteration:
-      g_match_info_free(keyMatchInfo);
-      g_match_info_free(valMatchInfo);
-
-      g_free(keyPrefix);
-      g_free(valPrefix);
-
-      g_strfreev(myKeys);
-      g_strfreev(myVals);
-
-      g_free(myKeyLine);
-      g_free(myValLine);
-      myKeyLine = NULL;
-      myValLine = NULL;
-
-      if (parseError) {
          break;
       }
+
+      keyLine = vp;
    }
 
    /*
     * Error conditions:
     *    Hash table empty:      Unable to parse any input.
-    *    myKeyLine != NULL:     Failed to read "key" and "value" lines during
-    *                           same loop iteration.
     *    parseError == TRUE:    See loop body above.
     */
-   if (keyIoStatus == G_IO_STATUS_ERROR ||
-       valIoStatus == G_IO_STATUS_ERROR ||
-       g_hash_table_size(myHashTable) == 0 ||
-       parseError) {
+   if (g_hash_table_size(myHashTable) == 0 || parseError) {
       g_hash_table_destroy(myHashTable);
       myHashTable = NULL;
    }
 
-   g_free(myKeyLine);
-   g_free(myValLine);
-   myKeyLine = NULL;
-   myValLine = NULL;
-
-   close(fd);
-   g_io_channel_unref(myChannel);
+   g_free(buf);
 
    return myHashTable;
 }
@@ -394,11 +335,9 @@ badIteration:
  *
  * @note        Caller should free the returned @c GHashTable with
  *              @c g_hash_table_destroy.
- * @note        This routine creates persistent GLib GRegexs.
  *
  * @return      On failure, NULL.  On success, a valid @c GHashTable.
  * @todo        Provide a case-insensitive key comparison function.
- * @todo        Consider init/cleanup routines to not "leak" GRegexs.
  *
  ******************************************************************************
  */
@@ -407,27 +346,16 @@ GHashTable *
 SlashProcNet_GetSnmp6(void)
 {
    GHashTable *myHashTable = NULL;
-   GIOChannel *myChannel = NULL;
-   GIOStatus ioStatus;
-   gchar *myInputLine = NULL;
+   const char *p;
+   char *buf;
+   size_t size;
    Bool parseError = FALSE;
-   int fd = -1;
 
-   static GRegex *myRegex = NULL;
-
-   if (myRegex == NULL) {
-      myRegex = g_regex_new("^(\\w+)\\s+(-?\\d+)\\s*$", G_REGEX_OPTIMIZE,
-                            0, NULL);
-      ASSERT(myRegex);
-   }
-
-   if ((fd = g_open(pathToNetSnmp6, O_RDONLY)) == -1) {
+   if ((buf = ReadProcFile(pathToNetSnmp6, &size)) == NULL) {
       return NULL;
    }
 
-   myChannel = g_io_channel_unix_new(fd);
-
-   myHashTable = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+   myHashTable = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
 
    /*
     * Expected format:
@@ -438,53 +366,31 @@ SlashProcNet_GetSnmp6(void)
     * keyN                              valueN
     */
 
-   while ((ioStatus = g_io_channel_read_line(myChannel, &myInputLine, NULL,
-                                             NULL, NULL)) == G_IO_STATUS_NORMAL) {
-      GMatchInfo *matchInfo = NULL;
-
-      if (g_regex_match(myRegex, myInputLine, 0, &matchInfo)) {
-         gchar *myKey = NULL;
-         gchar *myVal = NULL;
-         guint64 *myIntVal = NULL;
-
-         myKey = g_match_info_fetch(matchInfo, 1);
-         myVal = g_match_info_fetch(matchInfo, 2);
-
-         /*
-          * By virtue of having matched the above regex, this conversion
-          * must hold.
-          */
-         myIntVal = g_new(guint64, 1);
-         *myIntVal = g_ascii_strtoull(myVal, NULL, 10);
-
-         /*
-          * The hash table will take ownership of myKey and myIntVal.  We're
-          * still responsible for myVal.
-          */
-         g_hash_table_insert(myHashTable, myKey, myIntVal);
-         g_free(myVal);
-      } else {
+   p = buf;
+   while (*p != '\0') {
+      const char *myKey;
+      const char *hashKey;
+      size_t myKeyLen;
+      guint64 myVal;
+      gpointer counter;
+
+      if (!ParseToken(&p, &myKey, &myKeyLen) ||
+          !ParseDec(&p, &myVal) ||
+          !ParseEol(&p)) {
          parseError = TRUE;
-      }
-
-      g_match_info_free(matchInfo);
-      g_free(myInputLine);
-      myInputLine = NULL;
-
-      if (parseError) {
          break;
       }
+
+      counter = NewCounter("", 0, myKey, myKeyLen, myVal, &hashKey);
+      g_hash_table_replace(myHashTable, (gpointer)hashKey, counter);
    }
 
-   if (ioStatus == G_IO_STATUS_ERROR ||
-       g_hash_table_size(myHashTable) == 0 ||
-       parseError) {
+   if (g_hash_table_size(myHashTable) == 0 || parseError) {
       g_hash_table_destroy(myHashTable);
       myHashTable = NULL;
    }
 
-   close(fd);
-   g_io_channel_unref(myChannel);
+   g_free(buf);
 
    return myHashTable;
 }
@@ -510,11 +416,11 @@ SlashProcNet_GetSnmp6(void)
  * @endcode
  *
  * @note        Caller is responsible for freeing the @c GPtrArray with
- *              SlashProcNet_FreeRoute.
- * @note        This routine creates persistent GLib GRegexs.
+ *              SlashProcNet_FreeRoute.  The entries and their @c rt_dev
+ *              strings are carved out of a single allocation, so they must
+ *              not be freed, or removed from the array, individually.
  *
  * @return      On failure, NULL.  On success, a valid @c GPtrArray.
- * @todo        Consider init/cleanup routines to not "leak" GRegexs.
  * @todo        Consider rewriting, integrating with libdnet.
  *
  ******************************************************************************
@@ -523,126 +429,126 @@ SlashProcNet_GetSnmp6(void)
 GPtrArray *
 SlashProcNet_GetRoute(void)
 {
-   GIOChannel *myChannel = NULL;
-   GIOStatus myIoStatus;
-   GPtrArray *myArray = NULL;
-   gchar *myLine = NULL;
-   int fd = -1;
-
-   static GRegex *myFieldsRE = NULL;
-   static GRegex *myValuesRE = NULL;
+   static const char *myFields[] = {
+      "Iface", "Destination", "Gateway", "Flags", "RefCnt", "Use", "Metric",
+      "Mask", "MTU", "Window", "IRTT"
+   };
 
-   if (myFieldsRE == NULL) {
-      myFieldsRE = g_regex_new("^Iface\\s+Destination\\s+Gateway\\s+Flags\\s+"
-                               "RefCnt\\s+Use\\s+Metric\\s+Mask\\s+MTU\\s+"
-                               "Window\\s+IRTT\\s*$", 0, 0, NULL);
-      myValuesRE = g_regex_new("^(\\w+)\\s+([[:xdigit:]]{8})\\s+"
-                               "([[:xdigit:]]{8})\\s+([[:xdigit:]]{4})\\s+"
-                               "\\d+\\s+\\d+\\s+(\\d+)\\s+"
-                               "([[:xdigit:]]{8})\\s+(\\d+)\\s+\\d+\\s+(\\d+)\\s*$",
-                               0, 0, NULL);
-      ASSERT(myFieldsRE);
-      ASSERT(myValuesRE);
-   }
+   GPtrArray *myArray = NULL;
+   struct rtentry *myEntries = NULL;
+   char *myNames;
+   const char *p;
+   char *buf;
+   size_t size;
+   guint maxRoutes;
+   guint i;
 
    /*
-    * 1.  Open pathToNetRoute, associate it with a GIOChannel.
+    * 1.  Read pathToNetRoute.
     */
 
-   if ((fd = g_open(pathToNetRoute, O_RDONLY)) == -1) {
+   if ((buf = ReadProcFile(pathToNetRoute, &size)) == NULL) {
       Warning("%s: open(%s): %s\n", __func__, pathToNetRoute,
               g_strerror(errno));
       return NULL;
    }
 
-   myChannel = g_io_channel_unix_new(fd);
-
    /*
     * 2.  Sanity check the header, making sure it matches what we expect.
     *     (It's -extremely- unlikely this will change, but we should check
     *     anyway.)
     */
 
-   myIoStatus = g_io_channel_read_line(myChannel, &myLine, NULL, NULL, NULL);
-   if (myIoStatus != G_IO_STATUS_NORMAL ||
-       g_regex_match(myFieldsRE, myLine, 0, NULL) == FALSE) {
+   p = buf;
+   for (i = 0; i < ARRAYSIZE(myFields); i++) {
+      const char *field;
+      size_t fieldLen;
+
+      if (!ParseToken(&p, &field, &fieldLen) ||
+          fieldLen != strlen(myFields[i]) ||
+          memcmp(field, myFields[i], fieldLen) != 0) {
+         goto out;
+      }
+   }
+   if (!ParseEol(&p)) {
       goto out;
    }
 
-   g_free(myLine);
-   myLine = NULL;
+   /*
+    * 3.  Size the entries after the number of lines left; there is one
+    *     route per line.
+    */
+
+   maxRoutes = CountLines(p, size - (p - buf));
+   myArray = g_ptr_array_sized_new(maxRoutes);
+   if (maxRoutes == 0) {
+      goto out;
+   }
 
-   myArray = g_ptr_array_new();
+   myEntries = g_malloc0(maxRoutes * (sizeof *myEntries + IFNAMSIZ));
+   myNames = (char *)(myEntries + maxRoutes);
 
    /*
-    * 3.  For each line...
+    * 4.  For each line...
     */
 
-   while ((myIoStatus = g_io_channel_read_line(myChannel, &myLine, NULL, NULL,
-                                               NULL)) == G_IO_STATUS_NORMAL) {
-      GMatchInfo *myMatchInfo = NULL;
-      struct rtentry *myEntry = NULL;
-      struct sockaddr_in *sin = NULL;
-      Bool parseError = FALSE;
-
-      /*
-       * 3a. Validate with regex.
-       */
-      if (!g_regex_match(myValuesRE, myLine, 0, &myMatchInfo)) {
-         parseError = TRUE;
-         goto badIteration;
+   while (*p != '\0') {
+      struct rtentry *myEntry = &myEntries[myArray->len];
+      struct sockaddr_in *sin;
+      const char *dev;
+      size_t devLen;
+      guint64 dst, gateway, flags, refCnt, use, metric, mask, mtu, window, irtt;
+
+      ASSERT(myArray->len < maxRoutes);
+
+      if (!ParseToken(&p, &dev, &devLen) || devLen >= IFNAMSIZ ||
+          !ParseHex(&p, 8, &dst) ||
+          !ParseHex(&p, 8, &gateway) ||
+          !ParseHex(&p, 4, &flags) ||
+          !ParseDec(&p, &refCnt) ||
+          !ParseDec(&p, &use) ||
+          !ParseDec(&p, &metric) ||
+          !ParseHex(&p, 8, &mask) ||
+          !ParseDec(&p, &mtu) ||
+          !ParseDec(&p, &window) ||
+          !ParseDec(&p, &irtt) ||
+          !ParseEol(&p)) {
+         g_ptr_array_free(myArray, TRUE);
+         myArray = NULL;
+         goto out;
       }
 
-      /*
-       * 3b. Allocate new rtentry, add to array.  This simplifies the cleanup
-       *     code path.
-       */
-      myEntry = g_new0(struct rtentry, 1);
-      g_ptr_array_add(myArray, myEntry);
-
-      /*
-       * 3c. Copy contents to new struct rtentry.
-       */
-      myEntry->rt_dev = g_match_info_fetch(myMatchInfo, 1);
+      myEntry->rt_dev = &myNames[myArray->len * IFNAMSIZ];
+      memcpy(myEntry->rt_dev, dev, devLen);
 
       sin = (struct sockaddr_in *)&myEntry->rt_dst;
       sin->sin_family = AF_INET;
-      sin->sin_addr.s_addr = MatchToGuint64(myMatchInfo, 2, 16);
+      sin->sin_addr.s_addr = dst;
 
       sin = (struct sockaddr_in *)&myEntry->rt_gateway;
       sin->sin_family = AF_INET;
-      sin->sin_addr.s_addr = MatchToGuint64(myMatchInfo, 3, 16);
+      sin->sin_addr.s_addr = gateway;
 
       sin = (struct sockaddr_in *)&myEntry->rt_genmask;
       sin->sin_family = AF_INET;
-      sin->sin_addr.s_addr = MatchToGuint64(myMatchInfo, 6, 16);
-
-      myEntry->rt_flags = MatchToGuint64(myMatchInfo, 4, 16);
-      myEntry->rt_metric = MatchToGuint64(myMatchInfo, 5, 10);
-      myEntry->rt_mtu = MatchToGuint64(myMatchInfo, 7, 10);
-      myEntry->rt_irtt = MatchToGuint64(myMatchInfo, 8, 10);
-
-badIteration:
-      g_free(myLine);
-      myLine = NULL;
+      sin->sin_addr.s_addr = mask;
 
-      g_match_info_free(myMatchInfo);
-      myMatchInfo = NULL;
+      myEntry->rt_flags = flags;
+      myEntry->rt_metric = metric;
+      myEntry->rt_mtu = mtu;
+      myEntry->rt_irtt = irtt;
 
-      if (parseError) {
-         break;
-      }
-   }
-
-   if (myArray && myIoStatus != G_IO_STATUS_EOF) {
-      SlashProcNet_FreeRoute(myArray);
-      myArray = NULL;
+      g_ptr_array_add(myArray, myEntry);
    }
 
 out:
-   g_free(myLine);
-   close(fd);
-   g_io_channel_unref(myChannel);
+   /*
+    * Once the array holds entries, it owns them.
+    */
+   if (myArray == NULL || myArray->len == 0) {
+      g_free(myEntries);
+   }
+   g_free(buf);
 
    return myArray;
 }
@@ -663,17 +569,16 @@ out:
 void
 SlashProcNet_FreeRoute(GPtrArray *routeArray)
 {
-   int i;
-
    if (routeArray == NULL) {
       return;
    }
 
-   for (i = 0; i < routeArray->len; i++) {
-      struct rtentry *myEntry = g_ptr_array_index(routeArray, i);
-      ASSERT(myEntry->rt_dev);
-      g_free(myEntry->rt_dev);
-      g_free(myEntry);
+   /*
+    * All the entries, and their names, live in the block starting with the
+    * first entry.
+    */
+   if (routeArray->len > 0) {
+      g_free(g_ptr_array_index(routeArray, 0));
    }
 
    g_ptr_array_free(routeArray, TRUE);
@@ -700,11 +605,11 @@ SlashProcNet_FreeRoute(GPtrArray *routeArray)
  * @endcode
  *
  * @note        Caller is responsible for freeing the @c GPtrArray with
- *              SlashProcNet_FreeRoute6.
- * @note        This routine creates persistent GLib GRegexs.
+ *              SlashProcNet_FreeRoute6.  The entries are carved out of a
+ *              single allocation, so they must not be freed, or removed
+ *              from the array, individually.
  *
  * @return      On failure, NULL.  On success, a valid @c GPtrArray.
- * @todo        Consider init/cleanup routines to not "leak" GRegexs.
  * @todo        Consider rewriting, integrating with libdnet.
  *
  ******************************************************************************
@@ -713,85 +618,103 @@ SlashProcNet_FreeRoute(GPtrArray *routeArray)
 GPtrArray *
 SlashProcNet_GetRoute6(void)
 {
-   GIOChannel *myChannel = NULL;
-   GIOStatus myIoStatus;
-   GPtrArray *myArray = NULL;
-   gchar *myLine = NULL;
-   Bool parseError = FALSE;
-   int fd = -1;
-
-   static GRegex *myValuesRE = NULL;
+   struct {
+      char name[IFNAMSIZ];
+      int index;
+   } ifCache[IFINDEX_CACHE_SIZE];
+   guint ifCacheLen = 0;
+   guint ifCacheNext = 0;
 
-   if (myValuesRE == NULL) {
-      myValuesRE = g_regex_new("^([[:xdigit:]]{32}) ([[:xdigit:]]{2}) "
-                                "([[:xdigit:]]{32}) ([[:xdigit:]]{2}) "
-                                "([[:xdigit:]]{32}) ([[:xdigit:]]{8}) "
-                                "[[:xdigit:]]{8} [[:xdigit:]]{8} "
-                                "([[:xdigit:]]{8})\\s+(\\w+)\\s*$", 0, 0,
-                                NULL);
-      ASSERT(myValuesRE);
-   }
+   GPtrArray *myArray = NULL;
+   struct in6_rtmsg *myEntries = NULL;
+   const char *p;
+   char *buf;
+   size_t size;
+   guint maxRoutes;
 
    /*
-    * 1.  Open pathToNetRoute6, associate it with a GIOChannel.
+    * 1.  Read pathToNetRoute6.
     */
 
-   if ((fd = g_open(pathToNetRoute6, O_RDONLY)) == -1) {
-      Warning("%s: open(%s): %s\n", __func__, pathToNetRoute,
+   if ((buf = ReadProcFile(pathToNetRoute6, &size)) == NULL) {
+      Warning("%s: open(%s): %s\n", __func__, pathToNetRoute6,
               g_strerror(errno));
       return NULL;
    }
 
-   myChannel = g_io_channel_unix_new(fd);
+   maxRoutes = CountLines(buf, size);
+   myArray = g_ptr_array_sized_new(maxRoutes);
+   if (maxRoutes == 0) {
+      goto out;
+   }
 
-   myArray = g_ptr_array_new();
+   myEntries = g_malloc0(maxRoutes * sizeof *myEntries);
+
+   p = buf;
+   while (*p != '\0') {
+      struct in6_rtmsg *myEntry = &myEntries[myArray->len];
+      const char *dev;
+      size_t devLen;
+      guint64 dstLen, srcLen, metric, refCnt, use, flags;
+      guint i;
+
+      ASSERT(myArray->len < maxRoutes);
+
+      if (!ParseIn6Addr(&p, &myEntry->rtmsg_dst) ||
+          !ParseHex(&p, 2, &dstLen) ||
+          !ParseIn6Addr(&p, &myEntry->rtmsg_src) ||
+          !ParseHex(&p, 2, &srcLen) ||
+          !ParseIn6Addr(&p, &myEntry->rtmsg_gateway) ||
+          !ParseHex(&p, 8, &metric) ||
+          !ParseHex(&p, 8, &refCnt) ||
+          !ParseHex(&p, 8, &use) ||
+          !ParseHex(&p, 8, &flags) ||
+          !ParseToken(&p, &dev, &devLen) ||
+          !ParseEol(&p)) {
+         g_ptr_array_free(myArray, TRUE);
+         myArray = NULL;
+         goto out;
+      }
 
-   while ((myIoStatus = g_io_channel_read_line(myChannel, &myLine, NULL, NULL,
-                                               NULL)) == G_IO_STATUS_NORMAL) {
-      struct in6_rtmsg *myEntry = NULL;
-      GMatchInfo *myMatchInfo = NULL;
+      myEntry->rtmsg_dst_len = dstLen;
+      myEntry->rtmsg_src_len = srcLen;
+      myEntry->rtmsg_metric = metric;
+      myEntry->rtmsg_flags = flags;
 
-      if (!g_regex_match(myValuesRE, myLine, 0, &myMatchInfo)) {
-         parseError = TRUE;
-         goto badIteration;
+      /*
+       * Looking up an interface index takes a few system calls, and routes
+       * go through only a handful of interfaces: remember the last few.
+       */
+      myEntry->rtmsg_ifindex = -1;
+      if (devLen < IFNAMSIZ) {
+         for (i = 0; i < ifCacheLen; i++) {
+            if (strncmp(ifCache[i].name, dev, devLen) == 0 &&
+                ifCache[i].name[devLen] == '\0') {
+               break;
+            }
+         }
+         if (i == ifCacheLen) {
+            if (ifCacheLen < ARRAYSIZE(ifCache)) {
+               ifCacheLen++;
+            } else {
+               i = ifCacheNext;
+               ifCacheNext = (ifCacheNext + 1) % ARRAYSIZE(ifCache);
+            }
+            memcpy(ifCache[i].name, dev, devLen);
+            ifCache[i].name[devLen] = '\0';
+            ifCache[i].index = NetUtil_GetIfIndex(ifCache[i].name);
+         }
+         myEntry->rtmsg_ifindex = ifCache[i].index;
       }
 
-      myEntry = g_new0(struct in6_rtmsg, 1);
       g_ptr_array_add(myArray, myEntry);
-
-      MATCHEXPR(myMatchInfo, 1, Ip6StringToIn6Addr(MATCH, &myEntry->rtmsg_dst));
-      MATCHEXPR(myMatchInfo, 3, Ip6StringToIn6Addr(MATCH, &myEntry->rtmsg_src));
-      MATCHEXPR(myMatchInfo, 5, Ip6StringToIn6Addr(MATCH, &myEntry->rtmsg_gateway));
-
-      myEntry->rtmsg_dst_len = MatchToGuint64(myMatchInfo, 2, 16);
-      myEntry->rtmsg_src_len = MatchToGuint64(myMatchInfo, 4, 16);
-      myEntry->rtmsg_metric = MatchToGuint64(myMatchInfo, 6, 16);
-      myEntry->rtmsg_flags = MatchToGuint64(myMatchInfo, 7, 16);
-
-      MATCHEXPR(myMatchInfo, 8, myEntry->rtmsg_ifindex = NetUtil_GetIfIndex(MATCH));
-
-badIteration:
-      g_free(myLine);
-      myLine = NULL;
-
-      g_match_info_free(myMatchInfo);
-      myMatchInfo = NULL;
-
-      if (parseError) {
-         break;
-      }
    }
 
-   if (myArray && myIoStatus != G_IO_STATUS_EOF) {
-      g_ptr_array_free(myArray, TRUE);
-      myArray = NULL;
+out:
+   if (myArray == NULL || myArray->len == 0) {
+      g_free(myEntries);
    }
-
-   g_free(myLine);
-   myLine = NULL;
-
-   close(fd);
-   g_io_channel_unref(myChannel);
+   g_free(buf);
 
    return myArray;
 }
@@ -812,15 +735,15 @@ badIteration:
 void
 SlashProcNet_FreeRoute6(GPtrArray *routeArray)
 {
-   int i;
-
    if (routeArray == NULL) {
       return;
    }
 
-   for (i = 0; i < routeArray->len; i++) {
-      struct rtentry *myEntry = g_ptr_array_index(routeArray, i);
-      g_free(myEntry);
+   /*
+    * All the entries live in the block starting with the first one.
+    */
+   if (routeArray->len > 0) {
+      g_free(g_ptr_array_index(routeArray, 0));
    }
 
    g_ptr_array_free(routeArray, TRUE);
@@ -834,53 +757,401 @@ SlashProcNet_FreeRoute6(GPtrArray *routeArray)
 
 /*
  ******************************************************************************
- * Ip6StringToIn6Addr --                                                */ /**
+ * ReadProcFile --                                                      */ /**
+ *
+ * @brief Reads a whole file into a NUL-terminated buffer.
+ *
+ * @c /proc nodes have no meaningful size, so the buffer starts at
+ * @ref PROC_NET_BUFSIZE and doubles until the file fits.
+ *
+ * @param[in]   path    File to read.
+ * @param[out]  size    Number of bytes read, not counting the terminator.
+ *
+ * @return On success, the buffer, to be freed with @c g_free.  NULL on
+ *         failure, with @c errno set.
+ *
+ ******************************************************************************
+ */
+
+static char *
+ReadProcFile(const char *path,
+             size_t *size)
+{
+   size_t bufSize = PROC_NET_BUFSIZE;
+   size_t len = 0;
+   char *buf;
+   int fd;
+
+   if ((fd = g_open(path, O_RDONLY)) == -1) {
+      return NULL;
+   }
+
+   buf = g_malloc(bufSize);
+
+   for (;;) {
+      ssize_t nread;
+
+      if (len + 1 == bufSize) {
+         bufSize *= 2;
+         buf = g_realloc(buf, bufSize);
+      }
+
+      nread = read(fd, buf + len, bufSize - len - 1);
+      if (nread == 0) {
+         break;
+      } else if (nread == -1) {
+         int savedErrno = errno;
+
+         if (savedErrno == EINTR) {
+            continue;
+         }
+         close(fd);
+         g_free(buf);
+         errno = savedErrno;
+         return NULL;
+      }
+      len += nread;
+   }
+
+   close(fd);
+
+   buf[len] = '\0';
+   *size = len;
+   return buf;
+}
+
+
+/*
+ ******************************************************************************
+ * CountLines --                                                        */ /**
+ *
+ * @brief Counts the lines in a buffer, including an unterminated last one.
+ *
+ * @param[in]   buf     Buffer.
+ * @param[in]   size    Buffer length.
+ *
+ * @return Number of lines.
+ *
+ ******************************************************************************
+ */
+
+static guint
+CountLines(const char *buf,
+           size_t size)
+{
+   const char *end = buf + size;
+   const char *nl;
+   guint lines = 0;
+
+   while (buf < end && (nl = memchr(buf, '\n', end - buf)) != NULL) {
+      lines++;
+      buf = nl + 1;
+   }
+
+   return buf < end ? lines + 1 : lines;
+}
+
+
+/*
+ ******************************************************************************
+ * SkipBlanks --                                                        */ /**
+ *
+ * @brief Skips spaces and tabs.
+ *
+ * @param[in]   p       Cursor.
+ *
+ * @return Pointer to the first character which is not a space or a tab.
+ *
+ ******************************************************************************
+ */
+
+static INLINE const char *
+SkipBlanks(const char *p)
+{
+   while (*p == ' ' || *p == '\t') {
+      p++;
+   }
+   return p;
+}
+
+
+/*
+ ******************************************************************************
+ * IsDelimiter --                                                       */ /**
+ *
+ * @brief Checks whether a character ends a field.
+ *
+ * @param[in]   c       Character.
+ *
+ * @return TRUE if @a c is a blank, a newline or the end of the buffer.
+ *
+ ******************************************************************************
+ */
+
+static INLINE Bool
+IsDelimiter(char c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\0';
+}
+
+
+/*
+ ******************************************************************************
+ * HexDigitValue --                                                     */ /**
+ *
+ * @brief Inline @c g_ascii_xdigit_value; addresses are parsed a digit at a
+ *        time, and there are a lot of them in a large route table.
+ *
+ * @param[in]   c       Character.
+ *
+ * @return Value of the hex digit @a c, or -1.
+ *
+ ******************************************************************************
+ */
+
+static INLINE int
+HexDigitValue(char c)
+{
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   } else if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   } else if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   }
+   return -1;
+}
+
+
+/*
+ ******************************************************************************
+ * ParseEol --                                                          */ /**
+ *
+ * @brief Consumes the end of the current line, trailing blanks included.
+ *
+ * @param[in,out] p     Cursor, moved to the start of the next line on success.
+ *
+ * @return TRUE if nothing but blanks were left on the line.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+ParseEol(const char **p)
+{
+   const char *q = SkipBlanks(*p);
+
+   if (*q == '\n') {
+      *p = q + 1;
+      return TRUE;
+   } else if (*q == '\0') {
+      *p = q;
+      return TRUE;
+   }
+   return FALSE;
+}
+
+
+/*
+ ******************************************************************************
+ * ParseToken --                                                        */ /**
+ *
+ * @brief Parses a run of non-blank characters.
+ *
+ * @param[in,out] p     Cursor.
+ * @param[out]    token Start of the token, in the buffer.
+ * @param[out]    len   Length of the token.
+ *
+ * @return TRUE if a token was found before the end of the line.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+ParseToken(const char **p,
+           const char **token,
+           size_t *len)
+{
+   const char *q = SkipBlanks(*p);
+
+   *token = q;
+   while (!IsDelimiter(*q)) {
+      q++;
+   }
+
+   *len = q - *token;
+   *p = q;
+   return *len > 0;
+}
+
+
+/*
+ ******************************************************************************
+ * ParseHex --                                                          */ /**
+ *
+ * @brief Parses a fixed-width hexadecimal field.
+ *
+ * @param[in,out] p      Cursor.
+ * @param[in]     digits Expected number of digits (at most 16).
+ * @param[out]    value  Parsed value.
+ *
+ * @return TRUE if the field had exactly @a digits hex digits.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+ParseHex(const char **p,
+         unsigned int digits,
+         guint64 *value)
+{
+   const char *q = SkipBlanks(*p);
+   guint64 v = 0;
+   unsigned int i;
+
+   ASSERT(digits <= 16);
+
+   for (i = 0; i < digits; i++) {
+      int x = HexDigitValue(q[i]);
+
+      if (x < 0) {
+         return FALSE;
+      }
+      v = (v << 4) | x;
+   }
+
+   if (!IsDelimiter(q[digits])) {
+      return FALSE;
+   }
+
+   *value = v;
+   *p = q + digits;
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * ParseDec --                                                          */ /**
+ *
+ * @brief Parses an optionally negative decimal field.
+ *
+ * Negative numbers wrap around, as they do with @c g_ascii_strtoull.
+ *
+ * @param[in,out] p      Cursor.
+ * @param[out]    value  Parsed value.
+ *
+ * @return TRUE if the field was a number.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+ParseDec(const char **p,
+         guint64 *value)
+{
+   const char *q = SkipBlanks(*p);
+   const char *digits;
+   Bool negative = FALSE;
+   guint64 v = 0;
+
+   if (*q == '-') {
+      negative = TRUE;
+      q++;
+   }
+
+   for (digits = q; g_ascii_isdigit(*q); q++) {
+      v = v * 10 + (*q - '0');
+   }
+
+   if (q == digits || !IsDelimiter(*q)) {
+      return FALSE;
+   }
+
+   *value = negative ? -v : v;
+   *p = q;
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * ParseIn6Addr --                                                      */ /**
  *
  * @brief Parses a @c /proc/net/ipv6_route hexadecimal IPv6 address and
  *        records it in a <tt>struct in6_addr</tt>.
  *
- * @param[in]   ip6String       Source string.
- * @param[out]  in6_addr        Output struct.
+ * @param[in,out] p          Cursor.
+ * @param[out]    in6_addr   Output struct.
+ *
+ * @return TRUE if the field was 32 hex digits.
  *
  ******************************************************************************
  */
 
-static void
-Ip6StringToIn6Addr(const char *ip6String,
-                   struct in6_addr *in6_addr)
+static Bool
+ParseIn6Addr(const char **p,
+             struct in6_addr *in6_addr)
 {
+   const char *q = SkipBlanks(*p);
    unsigned int i;
 
-   ASSERT(strlen(ip6String) == 32);
-
    for (i = 0; i < 16; i++) {
-      int nmatched;
-      nmatched = sscanf(&ip6String[2 * i], "%2hhx", &in6_addr->s6_addr[i]);
-      ASSERT(nmatched == 1);
+      int hi = HexDigitValue(q[2 * i]);
+      int lo = hi < 0 ? -1 : HexDigitValue(q[2 * i + 1]);
+
+      if (lo < 0) {
+         return FALSE;
+      }
+      in6_addr->s6_addr[i] = (hi << 4) | lo;
+   }
+
+   if (!IsDelimiter(q[32])) {
+      return FALSE;
    }
+
+   *p = q + 32;
+   return TRUE;
 }
 
 
 /*
  ******************************************************************************
- * MatchToGuint64 --                                                    */ /**
+ * NewCounter --                                                        */ /**
  *
- * @brief Wrapper around @c g_ascii_strtoull and @c g_match_info_fetch.
+ * @brief Allocates an SNMP counter and its key together.
  *
- * @param[in]   matchInfo       Source regular expression match context.
- * @param[in]   matchIndex      Match number to fetch.
- * @param[in]   base            Base represented by matched string.
- *                              (See @c g_ascii_strtoull docs.)
+ * The value comes first in the block so that freeing the value frees the
+ * key too; hash tables of counters must not free their keys.
+ *
+ * @param[in]   prefix     Key prefix (e.g. "Ip").
+ * @param[in]   prefixLen  Length of @a prefix.
+ * @param[in]   name       Counter name (e.g. "InDiscards").
+ * @param[in]   nameLen    Length of @a name.
+ * @param[in]   value      Counter value.
+ * @param[out]  key        NUL-terminated key, "<prefix><name>".
+ *
+ * @return The counter value, to be freed with @c g_free.
  *
  ******************************************************************************
  */
 
-static guint64
-MatchToGuint64(const GMatchInfo *matchInfo,
-               const gint matchIndex,
-               gint base)
+static gpointer
+NewCounter(const char *prefix,
+           size_t prefixLen,
+           const char *name,
+           size_t nameLen,
+           guint64 value,
+           const char **key)
 {
-   guint64 retval;
-   MATCHEXPR(matchInfo, matchIndex, retval = g_ascii_strtoull(MATCH, NULL, base));
-   return retval;
+   guint64 *counter = g_malloc(sizeof *counter + prefixLen + nameLen + 1);
+   char *myKey = (char *)(counter + 1);
+
+   *counter = value;
+   memcpy(myKey, prefix, prefixLen);
+   memcpy(myKey + prefixLen, name, nameLen);
+   myKey[prefixLen + nameLen] = '\0';
+
+   *key = myKey;
+   return counter;
 }
@@ -43,6 +43,7 @@ typedef SyncDriverErr (*SyncFreezeFn)(const char *paths,
 typedef struct SyncHandle {
    SyncDriverErr (*thaw)(const SyncDriverHandle handle);
    void (*close)(SyncDriverHandle handle);
+   SyncDriverStats *(*getStats)(const SyncDriverHandle handle);  /* Optional. */
 } SyncHandle;
 
 #if defined(linux)
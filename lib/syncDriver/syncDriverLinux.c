@@ -25,13 +25,21 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <linux/fs.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "vmware.h"
 #include "debug.h"
 #include "dynbuf.h"
+#include "hostinfo.h"
+#include "str.h"
 #include "strutil.h"
 #include "syncDriverInt.h"
 
@@ -41,20 +49,257 @@
 #  define FITHAW          _IOWR('X', 120, int)    /* Thaw */
 #endif
 
+/* Most threads used to freeze or thaw the file systems of one wave. */
+#define LINUXDRIVER_MAX_THREADS     16
+
+
+/*
+ * A file system to freeze. File systems are frozen in "waves": a file system
+ * stacked on another one (i.e., on a loop device backed by a file of that
+ * file system) is frozen in an earlier wave than it, since flushing it writes
+ * to the lower file system, and thawed in a later one.
+ */
+
+typedef struct LinuxMount {
+   char       *path;
+   int         fd;
+   dev_t       dev;
+   dev_t       backingDev;    /* File system holding the loop file, or 0. */
+   int         wave;
+   Bool        frozen;
+   int         freezeErr;
+   int         thawErr;
+   VmTimeType  freezeStart;
+   VmTimeType  freezeEnd;
+   VmTimeType  thawEnd;
+} LinuxMount;
+
 
 typedef struct LinuxDriver {
    SyncHandle  driver;
-   size_t      fdCnt;
-   int        *fds;
+   size_t      mountCnt;
+   LinuxMount *mounts;
+   int         waveCnt;
+   VmTimeType  thawStart;
 } LinuxDriver;
 
 
+/* Work shared by the threads freezing or thawing one wave. */
+
+typedef struct LinuxWave {
+   LinuxDriver      *sync;
+   int               wave;
+   Bool              freeze;
+   size_t            next;
+   pthread_mutex_t   lock;
+} LinuxWave;
+
+
+/*
+ *******************************************************************************
+ * LinuxGetBackingDev --                                                  */ /**
+ *
+ * Finds out whether the file system on the given device is stacked on another
+ * one, i.e., whether the device is a loop device backed by a file.
+ *
+ * @param[in] dev    Device of the file system.
+ *
+ * @return The device of the file system holding the backing file, or 0.
+ *
+ *******************************************************************************
+ */
+
+static dev_t
+LinuxGetBackingDev(dev_t dev)
+{
+   char path[PATH_MAX];
+   char backingFile[PATH_MAX];
+   struct stat st;
+   size_t len;
+   FILE *f;
+
+   Str_Sprintf(path, sizeof path, "/sys/dev/block/%u:%u/loop/backing_file",
+               major(dev), minor(dev));
+   f = fopen(path, "r");
+   if (f == NULL) {
+      return 0;
+   }
+
+   len = fread(backingFile, 1, sizeof backingFile - 1, f);
+   fclose(f);
+   while (len > 0 && backingFile[len - 1] == '\n') {
+      len--;
+   }
+   backingFile[len] = '\0';
+
+   if (len == 0 || stat(backingFile, &st) == -1) {
+      return 0;
+   }
+   return st.st_dev;
+}
+
+
+/*
+ *******************************************************************************
+ * LinuxSortWaves --                                                      */ /**
+ *
+ * Assigns the file systems to waves, so that each one is frozen after all the
+ * file systems stacked on it.
+ *
+ * @param[in] sync   The driver handle.
+ *
+ *******************************************************************************
+ */
+
+static void
+LinuxSortWaves(LinuxDriver *sync)
+{
+   size_t i;
+   size_t j;
+   size_t pass;
+   Bool changed = TRUE;
+
+   /* Chains of stacked file systems are at most mountCnt long. */
+   for (pass = 0; changed && pass < sync->mountCnt; pass++) {
+      changed = FALSE;
+      for (i = 0; i < sync->mountCnt; i++) {
+         LinuxMount *upper = &sync->mounts[i];
+
+         if (upper->backingDev == 0) {
+            continue;
+         }
+         for (j = 0; j < sync->mountCnt; j++) {
+            LinuxMount *lower = &sync->mounts[j];
+
+            if (lower->dev == upper->backingDev && lower->wave <= upper->wave) {
+               lower->wave = upper->wave + 1;
+               changed = TRUE;
+            }
+         }
+      }
+   }
+
+   sync->waveCnt = 0;
+   for (i = 0; i < sync->mountCnt; i++) {
+      sync->waveCnt = MAX(sync->waveCnt, sync->mounts[i].wave + 1);
+   }
+}
+
+
+/*
+ *******************************************************************************
+ * LinuxWaveWorker --                                                     */ /**
+ *
+ * Freezes or thaws file systems of the current wave until there are none
+ * left. Runs in the worker threads as well as in the calling thread.
+ *
+ * @param[in] data   The LinuxWave being processed.
+ *
+ * @return NULL.
+ *
+ *******************************************************************************
+ */
+
+static void *
+LinuxWaveWorker(void *data)
+{
+   LinuxWave *w = data;
+
+   for (;;) {
+      LinuxMount *m = NULL;
+
+      pthread_mutex_lock(&w->lock);
+      while (m == NULL && w->next < w->sync->mountCnt) {
+         LinuxMount *cand = &w->sync->mounts[w->next++];
+
+         if (cand->wave == w->wave && (w->freeze || cand->frozen)) {
+            m = cand;
+         }
+      }
+      pthread_mutex_unlock(&w->lock);
+
+      if (m == NULL) {
+         break;
+      }
+
+      /* Errors are logged by the calling thread. */
+      if (w->freeze) {
+         m->freezeStart = Hostinfo_SystemTimerUS();
+         m->freezeErr = (ioctl(m->fd, FIFREEZE) == -1) ? errno : 0;
+         m->freezeEnd = Hostinfo_SystemTimerUS();
+         m->frozen = (m->freezeErr == 0);
+      } else {
+         m->thawErr = (ioctl(m->fd, FITHAW) == -1) ? errno : 0;
+         m->thawEnd = Hostinfo_SystemTimerUS();
+         m->frozen = (m->thawErr != 0);
+      }
+   }
+
+   return NULL;
+}
+
+
+/*
+ *******************************************************************************
+ * LinuxRunWave --                                                        */ /**
+ *
+ * Freezes or thaws the file systems of a wave concurrently, and waits for all
+ * of them to be done.
+ *
+ * @param[in] sync   The driver handle.
+ * @param[in] wave   Wave to process.
+ * @param[in] freeze Whether to freeze or thaw.
+ *
+ *******************************************************************************
+ */
+
+static void
+LinuxRunWave(LinuxDriver *sync,
+             int wave,
+             Bool freeze)
+{
+   pthread_t threads[LINUXDRIVER_MAX_THREADS - 1];
+   size_t threadCnt = 0;
+   size_t work = 0;
+   size_t i;
+   LinuxWave w;
+
+   for (i = 0; i < sync->mountCnt; i++) {
+      if (sync->mounts[i].wave == wave && (freeze || sync->mounts[i].frozen)) {
+         work++;
+      }
+   }
+
+   w.sync = sync;
+   w.wave = wave;
+   w.freeze = freeze;
+   w.next = 0;
+   pthread_mutex_init(&w.lock, NULL);
+
+   /*
+    * The calling thread does its share of the work, so failing to start
+    * threads only makes things slower.
+    */
+   while (threadCnt + 1 < MIN(work, LINUXDRIVER_MAX_THREADS) &&
+          pthread_create(&threads[threadCnt], NULL, LinuxWaveWorker, &w) == 0) {
+      threadCnt++;
+   }
+   LinuxWaveWorker(&w);
+
+   for (i = 0; i < threadCnt; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   pthread_mutex_destroy(&w.lock);
+}
+
+
 /*
  *******************************************************************************
  * LinuxFiThaw --                                                         */ /**
  *
- * Thaws the file systems monitored by the given handle. Tries to thaw all the
- * file systems even if an error occurs in one of them.
+ * Thaws the file systems monitored by the given handle, one wave at a time in
+ * the reverse order they were frozen in. Tries to thaw all the file systems
+ * even if an error occurs in one of them.
  *
  * @param[in] handle Handle returned by the freeze call.
  *
@@ -67,11 +312,21 @@ static SyncDriverErr
 LinuxFiThaw(const SyncDriverHandle handle)
 {
    size_t i;
+   int wave;
    LinuxDriver *sync = (LinuxDriver *) handle;
    SyncDriverErr err = SD_SUCCESS;
 
-   for (i = 0; i < sync->fdCnt; i++) {
-      if (ioctl(sync->fds[i], FITHAW) == -1) {
+   sync->thawStart = Hostinfo_SystemTimerUS();
+   for (wave = sync->waveCnt - 1; wave >= 0; wave--) {
+      LinuxRunWave(sync, wave, FALSE);
+   }
+
+   for (i = 0; i < sync->mountCnt; i++) {
+      LinuxMount *m = &sync->mounts[i];
+
+      if (m->frozen) {
+         Warning(LGPFX "failed to thaw '%s': %d (%s)\n",
+                 m->path, m->thawErr, strerror(m->thawErr));
          err = SD_ERROR;
       }
    }
@@ -80,6 +335,76 @@ LinuxFiThaw(const SyncDriverHandle handle)
 }
 
 
+/*
+ *******************************************************************************
+ * LinuxFiGetStats --                                                     */ /**
+ *
+ * Returns how long each file system took to freeze and stayed frozen.
+ *
+ * @param[in] handle Handle returned by the freeze call.
+ *
+ * @return The stats, to be freed with SyncDriver_FreeStats(), or NULL.
+ *
+ *******************************************************************************
+ */
+
+static SyncDriverStats *
+LinuxFiGetStats(const SyncDriverHandle handle)
+{
+   LinuxDriver *sync = (LinuxDriver *) handle;
+   SyncDriverStats *stats;
+   VmTimeType firstFreeze = 0;
+   VmTimeType lastFreeze = 0;
+   VmTimeType lastThaw = 0;
+   size_t i;
+
+   stats = calloc(1, sizeof *stats);
+   if (stats == NULL) {
+      return NULL;
+   }
+   stats->mounts = calloc(sync->mountCnt, sizeof *stats->mounts);
+   if (stats->mounts == NULL && sync->mountCnt > 0) {
+      free(stats);
+      return NULL;
+   }
+
+   for (i = 0; i < sync->mountCnt; i++) {
+      LinuxMount *m = &sync->mounts[i];
+      SyncDriverMountStats *ms;
+
+      /* Only report the file systems that were actually frozen. */
+      if (m->freezeEnd == 0 || m->freezeErr != 0) {
+         continue;
+      }
+
+      ms = &stats->mounts[stats->mountCnt++];
+      ms->path = strdup(m->path);
+      ms->wave = m->wave;
+      ms->freezeUS = m->freezeEnd - m->freezeStart;
+      if (m->thawEnd != 0 && m->thawErr == 0) {
+         ms->frozenUS = m->thawEnd - m->freezeStart;
+      }
+
+      if (firstFreeze == 0 || m->freezeStart < firstFreeze) {
+         firstFreeze = m->freezeStart;
+      }
+      lastFreeze = MAX(lastFreeze, m->freezeEnd);
+      lastThaw = MAX(lastThaw, m->thawEnd);
+   }
+
+   stats->waveCnt = sync->waveCnt;
+   if (stats->mountCnt > 0) {
+      stats->freezeUS = lastFreeze - firstFreeze;
+      if (sync->thawStart != 0) {
+         stats->frozenUS = lastThaw - firstFreeze;
+         stats->thawUS = lastThaw - sync->thawStart;
+      }
+   }
+
+   return stats;
+}
+
+
 /*
  *******************************************************************************
  * LinuxFiClose --                                                        */ /**
@@ -98,62 +423,49 @@ LinuxFiClose(SyncDriverHandle handle)
    LinuxDriver *sync = (LinuxDriver *) handle;
    size_t i;
 
-   for (i = 0; i < sync->fdCnt; i++) {
-      close(sync->fds[i]);
+   for (i = 0; i < sync->mountCnt; i++) {
+      close(sync->mounts[i].fd);
+      free(sync->mounts[i].path);
    }
-   free(sync->fds);
+   free(sync->mounts);
    free(sync);
 }
 
 
 /*
  *******************************************************************************
- * LinuxDriver_Freeze --                                                  */ /**
- *
- * Tries to freeze the filesystems using the Linux kernel's FIFREEZE ioctl.
+ * LinuxDriverOpenMounts --                                               */ /**
  *
- * If the first attempt at using the ioctl fails, assume that it doesn't exist
- * and return SD_UNAVAILABLE, so that other means of freezing are tried.
+ * Opens all the requested paths, before anything is frozen, so that no path
+ * lookup has to go through a frozen file system. Paths that are on the same
+ * file system as a previous one (e.g., bind mounts) are skipped.
  *
  * @param[in]  paths    Paths to freeze (colon-separated).
- * @param[out] handle   Handle to use for thawing.
+ * @param[in]  sync     The driver handle.
  *
  * @return A SyncDriverErr.
  *
  *******************************************************************************
  */
 
-SyncDriverErr
-LinuxDriver_Freeze(const char *paths,
-                   SyncDriverHandle *handle)
+static SyncDriverErr
+LinuxDriverOpenMounts(const char *paths,
+                      LinuxDriver *sync)
 {
    char *path;
    int fd;
-   size_t count = 0;
    unsigned int index = 0;
-   Bool first = TRUE;
-   DynBuf fds;
-   LinuxDriver *sync = NULL;
+   DynBuf mounts;
    SyncDriverErr err = SD_SUCCESS;
 
-   DynBuf_Init(&fds);
+   DynBuf_Init(&mounts);
 
-   Debug(LGPFX "Freezing using Linux ioctls...\n");
-
-   sync = calloc(1, sizeof *sync);
-   if (sync == NULL) {
-      return SD_ERROR;
-   }
-
-   sync->driver.thaw = LinuxFiThaw;
-   sync->driver.close = LinuxFiClose;
-
-   /*
-    * Iterate through the requested paths. If we get an error for the first
-    * path, and it's not EPERM, assume that the ioctls are not available in
-    * the current kernel.
-    */
    while ((path = StrUtil_GetNextToken(&index, paths, ":")) != NULL) {
+      LinuxMount m;
+      struct stat st;
+      size_t i;
+      Bool dup = FALSE;
+
       fd = open(path, O_RDONLY);
       if (fd == -1) {
          switch (errno) {
@@ -185,49 +497,135 @@ LinuxDriver_Freeze(const char *paths,
          }
       }
 
-      if (ioctl(fd, FIFREEZE) == -1) {
-         int ioctlerr = errno;
+      if (fstat(fd, &st) == -1) {
+         Debug(LGPFX "failed to stat '%s': %d (%s)\n",
+               path, errno, strerror(errno));
+         close(fd);
+         free(path);
+         err = SD_ERROR;
+         goto exit;
+      }
+
+      for (i = 0; i < DynBuf_GetSize(&mounts) / sizeof m; i++) {
+         if (((LinuxMount *) DynBuf_Get(&mounts))[i].dev == st.st_dev) {
+            dup = TRUE;
+            break;
+         }
+      }
+      if (dup) {
+         Debug(LGPFX "'%s' is on an already listed file system.\n", path);
+         close(fd);
+         free(path);
+         continue;
+      }
+
+      memset(&m, 0, sizeof m);
+      m.path = path;
+      m.fd = fd;
+      m.dev = st.st_dev;
+      m.backingDev = LinuxGetBackingDev(st.st_dev);
+      if (!DynBuf_Append(&mounts, &m, sizeof m)) {
+         close(fd);
+         free(path);
+         err = SD_ERROR;
+         goto exit;
+      }
+   }
+
+exit:
+   sync->mountCnt = DynBuf_GetSize(&mounts) / sizeof *sync->mounts;
+   sync->mounts = DynBuf_Detach(&mounts);
+   return err;
+}
+
+
+/*
+ *******************************************************************************
+ * LinuxDriver_Freeze --                                                  */ /**
+ *
+ * Tries to freeze the filesystems using the Linux kernel's FIFREEZE ioctl.
+ *
+ * All the paths are opened first. The file systems are then frozen one wave
+ * at a time (see LinuxMount), the file systems of a wave concurrently.
+ *
+ * If the ioctl fails with ENOTTY before any file system is frozen, assume that
+ * it doesn't exist and return SD_UNAVAILABLE, so that other means of freezing
+ * are tried.
+ *
+ * @param[in]  paths    Paths to freeze (colon-separated).
+ * @param[out] handle   Handle to use for thawing.
+ *
+ * @return A SyncDriverErr.
+ *
+ *******************************************************************************
+ */
+
+SyncDriverErr
+LinuxDriver_Freeze(const char *paths,
+                   SyncDriverHandle *handle)
+{
+   size_t i;
+   int wave;
+   size_t frozen = 0;
+   Bool noIoctl = FALSE;
+   LinuxDriver *sync = NULL;
+   SyncDriverErr err;
+
+   Debug(LGPFX "Freezing using Linux ioctls...\n");
+
+   sync = calloc(1, sizeof *sync);
+   if (sync == NULL) {
+      return SD_ERROR;
+   }
+
+   sync->driver.thaw = LinuxFiThaw;
+   sync->driver.close = LinuxFiClose;
+   sync->driver.getStats = LinuxFiGetStats;
+
+   err = LinuxDriverOpenMounts(paths, sync);
+   if (err != SD_SUCCESS) {
+      goto exit;
+   }
+
+   LinuxSortWaves(sync);
+
+   for (wave = 0; wave < sync->waveCnt && err == SD_SUCCESS; wave++) {
+      LinuxRunWave(sync, wave, TRUE);
+
+      for (i = 0; i < sync->mountCnt; i++) {
+         LinuxMount *m = &sync->mounts[i];
+
+         if (m->wave != wave) {
+            continue;
+         }
+
          /*
           * If the ioctl does not exist, Linux will return ENOTTY. If it's not
           * supported on the device, we get EOPNOTSUPP. Ignore the latter,
           * since freezing does not make sense for all fs types, and some
           * Linux fs drivers may not have been hooked up in the running kernel.
           *
-          * Also ignore EBUSY since we may try to freeze the same superblock
-          * more than once depending on the OS configuration (e.g., usage of
-          * bind mounts).
+          * Also ignore EBUSY since the file system may already be frozen by
+          * someone else.
           */
-         close(fd);
-         if (ioctlerr != EBUSY && ioctlerr != EOPNOTSUPP) {
+         if (m->frozen) {
+            Debug(LGPFX "successfully froze '%s' in %"FMT64"d us.\n",
+                  m->path, m->freezeEnd - m->freezeStart);
+            frozen++;
+         } else if (m->freezeErr != EBUSY && m->freezeErr != EOPNOTSUPP) {
             Debug(LGPFX "failed to freeze '%s': %d (%s)\n",
-                  path, ioctlerr, strerror(ioctlerr));
-            err = first && ioctlerr == ENOTTY ? SD_UNAVAILABLE : SD_ERROR;
-            free(path);
-            break;
-         }
-      } else {
-         Debug(LGPFX "successfully froze '%s'.\n", path);
-         if (!DynBuf_Append(&fds, &fd, sizeof fd)) {
-            if (ioctl(fd, FITHAW) == -1) {
-               Warning(LGPFX "failed to thaw '%s': %d (%s)\n",
-                       path, errno, strerror(errno));
-            }
-            free(path);
-            close(fd);
+                  m->path, m->freezeErr, strerror(m->freezeErr));
+            noIoctl = (m->freezeErr == ENOTTY);
             err = SD_ERROR;
-            break;
          }
-         count++;
       }
+   }
 
-      free(path);
-      first = FALSE;
+   if (err != SD_SUCCESS && noIoctl && frozen == 0) {
+      err = SD_UNAVAILABLE;
    }
 
 exit:
-   sync->fds = DynBuf_Detach(&fds);
-   sync->fdCnt = count;
-
    if (err != SD_SUCCESS) {
       LinuxFiThaw(&sync->driver);
       LinuxFiClose(&sync->driver);
@@ -236,4 +634,3 @@ exit:
    }
    return err;
 }
-
@@ -278,3 +278,61 @@ SyncDriver_CloseHandle(SyncDriverHandle *handle)   // IN/OUT
    }
 }
 
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SyncDriver_GetStats --
+ *
+ *    Returns the timing of the freeze (and thaw, if done) of the given
+ *    handle. Must be called before the handle is closed.
+ *
+ * Results:
+ *    The stats, to be freed with SyncDriver_FreeStats(), or NULL if the
+ *    backend doesn't keep any.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+SyncDriverStats *
+SyncDriver_GetStats(const SyncDriverHandle handle)   // IN
+{
+   if (handle != NULL && handle->getStats != NULL) {
+      return handle->getStats(handle);
+   }
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SyncDriver_FreeStats --
+ *
+ *    Frees stats returned by SyncDriver_GetStats().
+ *
+ * Results:
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+SyncDriver_FreeStats(SyncDriverStats *stats)   // IN
+{
+   size_t i;
+
+   if (stats != NULL) {
+      for (i = 0; i < stats->mountCnt; i++) {
+         free(stats->mounts[i].path);
+      }
+      free(stats->mounts);
+      free(stats);
+   }
+}
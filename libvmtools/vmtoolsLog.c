@@ -31,6 +31,7 @@
 #include "vmtoolsInt.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <glib/gstdio.h>
 #if defined(G_PLATFORM_WIN32)
 #  include <windows.h>
@@ -47,12 +48,17 @@
 #  include "w32Messages.h"
 #endif
 #include "str.h"
-#include "system.h"
 
 #define LOGGING_GROUP         "logging"
 
 #define MAX_DOMAIN_LEN        64
 
+/** Default amount of memory (in KB) that async logging may hold in its queue. */
+#define DEFAULT_ASYNC_BUFSIZE 1024
+
+/** Initial size of the per-thread buffers used to format log messages. */
+#define LOG_BUFFER_MIN_SIZE   256
+
 /** The default handler to use if none is specified by the config data. */
 #define DEFAULT_HANDLER "syslog"
 
@@ -104,6 +110,47 @@ typedef struct LogHandler {
    gboolean       inherited;
 } LogHandler;
 
+/** Per-thread buffer used to format log messages. */
+typedef struct LogBuffer {
+   gchar         *buf;
+   gsize          size;
+   glong          sec;           /* Second of the cached timestamp. */
+   gchar          tstamp[64];    /* Timestamp, "date.msec". */
+   gsize          tstampLen;     /* Length of the "date" part of tstamp. */
+   gboolean       busy;
+   gboolean       temporary;     /* Not the thread's buffer; free on release. */
+} LogBuffer;
+
+/** A formatted log message waiting to be written by the async log writer. */
+typedef struct LogRecord {
+   GlibLogger    *logger;
+   gboolean       coalesce;  /* Can be written together with similar records. */
+   GLogLevelFlags level;
+   gchar         *domain;
+   gchar         *msg;
+   gsize          len;
+} LogRecord;
+
+/**
+ * State of the async log writer. When enabled, messages are formatted by the
+ * thread logging them and queued; a writer thread picks up whatever is in the
+ * queue at once and hands it to the loggers, so that threads that log a lot
+ * do not wait for file or syslog I/O.
+ */
+typedef struct LogAsync {
+   GMutex        *lock;
+   GCond         *queued;    /* Records were queued, or the writer should stop. */
+   GCond         *written;   /* The writer finished writing a batch. */
+   GThread       *thread;
+   GQueue        *queue;
+   gsize          queuedBytes;
+   gsize          maxBytes;
+   guint          dropped;   /* Dropped since the last notice was logged. */
+   guint          totalDropped;
+   gboolean       writing;
+   gboolean       stop;
+} LogAsync;
+
 
 static gchar *gLogDomain = NULL;
 static gboolean gEnableCoreDump = TRUE;
@@ -112,6 +159,8 @@ static guint gPanicCount = 0;
 static LogHandler *gDefaultData;
 static LogHandler *gErrorData;
 static GPtrArray *gDomains = NULL;
+static LogAsync gLogAsync;
+static GStaticPrivate gLogBuffer = G_STATIC_PRIVATE_INIT;
 
 /* Internal functions. */
 
@@ -140,29 +189,146 @@ VMToolsAsprintf(gchar **string,
 }
 
 
+/**
+ * Frees a log buffer when the thread that owns it exits.
+ *
+ * @param[in] _lb    The buffer.
+ */
+
+static void
+VMToolsLogFreeBuffer(gpointer _lb)
+{
+   LogBuffer *lb = _lb;
+   g_free(lb->buf);
+   g_free(lb);
+}
+
+
+/**
+ * Returns a buffer in which the calling thread can format a log message.
+ * Each thread reuses its own buffer, so formatting messages does not need to
+ * allocate memory; if the thread's buffer is already in use (i.e., a logger
+ * is logging something itself), a temporary buffer is returned.
+ *
+ * @return A log buffer, to be released with VMToolsLogReleaseBuffer().
+ */
+
+static LogBuffer *
+VMToolsLogGetBuffer(void)
+{
+   LogBuffer *lb = g_static_private_get(&gLogBuffer);
+
+   if (lb == NULL) {
+      lb = g_new0(LogBuffer, 1);
+      g_static_private_set(&gLogBuffer, lb, VMToolsLogFreeBuffer);
+   }
+
+   if (lb->busy) {
+      lb = g_new0(LogBuffer, 1);
+      lb->temporary = TRUE;
+   }
+
+   lb->busy = TRUE;
+   return lb;
+}
+
+
+/**
+ * Releases a buffer returned by VMToolsLogGetBuffer().
+ *
+ * @param[in] lb     The buffer.
+ */
+
+static void
+VMToolsLogReleaseBuffer(LogBuffer *lb)
+{
+   if (lb->temporary) {
+      VMToolsLogFreeBuffer(lb);
+   } else {
+      lb->busy = FALSE;
+   }
+}
+
+
+/**
+ * Updates the timestamp in the given log buffer to the current time. The
+ * "date" part is only formatted (and converted to UTF-8) when the second
+ * changes; otherwise, only the milliseconds are updated.
+ *
+ * @param[in] lb     The log buffer.
+ */
+
+static void
+VMToolsLogUpdateTimestamp(LogBuffer *lb)
+{
+   GTimeVal now;
+   guint msec;
+   gchar *p;
+
+   g_get_current_time(&now);
+
+   if (now.tv_sec != lb->sec || lb->tstampLen == 0) {
+      char date[64];
+      gchar *utf8 = NULL;
+      time_t sec = now.tv_sec;
+      struct tm *tm;
+      size_t len;
+#if !defined(_WIN32)
+      struct tm tmbuf;
+
+      tm = localtime_r(&sec, &tmbuf);
+#else
+      tm = localtime(&sec);
+#endif
+      len = (tm != NULL) ? strftime(date, sizeof date, "%b %d %H:%M:%S", tm) : 0;
+      if (len > 0) {
+         utf8 = g_locale_to_utf8(date, len, NULL, NULL, NULL);
+      }
+
+      /* Leave room for the milliseconds. */
+      g_strlcpy(lb->tstamp, (utf8 != NULL) ? utf8 : "no time",
+                sizeof lb->tstamp - 4);
+      lb->tstampLen = strlen(lb->tstamp);
+      lb->sec = now.tv_sec;
+      g_free(utf8);
+   }
+
+   msec = (guint) (now.tv_usec / 1000) % 1000;
+   p = lb->tstamp + lb->tstampLen;
+   p[0] = '.';
+   p[1] = '0' + msec / 100;
+   p[2] = '0' + (msec / 10) % 10;
+   p[3] = '0' + msec % 10;
+   p[4] = '\0';
+}
+
+
 /**
  * Creates a formatted message to be logged. The format of the message will be:
  *
  *    [timestamp] [domain] [level] Log message
  *
+ * The message is formatted into the given log buffer, which is grown if
+ * needed.
+ *
+ * @param[in] lb           Log buffer where to format the message.
  * @param[in] message      User log message.
  * @param[in] domain       Log domain.
  * @param[in] level        Log level.
  * @param[in] data         Log handler data.
  *
- * @return Formatted log message according to the log domain's config.
- *         Should be g_free()'d.
+ * @return Length of the formatted message (in lb->buf).
  */
 
-static gchar *
-VMToolsLogFormat(const gchar *message,
+static gsize
+VMToolsLogFormat(LogBuffer *lb,
+                 const gchar *message,
                  const gchar *domain,
                  GLogLevelFlags level,
                  LogHandler *data)
 {
-   char *msg = NULL;
    const char *slevel;
-   size_t len = 0;
+   gsize len;
    gboolean shared = TRUE;
    gboolean addsTimestamp = TRUE;
 
@@ -213,26 +379,29 @@ VMToolsLogFormat(const gchar *message,
    }
 
    if (!addsTimestamp) {
-      char *tstamp;
+      VMToolsLogUpdateTimestamp(lb);
+   }
 
-      tstamp = System_GetTimeAsString();
-      if (shared) {
-         len = VMToolsAsprintf(&msg, "[%s] [%8s] [%s:%s] %s\n",
-                               (tstamp != NULL) ? tstamp : "no time",
-                               slevel, gLogDomain, domain, message);
-      } else {
-         len = VMToolsAsprintf(&msg, "[%s] [%8s] [%s] %s\n",
-                               (tstamp != NULL) ? tstamp : "no time",
-                               slevel, domain, message);
-      }
-      free(tstamp);
-   } else {
-      if (shared) {
-         len = VMToolsAsprintf(&msg, "[%8s] [%s:%s] %s\n",
-                               slevel, gLogDomain, domain, message);
-      } else {
-         len = VMToolsAsprintf(&msg, "[%8s] [%s] %s\n", slevel, domain, message);
+   if (lb->buf == NULL) {
+      lb->size = LOG_BUFFER_MIN_SIZE;
+      lb->buf = g_malloc(lb->size);
+   }
+
+   while (TRUE) {
+      len = g_snprintf(lb->buf, lb->size, "%s%s%s[%8s] [%s%s%s] %s\n",
+                       addsTimestamp ? "" : "[",
+                       addsTimestamp ? "" : lb->tstamp,
+                       addsTimestamp ? "" : "] ",
+                       slevel,
+                       shared ? gLogDomain : "",
+                       shared ? ":" : "",
+                       domain,
+                       message);
+      if (len < lb->size) {
+         break;
       }
+      lb->size = len + 1;
+      lb->buf = g_realloc(lb->buf, lb->size);
    }
 
    /*
@@ -241,22 +410,360 @@ VMToolsLogFormat(const gchar *message,
     * we detect whether the original message already had a new line, and
     * remove it, to avoid having two newlines when printing our log messages.
     */
-   if (msg != NULL && msg[len - 2] == '\n') {
-      msg[len - 1] = '\0';
+   if (len >= 2 && lb->buf[len - 2] == '\n') {
+      lb->buf[--len] = '\0';
+   }
+
+   return len;
+}
+
+
+/**
+ * Frees a log record.
+ *
+ * @param[in] rec    Record to free.
+ */
+
+static void
+VMToolsLogFreeRecord(LogRecord *rec)
+{
+   g_free(rec->domain);
+   g_free(rec->msg);
+   g_free(rec);
+}
+
+
+/**
+ * Writes a batch of queued log records. Consecutive records for the same
+ * logger and level are written with a single call when the logger allows it
+ * (i.e., plain files and stdio), so that the output is only flushed once.
+ *
+ * @param[in] batch     Records to write; emptied on return.
+ * @param[in] dropped   Number of messages dropped since the last batch.
+ */
+
+static void
+VMToolsLogWriteBatch(GQueue *batch,
+                     guint dropped)
+{
+   LogRecord *rec;
+   GString *buf = NULL;
+
+   while ((rec = g_queue_pop_head(batch)) != NULL) {
+      LogRecord *next = g_queue_peek_head(batch);
+
+      if (rec->coalesce &&
+          next != NULL &&
+          next->logger == rec->logger &&
+          next->level == rec->level) {
+         if (buf == NULL) {
+            buf = g_string_sized_new(4096);
+         }
+         g_string_append_len(buf, rec->msg, rec->len);
+      } else if (buf != NULL && buf->len > 0) {
+         g_string_append_len(buf, rec->msg, rec->len);
+         rec->logger->logfn(rec->domain, rec->level, buf->str, rec->logger);
+         g_string_truncate(buf, 0);
+      } else {
+         rec->logger->logfn(rec->domain, rec->level, rec->msg, rec->logger);
+      }
+      VMToolsLogFreeRecord(rec);
+   }
+
+   if (buf != NULL) {
+      g_string_free(buf, TRUE);
    }
 
-   return msg;
+   if (dropped > 0 && gDefaultData != NULL && gDefaultData->logger != NULL) {
+      gchar notice[64];
+      LogBuffer *lb = VMToolsLogGetBuffer();
+
+      g_snprintf(notice, sizeof notice,
+                 "Async logging queue full, dropped %u messages.\n", dropped);
+      VMToolsLogFormat(lb, notice, gLogDomain, G_LOG_LEVEL_WARNING,
+                       gDefaultData);
+      gDefaultData->logger->logfn(gLogDomain, G_LOG_LEVEL_WARNING, lb->buf,
+                                  gDefaultData->logger);
+      VMToolsLogReleaseBuffer(lb);
+   }
 }
 
 
 /**
- * Aborts the program, optionally creating a core dump.
+ * Takes all the records currently in the async log queue. Must be called
+ * with the async lock held.
+ *
+ * @param[out] dropped  Number of messages dropped since the last call.
+ *
+ * @return The queued records (possibly an empty queue).
+ */
+
+static GQueue *
+VMToolsLogTakeQueue(guint *dropped)
+{
+   GQueue *batch = gLogAsync.queue;
+
+   gLogAsync.queue = g_queue_new();
+   gLogAsync.queuedBytes = 0;
+   *dropped = gLogAsync.dropped;
+   gLogAsync.dropped = 0;
+   return batch;
+}
+
+
+/**
+ * Body of the async log writer thread. Waits for records to be queued and
+ * writes them in batches until asked to stop; anything still queued at that
+ * point is written before the thread exits.
+ *
+ * @param[in] unused    Unused.
+ *
+ * @return NULL.
+ */
+
+static gpointer
+VMToolsLogWriter(gpointer unused)
+{
+   g_mutex_lock(gLogAsync.lock);
+
+   while (TRUE) {
+      GQueue *batch;
+      guint dropped;
+
+      while (g_queue_is_empty(gLogAsync.queue) &&
+             gLogAsync.dropped == 0 &&
+             !gLogAsync.stop) {
+         g_cond_wait(gLogAsync.queued, gLogAsync.lock);
+      }
+
+      if (g_queue_is_empty(gLogAsync.queue) &&
+          gLogAsync.dropped == 0 &&
+          gLogAsync.stop) {
+         break;
+      }
+
+      batch = VMToolsLogTakeQueue(&dropped);
+      gLogAsync.writing = TRUE;
+      g_mutex_unlock(gLogAsync.lock);
+
+      VMToolsLogWriteBatch(batch, dropped);
+      g_queue_free(batch);
+
+      g_mutex_lock(gLogAsync.lock);
+      gLogAsync.writing = FALSE;
+      g_cond_broadcast(gLogAsync.written);
+   }
+
+   g_mutex_unlock(gLogAsync.lock);
+   return NULL;
+}
+
+
+/**
+ * Queues a formatted message for the async log writer. If the queue already
+ * holds as much data as allowed, the message is dropped and accounted for, so
+ * that a flood of messages cannot make the process' memory grow unbounded.
+ * Messages that race with a reset of the logging configuration (i.e., logging
+ * was disabled after the caller checked it) are dropped too: once the reset
+ * has flushed the queue, the handler they refer to may be gone.
+ *
+ * @param[in] data      Handler to log the message to.
+ * @param[in] domain    Log domain.
+ * @param[in] level     Log level.
+ * @param[in] msg       Formatted message (copied).
+ * @param[in] len       Length of the message.
+ *
+ * @return FALSE if async logging is not running, in which case the caller
+ *         should write the message itself.
+ */
+
+static gboolean
+VMToolsLogEnqueue(LogHandler *data,
+                  const gchar *domain,
+                  GLogLevelFlags level,
+                  const gchar *msg,
+                  gsize len)
+{
+   LogRecord *rec;
+   gboolean ret = TRUE;
+
+   rec = g_new(LogRecord, 1);
+   rec->logger = data->logger;
+   rec->coalesce = (strcmp(data->type, "file") == 0 ||
+                    strcmp(data->type, "std") == 0);
+   rec->level = level;
+   rec->domain = g_strdup(domain);
+   rec->msg = g_strndup(msg, len);
+   rec->len = len;
+
+   g_mutex_lock(gLogAsync.lock);
+   if (gLogAsync.thread == NULL || gLogAsync.stop) {
+      ret = FALSE;
+   } else if (!gLogEnabled) {
+      /* Being reset; drop the message. */
+   } else if (gLogAsync.queuedBytes + rec->len > gLogAsync.maxBytes) {
+      gLogAsync.dropped++;
+      gLogAsync.totalDropped++;
+   } else {
+      gLogAsync.queuedBytes += rec->len;
+      g_queue_push_tail(gLogAsync.queue, rec);
+      g_cond_signal(gLogAsync.queued);
+      rec = NULL;
+   }
+   g_mutex_unlock(gLogAsync.lock);
+
+   if (rec != NULL) {
+      VMToolsLogFreeRecord(rec);
+   }
+
+   return ret;
+}
+
+
+/**
+ * Writes out all queued log messages on the calling thread, without waiting
+ * for the writer thread. Used when the process is about to die, so that the
+ * messages leading up to the crash make it to the logs.
+ */
+
+static void
+VMToolsLogAsyncDrain(void)
+{
+   GQueue *batch;
+   guint dropped;
+
+   if (gLogAsync.lock == NULL) {
+      return;
+   }
+
+   g_mutex_lock(gLogAsync.lock);
+   batch = VMToolsLogTakeQueue(&dropped);
+   g_mutex_unlock(gLogAsync.lock);
+
+   VMToolsLogWriteBatch(batch, dropped);
+   g_queue_free(batch);
+}
+
+
+/**
+ * Waits until the async log writer has written all queued messages.
+ */
+
+static void
+VMToolsLogAsyncFlush(void)
+{
+   if (gLogAsync.lock == NULL) {
+      return;
+   }
+
+   g_mutex_lock(gLogAsync.lock);
+   while (gLogAsync.thread != NULL &&
+          (!g_queue_is_empty(gLogAsync.queue) ||
+           gLogAsync.dropped > 0 ||
+           gLogAsync.writing)) {
+      g_cond_wait(gLogAsync.written, gLogAsync.lock);
+   }
+   g_mutex_unlock(gLogAsync.lock);
+}
+
+
+/**
+ * Stops the async log writer, after it has written all queued messages.
+ */
+
+static void
+VMToolsLogAsyncStop(void)
+{
+   GThread *thread;
+
+   if (gLogAsync.lock == NULL) {
+      return;
+   }
+
+   g_mutex_lock(gLogAsync.lock);
+   thread = gLogAsync.thread;
+   gLogAsync.stop = TRUE;
+   g_cond_signal(gLogAsync.queued);
+   g_mutex_unlock(gLogAsync.lock);
+
+   if (thread != NULL) {
+      g_thread_join(thread);
+   }
+
+   g_mutex_lock(gLogAsync.lock);
+   gLogAsync.thread = NULL;
+   gLogAsync.stop = FALSE;
+   g_mutex_unlock(gLogAsync.lock);
+
+   if (thread != NULL && gLogAsync.totalDropped > 0) {
+      g_message("Async logging dropped %u messages.\n", gLogAsync.totalDropped);
+   }
+}
+
+
+/**
+ * Enables or disables async logging according to the configuration. The
+ * following options in the "[logging]" group are used:
+ *
+ *    - async: whether to write log messages from a separate thread.
+ *    - asyncBufferSize: max amount of data (in KB) to hold in the queue;
+ *      messages logged while the queue is full are dropped.
+ *
+ * @param[in] cfg    Config dictionary.
+ */
+
+static void
+VMToolsLogConfigAsync(GKeyFile *cfg)
+{
+   GError *err = NULL;
+   gboolean async;
+   gint bufSize;
+
+   async = g_key_file_get_boolean(cfg, LOGGING_GROUP, "async", NULL);
+   if (!async || !g_thread_supported()) {
+      VMToolsLogAsyncStop();
+      return;
+   }
+
+   bufSize = g_key_file_get_integer(cfg, LOGGING_GROUP, "asyncBufferSize", &err);
+   if (err != NULL || bufSize <= 0) {
+      g_clear_error(&err);
+      bufSize = DEFAULT_ASYNC_BUFSIZE;
+   }
+
+   if (gLogAsync.lock == NULL) {
+      gLogAsync.lock = g_mutex_new();
+      gLogAsync.queued = g_cond_new();
+      gLogAsync.written = g_cond_new();
+      gLogAsync.queue = g_queue_new();
+      atexit(VMToolsLogAsyncStop);
+   }
+
+   g_mutex_lock(gLogAsync.lock);
+   gLogAsync.maxBytes = (gsize) bufSize * 1024;
+   if (gLogAsync.thread == NULL) {
+      gLogAsync.thread = g_thread_create(VMToolsLogWriter, NULL, TRUE, &err);
+      if (gLogAsync.thread == NULL) {
+         g_mutex_unlock(gLogAsync.lock);
+         g_warning("Failed to start async log writer: %s\n", err->message);
+         g_clear_error(&err);
+         return;
+      }
+   }
+   g_mutex_unlock(gLogAsync.lock);
+}
+
+
+/**
+ * Aborts the program, optionally creating a core dump. Messages still waiting
+ * to be written by the async log writer are written out first.
  */
 
 static INLINE NORETURN void
 VMToolsLogPanic(void)
 {
    gPanicCount++;
+   VMToolsLogAsyncDrain();
    if (gEnableCoreDump) {
 #if defined(_WIN32)
       CoreDump_CoreDump();
@@ -303,17 +810,31 @@ VMToolsLog(const gchar *domain,
    LogHandler *data = _data;
 
    if (SHOULD_LOG(level, data)) {
-      gchar *msg;
+      LogHandler *out;
 
       data = data->inherited ? gDefaultData : data;
-      msg = VMToolsLogFormat(message, domain, level, data);
+      out = (data->logger != NULL) ? data : gErrorData;
+
+      if (out->logger != NULL) {
+         LogBuffer *lb = VMToolsLogGetBuffer();
+         gsize len = VMToolsLogFormat(lb, message, domain, level, data);
+         gboolean queued = FALSE;
+
+         /*
+          * Fatal messages, and anything logged while panicking, are written
+          * right away, after whatever is still queued.
+          */
+         if (gLogAsync.thread != NULL && !IS_FATAL(level) && gPanicCount == 0) {
+            queued = VMToolsLogEnqueue(out, domain, level, lb->buf, len);
+         } else if (gLogAsync.thread != NULL) {
+            VMToolsLogAsyncDrain();
+         }
 
-      if (data->logger != NULL) {
-         data->logger->logfn(domain, level, msg, data->logger);
-      } else if (gErrorData->logger != NULL) {
-         gErrorData->logger->logfn(domain, level, msg, gErrorData->logger);
+         if (!queued) {
+            out->logger->logfn(domain, level, lb->buf, out->logger);
+         }
+         VMToolsLogReleaseBuffer(lb);
       }
-      g_free(msg);
    }
    if (IS_FATAL(level)) {
       VMToolsLogPanic();
@@ -590,23 +1111,33 @@ VMToolsResetLogging(gboolean hard)
    gLogEnabled = FALSE;
    g_log_set_default_handler(g_log_default_handler, NULL);
 
-   CLEAR_LOG_HANDLER(gErrorData);
-   gErrorData = NULL;
-
    if (gDomains != NULL) {
       guint i;
       for (i = 0; i < gDomains->len; i++) {
          LogHandler *data = g_ptr_array_index(gDomains, i);
          g_log_remove_handler(data->domain, data->handlerId);
          data->handlerId = 0;
-         if (hard) {
-            CLEAR_LOG_HANDLER(data);
-         }
       }
-      if (hard) {
-         g_ptr_array_free(gDomains, TRUE);
-         gDomains = NULL;
+   }
+
+   /*
+    * Nothing can be queued anymore (see VMToolsLogEnqueue()); wait for what
+    * is already queued to be written, since it refers to the loggers freed
+    * below.
+    */
+   VMToolsLogAsyncFlush();
+
+   CLEAR_LOG_HANDLER(gErrorData);
+   gErrorData = NULL;
+
+   if (gDomains != NULL && hard) {
+      guint i;
+      for (i = 0; i < gDomains->len; i++) {
+         LogHandler *data = g_ptr_array_index(gDomains, i);
+         CLEAR_LOG_HANDLER(data);
       }
+      g_ptr_array_free(gDomains, TRUE);
+      gDomains = NULL;
    }
 
    if (hard) {
@@ -793,6 +1324,8 @@ VMTools_ConfigLogging(const gchar *defaultDomain,
 #endif
    }
 
+   VMToolsLogConfigAsync(cfg);
+
    gLogEnabled |= force;
 
    if (allocDict) {
@@ -820,7 +1353,14 @@ VMToolsLogWrapper(GLogLevelFlags level,
                   va_list args)
 {
    if (gPanicCount == 0) {
-      char *msg = Str_Vasprintf(NULL, fmt, args);
+      char *msg;
+
+      /* Don't bother formatting messages that won't be logged. */
+      if (gDefaultData != NULL && !SHOULD_LOG(level, gDefaultData)) {
+         return;
+      }
+
+      msg = Str_Vasprintf(NULL, fmt, args);
       if (msg != NULL) {
          g_log(gLogDomain, level, "%s", msg);
          free(msg);
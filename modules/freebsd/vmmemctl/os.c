@@ -41,6 +41,7 @@
 #include <sys/module.h>
 #include <sys/conf.h>
 #include <sys/sysctl.h>
+#include <sys/queue.h>
 
 #include <vm/vm.h>
 #include <vm/vm_kern.h>
@@ -55,6 +56,7 @@
 
 #include "os.h"
 #include "vmballoon.h"
+#include "balloon_def.h"
 
 /*
  * Types
@@ -74,10 +76,33 @@ typedef struct {
    unsigned int  hint;       /* start searching from this word */
 } os_pmap;
 
+/*
+ * Large pages come from contigmalloc(), which returns a kernel address.
+ * The balloon knows a large page by the vm_page_t of its first page, so
+ * the address contigfree() needs is kept in a hash keyed by that page.
+ */
+
+#define OS_LARGE_PAGE_SIZE   (BALLOON_2M_PAGES * PAGE_SIZE)
+#define OS_LARGE_PAGE_HASH   1024
+
+typedef struct os_large_page {
+   LIST_ENTRY(os_large_page) link;
+   vm_page_t page;           /* first page of the run */
+   void *addr;               /* kernel address of the run */
+} os_large_page;
+
+LIST_HEAD(os_large_page_list, os_large_page);
+
+typedef struct {
+   struct os_large_page_list *hash;
+   u_long hashMask;
+} os_large_pages;
+
 typedef struct {
    os_timer    timer;
    os_pmap     pmap;
    vm_object_t vmobject;     /* vm backing object */
+   os_large_pages largePages;
 } os_state;
 
 MALLOC_DEFINE(M_VMMEMCTL, BALLOON_NAME, "vmmemctl metadata");
@@ -458,6 +483,207 @@ OS_ReservedPageFree(PageHandle handle) // IN: A valid page handle
 }
 
 
+static struct os_large_page_list *
+os_large_page_bucket(vm_page_t page) // IN
+{
+   os_large_pages *large = &global_state.largePages;
+
+   return &large->hash[(atop(VM_PAGE_TO_PHYS(page)) / BALLOON_2M_PAGES) &
+                       large->hashMask];
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageSupported --
+ *
+ *      Whether OS_ReservedLargePageAlloc() can reserve large pages.
+ *
+ * Results:
+ *      TRUE once the driver is initialized.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+OS_ReservedLargePageSupported(void)
+{
+   return global_state.largePages.hash != NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageAlloc --
+ *
+ *      Reserve a 2MB aligned run of physical pages for the exclusive use
+ *      of this driver. The allocation never sleeps, as the balloon runs
+ *      from a callout; it simply fails when physical memory is too
+ *      fragmented, and the balloon then falls back to small pages.
+ *
+ * Results:
+ *      On success: A valid page handle that can be passed to
+ *                  OS_ReservedPageGetPPN() or OS_ReservedLargePageFree().
+ *      On failure: PAGE_HANDLE_INVALID
+ *
+ * Side effects:
+ *      Maps the run in the kernel address space.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+PageHandle
+OS_ReservedLargePageAlloc(int canSleep) // IN: Unused
+{
+   os_large_page *lp;
+
+   lp = malloc(sizeof *lp, M_VMMEMCTL, M_NOWAIT);
+   if (lp == NULL) {
+      return PAGE_HANDLE_INVALID;
+   }
+
+   lp->addr = contigmalloc(OS_LARGE_PAGE_SIZE, M_VMMEMCTL, M_NOWAIT,
+                           0, ~(vm_paddr_t)0, OS_LARGE_PAGE_SIZE, 0);
+   if (lp->addr == NULL) {
+      free(lp, M_VMMEMCTL);
+      return PAGE_HANDLE_INVALID;
+   }
+
+   lp->page = PHYS_TO_VM_PAGE(vtophys(lp->addr));
+   LIST_INSERT_HEAD(os_large_page_bucket(lp->page), lp, link);
+
+   return (PageHandle)lp->page;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageFree --
+ *
+ *      Unreserve a run of pages previously reserved with
+ *      OS_ReservedLargePageAlloc().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+OS_ReservedLargePageFree(PageHandle handle) // IN: A valid page handle
+{
+   vm_page_t page = (vm_page_t)handle;
+   os_large_page *lp;
+
+   LIST_FOREACH(lp, os_large_page_bucket(page), link) {
+      if (lp->page == page) {
+         break;
+      }
+   }
+
+   KASSERT(lp != NULL, ("vmmemctl: unknown large page %p", page));
+   if (lp == NULL) {
+      return;
+   }
+
+   LIST_REMOVE(lp, link);
+   contigfree(lp->addr, OS_LARGE_PAGE_SIZE, M_VMMEMCTL);
+   free(lp, M_VMMEMCTL);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_MapPageHandle --
+ *
+ *      Map a page handle (of a physical page previously reserved with
+ *      OS_ReservedPageAlloc()) into the kernel address space.
+ *
+ * Results:
+ *      On success: A mapping that can be passed to OS_Mapping2Addr() or
+ *                  OS_UnmapPage().
+ *      On failure: MAPPING_INVALID
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Mapping
+OS_MapPageHandle(PageHandle handle) // IN: A valid page handle
+{
+   vm_page_t page = (vm_page_t)handle;
+   vm_offset_t res;
+
+   res = kmem_alloc_nofault(kernel_map, PAGE_SIZE);
+   if (!res) {
+      return MAPPING_INVALID;
+   }
+
+   pmap_qenter(res, &page, 1);
+
+   return (Mapping)res;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_Mapping2Addr --
+ *
+ *      Return the address of a page mapped with OS_MapPageHandle().
+ *
+ * Results:
+ *      The address.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void *
+OS_Mapping2Addr(Mapping mapping) // IN: A valid mapping
+{
+   return (void *)mapping;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_UnmapPage --
+ *
+ *      Unmap a page mapped with OS_MapPageHandle().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+OS_UnmapPage(Mapping mapping) // IN: A valid mapping
+{
+   pmap_qremove((vm_offset_t)mapping, 1);
+   kmem_free(kernel_map, (vm_offset_t)mapping, PAGE_SIZE);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -532,7 +758,14 @@ vmmemctl_init(void)
    os_timer *t = &state->timer;
    os_pmap *pmap = &state->pmap;
 
+   /* the balloon asks for large page support when it starts */
+   state->largePages.hash = hashinit(OS_LARGE_PAGE_HASH, M_VMMEMCTL,
+                                     &state->largePages.hashMask);
+
    if (!Balloon_Init(BALLOON_GUEST_BSD)) {
+      hashdestroy(state->largePages.hash, M_VMMEMCTL,
+                  state->largePages.hashMask);
+      state->largePages.hash = NULL;
       return EIO;
    }
 
@@ -589,6 +822,10 @@ vmmemctl_cleanup(void)
    os_balloonobject_delete();
    os_pmap_free(pmap);
 
+   /* Balloon_Cleanup() has released the large pages */
+   hashdestroy(state->largePages.hash, M_VMMEMCTL, state->largePages.hashMask);
+   state->largePages.hash = NULL;
+
    /* log device unload */
    printf(BALLOON_NAME_VERBOSE " unloaded\n");
 }
@@ -656,9 +893,11 @@ vmmemctl_sysctl(SYSCTL_HANDLER_ARGS)
    /* format size info */
    len += snprintf(buf + len, sizeof(buf) - len,
                    "target:             %8d pages\n"
-                   "current:            %8d pages\n",
+                   "current:            %8d pages\n"
+                   "currentLarge:       %8d pages\n",
                    stats->nPagesTarget,
-                   stats->nPages);
+                   stats->nPages,
+                   stats->nLargePages);
 
    /* format rate info */
    len += snprintf(buf + len, sizeof(buf) - len,
@@ -677,9 +916,13 @@ vmmemctl_sysctl(SYSCTL_HANDLER_ARGS)
                    "lock:               %8u (%4u failed)\n"
                    "unlock:             %8u (%4u failed)\n"
                    "target:             %8u (%4u failed)\n"
+                   "batchLock:          %8u (%4u failed)\n"
+                   "batchUnlock:        %8u (%4u failed)\n"
                    "primNoSleepAlloc:   %8u (%4u failed)\n"
                    "primCanSleepAlloc:  %8u (%4u failed)\n"
                    "primFree:           %8u\n"
+                   "primLargeAlloc:     %8u (%4u failed)\n"
+                   "primLargeFree:      %8u\n"
                    "errAlloc:           %8u\n"
                    "errFree:            %8u\n",
                    stats->timer,
@@ -688,11 +931,15 @@ vmmemctl_sysctl(SYSCTL_HANDLER_ARGS)
                    stats->lock,  stats->lockFail,
                    stats->unlock, stats->unlockFail,
                    stats->target, stats->targetFail,
+                   stats->batchLock, stats->batchLockFail,
+                   stats->batchUnlock, stats->batchUnlockFail,
                    stats->primAlloc[BALLOON_PAGE_ALLOC_NOSLEEP],
                    stats->primAllocFail[BALLOON_PAGE_ALLOC_NOSLEEP],
                    stats->primAlloc[BALLOON_PAGE_ALLOC_CANSLEEP],
                    stats->primAllocFail[BALLOON_PAGE_ALLOC_CANSLEEP],
                    stats->primFree,
+                   stats->primLargeAlloc, stats->primLargeAllocFail,
+                   stats->primLargeFree,
                    stats->primErrorPageAlloc,
                    stats->primErrorPageFree);
 
@@ -90,6 +90,21 @@
 #define BALLOON_BDOOR_CMD_LOCK          (2)
 #define BALLOON_BDOOR_CMD_UNLOCK        (3)
 #define BALLOON_BDOOR_CMD_GUEST_ID      (4)
+#define BALLOON_BDOOR_CMD_BATCHED_LOCK  (6)
+#define BALLOON_BDOOR_CMD_BATCHED_UNLOCK (7)
+#define BALLOON_BDOOR_CMD_BATCHED_2M_LOCK (8)
+#define BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK (9)
+
+/*
+ * Capabilities, passed by the guest with BALLOON_BDOOR_CMD_START. Monitors
+ * that predate capabilities take the argument as the protocol version,
+ * which is why BALLOON_BASIC_CMDS has the value of protocol version 2.
+ * Newer monitors reply BALLOON_SUCCESS_WITH_CAPABILITIES, with the
+ * capabilities they accepted in cx.
+ */
+#define BALLOON_BASIC_CMDS              (1 << 1)
+#define BALLOON_BATCHED_CMDS            (1 << 2)
+#define BALLOON_BATCHED_2M_CMDS         (1 << 3)
 
 /* use config value for max balloon size */
 #define BALLOON_MAX_SIZE_USE_CONFIG     (0)
@@ -122,4 +137,61 @@ typedef enum {
 #define BALLOON_ERROR_RESET             (7)
 #define BALLOON_ERROR_BUSY              (8)
 
+#define BALLOON_SUCCESS_WITH_CAPABILITIES (0x03000000)
+
+/*
+ * Batched commands
+ *
+ *      The guest passes the PPN of a page of PA64 entries in bx and the
+ *      number of entries in si. Each entry is the physical address of a
+ *      page to lock or unlock; the monitor returns the status of the page
+ *      in the low bits of the entry. Batch entries describe 4KB pages,
+ *      whatever the page size of the guest, except for the 2M commands,
+ *      whose entries are the addresses of 2MB aligned runs of
+ *      BALLOON_2M_PAGES pages.
+ */
+#define BALLOON_BATCH_PAGE_SHIFT        (12)
+#define BALLOON_BATCH_MAX_PAGES         ((1 << BALLOON_BATCH_PAGE_SHIFT) / \
+                                         sizeof(PA64))
+#define BALLOON_2M_PAGE_ORDER           (9)
+#define BALLOON_2M_PAGES                (1 << BALLOON_2M_PAGE_ORDER)
+#define BALLOON_BATCH_STATUS_MASK       ((PA64)0x1f)
+#define BALLOON_BATCH_PAGE_MASK         \
+   (~(((PA64)1 << BALLOON_BATCH_PAGE_SHIFT) - 1))
+
+typedef struct {
+   PA64 pages[BALLOON_BATCH_MAX_PAGES];
+} BalloonBatchPage;
+
+static INLINE PA64
+Balloon_BatchGetPA(BalloonBatchPage *batchPage, // IN
+                   uint16 idx)                  // IN
+{
+   return batchPage->pages[idx] & BALLOON_BATCH_PAGE_MASK;
+}
+
+static INLINE int
+Balloon_BatchGetStatus(BalloonBatchPage *batchPage, // IN
+                       uint16 idx)                  // IN
+{
+   return (int)(batchPage->pages[idx] & BALLOON_BATCH_STATUS_MASK);
+}
+
+static INLINE void
+Balloon_BatchSetPA(BalloonBatchPage *batchPage, // IN/OUT
+                   uint16 idx,                  // IN
+                   PA64 pa)                     // IN
+{
+   batchPage->pages[idx] = pa;
+}
+
+static INLINE void
+Balloon_BatchSetStatus(BalloonBatchPage *batchPage, // IN/OUT
+                       uint16 idx,                  // IN
+                       int status)                  // IN
+{
+   batchPage->pages[idx] = (batchPage->pages[idx] & BALLOON_BATCH_PAGE_MASK) |
+                           ((PA64)status & BALLOON_BATCH_STATUS_MASK);
+}
+
 #endif  /* _BALLOON_DEF_H */
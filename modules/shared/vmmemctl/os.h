@@ -78,6 +78,10 @@ typedef uintptr_t PageHandle;
 
 #define PAGE_HANDLE_INVALID 0
 
+typedef uintptr_t Mapping;
+
+#define MAPPING_INVALID 0
+
 /*
  * Operations
  */
@@ -95,4 +99,21 @@ extern unsigned long OS_ReservedPageGetPPN(PageHandle handle);
 extern PageHandle    OS_ReservedPageAlloc(int canSleep);
 extern void          OS_ReservedPageFree(PageHandle handle);
 
+/*
+ * Large pages are 2MB aligned runs of BALLOON_2M_PAGES physical pages;
+ * OS_ReservedPageGetPPN() returns the first PPN of the run. Operating
+ * systems that cannot allocate them return FALSE from
+ * OS_ReservedLargePageSupported(), and the balloon then does not offer
+ * the 2MB commands to the monitor. FreeBSD and the balloon simulator
+ * (tests/vmballoonSim) allocate large pages; Solaris does not, so Solaris
+ * guests only balloon 4KB pages.
+ */
+extern Bool          OS_ReservedLargePageSupported(void);
+extern PageHandle    OS_ReservedLargePageAlloc(int canSleep);
+extern void          OS_ReservedLargePageFree(PageHandle handle);
+
+extern Mapping       OS_MapPageHandle(PageHandle handle);
+extern void         *OS_Mapping2Addr(Mapping mapping);
+extern void          OS_UnmapPage(Mapping mapping);
+
 #endif  /* OS_H */
@@ -105,7 +105,8 @@ extern "C" {
 #define NULL 0
 #endif
 
-#define BALLOON_PROTOCOL_VERSION        2
+#define BALLOON_CAPABILITIES            (BALLOON_BASIC_CMDS | \
+                                         BALLOON_BATCHED_CMDS)
 
 #define BALLOON_CHUNK_PAGES             1000
 
@@ -143,21 +144,39 @@ extern "C" {
  * Types
  */
 
+/*
+ * Sizes of the pages of the balloon. Balloon sizes, targets and rates
+ * are in small (4KB) pages, a large page counting as BALLOON_2M_PAGES.
+ */
+typedef enum {
+   BALLOON_PAGE_SMALL = 0,
+   BALLOON_PAGE_LARGE = 1,
+   BALLOON_PAGE_TYPES_NR,
+} BalloonPageType;
+
+#define BALLOON_PAGE_UNITS(type) \
+   ((type) == BALLOON_PAGE_LARGE ? BALLOON_2M_PAGES : 1)
+
 typedef struct BalloonChunk {
    PageHandle page[BALLOON_CHUNK_PAGES];
    uint32 pageCount;
    DblLnkLst_Links node;
 } BalloonChunk;
 
+typedef struct {
+   DblLnkLst_Links chunks;
+   int nChunks;
+} BalloonChunkList;
+
 typedef struct {
    PageHandle page[BALLOON_ERROR_PAGES];
+   BalloonPageType pageType[BALLOON_ERROR_PAGES];
    uint32 pageCount;
 } BalloonErrorPages;
 
 typedef struct {
-   /* sets of reserved physical pages */
-   DblLnkLst_Links chunks;
-   int nChunks;
+   /* sets of reserved physical pages, one per page size */
+   BalloonChunkList pages[BALLOON_PAGE_TYPES_NR];
 
    /* transient list of non-balloonable pages */
    BalloonErrorPages errors;
@@ -167,10 +186,25 @@ typedef struct {
    /* balloon size */
    int nPages;
    int nPagesTarget;
+   int nLargePages;
 
    /* reset flag */
    int resetFlag;
 
+   /* capabilities accepted by the monitor */
+   uint32 capabilities;
+
+   /* page shared with the monitor for batched commands, if any */
+   PageHandle batchPageHandle;
+   Mapping batchPageMapping;
+   BalloonBatchPage *batchPage;
+   uint32 batchPagePPN;
+
+   /* handles and size of the pages in the batch page */
+   PageHandle batchHandles[BALLOON_BATCH_MAX_PAGES];
+   uint16 batchCount;
+   BalloonPageType batchType;
+
    /* adjustment rates (pages per second) */
    int rateAlloc;
    int rateFree;
@@ -192,7 +226,13 @@ static Balloon globalBalloon;
  * Balloon operations
  */
 static int  BalloonPageAlloc(Balloon *b, BalloonPageAllocType allocType);
-static int  BalloonPageFree(Balloon *b, int monitorUnlock);
+static int  BalloonPageFree(Balloon *b, BalloonPageType pageType,
+                            int monitorUnlock);
+static int  BalloonBatchPageAlloc(Balloon *b, BalloonPageAllocType allocType,
+                                  BalloonPageType pageType);
+static int  BalloonBatchLock(Balloon *b);
+static int  BalloonBatchUnlock(Balloon *b, BalloonPageType pageType,
+                               uint16 nPages);
 static int  BalloonAdjustSize(Balloon *b, uint32 target);
 static void BalloonReset(Balloon *b);
 
@@ -204,6 +244,7 @@ static int BalloonMonitorGuestType(Balloon *b);
 static int BalloonMonitorGetTarget(Balloon *b, uint32 *nPages);
 static int BalloonMonitorLockPage(Balloon *b, PageHandle handle);
 static int BalloonMonitorUnlockPage(Balloon *b, PageHandle handle);
+static int BalloonMonitorBatched(Balloon *b, uint32 cmd, uint16 nPages);
 
 /*
  * Macros
@@ -246,6 +287,7 @@ Balloon_GetStats(void)
     */
    stats->nPages = b->nPages;
    stats->nPagesTarget = b->nPagesTarget;
+   stats->nLargePages = b->nLargePages;
    stats->rateNoSleepAlloc = BALLOON_NOSLEEP_ALLOC_MAX;
    stats->rateAlloc = b->rateAlloc;
    stats->rateFree = b->rateFree;
@@ -319,6 +361,34 @@ BalloonChunk_Destroy(BalloonChunk *chunk) // IN
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonReservedPageFree --
+ *
+ *      Returns a page of the given size to the guest.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+BalloonReservedPageFree(PageHandle page,          // IN
+                        BalloonPageType pageType) // IN
+{
+   if (pageType == BALLOON_PAGE_LARGE) {
+      OS_ReservedLargePageFree(page);
+   } else {
+      OS_ReservedPageFree(page);
+   }
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -339,18 +409,110 @@ static void
 Balloon_Deallocate(Balloon *b) // IN
 {
    unsigned int cnt = 0;
+   BalloonPageType pageType;
 
    /* free all pages, skipping monitor unlock */
-   while (b->nChunks > 0) {
-      (void) BalloonPageFree(b, FALSE);
-      if (++cnt >= b->rateFree) {
-         cnt = 0;
-         OS_Yield();
+   for (pageType = 0; pageType < BALLOON_PAGE_TYPES_NR; pageType++) {
+      while (b->pages[pageType].nChunks > 0) {
+         (void) BalloonPageFree(b, pageType, FALSE);
+         if (++cnt >= b->rateFree) {
+            cnt = 0;
+            OS_Yield();
+         }
       }
    }
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonBatchDestroy --
+ *
+ *      Releases the page shared with the monitor for batched commands.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      The balloon falls back to per-page commands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+BalloonBatchDestroy(Balloon *b) // IN
+{
+   if (b->batchPage == NULL) {
+      return;
+   }
+
+   OS_UnmapPage(b->batchPageMapping);
+   OS_ReservedPageFree(b->batchPageHandle);
+
+   b->batchPage = NULL;
+   b->batchPageMapping = MAPPING_INVALID;
+   b->batchPageHandle = PAGE_HANDLE_INVALID;
+   b->batchPagePPN = 0;
+   b->batchCount = 0;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonBatchCreate --
+ *
+ *      Allocates and maps the page shared with the monitor for batched
+ *      commands, unless already done.
+ *
+ * Results:
+ *      TRUE if batched commands can be used.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Bool
+BalloonBatchCreate(Balloon *b) // IN
+{
+   unsigned long ppn;
+
+   if (b->batchPage != NULL) {
+      return TRUE;
+   }
+
+   b->batchPageHandle = OS_ReservedPageAlloc(BALLOON_PAGE_ALLOC_CANSLEEP);
+   if (b->batchPageHandle == PAGE_HANDLE_INVALID) {
+      return FALSE;
+   }
+
+   /* The PPN of the batch page is passed in a 32-bit register. */
+   ppn = OS_ReservedPageGetPPN(b->batchPageHandle);
+   b->batchPagePPN = (uint32)ppn;
+   if (b->batchPagePPN != ppn) {
+      goto error;
+   }
+
+   b->batchPageMapping = OS_MapPageHandle(b->batchPageHandle);
+   if (b->batchPageMapping == MAPPING_INVALID) {
+      goto error;
+   }
+
+   b->batchPage = OS_Mapping2Addr(b->batchPageMapping);
+   b->batchCount = 0;
+   return TRUE;
+
+error:
+   OS_ReservedPageFree(b->batchPageHandle);
+   b->batchPageHandle = PAGE_HANDLE_INVALID;
+   b->batchPagePPN = 0;
+   return FALSE;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -382,6 +544,12 @@ BalloonReset(Balloon *b) // IN
       /* clear flag */
       b->resetFlag = 0;
 
+      /* use batched commands if possible, fall back to per-page ones */
+      if ((b->capabilities & BALLOON_BATCHED_CMDS) == 0 ||
+          !BalloonBatchCreate(b)) {
+         BalloonBatchDestroy(b);
+      }
+
       /* report guest type */
       (void) BalloonMonitorGuestType(b);
    }
@@ -456,8 +624,9 @@ Balloon_QueryAndExecute(void)
  */
 
 static int
-BalloonErrorPageStore(Balloon *b,      // IN
-                      PageHandle page) // IN
+BalloonErrorPageStore(Balloon *b,               // IN
+                      PageHandle page,          // IN
+                      BalloonPageType pageType) // IN
 {
    /* fail if list already full */
    if (b->errors.pageCount >= BALLOON_ERROR_PAGES) {
@@ -465,6 +634,7 @@ BalloonErrorPageStore(Balloon *b,      // IN
    }
 
    /* add page to list */
+   b->errors.pageType[b->errors.pageCount] = pageType;
    b->errors.page[b->errors.pageCount++] = page;
    STATS_INC(b->stats.primErrorPageAlloc);
    return BALLOON_SUCCESS;
@@ -494,7 +664,7 @@ BalloonErrorPagesFree(Balloon *b) // IN
 
    /* free all non-balloonable "error" pages */
    for (i = 0; i < b->errors.pageCount; i++) {
-      OS_ReservedPageFree(b->errors.page[i]);
+      BalloonReservedPageFree(b->errors.page[i], b->errors.pageType[i]);
       b->errors.page[i] = PAGE_HANDLE_INVALID;
       STATS_INC(b->stats.primErrorPageFree);
    }
@@ -507,8 +677,9 @@ BalloonErrorPagesFree(Balloon *b) // IN
  *
  * BalloonGetChunk --
  *
- *      Attempt to find a "chunk" with a free slot to store locked page.
- *      Try to allocate new chunk if all existing chunks are full.
+ *      Attempt to find a "chunk" with a free slot to store a locked page
+ *      of the given size. Try to allocate new chunk if all existing
+ *      chunks are full.
  *
  * Results:
  *      Returns NULL on failure.
@@ -520,13 +691,15 @@ BalloonErrorPagesFree(Balloon *b) // IN
  */
 
 static BalloonChunk *
-BalloonGetChunk(Balloon *b)         // IN
+BalloonGetChunk(Balloon *b,               // IN
+                BalloonPageType pageType) // IN
 {
+   BalloonChunkList *list = &b->pages[pageType];
    BalloonChunk *chunk;
 
    /* Get first chunk from the list */
-   if (DblLnkLst_IsLinked(&b->chunks)) {
-      chunk = DblLnkLst_Container(b->chunks.next, BalloonChunk, node);
+   if (DblLnkLst_IsLinked(&list->chunks)) {
+      chunk = DblLnkLst_Container(list->chunks.next, BalloonChunk, node);
       if (chunk->pageCount < BALLOON_CHUNK_PAGES) {
          /* This chunk has free slots, use it */
          return chunk;
@@ -536,10 +709,10 @@ BalloonGetChunk(Balloon *b)         // IN
    /* create new chunk */
    chunk = BalloonChunk_Create();
    if (chunk != NULL) {
-      DblLnkLst_LinkFirst(&b->chunks, &chunk->node);
+      DblLnkLst_LinkFirst(&list->chunks, &chunk->node);
 
       /* update stats */
-      b->nChunks++;
+      list->nChunks++;
    }
 
    return chunk;
@@ -616,7 +789,7 @@ BalloonPageAlloc(Balloon *b,                     // IN
 
       /* Get the chunk to store allocated page. */
       if (!chunk) {
-         chunk = BalloonGetChunk(b);
+         chunk = BalloonGetChunk(b, BALLOON_PAGE_SMALL);
          if (!chunk) {
             OS_ReservedPageFree(page);
             return BALLOON_PAGE_ALLOC_FAILURE;
@@ -634,7 +807,7 @@ BalloonPageAlloc(Balloon *b,                     // IN
          }
 
          /* place on list of non-balloonable pages, retry allocation */
-         status = BalloonErrorPageStore(b, page);
+         status = BalloonErrorPageStore(b, page, BALLOON_PAGE_SMALL);
          if (status != BALLOON_SUCCESS) {
             OS_ReservedPageFree(page);
             return status;
@@ -657,9 +830,10 @@ BalloonPageAlloc(Balloon *b,                     // IN
  *
  * BalloonPageFree --
  *
- *      Attempts to deallocate a physical page, deflating balloon "b".
- *      Informs monitor of PPN for deallocated page via backdoor if
- *      "monitorUnlock" is specified.
+ *      Attempts to deallocate a physical page of the given size,
+ *      deflating balloon "b". Informs monitor of PPN for deallocated
+ *      page via backdoor if "monitorUnlock" is specified (small pages
+ *      only; large pages are unlocked with BalloonBatchUnlock()).
  *
  * Results:
  *      Returns BALLOON_SUCCESS if successful, otherwise error code.
@@ -671,15 +845,17 @@ BalloonPageAlloc(Balloon *b,                     // IN
  */
 
 static int
-BalloonPageFree(Balloon *b,        // IN
-                int monitorUnlock) // IN
+BalloonPageFree(Balloon *b,               // IN
+                BalloonPageType pageType, // IN
+                int monitorUnlock)        // IN
 {
+   BalloonChunkList *list = &b->pages[pageType];
    DblLnkLst_Links *node, *next;
    BalloonChunk *chunk = NULL;
    PageHandle page;
    int status;
 
-   DblLnkLst_ForEachSafe(node, next, &b->chunks) {
+   DblLnkLst_ForEachSafe(node, next, &list->chunks) {
       chunk = DblLnkLst_Container(node, BalloonChunk, node);
       if (chunk->pageCount > 0) {
          break;
@@ -691,7 +867,7 @@ BalloonPageFree(Balloon *b,        // IN
       chunk = NULL;
 
       /* update stats */
-      b->nChunks--;
+      list->nChunks--;
    }
 
    if (!chunk) {
@@ -713,11 +889,16 @@ BalloonPageFree(Balloon *b,        // IN
    }
 
    /* deallocate page */
-   OS_ReservedPageFree(page);
-   STATS_INC(b->stats.primFree);
+   BalloonReservedPageFree(page, pageType);
+   if (pageType == BALLOON_PAGE_LARGE) {
+      STATS_INC(b->stats.primLargeFree);
+      b->nLargePages--;
+   } else {
+      STATS_INC(b->stats.primFree);
+   }
 
    /* update balloon size */
-   b->nPages--;
+   b->nPages -= BALLOON_PAGE_UNITS(pageType);
 
    /* reclaim chunk, if empty */
    if (chunk->pageCount == 0) {
@@ -726,13 +907,313 @@ BalloonPageFree(Balloon *b,        // IN
       BalloonChunk_Destroy(chunk);
 
       /* update stats */
-      b->nChunks--;
+      list->nChunks--;
+   }
+
+   return BALLOON_SUCCESS;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonBatchPageAlloc --
+ *
+ *      Batched counterpart of BalloonPageAlloc(): allocates a physical
+ *      page of the given size and adds it to the batch page. The batch
+ *      is sent to the monitor once full or when the page size changes;
+ *      BalloonInflate() sends the remainder.
+ *
+ * Results:
+ *      Returns BALLOON_SUCCESS if successful, otherwise error code.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+BalloonBatchPageAlloc(Balloon *b,                     // IN
+                      BalloonPageAllocType allocType, // IN
+                      BalloonPageType pageType)       // IN
+{
+   PageHandle page;
+   unsigned long ppn;
+
+   /* a batch holds pages of a single size */
+   if (b->batchCount > 0 && b->batchType != pageType) {
+      int status = BalloonBatchLock(b);
+
+      if (status != BALLOON_SUCCESS) {
+         return status;
+      }
+   }
+
+   if (pageType == BALLOON_PAGE_LARGE) {
+      STATS_INC(b->stats.primLargeAlloc);
+      page = OS_ReservedLargePageAlloc(allocType);
+      if (page == PAGE_HANDLE_INVALID) {
+         STATS_INC(b->stats.primLargeAllocFail);
+         return BALLOON_PAGE_ALLOC_FAILURE;
+      }
+   } else {
+      STATS_INC(b->stats.primAlloc[allocType]);
+      page = OS_ReservedPageAlloc(allocType);
+      if (page == PAGE_HANDLE_INVALID) {
+         STATS_INC(b->stats.primAllocFail[allocType]);
+         return BALLOON_PAGE_ALLOC_FAILURE;
+      }
+   }
+
+   ppn = OS_ReservedPageGetPPN(page);
+   Balloon_BatchSetPA(b->batchPage, b->batchCount,
+                      (PA64)ppn << BALLOON_BATCH_PAGE_SHIFT);
+   b->batchHandles[b->batchCount++] = page;
+   b->batchType = pageType;
+
+   if (b->batchCount == BALLOON_BATCH_MAX_PAGES) {
+      return BalloonBatchLock(b);
    }
 
    return BALLOON_SUCCESS;
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonBatchLock --
+ *
+ *      Asks the monitor to lock the pages of the batch page, and tracks
+ *      the ones it accepted. Refused pages go to the list of
+ *      non-balloonable pages, like in BalloonPageAlloc().
+ *
+ * Results:
+ *      Returns BALLOON_SUCCESS if successful, otherwise error code.
+ *
+ * Side effects:
+ *      Empties the batch.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+BalloonBatchLock(Balloon *b) // IN
+{
+   BalloonPageType pageType = b->batchType;
+   BalloonChunk *chunk;
+   BalloonChunk *spare = NULL;
+   uint16 nPages = b->batchCount;
+   int status;
+   uint16 i;
+
+   b->batchCount = 0;
+
+   /*
+    * Make sure every page of the batch can be tracked before giving the
+    * pages away. A batch is smaller than a chunk, so at most one more
+    * chunk is needed.
+    */
+   chunk = BalloonGetChunk(b, pageType);
+   if (chunk != NULL && BALLOON_CHUNK_PAGES - chunk->pageCount < nPages) {
+      spare = BalloonChunk_Create();
+      if (spare == NULL) {
+         chunk = NULL;
+      }
+   }
+
+   if (chunk == NULL) {
+      status = BALLOON_PAGE_ALLOC_FAILURE;
+   } else {
+      status = BalloonMonitorBatched(b,
+                                     pageType == BALLOON_PAGE_LARGE ?
+                                        BALLOON_BDOOR_CMD_BATCHED_2M_LOCK :
+                                        BALLOON_BDOOR_CMD_BATCHED_LOCK,
+                                     nPages);
+   }
+
+   if (status != BALLOON_SUCCESS) {
+      for (i = 0; i < nPages; i++) {
+         BalloonReservedPageFree(b->batchHandles[i], pageType);
+      }
+      goto out;
+   }
+
+   for (i = 0; i < nPages; i++) {
+      PageHandle page = b->batchHandles[i];
+      int pageStatus = Balloon_BatchGetStatus(b->batchPage, i);
+
+      STATS_INC(b->stats.lock);
+
+      if (pageStatus == BALLOON_SUCCESS) {
+         if (chunk->pageCount == BALLOON_CHUNK_PAGES) {
+            DblLnkLst_LinkFirst(&b->pages[pageType].chunks, &spare->node);
+            b->pages[pageType].nChunks++;
+            chunk = spare;
+            spare = NULL;
+         }
+
+         /* track allocated page */
+         BalloonPageStore(chunk, page);
+
+         /* update balloon size */
+         b->nPages += BALLOON_PAGE_UNITS(pageType);
+         if (pageType == BALLOON_PAGE_LARGE) {
+            b->nLargePages++;
+         }
+         continue;
+      }
+
+      STATS_INC(b->stats.lockFail);
+
+      if (pageStatus == BALLOON_ERROR_RESET ||
+          pageStatus == BALLOON_ERROR_PPN_NOTNEEDED) {
+         if (pageStatus == BALLOON_ERROR_RESET) {
+            b->resetFlag = 1;
+         }
+         BalloonReservedPageFree(page, pageType);
+         if (status == BALLOON_SUCCESS) {
+            status = pageStatus;
+         }
+         continue;
+      }
+
+      /* place on list of non-balloonable pages */
+      if (BalloonErrorPageStore(b, page, pageType) != BALLOON_SUCCESS) {
+         BalloonReservedPageFree(page, pageType);
+         if (status == BALLOON_SUCCESS) {
+            status = BALLOON_FAILURE;
+         }
+      }
+   }
+
+out:
+   if (spare != NULL) {
+      BalloonChunk_Destroy(spare);
+   }
+   return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonBatchUnlock --
+ *
+ *      Batched counterpart of BalloonPageFree(b, pageType, TRUE): asks
+ *      the monitor to unlock up to "nPages" pages of the given size with
+ *      one backdoor call and frees the ones it released. Pages the
+ *      monitor refused stay in the balloon.
+ *
+ * Results:
+ *      Returns BALLOON_SUCCESS if successful, otherwise error code.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+BalloonBatchUnlock(Balloon *b,               // IN
+                   BalloonPageType pageType, // IN
+                   uint16 nPages)            // IN
+{
+   BalloonChunkList *list = &b->pages[pageType];
+   DblLnkLst_Links *node, *next;
+   BalloonChunk *chunk;
+   int status, ret;
+   uint16 i;
+
+   /* take pages off the chunks, most recently allocated first */
+   b->batchCount = 0;
+   b->batchType = pageType;
+   DblLnkLst_ForEach(node, &list->chunks) {
+      chunk = DblLnkLst_Container(node, BalloonChunk, node);
+      while (chunk->pageCount > 0 && b->batchCount < nPages) {
+         PageHandle page = chunk->page[--chunk->pageCount];
+
+         Balloon_BatchSetPA(b->batchPage, b->batchCount,
+                            (PA64)OS_ReservedPageGetPPN(page) <<
+                               BALLOON_BATCH_PAGE_SHIFT);
+         b->batchHandles[b->batchCount++] = page;
+      }
+      if (b->batchCount == nPages) {
+         break;
+      }
+   }
+
+   if (b->batchCount == 0) {
+      /* We could not find a single non-empty chunk. */
+      return BALLOON_FAILURE;
+   }
+
+   status = BalloonMonitorBatched(b,
+                                  pageType == BALLOON_PAGE_LARGE ?
+                                     BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK :
+                                     BALLOON_BDOOR_CMD_BATCHED_UNLOCK,
+                                  b->batchCount);
+   ret = status;
+
+   for (i = 0; i < b->batchCount; i++) {
+      PageHandle page = b->batchHandles[i];
+      int pageStatus = status;
+
+      if (status == BALLOON_SUCCESS) {
+         pageStatus = Balloon_BatchGetStatus(b->batchPage, i);
+         STATS_INC(b->stats.unlock);
+         if (pageStatus != BALLOON_SUCCESS) {
+            STATS_INC(b->stats.unlockFail);
+         }
+      }
+
+      if (pageStatus == BALLOON_SUCCESS) {
+         /* deallocate page */
+         BalloonReservedPageFree(page, pageType);
+         if (pageType == BALLOON_PAGE_LARGE) {
+            STATS_INC(b->stats.primLargeFree);
+            b->nLargePages--;
+         } else {
+            STATS_INC(b->stats.primFree);
+         }
+
+         /* update balloon size */
+         b->nPages -= BALLOON_PAGE_UNITS(pageType);
+         continue;
+      }
+
+      /* put the page back into the first chunk with a free slot */
+      DblLnkLst_ForEach(node, &list->chunks) {
+         chunk = DblLnkLst_Container(node, BalloonChunk, node);
+         if (chunk->pageCount < BALLOON_CHUNK_PAGES) {
+            BalloonPageStore(chunk, page);
+            break;
+         }
+      }
+
+      if (ret == BALLOON_SUCCESS) {
+         ret = pageStatus;
+      }
+   }
+   b->batchCount = 0;
+
+   /* reclaim empty chunks */
+   DblLnkLst_ForEachSafe(node, next, &list->chunks) {
+      chunk = DblLnkLst_Container(node, BalloonChunk, node);
+      if (chunk->pageCount == 0) {
+         DblLnkLst_Unlink1(node);
+         BalloonChunk_Destroy(chunk);
+
+         /* update stats */
+         list->nChunks--;
+      }
+   }
+
+   return ret;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -756,9 +1237,12 @@ BalloonInflate(Balloon *b,    // IN
    unsigned int goal;
    unsigned int rate;
    unsigned int i;
+   unsigned int units;
+   unsigned int charged = 0;
    unsigned int allocations = 0;
    int status = 0;
    BalloonPageAllocType allocType = BALLOON_PAGE_ALLOC_NOSLEEP;
+   BalloonPageType pageType = BALLOON_PAGE_SMALL;
 
    /*
     * First try NOSLEEP page allocations to inflate balloon.
@@ -783,9 +1267,31 @@ BalloonInflate(Balloon *b,    // IN
    rate = b->slowPageAllocationCycles ?
                 b->rateAlloc : BALLOON_NOSLEEP_ALLOC_MAX;
 
-   for (i = 0; i < goal; i++) {
+   /*
+    * Unless the guest is under memory pressure, start with large pages
+    * if the monitor takes them. The rates are there to bound the time
+    * spent per cycle, so a large page counts as one allocation against
+    * them.
+    */
+   if (b->batchPage != NULL &&
+       (b->capabilities & BALLOON_BATCHED_2M_CMDS) != 0 &&
+       !b->slowPageAllocationCycles) {
+      pageType = BALLOON_PAGE_LARGE;
+   }
+
+   for (i = 0; i < goal; i += units) {
+
+      /* do not overshoot the target with a large page */
+      if (pageType == BALLOON_PAGE_LARGE && goal - i < BALLOON_2M_PAGES) {
+         pageType = BALLOON_PAGE_SMALL;
+      }
+      units = BALLOON_PAGE_UNITS(pageType);
 
-      status = BalloonPageAlloc(b, allocType);
+      if (b->batchPage != NULL) {
+         status = BalloonBatchPageAlloc(b, allocType, pageType);
+      } else {
+         status = BalloonPageAlloc(b, allocType);
+      }
       if (status != BALLOON_SUCCESS) {
          if (status != BALLOON_PAGE_ALLOC_FAILURE) {
             /*
@@ -795,6 +1301,18 @@ BalloonInflate(Balloon *b,    // IN
             break;
          }
 
+         if (pageType == BALLOON_PAGE_LARGE) {
+            /*
+             * No large page to be had, which does not mean the guest is
+             * under memory pressure (its memory may just be fragmented).
+             * Use small pages for the rest of this cycle.
+             */
+            pageType = BALLOON_PAGE_SMALL;
+            units = 0;
+            status = BALLOON_SUCCESS;
+            continue;
+         }
+
          if (allocType == BALLOON_PAGE_ALLOC_CANSLEEP) {
             /*
              * CANSLEEP page allocation failed, so guest is under severe
@@ -813,7 +1331,7 @@ BalloonInflate(Balloon *b,    // IN
           */
          b->slowPageAllocationCycles = SLOW_PAGE_ALLOCATION_CYCLES;
 
-         if (i >= b->rateAlloc)
+         if (charged >= b->rateAlloc)
             break;
 
          allocType = BALLOON_PAGE_ALLOC_CANSLEEP;
@@ -826,18 +1344,28 @@ BalloonInflate(Balloon *b,    // IN
          allocations = 0;
       }
 
-      if (i >= rate) {
+      if (charged >= rate) {
          /* We allocated enough pages, let's take a break. */
          break;
       }
+      charged++;
+   }
+
+   /* lock the pages left in the batch */
+   if (b->batchCount > 0) {
+      int batchStatus = BalloonBatchLock(b);
+
+      if (status == BALLOON_SUCCESS) {
+         status = batchStatus;
+      }
    }
 
    /*
     * We reached our goal without failures so try increasing
     * allocation rate.
     */
-   if (status == BALLOON_SUCCESS && i >= b->rateAlloc) {
-      unsigned int mult = i / b->rateAlloc;
+   if (status == BALLOON_SUCCESS && charged >= b->rateAlloc) {
+      unsigned int mult = charged / b->rateAlloc;
 
       b->rateAlloc = MIN(b->rateAlloc + mult * BALLOON_RATE_ALLOC_INC,
                          BALLOON_RATE_ALLOC_MAX);
@@ -869,15 +1397,42 @@ static int
 BalloonDeflate(Balloon *b,    // IN
                uint32 target) // IN
 {
-   int status, i;
+   int status;
+   uint32 i, n;
+   uint32 charged = 0;
    uint32 nFree = b->nPages - target;
+   BalloonPageType pageType;
 
-   /* limit deallocation rate */
-   nFree = MIN(nFree, b->rateFree);
+   /*
+    * Free pages to reach target, limiting the number of pages freed
+    * (of either size) to the deallocation rate.
+    */
+   for (i = 0; i < nFree && charged < b->rateFree;
+        i += n * BALLOON_PAGE_UNITS(pageType), charged += n) {
+      uint32 left = nFree - i;
+      uint32 nSmall = b->nPages - b->nLargePages * BALLOON_2M_PAGES;
 
-   /* free pages to reach target */
-   for (i = 0; i < nFree; i++) {
-      status = BalloonPageFree(b, TRUE);
+      /*
+       * Free large pages while one fits in what is left to free. Only
+       * overshoot the target with one if there are no small pages left;
+       * the next inflation makes up for it with small pages.
+       */
+      if (b->nLargePages > 0 && (left >= BALLOON_2M_PAGES || nSmall == 0)) {
+         pageType = BALLOON_PAGE_LARGE;
+         n = MAX(left / BALLOON_2M_PAGES, 1);
+      } else {
+         pageType = BALLOON_PAGE_SMALL;
+         n = MIN(left, nSmall);
+      }
+      n = MIN(n, b->rateFree - charged);
+
+      if (b->batchPage != NULL) {
+         n = MIN(n, BALLOON_BATCH_MAX_PAGES);
+         status = BalloonBatchUnlock(b, pageType, n);
+      } else {
+         n = 1;
+         status = BalloonPageFree(b, pageType, TRUE);
+      }
       if (status != BALLOON_SUCCESS) {
          if (BALLOON_RATE_ADAPT) {
             /* quickly decrease rate if error */
@@ -934,13 +1489,14 @@ BalloonAdjustSize(Balloon *b,    // IN
  *
  * BalloonMonitorStart --
  *
- *      Attempts to contact monitor via backdoor to begin operation.
+ *      Attempts to contact monitor via backdoor to begin operation,
+ *      negotiating the capabilities of the protocol.
  *
  * Results:
  *      Returns BALLOON_SUCCESS if successful, otherwise error code.
  *
  * Side effects:
- *      None.
+ *      Sets the capabilities accepted by the monitor.
  *
  *----------------------------------------------------------------------
  */
@@ -949,11 +1505,17 @@ static int
 BalloonMonitorStart(Balloon *b) // IN
 {
    uint32 status, target;
+   uint32 capabilities = BALLOON_CAPABILITIES;
    Backdoor_proto bp;
 
+   /* only offer 2MB pages if the OS can allocate them */
+   if (OS_ReservedLargePageSupported()) {
+      capabilities |= BALLOON_BATCHED_2M_CMDS;
+   }
+
    /* prepare backdoor args */
    bp.in.cx.halfs.low = BALLOON_BDOOR_CMD_START;
-   bp.in.size = BALLOON_PROTOCOL_VERSION;
+   bp.in.size = capabilities;
 
    /* invoke backdoor */
    Backdoor_Balloon(&bp);
@@ -962,6 +1524,14 @@ BalloonMonitorStart(Balloon *b) // IN
    status = bp.out.ax.word;
    target = bp.out.bx.word;
 
+   /* older monitors only know the basic commands */
+   if (status == BALLOON_SUCCESS_WITH_CAPABILITIES) {
+      b->capabilities = bp.out.cx.word;
+      status = BALLOON_SUCCESS;
+   } else {
+      b->capabilities = BALLOON_BASIC_CMDS;
+   }
+
    /* update stats */
    STATS_INC(b->stats.start);
    if (status != BALLOON_SUCCESS) {
@@ -1211,6 +1781,67 @@ BalloonMonitorUnlockPage(Balloon *b,        // IN
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * BalloonMonitorBatched --
+ *
+ *      Attempts to contact monitor and lock or unlock (depending on
+ *      "cmd") the first "nPages" pages of the batch page.
+ *
+ * Results:
+ *      Returns BALLOON_SUCCESS if the monitor processed the batch,
+ *      otherwise error code. The status of each page is in its entry
+ *      of the batch page.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+BalloonMonitorBatched(Balloon *b,    // IN
+                      uint32 cmd,    // IN
+                      uint16 nPages) // IN
+{
+   uint32 status;
+   Backdoor_proto bp;
+
+   /* prepare backdoor args */
+   bp.in.cx.halfs.low = cmd;
+   bp.in.size = b->batchPagePPN;
+   bp.in.si.word = nPages;
+
+   /* invoke backdoor */
+   Backdoor_Balloon(&bp);
+
+   /* parse return values */
+   status = bp.out.ax.word;
+
+   /* set flag if reset requested */
+   if (status == BALLOON_ERROR_RESET) {
+      b->resetFlag = 1;
+   }
+
+   /* update stats */
+   if (cmd == BALLOON_BDOOR_CMD_BATCHED_LOCK ||
+       cmd == BALLOON_BDOOR_CMD_BATCHED_2M_LOCK) {
+      STATS_INC(b->stats.batchLock);
+      if (status != BALLOON_SUCCESS) {
+         STATS_INC(b->stats.batchLockFail);
+      }
+   } else {
+      STATS_INC(b->stats.batchUnlock);
+      if (status != BALLOON_SUCCESS) {
+         STATS_INC(b->stats.batchUnlockFail);
+      }
+   }
+
+   return status;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1232,7 +1863,8 @@ Balloon_Init(BalloonGuest guestType)
 {
    Balloon *b = &globalBalloon;
 
-   DblLnkLst_Init(&b->chunks);
+   DblLnkLst_Init(&b->pages[BALLOON_PAGE_SMALL].chunks);
+   DblLnkLst_Init(&b->pages[BALLOON_PAGE_LARGE].chunks);
 
    b->guestType = guestType;
 
@@ -1275,6 +1907,7 @@ Balloon_Cleanup(void)
     */
    BalloonMonitorStart(b);
    Balloon_Deallocate(b);
+   BalloonBatchDestroy(b);
 }
 
 #ifdef __cplusplus
@@ -86,7 +86,7 @@ typedef enum BalloonPageAllocType {
  */
 
 typedef struct {
-   /* current status */
+   /* current status (in small pages) */
    uint32 nPages;
    uint32 nPagesTarget;
 
@@ -104,8 +104,11 @@ typedef struct {
    uint32 primFree;
    uint32 primErrorPageAlloc;
    uint32 primErrorPageFree;
+   uint32 primLargeAlloc;
+   uint32 primLargeAllocFail;
+   uint32 primLargeFree;
 
-   /* monitor operations */
+   /* monitor operations (lock and unlock count pages, batched or not) */
    uint32 lock;
    uint32 lockFail;
    uint32 unlock;
@@ -116,6 +119,15 @@ typedef struct {
    uint32 startFail;
    uint32 guestType;
    uint32 guestTypeFail;
+
+   /* batched monitor operations */
+   uint32 batchLock;
+   uint32 batchLockFail;
+   uint32 batchUnlock;
+   uint32 batchUnlockFail;
+
+   /* large pages in the balloon (included in nPages) */
+   uint32 nLargePages;
 } BalloonStats;
 
 /*
@@ -36,6 +36,7 @@
 #include <sys/proc.h>
 #include <sys/disp.h>
 #include <sys/ksynch.h>
+#include <sys/vmsystm.h>
 
 #include "os.h"
 #include "vmballoon.h"
@@ -375,6 +376,154 @@ OS_ReservedPageFree(PageHandle handle) // IN: A valid page handle
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageSupported --
+ *
+ *      Whether OS_ReservedLargePageAlloc() can reserve large pages. It
+ *      cannot: the driver builds its pages one at a time with
+ *      page_create_va() and has no way to get a 2MB aligned physical
+ *      run, so Solaris guests only balloon small pages.
+ *
+ * Results:
+ *      FALSE
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+OS_ReservedLargePageSupported(void)
+{
+   return FALSE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageAlloc --
+ *
+ *      Reserve a 2MB aligned run of physical pages for the exclusive use
+ *      of this driver. Not supported on Solaris, see
+ *      OS_ReservedLargePageSupported(); never called.
+ *
+ * Results:
+ *      PAGE_HANDLE_INVALID
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+PageHandle
+OS_ReservedLargePageAlloc(int canSleep) // IN
+{
+   return PAGE_HANDLE_INVALID;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageFree --
+ *
+ *      Unreserve a run of pages previously reserved with
+ *      OS_ReservedLargePageAlloc().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+OS_ReservedLargePageFree(PageHandle handle) // IN: A valid page handle
+{
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_MapPageHandle --
+ *
+ *      Map a page handle (of a physical page previously reserved with
+ *      OS_ReservedPageAlloc()) into the kernel address space.
+ *
+ * Results:
+ *      On success: A mapping that can be passed to OS_Mapping2Addr() or
+ *                  OS_UnmapPage().
+ *      On failure: MAPPING_INVALID
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Mapping
+OS_MapPageHandle(PageHandle handle) // IN: A valid page handle
+{
+   page_t *pp = ((os_page *)handle)->pp;
+
+   return (Mapping)ppmapin(pp, PROT_READ | PROT_WRITE, (caddr_t)-1);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_Mapping2Addr --
+ *
+ *      Return the address of a page mapped with OS_MapPageHandle().
+ *
+ * Results:
+ *      The address.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void *
+OS_Mapping2Addr(Mapping mapping) // IN: A valid mapping
+{
+   return (void *)mapping;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OS_UnmapPage --
+ *
+ *      Unmap a page mapped with OS_MapPageHandle().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+OS_UnmapPage(Mapping mapping) // IN: A valid mapping
+{
+   ppmapout((caddr_t)mapping);
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -41,6 +41,7 @@
 typedef struct {
    kstat_named_t nPagesTarget;
    kstat_named_t nPages;
+   kstat_named_t nLargePages;
    kstat_named_t rateAlloc;
    kstat_named_t rateFree;
    kstat_named_t timer;
@@ -54,11 +55,18 @@ typedef struct {
    kstat_named_t unlockFail;
    kstat_named_t target;
    kstat_named_t targetFail;
+   kstat_named_t batchLock;
+   kstat_named_t batchLockFail;
+   kstat_named_t batchUnlock;
+   kstat_named_t batchUnlockFail;
    kstat_named_t primAlloc[BALLOON_PAGE_ALLOC_TYPES_NR];
    kstat_named_t primAllocFail[BALLOON_PAGE_ALLOC_TYPES_NR];
    kstat_named_t primFree;
    kstat_named_t primErrorPageAlloc;
    kstat_named_t primErrorPageFree;
+   kstat_named_t primLargeAlloc;
+   kstat_named_t primLargeAllocFail;
+   kstat_named_t primLargeFree;
 } BalloonKstats;
 
 /*
@@ -92,6 +100,7 @@ BalloonKstatUpdate(kstat_t *ksp, int rw)
    /* size info */
    bkp->nPagesTarget.value.ui32 = stats->nPagesTarget;
    bkp->nPages.value.ui32 = stats->nPages;
+   bkp->nLargePages.value.ui32 = stats->nLargePages;
 
    /* rate info */
    bkp->rateAlloc.value.ui32 = stats->rateAlloc;
@@ -109,6 +118,10 @@ BalloonKstatUpdate(kstat_t *ksp, int rw)
    bkp->unlockFail.value.ui32 = stats->unlockFail;
    bkp->target.value.ui32 = stats->target;
    bkp->targetFail.value.ui32 = stats->targetFail;
+   bkp->batchLock.value.ui32 = stats->batchLock;
+   bkp->batchLockFail.value.ui32 = stats->batchLockFail;
+   bkp->batchUnlock.value.ui32 = stats->batchUnlock;
+   bkp->batchUnlockFail.value.ui32 = stats->batchUnlockFail;
    for (i = 0; i < BALLOON_PAGE_ALLOC_TYPES_NR; i++) {
       bkp->primAlloc[i].value.ui32 = stats->primAlloc[i];
       bkp->primAllocFail[i].value.ui32 = stats->primAllocFail[i];
@@ -116,6 +129,9 @@ BalloonKstatUpdate(kstat_t *ksp, int rw)
    bkp->primFree.value.ui32 = stats->primFree;
    bkp->primErrorPageAlloc.value.ui32 = stats->primErrorPageAlloc;
    bkp->primErrorPageFree.value.ui32 = stats->primErrorPageFree;
+   bkp->primLargeAlloc.value.ui32 = stats->primLargeAlloc;
+   bkp->primLargeAllocFail.value.ui32 = stats->primLargeAllocFail;
+   bkp->primLargeFree.value.ui32 = stats->primLargeFree;
 
    return 0;
 }
@@ -139,6 +155,8 @@ BalloonKstatCreate(void)
    bkp = ksp->ks_data;
    kstat_named_init(&bkp->nPagesTarget, "targetPages", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->nPages, "currentPages", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->nLargePages, "currentLargePages",
+			KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->rateAlloc, "rateAlloc", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->rateFree, "rateFree", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->timer, "timer", KSTAT_DATA_UINT32);
@@ -152,6 +170,11 @@ BalloonKstatCreate(void)
    kstat_named_init(&bkp->unlockFail, "unlockFail", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->target, "target", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->targetFail, "targetFail", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->batchLock, "batchLock", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->batchLockFail, "batchLockFail", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->batchUnlock, "batchUnlock", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->batchUnlockFail, "batchUnlockFail",
+			KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->primAlloc[BALLOON_PAGE_ALLOC_NOSLEEP], 
 			"primAllocNoSleep", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->primAlloc[BALLOON_PAGE_ALLOC_CANSLEEP],
@@ -163,6 +186,10 @@ BalloonKstatCreate(void)
    kstat_named_init(&bkp->primFree, "primFree", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->primErrorPageAlloc, "errAlloc", KSTAT_DATA_UINT32);
    kstat_named_init(&bkp->primErrorPageFree, "errFree", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->primLargeAlloc, "primLargeAlloc", KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->primLargeAllocFail, "primLargeAllocFail",
+			KSTAT_DATA_UINT32);
+   kstat_named_init(&bkp->primLargeFree, "primLargeFree", KSTAT_DATA_UINT32);
 
    /* set update function to be run when kstats are read */
    ksp->ks_update = BalloonKstatUpdate;
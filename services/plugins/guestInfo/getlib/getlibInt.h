@@ -36,6 +36,9 @@
 Bool GuestInfoGetFqdn(int outBufLen, char fqdn[]);
 GuestDiskInfo *GuestInfoGetDiskInfoWiper(void);
 Bool GuestInfoGetNicInfo(NicInfoV3 *nicInfo);
+#if defined __linux__
+Bool GuestInfoGetNicInfoNetlink(NicInfoV3 *nicInfo);
+#endif
 
 GuestNicV3 *GuestInfoAddNicEntry(NicInfoV3 *nicInfo,                    // IN/OUT
                                  const char macAddress[NICINFO_MAC_LEN], // IN
@@ -0,0 +1,599 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/**
+ * @file guestInfoNetlink.c
+ *
+ * Linux NIC and routing information collector based on rtnetlink(7).
+ *
+ * The links, addresses and routes of the guest are each read with a single
+ * dump request on a netlink socket, instead of enumerating interfaces with
+ * ioctls and parsing the /proc/net route tables line by line. The same
+ * socket family is used to let callers know when any of these change.
+ */
+
+#if defined(__linux__)
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "vm_assert.h"
+#include "debug.h"
+#include "getlibInt.h"
+#include "str.h"
+#include "util.h"
+#include "xdrutil.h"
+
+
+/*
+ * Size of the buffer used to receive dump replies. The kernel does not put
+ * more than 32k in a single dump message; anything larger than a page is
+ * enough for it not to truncate messages.
+ */
+#define NETLINK_BUF_SIZE   (32 * 1024)
+
+/** State shared by the callbacks of a NIC info dump. */
+typedef struct NetlinkNicState {
+   NicInfoV3  *nicInfo;
+   /* Kernel interface index of each NIC in nicInfo. */
+   int         ifIndex[NICINFO_MAX_NICS];
+} NetlinkNicState;
+
+typedef Bool (*NetlinkMsgCb)(const struct nlmsghdr *nlh,
+                             NetlinkNicState *state);
+
+
+/*
+ ******************************************************************************
+ * NetlinkDump --                                                        */ /**
+ *
+ * @brief Sends a dump request on a netlink socket and feeds each message of
+ * the reply to a callback.
+ *
+ * @param[in]  fd       Netlink socket.
+ * @param[in]  type     Request type (RTM_GETLINK, RTM_GETADDR, ...).
+ * @param[in]  seq      Request sequence number.
+ * @param[in]  buf      Receive buffer of NETLINK_BUF_SIZE bytes.
+ * @param[in]  cb       Callback.
+ * @param[in]  state    Callback data.
+ *
+ * @retval TRUE  The whole dump was read.
+ * @retval FALSE Error, or the callback failed.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+NetlinkDump(int fd,
+            uint16 type,
+            uint32 seq,
+            char *buf,
+            NetlinkMsgCb cb,
+            NetlinkNicState *state)
+{
+   struct {
+      struct nlmsghdr nlh;
+      struct rtgenmsg gen;
+   } req;
+   struct sockaddr_nl kernel;
+
+   memset(&kernel, 0, sizeof kernel);
+   kernel.nl_family = AF_NETLINK;
+
+   memset(&req, 0, sizeof req);
+   req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof req.gen);
+   req.nlh.nlmsg_type = type;
+   req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+   req.nlh.nlmsg_seq = seq;
+   req.gen.rtgen_family = AF_UNSPEC;
+
+   if (sendto(fd, &req, req.nlh.nlmsg_len, 0,
+              (struct sockaddr *) &kernel, sizeof kernel) < 0) {
+      g_debug("%s: sendto failed: %s\n", __FUNCTION__, strerror(errno));
+      return FALSE;
+   }
+
+   for (;;) {
+      struct iovec iov = { buf, NETLINK_BUF_SIZE };
+      struct msghdr msg;
+      struct nlmsghdr *nlh;
+      ssize_t len;
+
+      memset(&msg, 0, sizeof msg);
+      msg.msg_name = &kernel;
+      msg.msg_namelen = sizeof kernel;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+
+      len = recvmsg(fd, &msg, 0);
+      if (len < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         g_debug("%s: recvmsg failed: %s\n", __FUNCTION__, strerror(errno));
+         return FALSE;
+      }
+      if (msg.msg_flags & MSG_TRUNC) {
+         g_debug("%s: truncated netlink message.\n", __FUNCTION__);
+         return FALSE;
+      }
+
+      for (nlh = (struct nlmsghdr *) buf;
+           NLMSG_OK(nlh, len);
+           nlh = NLMSG_NEXT(nlh, len)) {
+         if (nlh->nlmsg_seq != seq) {
+            continue;
+         }
+         if (nlh->nlmsg_type == NLMSG_DONE) {
+            return TRUE;
+         }
+         if (nlh->nlmsg_type == NLMSG_ERROR) {
+            const struct nlmsgerr *err = NLMSG_DATA(nlh);
+            g_debug("%s: dump %u failed: %s\n", __FUNCTION__, type,
+                    strerror(-err->error));
+            return FALSE;
+         }
+         if (!cb(nlh, state)) {
+            return FALSE;
+         }
+      }
+   }
+}
+
+
+/*
+ ******************************************************************************
+ * NetlinkParseAttrs --                                                  */ /**
+ *
+ * @brief Indexes the attributes following a netlink message header.
+ *
+ * @param[in]  rta      First attribute.
+ * @param[in]  len      Length of the attributes.
+ * @param[out] tb       Attributes by type, NULL for missing attributes.
+ * @param[in]  max      Largest attribute type to index.
+ *
+ ******************************************************************************
+ */
+
+static void
+NetlinkParseAttrs(struct rtattr *rta,
+                  int len,
+                  struct rtattr **tb,
+                  unsigned int max)
+{
+   memset(tb, 0, sizeof *tb * (max + 1));
+   for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+      if (rta->rta_type <= max) {
+         tb[rta->rta_type] = rta;
+      }
+   }
+}
+
+
+/*
+ ******************************************************************************
+ * NetlinkFindNic --                                                     */ /**
+ *
+ * @brief Finds the NIC with the given kernel interface index.
+ *
+ * @param[in]  state    Dump state.
+ * @param[in]  ifIndex  Kernel interface index.
+ *
+ * @return Offset of the NIC in the NIC list, -1 if not found.
+ *
+ ******************************************************************************
+ */
+
+static int
+NetlinkFindNic(const NetlinkNicState *state,
+               int ifIndex)
+{
+   u_int i;
+
+   for (i = 0; i < state->nicInfo->nics.nics_len; i++) {
+      if (state->ifIndex[i] == ifIndex) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+
+/*
+ ******************************************************************************
+ * NetlinkRecordLink --                                                  */ /**
+ *
+ * @brief RTM_NEWLINK callback. Adds Ethernet interfaces to the NIC list.
+ *
+ * @param[in]  nlh      Netlink message.
+ * @param[in]  state    Dump state.
+ *
+ * @return TRUE.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+NetlinkRecordLink(const struct nlmsghdr *nlh,
+                  NetlinkNicState *state)
+{
+   struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+   struct rtattr *tb[IFLA_MAX + 1];
+   char macAddress[NICINFO_MAC_LEN];
+   const unsigned char *hwAddr;
+   GuestNicV3 *nic;
+
+   if (nlh->nlmsg_type != RTM_NEWLINK || ifi->ifi_type != ARPHRD_ETHER) {
+      return TRUE;
+   }
+
+   NetlinkParseAttrs(IFLA_RTA(ifi), IFLA_PAYLOAD(nlh), tb, IFLA_MAX);
+
+   /*
+    * Interfaces being brought up may not have a MAC address yet; they will
+    * be picked up by a later scan.
+    */
+   if (tb[IFLA_ADDRESS] == NULL || RTA_PAYLOAD(tb[IFLA_ADDRESS]) != 6) {
+      return TRUE;
+   }
+
+   hwAddr = RTA_DATA(tb[IFLA_ADDRESS]);
+   Str_Sprintf(macAddress, sizeof macAddress,
+               "%02x:%02x:%02x:%02x:%02x:%02x",
+               hwAddr[0], hwAddr[1], hwAddr[2],
+               hwAddr[3], hwAddr[4], hwAddr[5]);
+
+   nic = GuestInfoAddNicEntry(state->nicInfo, macAddress, NULL, NULL);
+   if (nic != NULL) {
+      state->ifIndex[state->nicInfo->nics.nics_len - 1] = ifi->ifi_index;
+   }
+
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * NetlinkRecordAddress --                                               */ /**
+ *
+ * @brief RTM_NEWADDR callback. Adds IPv4 and IPv6 addresses to their NIC.
+ *
+ * @param[in]  nlh      Netlink message.
+ * @param[in]  state    Dump state.
+ *
+ * @return TRUE.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+NetlinkRecordAddress(const struct nlmsghdr *nlh,
+                     NetlinkNicState *state)
+{
+   struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+   struct rtattr *tb[IFA_MAX + 1];
+   struct rtattr *addr;
+   struct sockaddr_storage ss;
+   int nicIdx;
+
+   if (nlh->nlmsg_type != RTM_NEWADDR ||
+       (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)) {
+      return TRUE;
+   }
+
+   nicIdx = NetlinkFindNic(state, ifa->ifa_index);
+   if (nicIdx < 0) {
+      return TRUE;
+   }
+
+   NetlinkParseAttrs(IFA_RTA(ifa), IFA_PAYLOAD(nlh), tb, IFA_MAX);
+
+   /*
+    * For IPv4 point to point links IFA_ADDRESS is the peer's address, and
+    * IFA_LOCAL the interface's.
+    */
+   addr = tb[IFA_LOCAL] != NULL ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+   if (addr == NULL) {
+      return TRUE;
+   }
+
+   memset(&ss, 0, sizeof ss);
+   if (ifa->ifa_family == AF_INET) {
+      struct sockaddr_in *sin = (struct sockaddr_in *) &ss;
+
+      if (RTA_PAYLOAD(addr) != sizeof sin->sin_addr) {
+         return TRUE;
+      }
+      sin->sin_family = AF_INET;
+      memcpy(&sin->sin_addr, RTA_DATA(addr), sizeof sin->sin_addr);
+   } else {
+      struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &ss;
+
+      if (RTA_PAYLOAD(addr) != sizeof sin6->sin6_addr) {
+         return TRUE;
+      }
+      sin6->sin6_family = AF_INET6;
+      memcpy(&sin6->sin6_addr, RTA_DATA(addr), sizeof sin6->sin6_addr);
+   }
+
+   GuestInfoAddIpAddress(XDRUTIL_GETITEM(state->nicInfo, nics, nicIdx),
+                         (struct sockaddr *) &ss, ifa->ifa_prefixlen,
+                         NULL, NULL);
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * NetlinkRecordRoute --                                                 */ /**
+ *
+ * @brief RTM_NEWROUTE callback. Adds the unicast routes of the main routing
+ * table that go through one of the NICs to the route list.
+ *
+ * @param[in]  nlh      Netlink message.
+ * @param[in]  state    Dump state.
+ *
+ * @return TRUE.
+ *
+ ******************************************************************************
+ */
+
+static Bool
+NetlinkRecordRoute(const struct nlmsghdr *nlh,
+                   NetlinkNicState *state)
+{
+   NicInfoV3 *nicInfo = state->nicInfo;
+   struct rtmsg *rtm = NLMSG_DATA(nlh);
+   struct rtattr *tb[RTA_MAX + 1];
+   struct sockaddr_storage ss;
+   InetCidrRouteEntry *icre;
+   uint32 table;
+   size_t addrLen;
+   int nicIdx;
+
+   if (nlh->nlmsg_type != RTM_NEWROUTE ||
+       (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6) ||
+       rtm->rtm_type != RTN_UNICAST ||
+       (rtm->rtm_flags & RTM_F_CLONED) != 0) {
+      return TRUE;
+   }
+
+   NetlinkParseAttrs(RTM_RTA(rtm), RTM_PAYLOAD(nlh), tb, RTA_MAX);
+
+   table = rtm->rtm_table;
+   if (tb[RTA_TABLE] != NULL) {
+      table = *(uint32 *) RTA_DATA(tb[RTA_TABLE]);
+   }
+   if (table != RT_TABLE_MAIN || tb[RTA_OIF] == NULL) {
+      return TRUE;
+   }
+
+   nicIdx = NetlinkFindNic(state, *(int *) RTA_DATA(tb[RTA_OIF]));
+   if (nicIdx < 0) {
+      return TRUE;
+   }
+
+   /* Check to see if we're going above our limit. See bug 605821. */
+   if (nicInfo->routes.routes_len == NICINFO_MAX_ROUTES) {
+      return TRUE;
+   }
+
+   addrLen = rtm->rtm_family == AF_INET ? sizeof (struct in_addr) :
+                                          sizeof (struct in6_addr);
+
+   icre = XDRUTIL_ARRAYAPPEND(nicInfo, routes, 1);
+   ASSERT_MEM_ALLOC(icre);
+
+   /*
+    * Destination. The default route has no RTA_DST.
+    */
+   memset(&ss, 0, sizeof ss);
+   ss.ss_family = rtm->rtm_family;
+   if (tb[RTA_DST] != NULL && RTA_PAYLOAD(tb[RTA_DST]) == addrLen) {
+      if (rtm->rtm_family == AF_INET) {
+         memcpy(&((struct sockaddr_in *) &ss)->sin_addr,
+                RTA_DATA(tb[RTA_DST]), addrLen);
+      } else {
+         memcpy(&((struct sockaddr_in6 *) &ss)->sin6_addr,
+                RTA_DATA(tb[RTA_DST]), addrLen);
+      }
+   }
+   GuestInfoSockaddrToTypedIpAddress((struct sockaddr *) &ss,
+                                     &icre->inetCidrRouteDest);
+   icre->inetCidrRoutePfxLen = rtm->rtm_dst_len;
+
+   /*
+    * Gateways are optional (ex: one can bind a route to an interface w/o
+    * specifying a next hop address).
+    */
+   if (tb[RTA_GATEWAY] != NULL && RTA_PAYLOAD(tb[RTA_GATEWAY]) == addrLen) {
+      TypedIpAddress *ip = Util_SafeCalloc(1, sizeof *ip);
+
+      memset(&ss, 0, sizeof ss);
+      ss.ss_family = rtm->rtm_family;
+      if (rtm->rtm_family == AF_INET) {
+         memcpy(&((struct sockaddr_in *) &ss)->sin_addr,
+                RTA_DATA(tb[RTA_GATEWAY]), addrLen);
+      } else {
+         memcpy(&((struct sockaddr_in6 *) &ss)->sin6_addr,
+                RTA_DATA(tb[RTA_GATEWAY]), addrLen);
+      }
+      GuestInfoSockaddrToTypedIpAddress((struct sockaddr *) &ss, ip);
+      icre->inetCidrRouteNextHop = ip;
+   }
+
+   /*
+    * Interface, metric.
+    */
+   icre->inetCidrRouteIfIndex = nicIdx;
+   if (tb[RTA_PRIORITY] != NULL) {
+      icre->inetCidrRouteMetric = *(uint32 *) RTA_DATA(tb[RTA_PRIORITY]);
+   }
+
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoGetNicInfoNetlink --                                         */ /**
+ *
+ * @brief Collects the guest's Ethernet NICs, their addresses, and the
+ * routes going through them with three rtnetlink dumps.
+ *
+ * @param[out] nicInfo  NicInfoV3 container.
+ *
+ * @note Resolver settings are not collected by this function.
+ *
+ * @retval TRUE  Values collected, attached to @a nicInfo.
+ * @retval FALSE Netlink is not available or failed. @a nicInfo may be
+ *               partially filled in.
+ *
+ ******************************************************************************
+ */
+
+Bool
+GuestInfoGetNicInfoNetlink(NicInfoV3 *nicInfo)  // OUT
+{
+   NetlinkNicState state;
+   Bool ret = FALSE;
+   char *buf;
+   int fd;
+
+   fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+   if (fd < 0) {
+      g_debug("%s: cannot open netlink socket: %s\n", __FUNCTION__,
+              strerror(errno));
+      return FALSE;
+   }
+
+   buf = Util_SafeMalloc(NETLINK_BUF_SIZE);
+   memset(&state, 0, sizeof state);
+   state.nicInfo = nicInfo;
+
+   if (NetlinkDump(fd, RTM_GETLINK, 1, buf, NetlinkRecordLink, &state) &&
+       NetlinkDump(fd, RTM_GETADDR, 2, buf, NetlinkRecordAddress, &state) &&
+       NetlinkDump(fd, RTM_GETROUTE, 3, buf, NetlinkRecordRoute, &state)) {
+      ret = TRUE;
+   }
+
+   if (nicInfo->routes.routes_len == NICINFO_MAX_ROUTES) {
+      g_message("%s: route limit (%d) reached, skipping overflow.",
+                __FUNCTION__, NICINFO_MAX_ROUTES);
+   }
+
+   free(buf);
+   close(fd);
+   return ret;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfo_OpenNicMonitor --                                           */ /**
+ *
+ * @brief Opens a socket that becomes readable when links, addresses or
+ * routes of the guest change.
+ *
+ * @return The socket, to be read with GuestInfo_ReadNicMonitor, or -1 if
+ *         change notifications are not available.
+ *
+ ******************************************************************************
+ */
+
+int
+GuestInfo_OpenNicMonitor(void)
+{
+   struct sockaddr_nl addr;
+   int fd;
+
+   fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+   if (fd < 0) {
+      g_debug("%s: cannot open netlink socket: %s\n", __FUNCTION__,
+              strerror(errno));
+      return -1;
+   }
+
+   memset(&addr, 0, sizeof addr);
+   addr.nl_family = AF_NETLINK;
+   addr.nl_groups = RTMGRP_LINK |
+                    RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE |
+                    RTMGRP_IPV6_IFADDR | RTMGRP_IPV6_ROUTE;
+
+   if (bind(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+      g_debug("%s: cannot bind netlink socket: %s\n", __FUNCTION__,
+              strerror(errno));
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfo_ReadNicMonitor --                                           */ /**
+ *
+ * @brief Consumes the pending notifications of a socket returned by
+ * GuestInfo_OpenNicMonitor. A single change usually generates several
+ * notifications; they are all read, and only reported once.
+ *
+ * @param[in]  fd       Monitor socket.
+ * @param[out] changed  Whether anything changed.
+ *
+ * @retval TRUE  Success.
+ * @retval FALSE The socket is not usable anymore and should be closed.
+ *
+ ******************************************************************************
+ */
+
+Bool
+GuestInfo_ReadNicMonitor(int fd,
+                         Bool *changed)
+{
+   char buf[4096];
+   ssize_t len;
+
+   ASSERT(changed);
+   *changed = FALSE;
+
+   while ((len = recv(fd, buf, sizeof buf, MSG_DONTWAIT)) > 0) {
+      *changed = TRUE;
+   }
+
+   if (len < 0 && errno == ENOBUFS) {
+      /* Notifications were dropped, which still means something changed. */
+      *changed = TRUE;
+   } else if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+      g_debug("%s: error reading netlink socket: %s\n", __FUNCTION__,
+              len == 0 ? "EOF" : strerror(errno));
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+#endif // if defined(__linux__)
@@ -121,9 +121,11 @@
 #ifndef NO_DNET
 static void RecordNetworkAddress(GuestNicV3 *nic, const struct addr *addr);
 static int ReadInterfaceDetails(const struct intf_entry *entry, void *arg);
+static Bool RecordRoutingInfo(NicInfoV3 *nicInfo);
+#endif
+#if !defined(NO_DNET) || defined(__linux__)
 static Bool RecordResolverInfo(NicInfoV3 *nicInfo);
 static void RecordResolverNS(DnsConfigInfo *dnsConfigInfo);
-static Bool RecordRoutingInfo(NicInfoV3 *nicInfo);
 #endif
 
 
@@ -164,7 +166,23 @@ GuestInfoGetNicInfo(NicInfoV3 *nicInfo) // OUT
 {
 #ifndef NO_DNET
    intf_t *intf;
+#endif
 
+#if defined(__linux__)
+   /*
+    * rtnetlink gets all the links, addresses and routes in three requests,
+    * so prefer it to enumerating the interfaces and parsing /proc.
+    */
+   if (GuestInfoGetNicInfoNetlink(nicInfo)) {
+      return RecordResolverInfo(nicInfo);
+   }
+
+   g_debug("Error collecting NIC info from netlink, falling back.\n");
+   VMX_XDR_FREE(xdr_NicInfoV3, nicInfo);
+   memset(nicInfo, 0, sizeof *nicInfo);
+#endif
+
+#ifndef NO_DNET
    /* Get a handle to read the network interface configuration details. */
    if ((intf = intf_open()) == NULL) {
       g_debug("Error, failed NULL result from intf_open()\n");
@@ -317,6 +335,10 @@ ReadInterfaceDetails(const struct intf_entry *entry,  // IN: current interface e
 }
 
 
+#endif // ifndef NO_DNET
+
+
+#if !defined(NO_DNET) || defined(__linux__)
 /*
  ******************************************************************************
  * RecordResolverInfo --                                                 */ /**
@@ -487,6 +509,10 @@ RecordResolverNS(DnsConfigInfo *dnsConfigInfo) // IN
    }
 #endif                                  // if !defined RESOLVER_IPV6_GETSERVERS
 }
+#endif // if !defined(NO_DNET) || defined(__linux__)
+
+
+#ifndef NO_DNET
 
 
 #ifdef USE_SLASH_PROC
@@ -35,5 +35,8 @@ extern int guestInfoPollInterval;
 Bool
 GuestInfo_PerfMon(struct GuestMemInfo *vmStats);
 
+void
+GuestInfo_PerfMonShutdown(void);
+
 #endif /* _GUESTINFOINT_H_ */
 
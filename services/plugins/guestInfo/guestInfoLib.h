@@ -38,6 +38,15 @@ GuestInfo_GetNicInfo(NicInfoV3 **nicInfo);
 void
 GuestInfo_FreeNicInfo(NicInfoV3 *nicInfo);
 
+#if defined __linux__
+int
+GuestInfo_OpenNicMonitor(void);
+
+Bool
+GuestInfo_ReadNicMonitor(int fd,
+                         Bool *changed);
+#endif
+
 GuestDiskInfo *
 GuestInfo_GetDiskInfo(void);
 
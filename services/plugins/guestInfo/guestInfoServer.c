@@ -71,6 +71,24 @@ VM_EMBED_VERSION(VMTOOLSD_VERSION_STRING);
  */
 #define GUESTINFO_TIME_INTERVAL_MSEC 30000
 
+/**
+ * Default disk info interval is 2 minutes (in seconds).
+ */
+#define GUESTINFO_DISKINFO_INTERVAL_SEC 120
+
+/**
+ * Default NIC info interval when change notifications are available is
+ * 2 minutes (in seconds). Notifications do not cover everything reported
+ * with the NIC info (e.g. DNS settings), so it is still polled now and then.
+ */
+#define GUESTINFO_NICINFO_INTERVAL_SEC 120
+
+/**
+ * Delay between a change notification and the gathering of the changed
+ * information (in milliseconds).
+ */
+#define GUESTINFO_CHANGE_DELAY_MSEC 1000
+
 #define GUESTINFO_DEFAULT_DELIMITER ' '
 
 /*
@@ -102,6 +120,22 @@ static GSource *gatherTimeoutSource = NULL;
 /* Local cache of the guest information that was last sent to vmx. */
 static GuestInfoCache gInfoCache;
 
+/* OS names, which do not change while the service runs. */
+static char *gOSName = NULL;
+static char *gOSNameFull = NULL;
+
+/**
+ * Pending one shot source that gathers changed information.
+ */
+static GSource *changedTimeoutSource = NULL;
+
+#if defined(linux)
+/**
+ * Source watching for network configuration changes.
+ */
+static GSource *nicMonitorSource = NULL;
+#endif
+
 /*
  * A boolean flag that specifies whether the state of the VM was
  * changed since the last time guest info was sent to the VMX.
@@ -119,11 +153,58 @@ static Bool vmResumed;
 static Bool GuestInfoUpdateVmdb(ToolsAppCtx *ctx, GuestInfoType infoType, void *info);
 static Bool SetGuestInfo(ToolsAppCtx *ctx, GuestInfoType key,
                          const char *value);
-static void SendUptime(ToolsAppCtx *ctx);
+static gboolean SendUptime(ToolsAppCtx *ctx);
 static Bool DiskInfoChanged(const GuestDiskInfo *diskInfo);
 static void GuestInfoClearCache(void);
 static GuestNicList *NicInfoV3ToV2(const NicInfoV3 *infoV3);
 static void TweakGatherLoop(ToolsAppCtx *ctx, gboolean enable);
+static gboolean GuestInfoCollectOS(ToolsAppCtx *ctx);
+static gboolean GuestInfoCollectDnsName(ToolsAppCtx *ctx);
+static gboolean GuestInfoCollectDisk(ToolsAppCtx *ctx);
+static gboolean GuestInfoCollectNic(ToolsAppCtx *ctx);
+#if defined(_WIN32) || defined(linux)
+static gboolean GuestInfoCollectPerf(ToolsAppCtx *ctx);
+#endif
+
+
+/*
+ * Guest information is gathered by independent collectors. Each collector
+ * runs every few ticks of the poll loop, or only when explicitly requested
+ * (ticks == 0), and is also run at the next opportunity after being marked
+ * dirty by a change notification or a reset of the cache. A collector that
+ * fails to send its data stays dirty, so that it is retried at the next tick.
+ */
+
+typedef enum {
+   GUESTINFO_COLLECTOR_OS,
+   GUESTINFO_COLLECTOR_DNSNAME,
+   GUESTINFO_COLLECTOR_DISK,
+   GUESTINFO_COLLECTOR_NIC,
+   GUESTINFO_COLLECTOR_UPTIME,
+#if defined(_WIN32) || defined(linux)
+   GUESTINFO_COLLECTOR_PERF,
+#endif
+   GUESTINFO_COLLECTOR_MAX
+} GuestInfoCollectorId;
+
+typedef struct GuestInfoCollector {
+   const char  *name;
+   gboolean   (*collect)(ToolsAppCtx *ctx);
+   guint        ticks;      // Poll loop ticks between two runs
+   guint        countdown;  // Ticks left until the next run
+   gboolean     dirty;      // Run at the next opportunity
+} GuestInfoCollector;
+
+static GuestInfoCollector gCollectors[GUESTINFO_COLLECTOR_MAX] = {
+   { "os",      GuestInfoCollectOS,      0, 0, TRUE },
+   { "dnsname", GuestInfoCollectDnsName, 1, 0, TRUE },
+   { "disk",    GuestInfoCollectDisk,    1, 0, TRUE },
+   { "nic",     GuestInfoCollectNic,     1, 0, TRUE },
+   { "uptime",  SendUptime,              1, 0, TRUE },
+#if defined(_WIN32) || defined(linux)
+   { "perf",    GuestInfoCollectPerf,    1, 0, TRUE },
+#endif
+};
 
 
 /*
@@ -214,33 +295,22 @@ GuestInfoVMSupport(RpcInData *data)
 
 /*
  ******************************************************************************
- * GuestInfoGather --                                                    */ /**
+ * GuestInfoCollectOS --                                                 */ /**
  *
- * Collects all the desired guest information and updates the VMX.
+ * Sends the tools version and the OS names. These do not change while the
+ * service is running, so they are only queried once.
  *
- * @param[in]  data     The application context.
+ * @param[in]  ctx      The application context.
  *
- * @return TRUE to indicate that the timer should be rescheduled.
+ * @return FALSE if the data could not be gathered or sent.
  *
  ******************************************************************************
  */
 
 static gboolean
-GuestInfoGather(gpointer data)
+GuestInfoCollectOS(ToolsAppCtx *ctx)
 {
-   char name[256];  // Size is derived from the SUS2 specification
-                    // "Host names are limited to 255 bytes"
-   char *osString = NULL;
-   gboolean disableQueryDiskInfo;
-   NicInfoV3 *nicInfo = NULL;
-   GuestDiskInfo *diskInfo = NULL;
-#if defined(_WIN32) || defined(linux)
-   GuestMemInfo vmStats = {0};
-   gboolean perfmonEnabled;
-#endif
-   ToolsAppCtx *ctx = data;
-
-   g_debug("Entered guest info gather.\n");
+   gboolean success = TRUE;
 
    /* Send tools version. */
    if (!GuestInfoUpdateVmdb(ctx, INFO_BUILD_NUMBER, BUILD_NUMBER)) {
@@ -252,53 +322,121 @@ GuestInfoGather(gpointer data)
       g_warning("Failed to update VMDB with tools version.\n");
    }
 
-   /* Gather all the relevant guest information. */
-   osString = Hostinfo_GetOSName();
-   if (osString == NULL) {
+   if (gOSNameFull == NULL) {
+      gOSNameFull = Hostinfo_GetOSName();
+   }
+   if (gOSNameFull == NULL) {
       g_warning("Failed to get OS info.\n");
-   } else {
-      if (!GuestInfoUpdateVmdb(ctx, INFO_OS_NAME_FULL, osString)) {
-         g_warning("Failed to update VMDB\n");
-      }
+      success = FALSE;
+   } else if (!GuestInfoUpdateVmdb(ctx, INFO_OS_NAME_FULL, gOSNameFull)) {
+      g_warning("Failed to update VMDB\n");
+      success = FALSE;
    }
-   free(osString);
 
-   osString = Hostinfo_GetOSGuestString();
-   if (osString == NULL) {
+   if (gOSName == NULL) {
+      gOSName = Hostinfo_GetOSGuestString();
+   }
+   if (gOSName == NULL) {
       g_warning("Failed to get OS info.\n");
-   } else {
-      if (!GuestInfoUpdateVmdb(ctx, INFO_OS_NAME, osString)) {
-         g_warning("Failed to update VMDB\n");
-      }
+      success = FALSE;
+   } else if (!GuestInfoUpdateVmdb(ctx, INFO_OS_NAME, gOSName)) {
+      g_warning("Failed to update VMDB\n");
+      success = FALSE;
    }
-   free(osString);
-
-   disableQueryDiskInfo =
-      g_key_file_get_boolean(ctx->config, CONFGROUPNAME_GUESTINFO,
-                             CONFNAME_GUESTINFO_DISABLEQUERYDISKINFO, NULL);
-   if (!disableQueryDiskInfo) {
-      if ((diskInfo = GuestInfo_GetDiskInfo()) == NULL) {
-         g_warning("Failed to get disk info.\n");
-      } else {
-         if (GuestInfoUpdateVmdb(ctx, INFO_DISK_FREE_SPACE, diskInfo)) {
-            GuestInfo_FreeDiskInfo(gInfoCache.diskInfo);
-            gInfoCache.diskInfo = diskInfo;
-         } else {
-            g_warning("Failed to update VMDB\n.");
-            GuestInfo_FreeDiskInfo(diskInfo);
-         }
-      }
+
+   return success;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoCollectDisk --                                               */ /**
+ *
+ * Gathers disk information and sends it if it changed.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ * @return FALSE if the data could not be gathered or sent.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoCollectDisk(ToolsAppCtx *ctx)
+{
+   GuestDiskInfo *diskInfo;
+
+   if (g_key_file_get_boolean(ctx->config, CONFGROUPNAME_GUESTINFO,
+                              CONFNAME_GUESTINFO_DISABLEQUERYDISKINFO, NULL)) {
+      return TRUE;
    }
 
+   if ((diskInfo = GuestInfo_GetDiskInfo()) == NULL) {
+      g_warning("Failed to get disk info.\n");
+      return FALSE;
+   } else if (GuestInfoUpdateVmdb(ctx, INFO_DISK_FREE_SPACE, diskInfo)) {
+      GuestInfo_FreeDiskInfo(gInfoCache.diskInfo);
+      gInfoCache.diskInfo = diskInfo;
+      return TRUE;
+   } else {
+      g_warning("Failed to update VMDB\n.");
+      GuestInfo_FreeDiskInfo(diskInfo);
+      return FALSE;
+   }
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoCollectDnsName --                                            */ /**
+ *
+ * Sends the host name of the guest if it changed.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ * @return FALSE if the data could not be gathered or sent.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoCollectDnsName(ToolsAppCtx *ctx)
+{
+   char name[256];  // Size is derived from the SUS2 specification
+                    // "Host names are limited to 255 bytes"
+
    if (!System_GetNodeName(sizeof name, name)) {
       g_warning("Failed to get netbios name.\n");
+      return FALSE;
    } else if (!GuestInfoUpdateVmdb(ctx, INFO_DNS_NAME, name)) {
       g_warning("Failed to update VMDB.\n");
+      return FALSE;
    }
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoCollectNic --                                                */ /**
+ *
+ * Gathers NIC information and sends it if it changed.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ * @return FALSE if the data could not be gathered or sent.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoCollectNic(ToolsAppCtx *ctx)
+{
+   NicInfoV3 *nicInfo = NULL;
 
-   /* Get NIC information. */
    if (!GuestInfo_GetNicInfo(&nicInfo)) {
       g_warning("Failed to get nic info.\n");
+      return FALSE;
    } else if (GuestInfo_IsEqual_NicInfoV3(nicInfo, gInfoCache.nicInfo)) {
       g_debug("Nic info not changed.\n");
       GuestInfo_FreeNicInfo(nicInfo);
@@ -312,34 +450,326 @@ GuestInfoGather(gpointer data)
    } else {
       g_warning("Failed to update VMDB.\n");
       GuestInfo_FreeNicInfo(nicInfo);
+      return FALSE;
    }
+   return TRUE;
+}
 
-   /* Send the uptime to VMX so that it can detect soft resets. */
-   SendUptime(ctx);
 
 #if defined(_WIN32) || defined(linux)
-   /* Send the vmstats to the VMX. */
-   perfmonEnabled = !g_key_file_get_boolean(ctx->config,
-                                            CONFGROUPNAME_GUESTINFO,
-                                            CONFNAME_GUESTINFO_DISABLEPERFMON,
-                                            NULL);
-
-   if (perfmonEnabled) {
-      if (!GuestInfo_PerfMon(&vmStats)) {
-         g_warning("Failed to get vmstats.\n");
-      } else {
-         vmStats.version = 1;
-         if (!GuestInfoUpdateVmdb(ctx, INFO_MEMORY, &vmStats)) {
-            g_warning("Failed to send vmstats.\n");
+/*
+ ******************************************************************************
+ * GuestInfoCollectPerf --                                               */ /**
+ *
+ * Sends the vmstats to the VMX.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ * @return FALSE if the data could not be gathered or sent.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoCollectPerf(ToolsAppCtx *ctx)
+{
+   GuestMemInfo vmStats = {0};
+
+   if (g_key_file_get_boolean(ctx->config, CONFGROUPNAME_GUESTINFO,
+                              CONFNAME_GUESTINFO_DISABLEPERFMON, NULL)) {
+      return TRUE;
+   }
+
+   if (!GuestInfo_PerfMon(&vmStats)) {
+      g_warning("Failed to get vmstats.\n");
+      return FALSE;
+   }
+
+   vmStats.version = 1;
+   if (!GuestInfoUpdateVmdb(ctx, INFO_MEMORY, &vmStats)) {
+      g_warning("Failed to send vmstats.\n");
+      return FALSE;
+   }
+   return TRUE;
+}
+#endif
+
+
+/*
+ ******************************************************************************
+ * GuestInfoRunCollectors --                                             */ /**
+ *
+ * Runs the collectors that are due.
+ *
+ * @param[in]  ctx      The application context.
+ * @param[in]  tick     Whether this is a poll loop tick. If FALSE, only the
+ *                      collectors marked dirty are run.
+ *
+ ******************************************************************************
+ */
+
+static void
+GuestInfoRunCollectors(ToolsAppCtx *ctx,
+                       gboolean tick)
+{
+   size_t i;
+
+   for (i = 0; i < ARRAYSIZE(gCollectors); i++) {
+      GuestInfoCollector *c = &gCollectors[i];
+      gboolean due = c->dirty;
+
+      if (tick && c->ticks > 0) {
+         if (c->countdown > 0) {
+            c->countdown--;
+         }
+         due = due || c->countdown == 0;
+      }
+
+      if (due) {
+         g_debug("Running collector %s.\n", c->name);
+         c->countdown = c->ticks;
+         c->dirty = !c->collect(ctx);
+         if (c->dirty) {
+            g_debug("Collector %s failed, will retry.\n", c->name);
          }
       }
    }
-#endif
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoGather --                                                    */ /**
+ *
+ * Poll loop callback. Runs the collectors whose interval has elapsed or that
+ * have been notified of a change since the last run, so each tick only does
+ * the work for what may have changed. The collectors only send data that is
+ * different from what was last sent to the VMX.
+ *
+ * @param[in]  data     The application context.
+ *
+ * @return TRUE to indicate that the timer should be rescheduled.
+ *
+ ******************************************************************************
+ */
 
+static gboolean
+GuestInfoGather(gpointer data)
+{
+   g_debug("Entered guest info gather.\n");
+   GuestInfoRunCollectors(data, TRUE);
    return TRUE;
 }
 
 
+/*
+ ******************************************************************************
+ * GuestInfoGatherChanged --                                             */ /**
+ *
+ * One shot callback that runs the collectors that were notified of a change,
+ * so that the change reaches the VMX before the next poll.
+ *
+ * @param[in]  data     The application context.
+ *
+ * @return FALSE.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoGatherChanged(gpointer data)
+{
+   g_debug("Gathering changed guest info.\n");
+   changedTimeoutSource = NULL;
+   GuestInfoRunCollectors(data, FALSE);
+   return FALSE;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoCollectorChanged --                                          */ /**
+ *
+ * Marks a collector as dirty, and schedules it to run shortly if the poll
+ * loop is running. Notifications usually arrive in bursts, so the collector
+ * runs once after GUESTINFO_CHANGE_DELAY_MSEC.
+ *
+ * @param[in]  ctx      The application context.
+ * @param[in]  id       The collector.
+ *
+ ******************************************************************************
+ */
+
+static void
+GuestInfoCollectorChanged(ToolsAppCtx *ctx,
+                          GuestInfoCollectorId id)
+{
+   gCollectors[id].dirty = TRUE;
+
+   if (guestInfoPollInterval != 0 && changedTimeoutSource == NULL) {
+      changedTimeoutSource = g_timeout_source_new(GUESTINFO_CHANGE_DELAY_MSEC);
+      VMTOOLSAPP_ATTACH_SOURCE(ctx, changedTimeoutSource,
+                               GuestInfoGatherChanged, ctx, NULL);
+      g_source_unref(changedTimeoutSource);
+   }
+}
+
+
+#if defined(linux)
+/*
+ ******************************************************************************
+ * GuestInfoNicMonitorCb --                                              */ /**
+ *
+ * Handles notifications of link, address and route changes by scheduling
+ * a NIC info update.
+ *
+ * @param[in]  chan     The monitor channel.
+ * @param[in]  cond     Unused.
+ * @param[in]  data     The application context.
+ *
+ * @return Whether to keep monitoring.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoNicMonitorCb(GIOChannel *chan,
+                      GIOCondition cond,
+                      gpointer data)
+{
+   Bool changed;
+
+   if (!GuestInfo_ReadNicMonitor(g_io_channel_unix_get_fd(chan), &changed)) {
+      g_warning("Error reading NIC monitor, NIC info will be polled.\n");
+      nicMonitorSource = NULL;
+      gCollectors[GUESTINFO_COLLECTOR_NIC].ticks = 1;
+      gCollectors[GUESTINFO_COLLECTOR_NIC].countdown = 1;
+      return FALSE;
+   }
+
+   if (changed) {
+      GuestInfoCollectorChanged(data, GUESTINFO_COLLECTOR_NIC);
+   }
+   return TRUE;
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoStartNicMonitor --                                           */ /**
+ *
+ * Subscribes to notifications of link, address and route changes.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ * @return Whether change notifications are available.
+ *
+ ******************************************************************************
+ */
+
+static gboolean
+GuestInfoStartNicMonitor(ToolsAppCtx *ctx)
+{
+   GIOChannel *chan;
+   int fd;
+
+   fd = GuestInfo_OpenNicMonitor();
+   if (fd < 0) {
+      return FALSE;
+   }
+
+   chan = g_io_channel_unix_new(fd);
+   g_io_channel_set_close_on_unref(chan, TRUE);
+   nicMonitorSource = g_io_create_watch(chan, G_IO_IN);
+   VMTOOLSAPP_ATTACH_SOURCE(ctx, nicMonitorSource, GuestInfoNicMonitorCb,
+                            ctx, NULL);
+   g_source_unref(nicMonitorSource);
+   g_io_channel_unref(chan);
+
+   return TRUE;
+}
+#endif
+
+
+/*
+ ******************************************************************************
+ * GuestInfoGetInterval --                                               */ /**
+ *
+ * Reads a collector interval from the config file, and converts it to a
+ * number of poll loop ticks.
+ *
+ * @param[in]  ctx         The application context.
+ * @param[in]  key         Config key.
+ * @param[in]  defaultSec  Default interval, in seconds.
+ *
+ * @return Number of ticks between two runs, at least 1.
+ *
+ ******************************************************************************
+ */
+
+static guint
+GuestInfoGetInterval(ToolsAppCtx *ctx,
+                     const gchar *key,
+                     gint defaultSec)
+{
+   GError *gError = NULL;
+   gint intervalSec = defaultSec;
+   gint64 ticks;
+
+   if (g_key_file_has_key(ctx->config, CONFGROUPNAME_GUESTINFO, key, NULL)) {
+      intervalSec = g_key_file_get_integer(ctx->config, CONFGROUPNAME_GUESTINFO,
+                                           key, &gError);
+      if (intervalSec < 0 || gError) {
+         g_warning("Invalid %s.%s value.  Using default.\n",
+                   CONFGROUPNAME_GUESTINFO, key);
+         intervalSec = defaultSec;
+      }
+      g_clear_error(&gError);
+   }
+
+   ASSERT(guestInfoPollInterval > 0);
+   ticks = ((gint64) intervalSec * 1000 + guestInfoPollInterval / 2) /
+           guestInfoPollInterval;
+   return (guint) CLAMP(ticks, 1, G_MAXUINT);
+}
+
+
+/*
+ ******************************************************************************
+ * GuestInfoConfigureCollectors --                                       */ /**
+ *
+ * Sets the collector intervals from the config file.
+ *
+ * @param[in]  ctx      The application context.
+ *
+ ******************************************************************************
+ */
+
+static void
+GuestInfoConfigureCollectors(ToolsAppCtx *ctx)
+{
+   GuestInfoCollector *disk = &gCollectors[GUESTINFO_COLLECTOR_DISK];
+   GuestInfoCollector *nic = &gCollectors[GUESTINFO_COLLECTOR_NIC];
+
+   /* Keep the current schedule while the poll loop is off. */
+   if (guestInfoPollInterval == 0) {
+      return;
+   }
+
+   disk->ticks = GuestInfoGetInterval(ctx, CONFNAME_GUESTINFO_DISKINFOINTERVAL,
+                                      GUESTINFO_DISKINFO_INTERVAL_SEC);
+   disk->countdown = MIN(disk->countdown, disk->ticks);
+
+#if defined(linux)
+   if (nicMonitorSource != NULL) {
+      nic->ticks = GuestInfoGetInterval(ctx, CONFNAME_GUESTINFO_NICINFOINTERVAL,
+                                        GUESTINFO_NICINFO_INTERVAL_SEC);
+      nic->countdown = MIN(nic->countdown, nic->ticks);
+   }
+#endif
+}
+
+
 /*
  ******************************************************************************
  * GuestInfoConvertNicInfoToNicInfoV1 --                                 */ /**
@@ -732,16 +1162,21 @@ nicinfo_fsm:
  *
  * @param[in]  ctx      The application context.
  *
+ * @return Whether the uptime was sent.
+ *
  ******************************************************************************
  */
 
-static void
+static gboolean
 SendUptime(ToolsAppCtx *ctx)
 {
    gchar *uptime = g_strdup_printf("%"FMT64"u", System_Uptime());
+   gboolean success;
+
    g_debug("Setting guest uptime to '%s'\n", uptime);
-   GuestInfoUpdateVmdb(ctx, INFO_UPTIME, uptime);
+   success = GuestInfoUpdateVmdb(ctx, INFO_UPTIME, uptime);
    g_free(uptime);
+   return success;
 }
 
 
@@ -1040,7 +1475,7 @@ TweakGatherLoop(ToolsAppCtx *ctx,
     */
    if (guestInfoPollInterval == pollInterval) {
       ASSERT(pollInterval || gatherTimeoutSource == NULL);
-      return;
+      goto exit;
    }
 
    /*
@@ -1063,8 +1498,15 @@ TweakGatherLoop(ToolsAppCtx *ctx,
       g_source_unref(gatherTimeoutSource);
    } else {
       g_info("Poll loop disabled.\n");
+
+      if (changedTimeoutSource != NULL) {
+         g_source_destroy(changedTimeoutSource);
+         changedTimeoutSource = NULL;
+      }
    }
 
+exit:
+   GuestInfoConfigureCollectors(ctx);
    g_clear_error(&gError);
 }
 
@@ -1142,11 +1584,32 @@ GuestInfoServerShutdown(gpointer src,
 {
    GuestInfoClearCache();
 
+   free(gOSName);
+   gOSName = NULL;
+   free(gOSNameFull);
+   gOSNameFull = NULL;
+
+#if defined(linux)
+   GuestInfo_PerfMonShutdown();
+#endif
+
    if (gatherTimeoutSource != NULL) {
       g_source_destroy(gatherTimeoutSource);
       gatherTimeoutSource = NULL;
    }
 
+   if (changedTimeoutSource != NULL) {
+      g_source_destroy(changedTimeoutSource);
+      changedTimeoutSource = NULL;
+   }
+
+#if defined(linux)
+   if (nicMonitorSource != NULL) {
+      g_source_destroy(nicMonitorSource);
+      nicMonitorSource = NULL;
+   }
+#endif
+
 #ifdef _WIN32
    NetUtil_FreeIpHlpApiDll();
 #endif
@@ -1158,7 +1621,8 @@ GuestInfoServerShutdown(gpointer src,
  * GuestInfoServerReset --                                               */ /**
  *
  * Reset callback - sets the internal flag that says we should purge all
- * caches.
+ * caches, and makes all collectors run on the next poll so that the VMX
+ * gets all the information again.
  *
  * @param[in]  src      The source object.
  * @param[in]  ctx      Unused.
@@ -1172,7 +1636,12 @@ GuestInfoServerReset(gpointer src,
                      ToolsAppCtx *ctx,
                      gpointer data)
 {
+   size_t i;
+
    vmResumed = TRUE;
+   for (i = 0; i < ARRAYSIZE(gCollectors); i++) {
+      gCollectors[i].dirty = TRUE;
+   }
 }
 
 
@@ -1318,6 +1787,13 @@ ToolsOnLoad(ToolsAppCtx *ctx)
       memset(&gInfoCache, 0, sizeof gInfoCache);
       vmResumed = FALSE;
 
+#if defined(linux)
+      /*
+       * Poll NIC info less often if we get told about changes.
+       */
+      GuestInfoStartNicMonitor(ctx);
+#endif
+
       /*
        * Set up the GuestInfoGather loop.
        */
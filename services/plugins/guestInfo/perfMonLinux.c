@@ -19,134 +19,331 @@
 /*
  * This file gathers the virtual memory stats from Linux guest to be
  * passed on to the vmx.
+ *
+ * The stats come from /proc/meminfo and /proc/vmstat (or the "page" and
+ * "swap" lines of /proc/stat on kernels without /proc/vmstat). The files
+ * are kept open between samples and re-read with pread() into a fixed
+ * buffer, and every file is parsed in a single pass. The swap and IO
+ * rates are computed from the difference between two consecutive samples,
+ * so they describe the last poll interval rather than the average since
+ * boot.
  */
 
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <sys/wait.h>
-#include <string.h>
 
 #include "vmware.h"
 #include "guestInfo.h"
-#include "strutil.h"
+#include "guestInfoInt.h"
+#include "hostinfo.h"
 #include "debug.h"
 
-#ifndef NO_PROCPS
-#include "vm_procps.h"
-static void GuestInfoMonitorGetStat(GuestMemInfo *vmStats);
-static Bool GuestInfoMonitorReadMeminfo(GuestMemInfo *vmStats);
-#endif
-
 #define LINUX_MEMINFO_FLAGS (MEMINFO_MEMTOTAL | MEMINFO_MEMFREE | MEMINFO_MEMBUFF |\
-                             MEMINFO_MEMCACHE | MEMINFO_MEMACTIVE | MEMINFO_MEMINACTIVE |\
-                             MEMINFO_SWAPINRATE | MEMINFO_SWAPOUTRATE |\
+                             MEMINFO_MEMCACHE | MEMINFO_MEMACTIVE | MEMINFO_MEMINACTIVE)
+
+#define LINUX_RATE_FLAGS    (MEMINFO_SWAPINRATE | MEMINFO_SWAPOUTRATE |\
                              MEMINFO_IOINRATE | MEMINFO_IOOUTRATE)
 
+/*
+ * Large enough for /proc/meminfo and for /proc/vmstat up to the paging
+ * counters on current kernels. Anything past the end of the buffer is
+ * ignored.
+ */
+#define PERFMON_BUFSIZE    8192
+
+/*
+ * Samples taken closer together than this reuse the rates of the previous
+ * interval instead of computing new, noisy, ones.
+ */
+#define PERFMON_MIN_INTERVAL_US  1000000
+
+#define PERFMON_FD_MEMINFO 0
+#define PERFMON_FD_VMSTAT  1
+#define PERFMON_FD_STAT    2
+#define PERFMON_FD_MAX     3
+
+/* Indices of the counters in PerfMonSample.value and in the field tables. */
+typedef enum {
+   PERFMON_MEMTOTAL,
+   PERFMON_MEMFREE,
+   PERFMON_MEMBUFF,
+   PERFMON_MEMCACHE,
+   PERFMON_MEMACTIVE,
+   PERFMON_MEMINACTIVE,
+   PERFMON_HUGEPAGESTOTAL,
+   PERFMON_HUGEPAGESFREE,
+   PERFMON_PAGEIN,         /* KB */
+   PERFMON_PAGEOUT,        /* KB */
+   PERFMON_SWAPIN,         /* pages */
+   PERFMON_SWAPOUT,        /* pages */
+   PERFMON_NUM_VALUES
+} PerfMonValue;
+
+#define PERFMON_BIT(v)     (1U << (v))
+#define PERFMON_PAGING_BITS  (PERFMON_BIT(PERFMON_PAGEIN) |  \
+                              PERFMON_BIT(PERFMON_PAGEOUT) | \
+                              PERFMON_BIT(PERFMON_SWAPIN) |  \
+                              PERFMON_BIT(PERFMON_SWAPOUT))
+
+typedef struct PerfMonField {
+   const char *key;
+   size_t keyLen;
+   PerfMonValue value;
+} PerfMonField;
+
+#define PERFMON_FIELD(key, value) { key, sizeof key - 1, value }
+
+static const PerfMonField gMeminfoFields[] = {
+   PERFMON_FIELD("MemTotal",        PERFMON_MEMTOTAL),
+   PERFMON_FIELD("MemFree",         PERFMON_MEMFREE),
+   PERFMON_FIELD("Buffers",         PERFMON_MEMBUFF),
+   PERFMON_FIELD("Cached",          PERFMON_MEMCACHE),
+   PERFMON_FIELD("Active",          PERFMON_MEMACTIVE),
+   PERFMON_FIELD("Inactive",        PERFMON_MEMINACTIVE),
+   PERFMON_FIELD("HugePages_Total", PERFMON_HUGEPAGESTOTAL),
+   PERFMON_FIELD("HugePages_Free",  PERFMON_HUGEPAGESFREE),
+};
+
+static const PerfMonField gVmstatFields[] = {
+   PERFMON_FIELD("pgpgin",  PERFMON_PAGEIN),
+   PERFMON_FIELD("pgpgout", PERFMON_PAGEOUT),
+   PERFMON_FIELD("pswpin",  PERFMON_SWAPIN),
+   PERFMON_FIELD("pswpout", PERFMON_SWAPOUT),
+};
+
+typedef struct PerfMonSample {
+   uint32 found;                       /* PERFMON_BIT()s of the values read */
+   uint64 value[PERFMON_NUM_VALUES];
+   VmTimeType timeUS;
+} PerfMonSample;
+
+static const char *gProcPaths[PERFMON_FD_MAX] = {
+   "/proc/meminfo",
+   "/proc/vmstat",
+   "/proc/stat",
+};
+
+static struct {
+   int fd[PERFMON_FD_MAX];
+   Bool noVmstat;                      /* Use /proc/stat for paging counters. */
+   Bool havePrev;
+   PerfMonSample prev;
+   uint64 rate[4];                     /* Last swap in/out, IO in/out rates. */
+   Bool haveRates;
+   char buf[PERFMON_BUFSIZE];
+} gPerfMon = { { -1, -1, -1 } };
+
+
 /*
  *----------------------------------------------------------------------
  *
- * GuestInfo_PerfMon --
+ * PerfMonReadFile --
  *
- *      Gather performance stats.
+ *      Reads the whole of (or as much as fits of) one of the /proc files
+ *      into gPerfMon.buf. The file is opened on first use and then kept
+ *      open; later calls re-read it from offset 0 with pread(), which makes
+ *      the kernel regenerate its contents.
  *
  * Results:
- *      Gathered stats. Returns FALSE on failure.
+ *      Number of bytes read (the buffer is NUL terminated), -1 on error
+ *      with errno set.
  *
  * Side effects:
- *      None.
+ *      May open the file. Closes it on read errors, so that the next call
+ *      reopens it.
  *
  *----------------------------------------------------------------------
  */
 
-Bool
-GuestInfo_PerfMon(GuestMemInfo *vmStats)   // OUT: filled vmstats
+static ssize_t
+PerfMonReadFile(int which)    // IN: PERFMON_FD_*
 {
-#ifndef NO_PROCPS
-   ASSERT(vmStats);
-   vmStats->flags = 0;
-   GuestInfoMonitorGetStat(vmStats);
-   if (GuestInfoMonitorReadMeminfo(vmStats)) {
-      vmStats->flags |= LINUX_MEMINFO_FLAGS;
-      return TRUE;
+   int *fd = &gPerfMon.fd[which];
+   size_t len = 0;
+
+   if (*fd < 0) {
+      *fd = open(gProcPaths[which], O_RDONLY);
+      if (*fd < 0) {
+         int err = errno;
+
+         Log("%s: Error opening %s: %s.\n", __FUNCTION__, gProcPaths[which],
+             strerror(err));
+         errno = err;
+         return -1;
+      }
+      /* The fd lives as long as the service; keep it out of child processes. */
+      fcntl(*fd, F_SETFD, FD_CLOEXEC);
+   }
+
+   while (len < sizeof gPerfMon.buf - 1) {
+      ssize_t n = pread(*fd, gPerfMon.buf + len,
+                        sizeof gPerfMon.buf - 1 - len, len);
+
+      if (n < 0) {
+         int err = errno;
+
+         if (err == EINTR) {
+            continue;
+         }
+         Log("%s: Error reading %s: %s.\n", __FUNCTION__, gProcPaths[which],
+             strerror(err));
+         close(*fd);
+         *fd = -1;
+         errno = err;
+         return -1;
+      }
+      if (n == 0) {
+         break;
+      }
+      len += n;
    }
-#endif
-   return FALSE;
+
+   gPerfMon.buf[len] = '\0';
+   return len;
 }
 
 
-#ifndef NO_PROCPS
 /*
  *----------------------------------------------------------------------
  *
- * GuestInfoMonitorGetStat --
+ * PerfMonParseFields --
  *
- *      Calls getstat() to gather memory stats.
+ *      Parses "key[:] value" lines, as found in /proc/meminfo and
+ *      /proc/vmstat, in one pass over gPerfMon.buf and stores the values
+ *      of the keys listed in the field table. Stops as soon as all the
+ *      fields have been found. A line cut off by the end of the buffer is
+ *      ignored.
  *
  * Results:
- *      Gathered stats in vmStats.
+ *      None.
  *
  * Side effects:
+ *      Updates the values and the found mask of the sample.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PerfMonParseFields(size_t len,                   // IN: bytes in buffer
+                   const PerfMonField *fields,   // IN
+                   size_t numFields,             // IN
+                   PerfMonSample *sample)        // IN/OUT
+{
+   const char *p = gPerfMon.buf;
+   const char *end = gPerfMon.buf + len;
+   size_t left = numFields;
+
+   while (p < end && left > 0) {
+      const char *eol = memchr(p, '\n', end - p);
+      const char *key = p;
+      size_t keyLen;
+      size_t i;
+
+      if (eol == NULL) {
+         break;
+      }
+
+      while (p < eol && *p != ':' && *p != ' ') {
+         p++;
+      }
+      keyLen = p - key;
+
+      for (i = 0; i < numFields; i++) {
+         if (fields[i].keyLen == keyLen &&
+             memcmp(fields[i].key, key, keyLen) == 0) {
+            uint64 value = 0;
+
+            if (p < eol && *p == ':') {
+               p++;
+            }
+            while (p < eol && *p == ' ') {
+               p++;
+            }
+            while (p < eol && *p >= '0' && *p <= '9') {
+               value = value * 10 + (*p - '0');
+               p++;
+            }
+            if ((sample->found & PERFMON_BIT(fields[i].value)) == 0) {
+               left--;
+            }
+            sample->value[fields[i].value] = value;
+            sample->found |= PERFMON_BIT(fields[i].value);
+            break;
+         }
+      }
+
+      p = eol + 1;
+   }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PerfMonParseStat --
+ *
+ *      Parses the "page <in> <out>" and "swap <in> <out>" lines of
+ *      /proc/stat, which is where kernels without /proc/vmstat report the
+ *      paging counters.
+ *
+ * Results:
  *      None.
  *
+ * Side effects:
+ *      Updates the values and the found mask of the sample.
+ *
  *----------------------------------------------------------------------
  */
 
 static void
-GuestInfoMonitorGetStat(GuestMemInfo *vmStats)   // OUT: filled vmstats
+PerfMonParseStat(size_t len,                // IN: bytes in buffer
+                 PerfMonSample *sample)     // IN/OUT
 {
-   uint32 hz = Hertz;
-   uint32 dummy;
-   jiff cpuUse[2];
-   jiff cpuNic[2];
-   jiff cpuSys[2];
-   jiff cpuIdl[2];
-   jiff cpuIow[2];
-   jiff cpuXxx[2];
-   jiff cpuYyy[2];
-   jiff cpuZzz[2];
-   jiff cpuTotal;
-   jiff cpuHalf;
-   unsigned long pageIn[2];
-   unsigned long pageOut[2];
-   unsigned long swapIn[2];
-   unsigned long swapOut[2];
-   unsigned int dummy2[2];
-   unsigned long kb_per_page = sysconf(_SC_PAGESIZE) / 1024ul;
-
-   meminfo();
-   getstat(cpuUse, cpuNic, cpuSys, cpuIdl, cpuIow, cpuXxx, cpuYyy, cpuZzz,
-           pageIn, pageOut, swapIn, swapOut, dummy2, dummy2, &dummy, &dummy,
-           &dummy, &dummy);
-
-   cpuTotal = *cpuUse + *cpuNic + *cpuSys + *cpuXxx +
-              *cpuYyy + *cpuIdl + *cpuIow + *cpuZzz;
-   cpuHalf = cpuTotal / 2UL;
-
-   vmStats->memFree = kb_main_free;
-   vmStats->memBuff = kb_main_buffers;
-   vmStats->memCache = kb_main_cached,
-   vmStats->memInactive = kb_inactive;
-   vmStats->memActive = kb_active;
-
-   vmStats->swapInRate = (uint64)((*swapIn  * kb_per_page * hz + cpuHalf) / cpuTotal);
-   vmStats->swapOutRate = (uint64)((*swapOut * kb_per_page * hz + cpuHalf) / cpuTotal);
-   vmStats->ioInRate = (uint64)((*pageIn * kb_per_page * hz + cpuHalf) / cpuTotal);
-   vmStats->ioOutRate = (uint64)((*pageOut * kb_per_page * hz + cpuHalf) / cpuTotal);
+   const char *p = gPerfMon.buf;
+   const char *end = gPerfMon.buf + len;
+
+   while (p < end) {
+      const char *eol = memchr(p, '\n', end - p);
+      PerfMonValue first;
+
+      if (eol == NULL) {
+         break;
+      }
+
+      if (eol - p > 5 && memcmp(p, "page ", 5) == 0) {
+         first = PERFMON_PAGEIN;
+      } else if (eol - p > 5 && memcmp(p, "swap ", 5) == 0) {
+         first = PERFMON_SWAPIN;
+      } else {
+         p = eol + 1;
+         continue;
+      }
+
+      sample->value[first] = strtoull(p + 5, (char **)&p, 10);
+      sample->value[first + 1] = strtoull(p, NULL, 10);
+      sample->found |= PERFMON_BIT(first) | PERFMON_BIT(first + 1);
+      if ((sample->found & PERFMON_PAGING_BITS) == PERFMON_PAGING_BITS) {
+         break;
+      }
+      p = eol + 1;
+   }
 }
 
 
 /*
  *----------------------------------------------------------------------
  *
- * GuestInfoMonitorReadMeminfo --
+ * PerfMonRate --
  *
- *      Reads /proc/meminfo to gather phsycial memory and huge page stats.
+ *      Computes a per second rate from two counter values.
  *
  * Results:
- *      Read /proc/meminfo for total physical memory and huge pages info.
- *      Returns FALSE on failure.
+ *      The rate; 0 if the counter went backwards.
  *
  * Side effects:
  *      None.
@@ -154,37 +351,162 @@ GuestInfoMonitorGetStat(GuestMemInfo *vmStats)   // OUT: filled vmstats
  *----------------------------------------------------------------------
  */
 
-static Bool
-GuestInfoMonitorReadMeminfo(GuestMemInfo *vmStats)   // OUT: filled vmstats
+static uint64
+PerfMonRate(uint64 prev,         // IN
+            uint64 cur,          // IN
+            uint64 scale,        // IN: multiplier to get KB
+            VmTimeType elapsed)  // IN: us, > 0
+{
+   if (cur < prev) {
+      return 0;
+   }
+   return ((cur - prev) * scale * 1000000 + elapsed / 2) / elapsed;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GuestInfo_PerfMon --
+ *
+ *      Gather performance stats.
+ *
+ *      The swap and IO rates need two samples; they are left out of the
+ *      first report after the service starts.
+ *
+ * Results:
+ *      Gathered stats. Returns FALSE on failure.
+ *
+ * Side effects:
+ *      Keeps the /proc files open and remembers the paging counters for
+ *      the next call.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Bool
+GuestInfo_PerfMon(GuestMemInfo *vmStats)   // OUT: filled vmstats
 {
-   char buf[512];
-   uint64 value;
-   FILE *fp;
-
-   /* Get the total memory, and huge page info from /proc/meminfo. */
-   fp = fopen("/proc/meminfo", "r");
-   if (!fp) {
-      Log("GuestInfoMonitorReadMeminfo: Error opening /proc/meminfo.\n");
+   PerfMonSample cur;
+   ssize_t len;
+
+   ASSERT(vmStats);
+   vmStats->flags = 0;
+
+   memset(&cur, 0, sizeof cur);
+
+   len = PerfMonReadFile(PERFMON_FD_MEMINFO);
+   if (len < 0) {
       return FALSE;
    }
+   cur.timeUS = Hostinfo_SystemTimerUS();
+   PerfMonParseFields(len, gMeminfoFields, ARRAYSIZE(gMeminfoFields), &cur);
 
-   while(!feof(fp)) {
-      if (fscanf(fp, "%s %"FMT64"u", buf, &value) != 2) {
-         continue;
-      }
-      if (StrUtil_StartsWith(buf, "MemTotal")) {
-         vmStats->memTotal = value;
+   if (!gPerfMon.noVmstat) {
+      len = PerfMonReadFile(PERFMON_FD_VMSTAT);
+      if (len >= 0) {
+         PerfMonParseFields(len, gVmstatFields, ARRAYSIZE(gVmstatFields), &cur);
+      } else if (errno == ENOENT) {
+         gPerfMon.noVmstat = TRUE;
       }
-      if (StrUtil_StartsWith(buf, "HugePages_Total")) {
-         vmStats->hugePagesTotal = value;
-         vmStats->flags |= MEMINFO_HUGEPAGESTOTAL;
-      }
-      if (StrUtil_StartsWith(buf, "HugePages_Free")) {
-         vmStats->hugePagesFree = value;
-         vmStats->flags |= MEMINFO_HUGEPAGESFREE;
+   }
+   if (gPerfMon.noVmstat) {
+      len = PerfMonReadFile(PERFMON_FD_STAT);
+      if (len >= 0) {
+         PerfMonParseStat(len, &cur);
       }
    }
-   fclose(fp);
+
+   vmStats->memTotal = cur.value[PERFMON_MEMTOTAL];
+   vmStats->memFree = cur.value[PERFMON_MEMFREE];
+   vmStats->memBuff = cur.value[PERFMON_MEMBUFF];
+   vmStats->memCache = cur.value[PERFMON_MEMCACHE];
+   vmStats->memActive = cur.value[PERFMON_MEMACTIVE];
+   vmStats->memInactive = cur.value[PERFMON_MEMINACTIVE];
+   vmStats->flags |= LINUX_MEMINFO_FLAGS;
+
+   if (cur.found & PERFMON_BIT(PERFMON_HUGEPAGESTOTAL)) {
+      vmStats->hugePagesTotal = cur.value[PERFMON_HUGEPAGESTOTAL];
+      vmStats->flags |= MEMINFO_HUGEPAGESTOTAL;
+   }
+   if (cur.found & PERFMON_BIT(PERFMON_HUGEPAGESFREE)) {
+      vmStats->hugePagesFree = cur.value[PERFMON_HUGEPAGESFREE];
+      vmStats->flags |= MEMINFO_HUGEPAGESFREE;
+   }
+
+   if ((cur.found & PERFMON_PAGING_BITS) != PERFMON_PAGING_BITS) {
+      /* No usable paging counters; forget about any previous sample. */
+      gPerfMon.havePrev = FALSE;
+      gPerfMon.haveRates = FALSE;
+      return TRUE;
+   }
+
+   if (gPerfMon.havePrev &&
+       cur.timeUS - gPerfMon.prev.timeUS >= PERFMON_MIN_INTERVAL_US) {
+      const uint64 *prev = gPerfMon.prev.value;
+      VmTimeType elapsed = cur.timeUS - gPerfMon.prev.timeUS;
+      uint64 kbPerPage = sysconf(_SC_PAGESIZE) / 1024;
+
+      gPerfMon.rate[0] = PerfMonRate(prev[PERFMON_SWAPIN],
+                                     cur.value[PERFMON_SWAPIN],
+                                     kbPerPage, elapsed);
+      gPerfMon.rate[1] = PerfMonRate(prev[PERFMON_SWAPOUT],
+                                     cur.value[PERFMON_SWAPOUT],
+                                     kbPerPage, elapsed);
+      gPerfMon.rate[2] = PerfMonRate(prev[PERFMON_PAGEIN],
+                                     cur.value[PERFMON_PAGEIN],
+                                     1, elapsed);
+      gPerfMon.rate[3] = PerfMonRate(prev[PERFMON_PAGEOUT],
+                                     cur.value[PERFMON_PAGEOUT],
+                                     1, elapsed);
+      gPerfMon.haveRates = TRUE;
+      gPerfMon.prev = cur;
+   } else if (!gPerfMon.havePrev) {
+      gPerfMon.prev = cur;
+      gPerfMon.havePrev = TRUE;
+   }
+
+   if (gPerfMon.haveRates) {
+      vmStats->swapInRate = gPerfMon.rate[0];
+      vmStats->swapOutRate = gPerfMon.rate[1];
+      vmStats->ioInRate = gPerfMon.rate[2];
+      vmStats->ioOutRate = gPerfMon.rate[3];
+      vmStats->flags |= LINUX_RATE_FLAGS;
+   }
+
    return TRUE;
 }
-#endif
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GuestInfo_PerfMonShutdown --
+ *
+ *      Closes the /proc files kept open by GuestInfo_PerfMon and forgets
+ *      the previous sample.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+GuestInfo_PerfMonShutdown(void)
+{
+   size_t i;
+
+   for (i = 0; i < ARRAYSIZE(gPerfMon.fd); i++) {
+      if (gPerfMon.fd[i] >= 0) {
+         close(gPerfMon.fd[i]);
+         gPerfMon.fd[i] = -1;
+      }
+   }
+   gPerfMon.noVmstat = FALSE;
+   gPerfMon.havePrev = FALSE;
+   gPerfMon.haveRates = FALSE;
+}
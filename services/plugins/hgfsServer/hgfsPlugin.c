@@ -26,12 +26,15 @@
 
 #define G_LOG_DOMAIN "hgfsd"
 
+#include "conf.h"
 #include "hgfs.h"
+#include "hgfsServer.h"
 #include "hgfsServerManager.h"
 #include "vm_assert.h"
 #include "vmware/guestrpc/tclodefs.h"
 #include "vmware/tools/log.h"
 #include "vmware/tools/plugin.h"
+#include "vmware/tools/threadPool.h"
 #include "vmware/tools/utils.h"
 
 
@@ -42,6 +45,60 @@ VM_EMBED_VERSION(VMTOOLSD_VERSION_STRING);
 #endif
 
 
+/** An HGFS server request handed to the service's thread pool. */
+typedef struct HgfsServerTask {
+   HgfsServerRequestFunc  *fn;
+   void                   *request;
+} HgfsServerTask;
+
+
+/**
+ * Runs an HGFS server request in a pool thread.
+ *
+ * @param[in]  ctx      Unused.
+ * @param[in]  data     The task.
+ */
+
+static void
+HgfsServerRunTask(ToolsAppCtx *ctx,
+                  gpointer data)
+{
+   HgfsServerTask *task = data;
+   task->fn(task->request);
+}
+
+
+/**
+ * Executor given to the HGFS server: queues asynchronous requests in the
+ * service's thread pool so that a slow request does not hold up the ones
+ * behind it.
+ *
+ * @param[in]  data     The application context.
+ * @param[in]  fn       Function processing the request.
+ * @param[in]  request  The request.
+ *
+ * @return TRUE if the request was queued, FALSE if the server should run it
+ *         itself.
+ */
+
+static Bool
+HgfsServerSubmitTask(void *data,
+                     HgfsServerRequestFunc *fn,
+                     void *request)
+{
+   ToolsAppCtx *ctx = data;
+   HgfsServerTask *task = g_malloc(sizeof *task);
+
+   task->fn = fn;
+   task->request = request;
+   if (ToolsCorePool_SubmitTask(ctx, HgfsServerRunTask, task, g_free) == 0) {
+      g_free(task);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+
 /**
  * Clean up internal state on shutdown.
  *
@@ -56,11 +113,107 @@ HgfsServerShutdown(gpointer src,
                    ToolsPluginData *plugin)
 {
    HgfsServerMgrData *mgrData = plugin->_private;
+
+   /* Wait for requests still running in the thread pool. */
+   HgfsServer_SetExecutor(NULL, NULL);
    HgfsServerManager_Unregister(mgrData);
    g_free(mgrData);
 }
 
 
+/**
+ * Reads a boolean from the plugin's config group.
+ *
+ * @param[in]  ctx      The app context.
+ * @param[in]  key      Config key.
+ *
+ * @return The value, or FALSE if it is not set or invalid.
+ */
+
+static gboolean
+HgfsServerGetConfigBool(ToolsAppCtx *ctx,
+                        const gchar *key)
+{
+   GError *err = NULL;
+   gboolean value;
+
+   if (ctx->config == NULL) {
+      return FALSE;
+   }
+
+   value = g_key_file_get_boolean(ctx->config, CONFGROUPNAME_HGFSSERVER,
+                                  key, &err);
+   if (err != NULL) {
+      g_clear_error(&err);
+      value = FALSE;
+   }
+   return value;
+}
+
+
+/**
+ * Turns request statistics on or off according to the configuration.
+ * Statistics start from zero whenever collection is turned on.
+ *
+ * @param[in]  src      The source object.
+ * @param[in]  ctx      The app context.
+ * @param[in]  data     Unused.
+ */
+
+static void
+HgfsServerConfReload(gpointer src,
+                     ToolsAppCtx *ctx,
+                     gpointer data)
+{
+   static gboolean statsEnabled = FALSE;
+   gboolean enable = HgfsServerGetConfigBool(ctx, CONFNAME_HGFSSERVER_STATS);
+
+   if (enable && !statsEnabled) {
+      HgfsServer_ResetStats();
+   }
+   if (enable != statsEnabled) {
+      g_debug("%s request statistics.\n", enable ? "Enabling" : "Disabling");
+      HgfsServer_EnableStats(enable);
+      statsEnabled = enable;
+   }
+}
+
+
+/**
+ * Prints a line of the HGFS statistics into the service's state dump.
+ *
+ * @param[in]  data     Unused.
+ * @param[in]  line     The line.
+ */
+
+static void
+HgfsServerLogStats(void *data,
+                   const char *line)
+{
+   ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN, "%s", line);
+}
+
+
+/**
+ * Dumps the HGFS request statistics.
+ *
+ * @param[in]  src      The source object.
+ * @param[in]  ctx      The app context.
+ * @param[in]  data     Unused.
+ */
+
+static void
+HgfsServerDumpState(gpointer src,
+                    ToolsAppCtx *ctx,
+                    gpointer data)
+{
+   HgfsServer_DumpStats(HgfsServerLogStats, NULL);
+   if (HgfsServerGetConfigBool(ctx, CONFNAME_HGFSSERVER_STATSRESETONDUMP)) {
+      HgfsServer_ResetStats();
+   }
+}
+
+
 /**
  * Handles hgfs requests.
  *
@@ -178,12 +331,24 @@ ToolsOnLoad(ToolsAppCtx *ctx)
       return NULL;
    }
 
+   /*
+    * Requests from transports able to reply asynchronously are processed in
+    * the thread pool. The backdoor transport replies synchronously (the VMX
+    * only has one TCLO request outstanding), so it is not affected.
+    */
+   if (ToolsCorePool_GetPool(ctx) != NULL) {
+      HgfsServer_SetExecutor(HgfsServerSubmitTask, ctx);
+   }
+   HgfsServerConfReload(NULL, ctx, NULL);
+
    {
       RpcChannelCallback rpcs[] = {
          { HGFS_SYNC_REQREP_CMD, HgfsServerRpcDispatch, mgrData, NULL, NULL, 0 }
       };
       ToolsPluginSignalCb sigs[] = {
          { TOOLS_CORE_SIG_CAPABILITIES, HgfsServerCapReg, &regData },
+         { TOOLS_CORE_SIG_CONF_RELOAD, HgfsServerConfReload, NULL },
+         { TOOLS_CORE_SIG_DUMP_STATE, HgfsServerDumpState, NULL },
          { TOOLS_CORE_SIG_SHUTDOWN, HgfsServerShutdown, &regData }
       };
       ToolsAppReg regs[] = {
@@ -24,15 +24,19 @@
 
 #include "vmBackupInt.h"
 
+#include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "vm_basic_defs.h"
 #include "file.h"
 #include "guestApp.h"
+#include "hostinfo.h"
 #include "procMgr.h"
 #include "str.h"
 #include "util.h"
+#include "vmware/tools/utils.h"
 
 /*
  * These are legacy scripts used before the vmbackup-based backups. To
@@ -55,7 +59,10 @@
 
 typedef struct VmBackupScript {
    char *path;
+   int group;                 /* Numeric file name prefix, or -1. */
    ProcMgr_AsyncProc *proc;
+   GSource *exitWatch;
+   VmTimeType startTime;
 } VmBackupScript;
 
 
@@ -65,6 +72,9 @@ typedef struct VmBackupScriptOp {
    Bool thawFailed;
    VmBackupScriptType type;
    VmBackupState *state;
+   ssize_t batchStart;        /* First script started by the last run. */
+   unsigned int numRunning;
+   VmTimeType startTime;
 } VmBackupScriptOp;
 
 
@@ -101,6 +111,316 @@ VmBackupGetScriptPath(void)
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupGetScriptOpName --
+ *
+ *    Returns the argument passed to the scripts for the given operation.
+ *
+ * Result
+ *    A static string.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *
+VmBackupGetScriptOpName(VmBackupScriptType type)   // IN
+{
+   switch (type) {
+   case VMBACKUP_SCRIPT_FREEZE:
+      return "freeze";
+
+   case VMBACKUP_SCRIPT_FREEZE_FAIL:
+      return "freezeFail";
+
+   case VMBACKUP_SCRIPT_THAW:
+      return "thaw";
+
+   default:
+      NOT_REACHED();
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupGetScriptGroup --
+ *
+ *    Parses the group of a script out of its file name: scripts named like
+ *    "10-database" or "10_webserver" belong to group 10.
+ *
+ * Result
+ *    The group, or -1 if the name has no numeric prefix.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+VmBackupGetScriptGroup(const char *name)   // IN
+{
+   char *end;
+   long group;
+
+   if (!isdigit((unsigned char) name[0])) {
+      return -1;
+   }
+
+   group = strtol(name, &end, 10);
+   if ((*end != '-' && *end != '_') || group > INT_MAX) {
+      return -1;
+   }
+   return (int) group;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupIsSameGroup --
+ *
+ *    Checks whether two script list entries belong to the same group, i.e.,
+ *    whether they can run concurrently in parallel mode.
+ *
+ * Result
+ *    TRUE if "other" is a script of the group of "index".
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+VmBackupIsSameGroup(VmBackupScript *scripts,   // IN
+                    ssize_t index,             // IN
+                    ssize_t other)             // IN
+{
+   return other >= 0 &&
+          scripts[other].path != NULL &&
+          scripts[index].group >= 0 &&
+          scripts[index].group == scripts[other].group;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupGetBatch --
+ *
+ *    Returns the range of the script list started by the last call to
+ *    VmBackupRunNextScript.
+ *
+ * Result
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VmBackupGetBatch(VmBackupScriptOp *op,   // IN
+                 ssize_t *first,         // OUT
+                 ssize_t *last)          // OUT
+{
+   *first = MIN(op->batchStart, op->state->currentScript);
+   *last = MAX(op->batchStart, op->state->currentScript);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupScriptExited --
+ *
+ *    Called when the selectable of a script's process is signaled, i.e.,
+ *    when the script exits. Wakes up the state machine so that it doesn't
+ *    wait for the next poll to notice.
+ *
+ * Result
+ *    FALSE.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#if defined(_WIN32)
+static gboolean
+VmBackupScriptExited(gpointer data)   // IN
+#else
+static gboolean
+VmBackupScriptExited(GIOChannel *chan,    // IN
+                     GIOCondition cond,   // IN
+                     gpointer data)       // IN
+#endif
+{
+   VmBackup_WakeUp(data);
+   return FALSE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupWatchScript --
+ *
+ *    Sets up a watch for the exit of a script's process.
+ *
+ * Result
+ *    The watch source.
+ *
+ * Side effects:
+ *    Attaches the source to the main loop.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static GSource *
+VmBackupWatchScript(VmBackupState *state,       // IN
+                    ProcMgr_AsyncProc *proc)    // IN
+{
+   GSource *src;
+
+#if defined(_WIN32)
+   src = VMTools_NewHandleSource(ProcMgr_GetAsyncProcSelectable(proc));
+#else
+   GIOChannel *chan;
+
+   chan = g_io_channel_unix_new(ProcMgr_GetAsyncProcSelectable(proc));
+   src = g_io_create_watch(chan, G_IO_IN | G_IO_HUP | G_IO_ERR);
+   g_io_channel_unref(chan);
+#endif
+
+   VMTOOLSAPP_ATTACH_SOURCE(state->ctx, src, VmBackupScriptExited, state, NULL);
+   return src;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupReleaseScript --
+ *
+ *    Frees the process handle of a script and removes its exit watch.
+ *
+ * Result
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VmBackupReleaseScript(VmBackupScript *script)   // IN/OUT
+{
+   if (script->exitWatch != NULL) {
+      g_source_destroy(script->exitWatch);
+      g_source_unref(script->exitWatch);
+      script->exitWatch = NULL;
+   }
+   if (script->proc != NULL) {
+      ProcMgr_Free(script->proc);
+      script->proc = NULL;
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupReapScript --
+ *
+ *    Collects the exit code of a finished script and logs how long it ran.
+ *
+ * Result
+ *    Whether the script succeeded.
+ *
+ * Side effects:
+ *    Frees the script's process handle.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+VmBackupReapScript(VmBackupScriptOp *op,       // IN/OUT
+                   VmBackupScript *script)     // IN/OUT
+{
+   int exitCode = -1;
+   Bool succeeded;
+
+   succeeded = (ProcMgr_GetExitCode(script->proc, &exitCode) == 0 &&
+                exitCode == 0);
+   g_message("Script %s (%s) exited with code %d after %.3f seconds.\n",
+             script->path, VmBackupGetScriptOpName(op->type), exitCode,
+             (Hostinfo_SystemTimerUS() - script->startTime) / 1000000.0);
+
+   VmBackupReleaseScript(script);
+   op->numRunning--;
+   return succeeded;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupKillScripts --
+ *
+ *    Kills the scripts started by the last call to VmBackupRunNextScript
+ *    that are still running.
+ *
+ * Result
+ *    None.
+ *
+ * Side effects:
+ *    Frees the process handles of the killed scripts.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VmBackupKillScripts(VmBackupScriptOp *op)   // IN/OUT
+{
+   VmBackupScript *scripts = op->state->scripts;
+   ssize_t first;
+   ssize_t last;
+   ssize_t i;
+
+   if (op->numRunning == 0) {
+      return;
+   }
+
+   VmBackupGetBatch(op, &first, &last);
+   for (i = first; i <= last; i++) {
+      if (scripts[i].proc != NULL) {
+         ProcMgr_Pid pid = ProcMgr_GetPid(scripts[i].proc);
+
+         if (!ProcMgr_KillByPid(pid)) {
+            // XXX: what to do in this situation? other than log and cry?
+            g_warning("Failed to kill script %s.\n", scripts[i].path);
+         } else {
+            int exitCode;
+            ProcMgr_GetExitCode(scripts[i].proc, &exitCode);
+         }
+         VmBackupReleaseScript(&scripts[i]);
+         op->numRunning--;
+      }
+   }
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -112,6 +432,9 @@ VmBackupGetScriptPath(void)
  *    try to start the preceding one until one script is run, or it runs out
  *    of scripts to try.
  *
+ *    In parallel mode, the scripts of the same group as the one started
+ *    are started along with it.
+ *
  * Results:
  *    -1: an error occurred.
  *    0: no more scripts to run.
@@ -126,30 +449,14 @@ VmBackupGetScriptPath(void)
 static int
 VmBackupRunNextScript(VmBackupScriptOp *op)  // IN/OUT
 {
-   const char *scriptOp;
+   const char *scriptOp = VmBackupGetScriptOpName(op->type);
    int ret = 0;
    ssize_t index;
+   ssize_t step;
    VmBackupScript *scripts = op->state->scripts;
 
-   switch (op->type) {
-   case VMBACKUP_SCRIPT_FREEZE:
-      index = ++op->state->currentScript;
-      scriptOp = "freeze";
-      break;
-
-   case VMBACKUP_SCRIPT_FREEZE_FAIL:
-      index = --op->state->currentScript;
-      scriptOp = "freezeFail";
-      break;
-
-   case VMBACKUP_SCRIPT_THAW:
-      index = --op->state->currentScript;
-      scriptOp = "thaw";
-      break;
-
-   default:
-      NOT_REACHED();
-   }
+   step = (op->type == VMBACKUP_SCRIPT_FREEZE) ? 1 : -1;
+   index = (op->state->currentScript += step);
 
    while (index >= 0 && scripts[index].path != NULL) {
       char *cmd;
@@ -174,23 +481,33 @@ VmBackupRunNextScript(VmBackupScriptOp *op)  // IN/OUT
 
          if (scripts[index].proc == NULL) {
             if (op->type == VMBACKUP_SCRIPT_FREEZE) {
+               VmBackupKillScripts(op);
                ret = -1;
                break;
             } else {
                op->thawFailed = TRUE;
             }
          } else {
+            if (ret == 0) {
+               op->batchStart = index;
+            }
+            scripts[index].startTime = Hostinfo_SystemTimerUS();
+            scripts[index].exitWatch = VmBackupWatchScript(op->state,
+                                                           scripts[index].proc);
+            op->numRunning++;
             ret = 1;
-            break;
          }
       }
 
-      if (op->type == VMBACKUP_SCRIPT_FREEZE) {
-         index = ++op->state->currentScript;
-      } else {
-         index = --op->state->currentScript;
+      /* In parallel mode, start the rest of the group too. */
+      if (ret == 1 &&
+          (!op->state->parallelScripts ||
+           !VmBackupIsSameGroup(scripts, index, index + step))) {
+         break;
       }
 
+      index = (op->state->currentScript += step);
+
       /*
        * This happens if all thaw/fail scripts failed to start. Since the first
        * entry may be a legacy script (which may not exist), need to check
@@ -236,20 +553,53 @@ VmBackupStringCompare(const void *str1,   // IN
 }
 
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackupScriptOpDone --
+ *
+ *    Logs how long the scripts of an operation took and, once the thaw (or
+ *    fail) scripts are done, for how long applications were quiesced.
+ *
+ * Result
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+VmBackupScriptOpDone(VmBackupScriptOp *op)   // IN
+{
+   VmTimeType now = Hostinfo_SystemTimerUS();
+
+   g_message("The %s scripts took %.3f seconds.\n",
+             VmBackupGetScriptOpName(op->type),
+             (now - op->startTime) / 1000000.0);
+
+   if (op->type != VMBACKUP_SCRIPT_FREEZE) {
+      g_message("Applications were quiesced for %.3f seconds.\n",
+                (now - op->state->quiesceStart) / 1000000.0);
+   }
+}
+
+
 /*
  *-----------------------------------------------------------------------------
  *
  *  VmBackupScriptOpQuery --
  *
- *    Checks the status of the current running script. If the script is
- *    finished, run the next script in the queue or, if no scripts are left,
- *    return a "finished" status.
+ *    Checks the status of the running scripts. Once they're finished, run
+ *    the next script (or group of scripts) in the queue or, if no scripts
+ *    are left, return a "finished" status.
  *
  * Result
  *    The status of the operation.
  *
  * Side effects:
- *    Might start a new process.
+ *    Might start new processes.
  *
  *-----------------------------------------------------------------------------
  */
@@ -260,57 +610,69 @@ VmBackupScriptOpQuery(VmBackupOp *_op) // IN
    VmBackupOpStatus ret = VMBACKUP_STATUS_PENDING;
    VmBackupScriptOp *op = (VmBackupScriptOp *) _op;
    VmBackupScript *scripts = op->state->scripts;
-   VmBackupScript *currScript = NULL;
-
-   if (scripts != NULL && op->state->currentScript >= 0) {
-      currScript = &scripts[op->state->currentScript];
-   }
+   Bool failed = FALSE;
+   ssize_t first;
+   ssize_t last;
+   ssize_t i;
 
    if (op->canceled) {
       ret = VMBACKUP_STATUS_CANCELED;
       goto exit;
-   } else if (scripts == NULL || currScript == NULL || currScript->proc == NULL) {
+   } else if (scripts == NULL || op->numRunning == 0) {
       ret = VMBACKUP_STATUS_FINISHED;
       goto exit;
    }
 
-   if (!ProcMgr_IsAsyncProcRunning(currScript->proc)) {
-      int exitCode;
-      Bool succeeded;
-
-      succeeded = (ProcMgr_GetExitCode(currScript->proc, &exitCode) == 0 &&
-                   exitCode == 0);
-      ProcMgr_Free(currScript->proc);
-      currScript->proc = NULL;
-
-      /*
-       * If thaw scripts fail, keep running and only notify the failure after
-       * all others have run.
-       */
-      if (!succeeded) {
-          if (op->type == VMBACKUP_SCRIPT_FREEZE) {
-             ret = VMBACKUP_STATUS_ERROR;
-             goto exit;
-          } else if (op->type == VMBACKUP_SCRIPT_THAW) {
-             op->thawFailed = TRUE;
-          }
+   VmBackupGetBatch(op, &first, &last);
+   for (i = first; i <= last; i++) {
+      if (scripts[i].proc != NULL &&
+          !ProcMgr_IsAsyncProcRunning(scripts[i].proc) &&
+          !VmBackupReapScript(op, &scripts[i])) {
+         failed = TRUE;
       }
+   }
 
-      switch (VmBackupRunNextScript(op)) {
-      case -1:
+   /*
+    * If thaw scripts fail, keep running and only notify the failure after
+    * all others have run. If a freeze script fails, stop the rest of its
+    * group; since any of them may have quiesced something already, they
+    * all get to run their "freezeFail" step.
+    */
+   if (failed) {
+      if (op->type == VMBACKUP_SCRIPT_FREEZE) {
+         VmBackupKillScripts(op);
+         if (op->state->parallelScripts) {
+            op->state->currentScript = last + 1;
+         }
          ret = VMBACKUP_STATUS_ERROR;
-         break;
+         goto exit;
+      } else if (op->type == VMBACKUP_SCRIPT_THAW) {
+         op->thawFailed = TRUE;
+      }
+   }
 
-      case 0:
-         ret = op->thawFailed ? VMBACKUP_STATUS_ERROR : VMBACKUP_STATUS_FINISHED;
-         break;
+   if (op->numRunning > 0) {
+      goto exit;
+   }
 
-      default:
-         break;
-      }
+   switch (VmBackupRunNextScript(op)) {
+   case -1:
+      ret = VMBACKUP_STATUS_ERROR;
+      break;
+
+   case 0:
+      ret = op->thawFailed ? VMBACKUP_STATUS_ERROR : VMBACKUP_STATUS_FINISHED;
+      break;
+
+   default:
+      break;
    }
 
 exit:
+   if (scripts != NULL &&
+       (ret == VMBACKUP_STATUS_FINISHED || ret == VMBACKUP_STATUS_ERROR)) {
+      VmBackupScriptOpDone(op);
+   }
    if (ret == VMBACKUP_STATUS_ERROR) {
       /* Report the script error to the host */
       VmBackup_SendEvent(VMBACKUP_EVENT_REQUESTOR_ERROR,
@@ -349,9 +711,7 @@ VmBackupScriptOpRelease(VmBackupOp *_op)  // IN
       VmBackupScript *scripts = op->state->scripts;
       for (i = 0; scripts[i].path != NULL; i++) {
          free(scripts[i].path);
-         if (scripts[i].proc != NULL) {
-            ProcMgr_Free(scripts[i].proc);
-         }
+         VmBackupReleaseScript(&scripts[i]);
       }
       free(op->state->scripts);
       op->state->scripts = NULL;
@@ -367,7 +727,7 @@ VmBackupScriptOpRelease(VmBackupOp *_op)  // IN
  *
  *  VmBackupScriptOpCancel --
  *
- *    Cancels the current operation. Kills any currently running script and
+ *    Cancels the current operation. Kills any currently running scripts and
  *    flags the operation as canceled.
  *
  * Result
@@ -383,20 +743,16 @@ static void
 VmBackupScriptOpCancel(VmBackupOp *_op)   // IN
 {
    VmBackupScriptOp *op = (VmBackupScriptOp *) _op;
-   VmBackupScript *scripts = op->state->scripts;
-   VmBackupScript *currScript = NULL;
-   ProcMgr_Pid pid;
-
-   if (scripts != NULL) {
-      currScript = &scripts[op->state->currentScript];
-      ASSERT(currScript->proc != NULL);
-
-      pid = ProcMgr_GetPid(currScript->proc);
-      if (!ProcMgr_KillByPid(pid)) {
-         // XXX: what to do in this situation? other than log and cry?
-      } else {
-         int exitCode;
-         ProcMgr_GetExitCode(currScript->proc, &exitCode);
+
+   if (op->state->scripts != NULL && op->numRunning > 0) {
+      ssize_t first;
+      ssize_t last;
+
+      /* As on failure, the whole group gets to run "freezeFail". */
+      VmBackupGetBatch(op, &first, &last);
+      VmBackupKillScripts(op);
+      if (op->type == VMBACKUP_SCRIPT_FREEZE && op->state->parallelScripts) {
+         op->state->currentScript = last + 1;
       }
    }
 
@@ -450,6 +806,7 @@ VmBackup_NewScriptOp(VmBackupScriptType type, // IN
 
    op->state = state;
    op->type = type;
+   op->startTime = Hostinfo_SystemTimerUS();
    op->callbacks.queryFn = VmBackupScriptOpQuery;
    op->callbacks.cancelFn = VmBackupScriptOpCancel;
    op->callbacks.releaseFn = VmBackupScriptOpRelease;
@@ -463,6 +820,10 @@ VmBackup_NewScriptOp(VmBackupScriptType type, // IN
     * This logic won't recurse into directories, so only files directly under
     * the script dir will be considered.
     *
+    * In parallel mode, consecutive scripts with the same numeric prefix
+    * (e.g. "10-db" and "10-web") form a group and run concurrently; scripts
+    * without a prefix still run on their own.
+    *
     * Legacy scripts will be the first ones to run (or last ones in the
     * case of thawing). If either the legacy freeze or thaw script
     * exist, the first entry in the script list will be reserved for
@@ -476,6 +837,7 @@ VmBackup_NewScriptOp(VmBackupScriptType type, // IN
 
       state->scripts = NULL;
       state->currentScript = 0;
+      state->quiesceStart = op->startTime;
 
       if (File_IsFile(LEGACY_FREEZE_SCRIPT) ||
           File_IsFile(LEGACY_THAW_SCRIPT)) {
@@ -502,6 +864,7 @@ VmBackup_NewScriptOp(VmBackupScriptType type, // IN
       }
 
       if (legacy > 0) {
+         scripts[idx].group = -1;
          scripts[idx++].path = Util_SafeStrdup(LEGACY_FREEZE_SCRIPT);
       }
 
@@ -520,6 +883,7 @@ VmBackup_NewScriptOp(VmBackupScriptType type, // IN
                fail = TRUE;
                goto exit;
             } else if (File_IsFile(script)) {
+               scripts[idx].group = VmBackupGetScriptGroup(fileList[i]);
                scripts[idx++].path = script;
             } else {
                free(script);
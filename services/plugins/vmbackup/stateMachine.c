@@ -504,6 +504,33 @@ exit:
 }
 
 
+/**
+ * Makes the state machine check the status of the current operation right
+ * away instead of at the end of the current poll period. For operations
+ * that get notified when they're done (e.g., when a script exits).
+ *
+ * @param[in]  state    The backup state.
+ */
+
+void
+VmBackup_WakeUp(VmBackupState *state)
+{
+   ASSERT(state == gBackupState);
+
+   /* Without a pending timer, the state machine is already running. */
+   if (state->timerEvent != NULL) {
+      g_source_destroy(state->timerEvent);
+      g_source_unref(state->timerEvent);
+      state->timerEvent = g_timeout_source_new(0);
+      VMTOOLSAPP_ATTACH_SOURCE(state->ctx,
+                               state->timerEvent,
+                               VmBackupAsyncCallback,
+                               NULL,
+                               NULL);
+   }
+}
+
+
 /**
  * Calls the sync provider's start function.
  *
@@ -634,12 +661,17 @@ VmBackupStartCommon(RpcInData *data,
    /* Instantiate the backup state and start the operation. */
    gBackupState->ctx = data->appCtx;
    gBackupState->pollPeriod = 1000;
+   gBackupState->parallelScripts = VmBackupConfigGetBoolean(ctx->config,
+                                                            "parallelScripts",
+                                                            FALSE);
    gBackupState->machineState = VMBACKUP_MSTATE_IDLE;
    gBackupState->provider = provider;
    g_debug("Using quiesceApps = %d, quiesceFS = %d, allowHWProvider = %d,"
-           "execScripts = %d, scriptArg = %s, timeout = %u\n",
+           "execScripts = %d, parallelScripts = %d, scriptArg = %s, "
+           "timeout = %u\n",
            gBackupState->quiesceApps, gBackupState->quiesceFS,
            gBackupState->allowHWProvider, gBackupState->execScripts,
+           gBackupState->parallelScripts,
            (gBackupState->scriptArg != NULL) ? gBackupState->scriptArg : "",
            gBackupState->timeout);
    g_debug("Quiescing volumes: %s",
@@ -908,6 +940,9 @@ VmBackupDumpState(gpointer src,
                          "Backup is in state: %s\n",
                          VmBackupGetStateName(gBackupState->machineState));
    }
+#if !defined(G_PLATFORM_WIN32)
+   VmBackup_SyncDriverDumpState();
+#endif
 }
 
 
@@ -42,6 +42,11 @@ typedef struct VmBackupDriverOp {
    SyncDriverHandle *syncHandle;
 } VmBackupDriverOp;
 
+#if !defined(_WIN32)
+/* Timing of the last freeze / thaw cycle, for the state dump. */
+static SyncDriverStats *gLastStats = NULL;
+#endif
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -64,6 +69,20 @@ static Bool
 VmBackupDriverThaw(VmBackupDriverOp *op)
 {
    Bool success = SyncDriver_Thaw(*op->syncHandle);
+
+#if !defined(_WIN32)
+   SyncDriver_FreeStats(gLastStats);
+   gLastStats = SyncDriver_GetStats(*op->syncHandle);
+   if (gLastStats != NULL) {
+      g_message("Froze %"FMTSZ"u file systems in %d waves; I/O was blocked "
+                "for %.3f seconds (freeze %.3f, thaw %.3f).\n",
+                gLastStats->mountCnt, gLastStats->waveCnt,
+                gLastStats->frozenUS / 1000000.0,
+                gLastStats->freezeUS / 1000000.0,
+                gLastStats->thawUS / 1000000.0);
+   }
+#endif
+
    SyncDriver_CloseHandle(op->syncHandle);
    return success;
 }
@@ -363,6 +382,55 @@ VmBackupSyncDriverRelease(struct VmBackupSyncProvider *provider)
 }
 
 
+#if !defined(_WIN32)
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ *  VmBackup_SyncDriverDumpState --
+ *
+ *    Logs how long each file system took to freeze and stayed frozen during
+ *    the last freeze / thaw cycle of the sync driver.
+ *
+ * Result
+ *    None.
+ *
+ * Side effects:
+ *    None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+VmBackup_SyncDriverDumpState(void)
+{
+   size_t i;
+
+   if (gLastStats == NULL) {
+      return;
+   }
+
+   ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN,
+                      "Last freeze: %"FMTSZ"u file systems in %d waves, "
+                      "frozen for %.3f s (freeze %.3f s, thaw %.3f s)\n",
+                      gLastStats->mountCnt, gLastStats->waveCnt,
+                      gLastStats->frozenUS / 1000000.0,
+                      gLastStats->freezeUS / 1000000.0,
+                      gLastStats->thawUS / 1000000.0);
+
+   for (i = 0; i < gLastStats->mountCnt; i++) {
+      SyncDriverMountStats *ms = &gLastStats->mounts[i];
+
+      ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN,
+                         "   %s: wave %d, freeze %.3f ms, frozen %.3f s\n",
+                         ms->path, ms->wave, ms->freezeUS / 1000.0,
+                         ms->frozenUS / 1000000.0);
+   }
+}
+
+#endif
+
+
 /*
  *-----------------------------------------------------------------------------
  *
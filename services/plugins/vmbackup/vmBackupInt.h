@@ -94,12 +94,14 @@ typedef struct VmBackupState {
    Bool           quiesceFS;
    Bool           allowHWProvider;
    Bool           execScripts;
+   Bool           parallelScripts;
    char          *scriptArg;
    guint          timeout;
    gpointer       clientData;
    void          *scripts;
    const char    *configDir;
    ssize_t        currentScript;
+   VmTimeType     quiesceStart;
    gchar         *errorMsg;
    VmBackupMState machineState;
    struct VmBackupSyncProvider *provider;
@@ -211,6 +213,11 @@ VmBackup_NewNullProvider(void);
 VmBackupSyncProvider *
 VmBackup_NewSyncDriverProvider(void);
 
+#if !defined(G_PLATFORM_WIN32)
+void
+VmBackup_SyncDriverDumpState(void);
+#endif
+
 #if defined(G_PLATFORM_WIN32)
 VmBackupSyncProvider *
 VmBackup_NewVssProvider(void);
@@ -223,6 +230,9 @@ VmBackupOp *
 VmBackup_NewScriptOp(VmBackupScriptType freeze,
                      VmBackupState *state);
 
+void
+VmBackup_WakeUp(VmBackupState *state);
+
 Bool
 VmBackup_SendEvent(const char *event,
                    const uint32 code,
@@ -29,6 +29,12 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#  include <errno.h>
+#  include <unistd.h>
+#  include <sys/inotify.h>
+#endif
 #include "toolsCoreInt.h"
 #include "conf.h"
 #include "guestApp.h"
@@ -41,6 +47,9 @@
 #include "vmware/tools/utils.h"
 #include "vmware/tools/vmbackup.h"
 
+static void
+ToolsCoreStopConfCheck(ToolsServiceState *state);
+
 /*
  ******************************************************************************
  * ToolsCoreCleanup --                                                  */ /**
@@ -56,6 +65,7 @@
 static void
 ToolsCoreCleanup(ToolsServiceState *state)
 {
+   ToolsCoreStopConfCheck(state);
    ToolsCorePool_Shutdown(&state->ctx);
    ToolsCore_UnloadPlugins(state);
    if (state->ctx.rpc != NULL) {
@@ -138,10 +148,238 @@ ToolsCoreConfFileCb(gpointer clientData)
 }
 
 
+/**
+ * Timer callback for a reload scheduled by ToolsCoreScheduleConfReload(). If
+ * the reload was forced, the modification time is reset so that the file
+ * is re-read even if it was changed more than once within the mtime
+ * granularity; otherwise the file is only re-read if its mtime changed.
+ *
+ * @param[in]  clientData  Service state.
+ *
+ * @return FALSE.
+ */
+
+static gboolean
+ToolsCoreConfReloadCb(gpointer clientData)
+{
+   ToolsServiceState *state = clientData;
+
+   state->configReloadTask = 0;
+   if (state->configReloadForce) {
+      state->configMtime = 0;
+      state->configReloadForce = FALSE;
+   }
+   ToolsCore_ReloadConfig(state, FALSE);
+   return FALSE;
+}
+
+
+/**
+ * Schedules a reload of the config file. Editors usually save a file with a
+ * burst of events (truncate, several writes, rename), so the reload is
+ * delayed until no new event has arrived for CONF_POLL_TIME ms.
+ *
+ * @param[in]  state    Service state.
+ * @param[in]  force    Whether to re-read the file even if its mtime did not
+ *                      change; should only be set when the file is known to
+ *                      have been modified (i.e., by the file watch).
+ */
+
+static void
+ToolsCoreScheduleConfReload(ToolsServiceState *state,
+                            gboolean force)
+{
+   if (state->configReloadTask > 0) {
+      g_source_remove(state->configReloadTask);
+   }
+   state->configReloadForce |= force;
+   state->configReloadTask = g_timeout_add(CONF_POLL_TIME,
+                                           ToolsCoreConfReloadCb,
+                                           state);
+}
+
+
+#if defined(__linux__)
+/**
+ * Callback for the inotify watch on the config file's directory. Schedules
+ * a reload if any of the events refer to the config file.
+ *
+ * If the directory itself goes away the watch becomes useless, so fall back
+ * to polling the file.
+ *
+ * @param[in]  chan     The inotify channel.
+ * @param[in]  cond     Unused.
+ * @param[in]  data     Service state.
+ *
+ * @return Whether to keep the watch installed.
+ */
+
+static gboolean
+ToolsCoreConfWatchCb(GIOChannel *chan,
+                     GIOCondition cond,
+                     gpointer data)
+{
+   ToolsServiceState *state = data;
+   gchar *confName;
+   gboolean changed = FALSE;
+   gboolean keep = TRUE;
+   char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+   ssize_t len;
+   ssize_t off;
+
+   len = read(g_io_channel_unix_get_fd(chan), buf, sizeof buf);
+   if (len <= 0) {
+      if (len == 0 || (errno != EINTR && errno != EAGAIN)) {
+         g_warning("Error reading config file watch, falling back to "
+                   "polling.\n");
+         keep = FALSE;
+      }
+      goto exit;
+   }
+
+   confName = g_path_get_basename(state->configFile != NULL ?
+                                  state->configFile : CONF_FILE);
+
+   for (off = 0; off < len; ) {
+      struct inotify_event *ev = (struct inotify_event *) (buf + off);
+
+      if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+         g_debug("Config directory went away, falling back to polling.\n");
+         keep = FALSE;
+         changed = TRUE;
+      } else if ((ev->mask & IN_Q_OVERFLOW) ||
+                 (ev->len > 0 && strcmp(ev->name, confName) == 0)) {
+         changed = TRUE;
+      }
+      off += sizeof *ev + ev->len;
+   }
+
+   g_free(confName);
+
+   if (changed) {
+      ToolsCoreScheduleConfReload(state, TRUE);
+   }
+
+exit:
+   if (!keep) {
+      state->configCheckTask = g_timeout_add(CONF_POLL_TIME * 10,
+                                             ToolsCoreConfFileCb,
+                                             state);
+   }
+   return keep;
+}
+
+
+/**
+ * Installs an inotify watch on the directory holding the config file, so
+ * that the file is reloaded as soon as it changes without having to poll it.
+ * The directory is watched instead of the file since most editors replace
+ * the file instead of writing to it.
+ *
+ * @param[in]  state    Service state.
+ *
+ * @return ID of the watch source, 0 if the watch could not be installed.
+ */
+
+static guint
+ToolsCoreAddConfWatch(ToolsServiceState *state)
+{
+   GIOChannel *chan;
+   gchar *confDir;
+   guint id = 0;
+   int fd;
+
+   fd = inotify_init();
+   if (fd < 0) {
+      g_debug("Cannot create inotify instance: %s\n", strerror(errno));
+      return 0;
+   }
+
+   if (state->configFile != NULL) {
+      confDir = g_path_get_dirname(state->configFile);
+   } else {
+      char *confPath = GuestApp_GetConfPath();
+      confDir = g_strdup(confPath);
+      free(confPath);
+   }
+
+   if (confDir == NULL ||
+       inotify_add_watch(fd, confDir,
+                         IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                         IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+                         IN_MOVE_SELF | IN_ONLYDIR) < 0) {
+      g_debug("Cannot watch config directory %s: %s\n",
+              confDir != NULL ? confDir : "(null)", strerror(errno));
+      close(fd);
+      g_free(confDir);
+      return 0;
+   }
+   g_free(confDir);
+
+   chan = g_io_channel_unix_new(fd);
+   g_io_channel_set_close_on_unref(chan, TRUE);
+   id = g_io_add_watch(chan, G_IO_IN, ToolsCoreConfWatchCb, state);
+   g_io_channel_unref(chan);
+
+   return id;
+}
+#endif
+
+
+/**
+ * Starts monitoring the config file for changes. On Linux this uses inotify;
+ * if that is not available, the file is polled periodically instead.
+ *
+ * @param[in]  state    Service state.
+ */
+
+static void
+ToolsCoreStartConfCheck(ToolsServiceState *state)
+{
+   ASSERT(state->configCheckTask == 0);
+
+#if defined(__linux__)
+   state->configCheckTask = ToolsCoreAddConfWatch(state);
+   if (state->configCheckTask > 0) {
+      return;
+   }
+#endif
+
+   state->configCheckTask = g_timeout_add(CONF_POLL_TIME * 10,
+                                          ToolsCoreConfFileCb,
+                                          state);
+}
+
+
+/**
+ * Stops monitoring the config file, cancelling any pending reload.
+ *
+ * @param[in]  state    Service state.
+ */
+
+static void
+ToolsCoreStopConfCheck(ToolsServiceState *state)
+{
+   if (state->configCheckTask > 0) {
+      g_source_remove(state->configCheckTask);
+      state->configCheckTask = 0;
+   }
+   if (state->configReloadTask > 0) {
+      g_source_remove(state->configReloadTask);
+      state->configReloadTask = 0;
+   }
+}
+
+
 /**
  * IO freeze signal handler. Disables the conf file check task if I/O is
  * frozen, re-enable it otherwise. See bug 529653.
  *
+ * Changes made while I/O was frozen are not seen by the file watch, so a
+ * check is scheduled on thaw to pick them up. It only reloads the file if
+ * its mtime changed, so that a quiesced snapshot does not by itself cause a
+ * reload (and the logging reset and signal that come with it).
+ *
  * @param[in]  src      The source object.
  * @param[in]  ctx      Unused.
  * @param[in]  freeze   Whether I/O is being frozen.
@@ -155,12 +393,10 @@ ToolsCoreIOFreezeCb(gpointer src,
                     ToolsServiceState *state)
 {
    if (state->configCheckTask > 0 && freeze) {
-      g_source_remove(state->configCheckTask);
-      state->configCheckTask = 0;
+      ToolsCoreStopConfCheck(state);
    } else if (state->configCheckTask == 0 && !freeze) {
-      state->configCheckTask = g_timeout_add(CONF_POLL_TIME * 10,
-                                             ToolsCoreConfFileCb,
-                                             state);
+      ToolsCoreStartConfCheck(state);
+      ToolsCoreScheduleConfReload(state, FALSE);
    }
 }
 
@@ -226,9 +462,7 @@ ToolsCoreRunLoop(ToolsServiceState *state)
                           state);
       }
 
-      state->configCheckTask = g_timeout_add(CONF_POLL_TIME * 10,
-                                             ToolsCoreConfFileCb,
-                                             state);
+      ToolsCoreStartConfCheck(state);
 
 #if defined(__APPLE__)
       ToolsCore_CFRunLoop(state);
@@ -27,6 +27,7 @@
 
 #include "vm_assert.h"
 #include "guestApp.h"
+#include "rpcin.h"
 #include "serviceObj.h"
 #include "util.h"
 #include "vmware/tools/i18n.h"
@@ -133,7 +134,8 @@ ToolsCoreDumpProperty(ToolsAppCtx *ctx,
 
 
 /**
- * State dump callback for GuestRPC applications.
+ * State dump callback for GuestRPC applications. When called for the
+ * provider itself (@a reg is NULL), dumps the counters of the RpcIn loop.
  *
  * @param[in]  ctx   The application context.
  * @param[in]  prov  Unused.
@@ -145,9 +147,24 @@ ToolsCoreDumpRPC(ToolsAppCtx *ctx,
                  ToolsAppProvider *prov,
                  gpointer reg)
 {
+   RpcInStats stats;
+
    if (reg != NULL) {
       RpcChannelCallback *cb = reg;
       ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN, "RPC callback: %s\n", cb->name);
+   } else if (ctx->rpc != NULL && BackdoorChannel_GetStats(ctx->rpc, &stats)) {
+      ASSERT_ON_COMPILE(RPCIN_LATENCY_BUCKETS == 8);
+      ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN,
+                         "RpcIn: %"FMT64"u polls, %"FMT64"u empty\n",
+                         stats.polls, stats.emptyPolls);
+      ToolsCore_LogState(TOOLS_STATE_LOG_PLUGIN,
+                         "RpcIn dispatch latency (ms): <1:%"FMT64"u "
+                         "<2:%"FMT64"u <4:%"FMT64"u <8:%"FMT64"u "
+                         "<16:%"FMT64"u <32:%"FMT64"u <64:%"FMT64"u "
+                         ">=64:%"FMT64"u\n",
+                         stats.latency[0], stats.latency[1], stats.latency[2],
+                         stats.latency[3], stats.latency[4], stats.latency[5],
+                         stats.latency[6], stats.latency[7]);
    }
 }
 
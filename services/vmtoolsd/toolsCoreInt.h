@@ -71,6 +71,8 @@ typedef struct ToolsServiceState {
    gchar         *configFile;
    time_t         configMtime;
    guint          configCheckTask;
+   guint          configReloadTask;
+   gboolean       configReloadForce;
    gboolean       mainService;
    gboolean       capsRegistered;
    gchar         *commonPath;
@@ -203,6 +203,33 @@ ToolsCoreRpcSetOption(RpcInData *data)
 }
 
 
+/**
+ * Reads a non-negative integer from the service's section of the config file.
+ *
+ * @param[in]  state    The service state.
+ * @param[in]  key      Config key to read.
+ * @param[in]  defVal   Value to use if the key is not set or is invalid.
+ *
+ * @return The configured value, or @a defVal.
+ */
+
+static guint
+ToolsCoreRpcGetConfigUInt(ToolsServiceState *state,
+                          const gchar *key,
+                          guint defVal)
+{
+   GError *err = NULL;
+   gint val;
+
+   val = g_key_file_get_integer(state->ctx.config, state->name, key, &err);
+   if (err != NULL || val < 0) {
+      g_clear_error(&err);
+      return defVal;
+   }
+   return (guint) val;
+}
+
+
 /**
  * Initializes the RPC channel. Currently this instantiates an RpcIn loop.
  * This function should only be called once.
@@ -246,6 +273,17 @@ ToolsCore_InitRpc(ToolsServiceState *state)
          state->ctx.rpc = NULL;
       } else {
          state->ctx.rpc = BackdoorChannel_New();
+
+         /*
+          * Let the user trade idle CPU usage for RPC latency: the RpcIn loop
+          * polls the host every "rpcin.minDelay" to "rpcin.maxDelay" (.01s
+          * units), and keeps polling without delay for "rpcin.burst" polls
+          * after receiving a message.
+          */
+         BackdoorChannel_SetSchedule(state->ctx.rpc,
+                                     ToolsCoreRpcGetConfigUInt(state, "rpcin.minDelay", 0),
+                                     ToolsCoreRpcGetConfigUInt(state, "rpcin.maxDelay", 0),
+                                     ToolsCoreRpcGetConfigUInt(state, "rpcin.burst", 0));
       }
       app = ToolsCore_GetTcloName(state);
       if (app == NULL) {
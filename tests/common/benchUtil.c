@@ -0,0 +1,171 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * benchUtil.c --
+ *
+ *      Helpers shared by the benchmarks and simulators under tests/.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "benchUtil.h"
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Bench_Now --
+ *
+ *      Monotonic time stamp.
+ *
+ * Results:
+ *      Current time in ns.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+uint64
+Bench_Now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCompareSamples --
+ *
+ *      qsort comparator for latency samples.
+ *
+ * Results:
+ *      <0, 0, >0.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+BenchCompareSamples(const void *a,  // IN
+                    const void *b)  // IN
+{
+   uint64 x = *(const uint64 *)a;
+   uint64 y = *(const uint64 *)b;
+
+   return x < y ? -1 : x > y;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Bench_SortSamples --
+ *
+ *      Sorts latency samples in ascending order, as expected by
+ *      Bench_PrintPercentiles().
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+Bench_SortSamples(uint64 *ns,     // IN/OUT
+                  size_t count)   // IN
+{
+   qsort(ns, count, sizeof *ns, BenchCompareSamples);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Bench_PrintPercentiles --
+ *
+ *      Prints the 50th, 90th and 99th percentiles and the maximum of sorted
+ *      latency samples, in us, as four columns of width 10 (each preceded
+ *      by a space). Does not end the line.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+Bench_PrintPercentiles(const uint64 *ns,   // IN: sorted samples
+                       size_t count)       // IN: at least 1
+{
+   printf(" %10.1f %10.1f %10.1f %10.1f",
+          ns[count / 2] / 1e3,
+          ns[count * 9 / 10] / 1e3,
+          ns[count * 99 / 100] / 1e3,
+          ns[count - 1] / 1e3);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Bench_Usage --
+ *
+ *      Prints "Usage: prog synopsis", then the description of the program,
+ *      and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+Bench_Usage(const char *prog,       // IN
+            const char *synopsis,   // IN: options and arguments
+            const char *fmt,        // IN: description
+            ...)                    // IN
+{
+   va_list args;
+
+   fprintf(stderr, "Usage: %s %s\n\n", prog, synopsis);
+   va_start(args, fmt);
+   vfprintf(stderr, fmt, args);
+   va_end(args);
+   exit(1);
+}
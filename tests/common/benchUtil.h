@@ -0,0 +1,40 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * benchUtil.h --
+ *
+ *      Helpers shared by the benchmarks and simulators under tests/:
+ *      time stamps, latency percentiles and usage messages. The source is
+ *      built into each program (see the programs' Makefile.am).
+ */
+
+#ifndef _BENCHUTIL_H_
+#define _BENCHUTIL_H_
+
+#include <stddef.h>
+
+#include "vm_basic_types.h"
+
+uint64 Bench_Now(void);
+void Bench_SortSamples(uint64 *ns, size_t count);
+void Bench_PrintPercentiles(const uint64 *ns, size_t count);
+NORETURN void Bench_Usage(const char *prog, const char *synopsis,
+                          const char *fmt, ...) PRINTF_DECL(3, 4);
+
+#endif /* _BENCHUTIL_H_ */
@@ -0,0 +1,178 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * fakeMessage.c --
+ *
+ *      Message_Channel implementation for the RpcIn benchmarks and tests
+ *      under tests/.
+ */
+
+#include <string.h>
+
+#include "vmware.h"
+#include "message.h"
+#include "fakeMessage.h"
+
+struct Message_Channel {
+   Bool open;
+};
+
+static Message_Channel fakeChannel;
+static FakeMessageHost fakeHost;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FakeMessage_Init --
+ *
+ *      Sets the callbacks playing the host side of the channel.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+FakeMessage_Init(const FakeMessageHost *host)   // IN
+{
+   ASSERT(host->receive != NULL);
+
+   fakeHost = *host;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Message_Open --
+ *
+ *      Opens the (single) fake channel.
+ *
+ * Results:
+ *      The channel, or NULL if it is already open.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Message_Channel *
+Message_Open(uint32 proto)   // IN: Unused
+{
+   if (fakeChannel.open) {
+      return NULL;
+   }
+   fakeChannel.open = TRUE;
+   return &fakeChannel;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Message_Send --
+ *
+ *      Hands a reply of the guest to the host callback.
+ *
+ * Results:
+ *      TRUE.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+Message_Send(Message_Channel *chan,    // IN/OUT
+             const unsigned char *buf, // IN
+             size_t bufSize)           // IN
+{
+   ASSERT(chan == &fakeChannel && chan->open);
+
+   if (fakeHost.send != NULL) {
+      fakeHost.send(fakeHost.clientData, (const char *)buf, bufSize);
+   }
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Message_Receive --
+ *
+ *      Polls the host callback for a request. Like the backdoor channel,
+ *      the buffer stays valid until the next call.
+ *
+ * Results:
+ *      TRUE, with an empty message if the host has nothing to send.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+Message_Receive(Message_Channel *chan, // IN/OUT
+                unsigned char **buf,   // OUT
+                size_t *bufSize)       // OUT
+{
+   const char *msg;
+
+   ASSERT(chan == &fakeChannel && chan->open);
+
+   msg = fakeHost.receive(fakeHost.clientData);
+   *buf = (unsigned char *)(msg != NULL ? msg : "");
+   *bufSize = msg != NULL ? strlen(msg) : 0;
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Message_Close --
+ *
+ *      Closes the fake channel.
+ *
+ * Results:
+ *      TRUE.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+Message_Close(Message_Channel *chan) // IN/OUT
+{
+   ASSERT(chan == &fakeChannel && chan->open);
+
+   chan->open = FALSE;
+   return TRUE;
+}
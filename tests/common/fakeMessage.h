@@ -0,0 +1,50 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * fakeMessage.h --
+ *
+ *      Message_Channel implementation for the RpcIn benchmarks and tests
+ *      under tests/. Programs that build fakeMessage.c and link lib/rpcIn
+ *      statically get this channel instead of the backdoor: the "host"
+ *      side is a pair of callbacks set with FakeMessage_Init().
+ */
+
+#ifndef _FAKEMESSAGE_H_
+#define _FAKEMESSAGE_H_
+
+#include <stddef.h>
+
+#include "vm_basic_types.h"
+
+typedef struct FakeMessageHost {
+   /*
+    * Returns the next TCLO request for the guest (a NUL terminated
+    * string), or NULL when there is none. Called for each poll.
+    */
+   const char *(*receive)(void *clientData);
+
+   /* Called with each reply sent by the guest. May be NULL. */
+   void (*send)(void *clientData, const char *buf, size_t bufSize);
+
+   void *clientData;
+} FakeMessageHost;
+
+void FakeMessage_Init(const FakeMessageHost *host);
+
+#endif /* _FAKEMESSAGE_H_ */
@@ -0,0 +1,248 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * guestInfoBench.c --
+ *
+ *   Benchmark for the guestInfo NIC collector. Times repeated collections
+ *   of the guest's network configuration:
+ *
+ *     netlink - links, addresses and routes with rtnetlink dumps
+ *     full    - GuestInfo_GetNicInfo, i.e. what the plugin does on
+ *               every NIC poll (including resolver settings)
+ *
+ *   Meant to be run through guestInfoBench.sh, which builds a network
+ *   namespace with a few hundred synthetic interfaces and routes so the
+ *   numbers do not depend on the configuration of the machine.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "vmware.h"
+#include "getlibInt.h"
+#include "guestInfoLib.h"
+#include "vmxrpc.h"
+#include "benchUtil.h"
+
+#define BENCH_DEFAULT_ITERATIONS 1000
+
+typedef Bool (*BenchCollectFn)(NicInfoV3 *nicInfo);
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchNullLog --
+ *
+ *      glib log handler that drops messages, so that per-NIC messages (e.g.
+ *      about the NIC limit being reached) are not part of the measurements.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchNullLog(const gchar *domain,    // IN
+             GLogLevelFlags level,   // IN
+             const gchar *message,   // IN
+             gpointer data)          // IN
+{
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCollectFull --
+ *
+ *      Collects the NIC info the way the guestInfo plugin does.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchCollectFull(NicInfoV3 *nicInfo)  // OUT
+{
+   NicInfoV3 *info;
+
+   if (!GuestInfo_GetNicInfo(&info)) {
+      return FALSE;
+   }
+   *nicInfo = *info;
+   free(info);
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRun --
+ *
+ *      Times iterations of a collector and prints one line of results.
+ *
+ * Results:
+ *      TRUE if all the collections succeeded.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchRun(const char *name,          // IN
+         BenchCollectFn collect,    // IN
+         unsigned int iterations)   // IN
+{
+   uint64 *ns;
+   uint64 total = 0;
+   unsigned int nics = 0;
+   unsigned int ips = 0;
+   unsigned int routes = 0;
+   unsigned int i;
+
+   ns = calloc(iterations, sizeof *ns);
+   if (ns == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      return FALSE;
+   }
+
+   for (i = 0; i < iterations; i++) {
+      NicInfoV3 nicInfo;
+      uint64 start;
+
+      memset(&nicInfo, 0, sizeof nicInfo);
+      start = Bench_Now();
+      if (!collect(&nicInfo)) {
+         fprintf(stderr, "%s: collection failed.\n", name);
+         VMX_XDR_FREE(xdr_NicInfoV3, &nicInfo);
+         free(ns);
+         return FALSE;
+      }
+      ns[i] = Bench_Now() - start;
+      total += ns[i];
+
+      if (i == 0) {
+         u_int j;
+
+         nics = nicInfo.nics.nics_len;
+         for (j = 0; j < nicInfo.nics.nics_len; j++) {
+            ips += nicInfo.nics.nics_val[j].ips.ips_len;
+         }
+         routes = nicInfo.routes.routes_len;
+      }
+      VMX_XDR_FREE(xdr_NicInfoV3, &nicInfo);
+   }
+
+   Bench_SortSamples(ns, iterations);
+   printf("%-8s %6u %6u %6u %10u %10.1f", name, nics, ips, routes,
+          iterations, total / 1e3 / iterations);
+   Bench_PrintPercentiles(ns, iterations);
+   printf("\n");
+
+   free(ns);
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog, "[-v] [-n iterations]",
+               "Collects the network configuration of the current network\n"
+               "namespace %u times (by default) with each collector, and\n"
+               "prints the number of NICs, IPs and routes reported and the\n"
+               "collection time. Log messages are dropped unless -v is "
+               "given.\n",
+               BENCH_DEFAULT_ITERATIONS);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   unsigned int iterations = BENCH_DEFAULT_ITERATIONS;
+   Bool verbose = FALSE;
+   Bool ok = TRUE;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "n:v")) != -1) {
+      switch (opt) {
+      case 'n':
+         iterations = strtoul(optarg, NULL, 0);
+         break;
+      case 'v':
+         verbose = TRUE;
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc || iterations == 0) {
+      BenchUsage(argv[0]);
+   }
+
+   if (!verbose) {
+      g_log_set_default_handler(BenchNullLog, NULL);
+   }
+
+   printf("%-8s %6s %6s %6s %10s %10s %10s %10s %10s %10s\n", "collector",
+          "nics", "ips", "routes", "count", "avg(us)", "p50(us)", "p90(us)",
+          "p99(us)", "max(us)");
+
+#if defined(__linux__)
+   ok &= BenchRun("netlink", GuestInfoGetNicInfoNetlink, iterations);
+#endif
+   ok &= BenchRun("full", BenchCollectFull, iterations);
+
+   return ok ? 0 : 1;
+}
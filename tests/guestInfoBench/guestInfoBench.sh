@@ -0,0 +1,99 @@
+#!/bin/sh
+################################################################################
+### Copyright 2010 VMware, Inc.  All rights reserved.
+###
+### This program is free software; you can redistribute it and/or modify
+### it under the terms of version 2 of the GNU General Public License as
+### published by the Free Software Foundation.
+###
+### This program is distributed in the hope that it will be useful,
+### but WITHOUT ANY WARRANTY; without even the implied warranty of
+### MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+### GNU General Public License for more details.
+###
+### You should have received a copy of the GNU General Public License
+### along with this program; if not, write to the Free Software
+### Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+################################################################################
+
+#
+# guestInfoBench.sh --
+#
+#    Runs guestInfoBench in a private network namespace populated with
+#    synthetic interfaces, addresses and routes. Must be run as root.
+#
+#    usage: guestInfoBench.sh [-i interfaces] [-r routes] [-- bench args]
+#
+
+set -e
+
+BENCH=${BENCH:-`dirname $0`/guestInfoBench}
+NUM_IFS=200
+NUM_ROUTES=400
+
+while getopts "i:r:" opt; do
+   case $opt in
+   i) NUM_IFS=$OPTARG ;;
+   r) NUM_ROUTES=$OPTARG ;;
+   *) echo "usage: $0 [-i interfaces] [-r routes] [-- bench args]" >&2
+      exit 1 ;;
+   esac
+done
+shift $((OPTIND - 1))
+
+#
+# Re-exec in a new network namespace; it goes away with the process, so
+# there is nothing to clean up.
+#
+if [ -z "$GUESTINFO_BENCH_NETNS" ]; then
+   GUESTINFO_BENCH_NETNS=1 exec unshare -n /bin/sh "$0" -i $NUM_IFS -r $NUM_ROUTES -- "$@"
+fi
+
+#
+# Interfaces are dummies when the kernel has them, otherwise veth pairs
+# (which create two interfaces each). Every interface gets an IPv4 and an
+# IPv6 address, and the routes are spread over them.
+#
+batch=`mktemp`
+trap "rm -f $batch" EXIT
+
+ip link set lo up
+if ip link add gibtest type dummy 2>/dev/null; then
+   ip link del gibtest
+   kind=dummy
+else
+   kind=veth
+fi
+
+i=0
+while [ $i -lt $NUM_IFS ]; do
+   hi=$((i / 256))
+   lo=$((i % 256))
+   if [ $kind = dummy ]; then
+      echo "link add gib$i type dummy"
+   else
+      echo "link add gib$i type veth peer name gibp$i"
+      echo "link set gibp$i up"
+   fi
+   echo "link set gib$i up"
+   echo "addr add 10.$hi.$lo.1/24 dev gib$i"
+   echo "addr add fd00::$hi:$lo:1/112 dev gib$i nodad"
+   i=$((i + 1))
+done > $batch
+ip -batch $batch
+
+i=0
+while [ $i -lt $NUM_ROUTES ]; do
+   nic=$((i % NUM_IFS))
+   hi=$((nic / 256))
+   lo=$((nic % 256))
+   echo "route add 172.$((16 + i / 65536)).$((i / 256 % 256)).$((i % 256))/32" \
+        "via 10.$hi.$lo.2 metric $i"
+   i=$((i + 1))
+done > $batch
+ip -batch $batch
+ip route add default via 10.0.0.254
+
+echo "`ip -o link | wc -l` links, `ip -o addr | wc -l` addresses," \
+     "`ip route | wc -l` IPv4 routes, `ip -6 route | wc -l` IPv6 routes"
+"$BENCH" "$@"
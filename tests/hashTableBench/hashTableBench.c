@@ -0,0 +1,324 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * hashTableBench.c --
+ *
+ *   Throughput benchmark for lib/misc HashTable. For each key type
+ *   (string, case-insensitive string, integer), plain and atomic, every
+ *   round allocates a table with a small initial bucket count and times:
+ *
+ *     insert - inserting all the keys
+ *     hit    - looking up all the keys
+ *     miss   - looking up as many keys that are not in the table
+ *     delete - deleting all the keys (plain tables only)
+ *
+ *   The program only uses the public HashTable API, so the same source
+ *   can be linked against an older lib/misc/hashTable.c to compare
+ *   implementations.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vmware.h"
+#include "hashTable.h"
+#include "str.h"
+#include "benchUtil.h"
+
+#define BENCH_DEFAULT_KEYS     100000
+#define BENCH_DEFAULT_BUCKETS  64
+#define BENCH_DEFAULT_ROUNDS   20
+
+typedef enum {
+   BENCH_INSERT,
+   BENCH_HIT,
+   BENCH_MISS,
+   BENCH_DELETE,
+   BENCH_NUM_PHASES,
+} BenchPhase;
+
+static const char *benchPhaseNames[BENCH_NUM_PHASES] = {
+   "insert", "hit", "miss", "delete",
+};
+
+/* Keys of the table, and keys that are never inserted. */
+static const void **benchKeys;
+static const void **benchMissKeys;
+static unsigned int benchNumKeys;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchMakeKeys --
+ *
+ *      Fills benchKeys and benchMissKeys for a key type. String keys look
+ *      like file names; integer keys are spread over the word so the low
+ *      bits alone don't pick the bucket.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees the previous string keys.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchMakeKeys(int keyType)   // IN: HASH_*_KEY
+{
+   static Bool stringKeys = FALSE;
+   unsigned int i;
+
+   for (i = 0; stringKeys && i < benchNumKeys; i++) {
+      free((void *) benchKeys[i]);
+      free((void *) benchMissKeys[i]);
+   }
+
+   stringKeys = (keyType & HASH_TYPE_MASK) != HASH_INT_KEY;
+   for (i = 0; i < benchNumKeys; i++) {
+      if (stringKeys) {
+         benchKeys[i] = Str_Asprintf(NULL, "ProgramFiles-%u.dll", i);
+         benchMissKeys[i] = Str_Asprintf(NULL, "ProgramFiles-%u.exe", i);
+      } else {
+         benchKeys[i] = (const void *) (uintptr_t) ((i + 1) * 2654435761U);
+         benchMissKeys[i] =
+            (const void *) (uintptr_t) ((i + 1 + benchNumKeys) * 2654435761U);
+      }
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRound --
+ *
+ *      Runs one round of all the phases on a fresh table.
+ *
+ * Results:
+ *      TRUE if every operation returned the expected result. ns[phase]
+ *      gets the time of each phase.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchRound(int keyType,        // IN: HASH_* type and flags
+           uint32 buckets,     // IN: initial bucket count
+           uint64 *ns)         // OUT: per-phase times
+{
+   HashTable *ht = HashTable_Alloc(buckets, keyType, NULL);
+   Bool atomic = (keyType & HASH_FLAG_ATOMIC) != 0;
+   Bool ok = TRUE;
+   uint64 start;
+   unsigned int i;
+
+   start = Bench_Now();
+   for (i = 0; i < benchNumKeys; i++) {
+      ok &= HashTable_Insert(ht, benchKeys[i], (void *) benchKeys[i]);
+   }
+   ns[BENCH_INSERT] = Bench_Now() - start;
+
+   start = Bench_Now();
+   for (i = 0; i < benchNumKeys; i++) {
+      void *value = NULL;
+
+      ok &= HashTable_Lookup(ht, benchKeys[i], &value) &&
+            value == benchKeys[i];
+   }
+   ns[BENCH_HIT] = Bench_Now() - start;
+
+   start = Bench_Now();
+   for (i = 0; i < benchNumKeys; i++) {
+      ok &= !HashTable_Lookup(ht, benchMissKeys[i], NULL);
+   }
+   ns[BENCH_MISS] = Bench_Now() - start;
+
+   if (atomic) {
+      ns[BENCH_DELETE] = 0;
+      HashTable_FreeUnsafe(ht);
+   } else {
+      start = Bench_Now();
+      for (i = 0; i < benchNumKeys; i++) {
+         ok &= HashTable_Delete(ht, benchKeys[i]);
+      }
+      ns[BENCH_DELETE] = Bench_Now() - start;
+      HashTable_Free(ht);
+   }
+
+   return ok;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRun --
+ *
+ *      Runs the rounds for one kind of table and prints one line of
+ *      results per phase.
+ *
+ * Results:
+ *      TRUE if all the rounds succeeded.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchRun(const char *name,       // IN
+         int keyType,            // IN: HASH_* type and flags
+         uint32 buckets,         // IN: initial bucket count
+         unsigned int rounds)    // IN
+{
+   uint64 *ns[BENCH_NUM_PHASES];
+   uint64 total[BENCH_NUM_PHASES] = { 0 };
+   Bool ok = TRUE;
+   unsigned int phase;
+   unsigned int r;
+
+   for (phase = 0; phase < BENCH_NUM_PHASES; phase++) {
+      ns[phase] = calloc(rounds, sizeof *ns[phase]);
+      if (ns[phase] == NULL) {
+         fprintf(stderr, "Out of memory.\n");
+         exit(1);
+      }
+   }
+
+   BenchMakeKeys(keyType);
+
+   for (r = 0; r < rounds; r++) {
+      uint64 sample[BENCH_NUM_PHASES];
+
+      if (!BenchRound(keyType, buckets, sample)) {
+         fprintf(stderr, "%s: unexpected HashTable result.\n", name);
+         ok = FALSE;
+      }
+      for (phase = 0; phase < BENCH_NUM_PHASES; phase++) {
+         ns[phase][r] = sample[phase];
+         total[phase] += sample[phase];
+      }
+   }
+
+   for (phase = 0; phase < BENCH_NUM_PHASES; phase++) {
+      if (total[phase] != 0) {
+         Bench_SortSamples(ns[phase], rounds);
+         printf("%-8s %-8s %10u %10.1f %10.2f", name, benchPhaseNames[phase],
+                benchNumKeys, (double) total[phase] / rounds / benchNumKeys,
+                (double) benchNumKeys * rounds / (total[phase] / 1e3));
+         Bench_PrintPercentiles(ns[phase], rounds);
+         printf("\n");
+      }
+      free(ns[phase]);
+   }
+
+   return ok;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog, "[-k keys] [-b buckets] [-n rounds]",
+               "Inserts, looks up and deletes %u keys (by default) in\n"
+               "HashTables that start with %u buckets, %u times. Prints the\n"
+               "average time per operation, the throughput and the\n"
+               "percentiles of the time of a whole phase.\n",
+               BENCH_DEFAULT_KEYS, BENCH_DEFAULT_BUCKETS,
+               BENCH_DEFAULT_ROUNDS);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   uint32 buckets = BENCH_DEFAULT_BUCKETS;
+   unsigned int rounds = BENCH_DEFAULT_ROUNDS;
+   Bool ok = TRUE;
+   int opt;
+
+   benchNumKeys = BENCH_DEFAULT_KEYS;
+
+   while ((opt = getopt(argc, argv, "b:k:n:")) != -1) {
+      switch (opt) {
+      case 'b':
+         buckets = strtoul(optarg, NULL, 0);
+         break;
+      case 'k':
+         benchNumKeys = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         rounds = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc || buckets == 0 || benchNumKeys == 0 || rounds == 0) {
+      BenchUsage(argv[0]);
+   }
+
+   benchKeys = calloc(benchNumKeys, sizeof *benchKeys);
+   benchMissKeys = calloc(benchNumKeys, sizeof *benchMissKeys);
+   if (benchKeys == NULL || benchMissKeys == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      return 1;
+   }
+
+   printf("%-8s %-8s %10s %10s %10s %10s %10s %10s %10s\n", "table",
+          "phase", "keys", "ns/op", "Mops/s", "p50(us)", "p90(us)",
+          "p99(us)", "max(us)");
+
+   ok &= BenchRun("string", HASH_STRING_KEY, buckets, rounds);
+   ok &= BenchRun("istring", HASH_ISTRING_KEY, buckets, rounds);
+   ok &= BenchRun("atomic", HASH_STRING_KEY | HASH_FLAG_ATOMIC, buckets,
+                  rounds);
+   ok &= BenchRun("int", HASH_INT_KEY, buckets, rounds);
+   ok &= BenchRun("atomint", HASH_INT_KEY | HASH_FLAG_ATOMIC, buckets,
+                  rounds);
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,1558 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * hgfsServerBench.c --
+ *
+ *   Offline benchmark for the HGFS server. Links the server with a
+ *   loopback transport standing in for the guest channel (see
+ *   hgfsChannelGuestBd.c) and drives it with a synthetic stream of V3
+ *   requests over a local directory:
+ *
+ *     create  - open/create, write the whole file, close
+ *     read    - open, read the whole file, close
+ *     getattr - getattr by name
+ *     search  - search open, read every entry, search close
+ *     case    - getattr by name with a case-insensitive lookup (-c), in
+ *               a tree of directories with one file each
+ *
+ *   With -o, the clients also hold that many extra handles open while
+ *   they read and list the files, so handle lookups run against a
+ *   populated session.
+ *
+ *   With -4, each client creates a V4 session and sends every request
+ *   with a V4 header. File data is then written and read with
+ *   WRITE_FAST_V4 and READ_FAST_V4, through a data packet split into
+ *   pages as the VMCI transport does, with guest "physical" addresses
+ *   mapped one to one.
+ *
+ *   With -a, the requests of all the clients go through a single
+ *   dispatcher thread, as the backdoor requests all go through the RPC
+ *   thread of vmtoolsd. With a non-zero number of workers, the transport
+ *   supports asynchronous replies and the server hands its REQ_ASYNC
+ *   requests to a pool of that many threads (see HgfsServer_SetExecutor);
+ *   with 0 workers every request runs on the dispatcher thread.
+ *
+ *   Each client thread has its own transport session and works on its
+ *   own share of the files. For every op the program reports ops/sec,
+ *   MB/s and latency percentiles, so server changes can be measured on a
+ *   plain Linux box without a hypervisor.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "vmware.h"
+#include "hgfs.h"
+#include "hgfsProto.h"
+#include "hgfsServer.h"
+#include "hgfsServerPolicy.h"
+#include "benchUtil.h"
+
+#define BENCH_DEFAULT_FILES      64
+#define BENCH_DEFAULT_FILE_SIZE  (1024 * 1024)
+#define BENCH_DEFAULT_IO_SIZE    HGFS_LARGE_IO_MAX
+#define BENCH_DEFAULT_ITERATIONS 4
+
+/*
+ * The case-insensitive lookups alternate between the directories of the
+ * client and a small set of hot directories that every client keeps using.
+ */
+#define BENCH_CASE_DIR           "case"
+#define BENCH_CASE_HOT_DIRS      32
+
+typedef enum {
+   BENCH_OP_OPEN,
+   BENCH_OP_READ,
+   BENCH_OP_WRITE,
+   BENCH_OP_CLOSE,
+   BENCH_OP_GETATTR,
+   BENCH_OP_SEARCH_OPEN,
+   BENCH_OP_SEARCH_READ,
+   BENCH_OP_SEARCH_CLOSE,
+   BENCH_OP_CASE_GETATTR,
+   BENCH_OP_CREATE_SESSION,
+   BENCH_OP_MAX
+} BenchOp;
+
+static const char *benchOpNames[BENCH_OP_MAX] = {
+   "open",
+   "read",
+   "write",
+   "close",
+   "getattr",
+   "searchOpen",
+   "searchRead",
+   "searchClose",
+   "caseGetattr",
+   "newSession",
+};
+
+static const HgfsOp benchHgfsOps[BENCH_OP_MAX] = {
+   HGFS_OP_OPEN_V3,
+   HGFS_OP_READ_V3,
+   HGFS_OP_WRITE_V3,
+   HGFS_OP_CLOSE_V3,
+   HGFS_OP_GETATTR_V3,
+   HGFS_OP_SEARCH_OPEN_V3,
+   HGFS_OP_SEARCH_READ_V3,
+   HGFS_OP_SEARCH_CLOSE_V3,
+   HGFS_OP_GETATTR_V3,
+   HGFS_OP_CREATE_SESSION_V4,
+};
+
+/* Start of the request payload in the connection's request buffer. */
+#define BENCH_REQ_PAYLOAD(conn) ((conn)->request + benchHeaderSize)
+
+/* Latency samples and byte counts of one op. */
+typedef struct BenchSamples {
+   uint64 *ns;
+   size_t count;
+   size_t size;
+   uint64 bytes;
+} BenchSamples;
+
+/*
+ * A loopback connection: one HGFS transport session, the reply buffer the
+ * server writes into, and the samples collected by the client using it.
+ * With -4, also the V4 session and the pages of the data packet.
+ */
+typedef struct BenchConn {
+   HgfsServerChannelCallbacks channelCbTable;
+   void *serverSession;
+   uint64 sessionId;
+   uint32 nextId;
+   size_t replyLen;
+   HgfsPacket *packet;
+   char *data;
+   char request[HGFS_LARGE_PACKET_MAX];
+   char reply[HGFS_LARGE_PACKET_MAX];
+   BenchSamples samples[BENCH_OP_MAX];
+
+   /* With -a, signaled by BenchSend when the reply is in. */
+   pthread_mutex_t replyLock;
+   pthread_cond_t replyCond;
+   Bool replied;
+
+   /* Work assignment. */
+   unsigned int index;
+   unsigned int numConns;
+   Bool failed;
+} BenchConn;
+
+/* A work queue drained by one or more threads (with -a). */
+typedef struct BenchQueueEntry {
+   struct BenchQueueEntry *next;
+   void (*fn)(void *data);
+   void *data;
+} BenchQueueEntry;
+
+typedef struct BenchQueue {
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   BenchQueueEntry *head;
+   BenchQueueEntry **tail;
+   Bool stop;
+} BenchQueue;
+
+static HgfsServerSessionCallbacks *serverCbTable;
+
+static const char *benchDir;
+static unsigned int numFiles = BENCH_DEFAULT_FILES;
+static uint32 fileSize = BENCH_DEFAULT_FILE_SIZE;
+static uint32 ioSize = BENCH_DEFAULT_IO_SIZE;
+static unsigned int iterations = BENCH_DEFAULT_ITERATIONS;
+static unsigned int numThreads = 1;
+static unsigned int numCaseDirs = 0;
+static unsigned int numHeldFiles = 0;
+static Bool useV4 = FALSE;
+static Bool useDispatcher = FALSE;
+static unsigned int numWorkers = 0;
+static BenchQueue dispatchQueue;
+static BenchQueue workQueue;
+static size_t benchHeaderSize = sizeof(HgfsRequest);
+static pthread_barrier_t createBarrier;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchAddSample --
+ *
+ *      Records the latency of one request.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Grows the sample array as needed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchAddSample(BenchSamples *samples,  // IN/OUT
+               uint64 ns,              // IN
+               uint64 bytes)           // IN
+{
+   if (samples->count == samples->size) {
+      samples->size = samples->size ? samples->size * 2 : 1024;
+      samples->ns = realloc(samples->ns, samples->size * sizeof *samples->ns);
+      if (samples->ns == NULL) {
+         fprintf(stderr, "Out of memory.\n");
+         exit(1);
+      }
+   }
+   samples->ns[samples->count++] = ns;
+   samples->bytes += bytes;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchSend --
+ *
+ *      Loopback transport send callback. The reply is already in the
+ *      connection's reply buffer (the packet's replyPacket); just record
+ *      its length and complete the packet, as the backdoor channel does.
+ *      With -a, also wakes up the client, since the reply may come from a
+ *      worker thread after the dispatcher is done with the request.
+ *
+ * Results:
+ *      TRUE.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchSend(void *data,             // IN: BenchConn
+          HgfsPacket *packet,     // IN/OUT: packet
+          char *buffer,           // IN: reply
+          size_t bufferLen,       // IN: reply length
+          HgfsSendFlags flags)    // IN: send flags
+{
+   BenchConn *conn = data;
+
+   conn->replyLen = bufferLen;
+   if (!(flags & HGFS_SEND_NO_COMPLETE)) {
+      serverCbTable->sendComplete(packet, conn->serverSession);
+   }
+   if (useDispatcher) {
+      pthread_mutex_lock(&conn->replyLock);
+      conn->replied = TRUE;
+      pthread_cond_signal(&conn->replyCond);
+      pthread_mutex_unlock(&conn->replyLock);
+   }
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchGetVa --
+ *
+ *      Loopback transport mapping callback. The "physical" addresses of
+ *      the data packet are the client's own addresses.
+ *
+ * Results:
+ *      The mapping.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+BenchGetVa(uint64 pa,       // IN
+           uint32 size,     // IN
+           char **token)    // OUT
+{
+   *token = (char *)(uintptr_t)pa;
+   return (void *)(uintptr_t)pa;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchPutVa --
+ *
+ *      Loopback transport unmapping callback.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchPutVa(char **token)   // IN/OUT
+{
+   *token = NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchQueuePush --
+ *
+ *      Appends a work item to a queue and wakes up one of its threads.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchQueuePush(BenchQueue *queue,      // IN/OUT
+               void (*fn)(void *),     // IN
+               void *data)             // IN
+{
+   BenchQueueEntry *entry = malloc(sizeof *entry);
+
+   if (entry == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+   entry->next = NULL;
+   entry->fn = fn;
+   entry->data = data;
+
+   pthread_mutex_lock(&queue->lock);
+   *queue->tail = entry;
+   queue->tail = &entry->next;
+   pthread_cond_signal(&queue->cond);
+   pthread_mutex_unlock(&queue->lock);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchQueueRun --
+ *
+ *      Body of the dispatcher and worker threads: runs the work items of
+ *      a queue in order until the queue is stopped and empty.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+BenchQueueRun(void *data)   // IN: BenchQueue
+{
+   BenchQueue *queue = data;
+
+   pthread_mutex_lock(&queue->lock);
+   for (;;) {
+      BenchQueueEntry *entry = queue->head;
+
+      if (entry == NULL) {
+         if (queue->stop) {
+            break;
+         }
+         pthread_cond_wait(&queue->cond, &queue->lock);
+         continue;
+      }
+      queue->head = entry->next;
+      if (queue->head == NULL) {
+         queue->tail = &queue->head;
+      }
+      pthread_mutex_unlock(&queue->lock);
+
+      entry->fn(entry->data);
+      free(entry);
+
+      pthread_mutex_lock(&queue->lock);
+   }
+   pthread_mutex_unlock(&queue->lock);
+
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchQueueStart --
+ *
+ *      Initializes a queue and starts the threads draining it.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process if a thread cannot be started.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchQueueStart(BenchQueue *queue,        // OUT
+                pthread_t *threads,       // OUT
+                unsigned int count)       // IN
+{
+   unsigned int i;
+
+   pthread_mutex_init(&queue->lock, NULL);
+   pthread_cond_init(&queue->cond, NULL);
+   queue->head = NULL;
+   queue->tail = &queue->head;
+   queue->stop = FALSE;
+
+   for (i = 0; i < count; i++) {
+      if (pthread_create(&threads[i], NULL, BenchQueueRun, queue) != 0) {
+         fprintf(stderr, "Could not start queue thread.\n");
+         exit(1);
+      }
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchQueueStop --
+ *
+ *      Lets the threads of a queue finish the work left and joins them.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchQueueStop(BenchQueue *queue,      // IN/OUT
+               pthread_t *threads,     // IN
+               unsigned int count)     // IN
+{
+   unsigned int i;
+
+   pthread_mutex_lock(&queue->lock);
+   queue->stop = TRUE;
+   pthread_cond_broadcast(&queue->cond);
+   pthread_mutex_unlock(&queue->lock);
+
+   for (i = 0; i < count; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   pthread_mutex_destroy(&queue->lock);
+   pthread_cond_destroy(&queue->cond);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchExecutor --
+ *
+ *      Executor given to the HGFS server with -a: queues an asynchronous
+ *      request for the worker threads, as the hgfsServer plugin does with
+ *      the vmtoolsd thread pool.
+ *
+ * Results:
+ *      TRUE.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchExecutor(void *data,                  // IN: BenchQueue
+              HgfsServerRequestFunc *fn,   // IN
+              void *request)               // IN
+{
+   BenchQueuePush(data, fn, request);
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchDispatch --
+ *
+ *      Dispatcher side of a request sent with -a: hands the connection's
+ *      packet to the server.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchDispatch(void *data)   // IN: BenchConn
+{
+   BenchConn *conn = data;
+
+   serverCbTable->receive(conn->packet, conn->serverSession);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRequest --
+ *
+ *      Sends the request whose payload has been built at
+ *      BENCH_REQ_PAYLOAD(conn), and times it. With -4 the request gets a
+ *      V4 header, and a non-zero dataSize sends the first dataSize bytes
+ *      of conn->data as the data packet, one page per iov entry.
+ *
+ * Results:
+ *      Pointer to the reply payload, or NULL if the server failed the
+ *      request.
+ *
+ * Side effects:
+ *      Records a sample for the op.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+BenchRequest(BenchConn *conn,      // IN/OUT
+             BenchOp op,           // IN
+             size_t payloadSize,   // IN: size of the request payload
+             uint64 bytes,         // IN: file data carried by the request
+             uint32 dataSize)      // IN: size of the data packet
+{
+   HgfsPacket *packet = conn->packet;
+   size_t packetSize = benchHeaderSize + payloadSize;
+   uint32 id = conn->nextId++;
+   HgfsOp hgfsOp = benchHgfsOps[op];
+   uint32 status;
+   void *replyPayload;
+   uint64 start;
+
+   if (dataSize > 0) {
+      hgfsOp = op == BENCH_OP_READ ? HGFS_OP_READ_FAST_V4 :
+                                     HGFS_OP_WRITE_FAST_V4;
+   }
+
+   if (useV4) {
+      HgfsHeader *header = (HgfsHeader *)conn->request;
+
+      memset(header, 0, sizeof *header);
+      header->version = 1;
+      header->dummy = HGFS_V4_LEGACY_OPCODE;
+      header->packetSize = packetSize;
+      header->headerSize = sizeof *header;
+      header->requestId = id;
+      header->op = hgfsOp;
+      header->sessionId = conn->sessionId;
+   } else {
+      HgfsRequest *header = (HgfsRequest *)conn->request;
+
+      header->id = id;
+      header->op = hgfsOp;
+   }
+
+   memset(packet, 0, sizeof *packet);
+   packet->iov[0].va = conn->request;
+   packet->iov[0].len = packetSize;
+   packet->iovCount = 1;
+   packet->metaPacket = conn->request;
+   packet->metaPacketSize = packetSize;
+   packet->replyPacket = conn->reply;
+   packet->replyPacketSize = sizeof conn->reply;
+   packet->guestInitiated = TRUE;
+   packet->supportsAsync = numWorkers > 0;
+
+   if (dataSize > 0) {
+      uint32 offset;
+
+      packet->dataPacketIovIndex = 1;
+      packet->dataPacketSize = dataSize;
+      for (offset = 0; offset < dataSize; offset += PAGE_SIZE) {
+         HgfsVmxIov *iov = &packet->iov[packet->iovCount++];
+
+         iov->va = NULL;
+         iov->pa = (uintptr_t)(conn->data + offset);
+         iov->len = MIN(PAGE_SIZE, dataSize - offset);
+         iov->token = NULL;
+      }
+   }
+   conn->replyLen = 0;
+
+   start = Bench_Now();
+   if (useDispatcher) {
+      conn->replied = FALSE;
+      BenchQueuePush(&dispatchQueue, BenchDispatch, conn);
+      pthread_mutex_lock(&conn->replyLock);
+      while (!conn->replied) {
+         pthread_cond_wait(&conn->replyCond, &conn->replyLock);
+      }
+      pthread_mutex_unlock(&conn->replyLock);
+   } else {
+      serverCbTable->receive(packet, conn->serverSession);
+   }
+   BenchAddSample(&conn->samples[op], Bench_Now() - start, bytes);
+
+   if (useV4) {
+      HgfsHeader *reply = (HgfsHeader *)conn->reply;
+
+      if (conn->replyLen < sizeof *reply || reply->requestId != id) {
+         fprintf(stderr, "%s: no reply.\n", benchOpNames[op]);
+         return NULL;
+      }
+      status = reply->status;
+      replyPayload = conn->reply + reply->headerSize;
+   } else {
+      HgfsReply *reply = (HgfsReply *)conn->reply;
+
+      if (conn->replyLen < sizeof *reply || reply->id != id) {
+         fprintf(stderr, "%s: no reply.\n", benchOpNames[op]);
+         return NULL;
+      }
+      status = reply->status;
+      replyPayload = HGFS_REP_GET_PAYLOAD_V3(reply);
+   }
+
+   if (status != HGFS_STATUS_SUCCESS) {
+      fprintf(stderr, "%s: status %u.\n", benchOpNames[op], status);
+      return NULL;
+   }
+   return replyPayload;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCreateSession --
+ *
+ *      Creates the V4 session of a connection.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchCreateSession(BenchConn *conn)   // IN/OUT
+{
+   HgfsRequestCreateSessionV4 *request =
+      (HgfsRequestCreateSessionV4 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsReplyCreateSessionV4 *reply;
+
+   memset(request, 0, sizeof *request);
+   request->maxPacketSize = sizeof conn->request;
+
+   reply = BenchRequest(conn, BENCH_OP_CREATE_SESSION, sizeof *request, 0, 0);
+   if (reply == NULL) {
+      return FALSE;
+   }
+   conn->sessionId = reply->sessionId;
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchPackName --
+ *
+ *      Fills in an HgfsFileNameV3 with the cross platform name of a file in
+ *      the benchmark directory, as seen through the guest's root share.
+ *
+ * Results:
+ *      Size of the variable part of the name (to add to the request size).
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t
+BenchPackName(HgfsFileNameV3 *fileName,   // OUT
+              const char *name,           // IN: file in benchDir, or NULL
+              size_t spaceLeft)           // IN: bytes available for name
+{
+   char path[PATH_MAX];
+   size_t len;
+   size_t i;
+
+   len = snprintf(path, sizeof path, "%s%s%s%s",
+                  HGFS_SERVER_POLICY_ROOT_SHARE_NAME, benchDir,
+                  name != NULL ? "/" : "", name != NULL ? name : "");
+   if (len >= sizeof path || len >= spaceLeft) {
+      fprintf(stderr, "Path too long.\n");
+      exit(1);
+   }
+
+   /* Cross platform names use NUL as the component separator. */
+   for (i = 0; i < len; i++) {
+      fileName->name[i] = path[i] == '/' ? '\0' : path[i];
+   }
+   fileName->name[len] = '\0';
+   fileName->length = len;
+   fileName->flags = 0;
+   fileName->caseType = HGFS_FILE_NAME_DEFAULT_CASE;
+   fileName->fid = HGFS_INVALID_HANDLE;
+
+   return len;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchOpen --
+ *
+ *      Opens (and optionally creates) a file in the benchmark directory.
+ *
+ * Results:
+ *      TRUE on success, handle in *file.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchOpen(BenchConn *conn,        // IN/OUT
+          const char *name,       // IN
+          Bool create,            // IN
+          HgfsHandle *file)       // OUT
+{
+   HgfsRequestOpenV3 *request =
+      (HgfsRequestOpenV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsReplyOpenV3 *reply;
+   size_t nameLen;
+
+   memset(request, 0, sizeof *request);
+   request->mask = HGFS_OPEN_VALID_MODE | HGFS_OPEN_VALID_FLAGS |
+                   HGFS_OPEN_VALID_OWNER_PERMS | HGFS_OPEN_VALID_FILE_NAME;
+   request->mode = create ? HGFS_OPEN_MODE_READ_WRITE : HGFS_OPEN_MODE_READ_ONLY;
+   request->flags = create ? HGFS_OPEN_CREATE_EMPTY : HGFS_OPEN;
+   request->ownerPerms = HGFS_PERM_READ | HGFS_PERM_WRITE;
+   nameLen = BenchPackName(&request->fileName, name,
+                           sizeof conn->request - benchHeaderSize -
+                           sizeof *request);
+
+   reply = BenchRequest(conn, BENCH_OP_OPEN, sizeof *request + nameLen, 0, 0);
+   if (reply == NULL) {
+      return FALSE;
+   }
+   *file = reply->file;
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchClose --
+ *
+ *      Closes a file handle.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchClose(BenchConn *conn,     // IN/OUT
+           HgfsHandle file)     // IN
+{
+   HgfsRequestCloseV3 *request =
+      (HgfsRequestCloseV3 *)BENCH_REQ_PAYLOAD(conn);
+
+   memset(request, 0, sizeof *request);
+   request->file = file;
+   return BenchRequest(conn, BENCH_OP_CLOSE, sizeof *request, 0, 0) != NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCreateFile --
+ *
+ *      Creates a file and writes fileSize bytes to it in ioSize chunks.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      Creates the file.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchCreateFile(BenchConn *conn,     // IN/OUT
+                const char *name)    // IN
+{
+   HgfsRequestWriteV3 *request =
+      (HgfsRequestWriteV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsHandle file;
+   uint64 offset;
+
+   if (!BenchOpen(conn, name, TRUE, &file)) {
+      return FALSE;
+   }
+
+   for (offset = 0; offset < fileSize; offset += ioSize) {
+      uint32 size = MIN(ioSize, fileSize - offset);
+      HgfsReplyWriteV3 *reply;
+
+      memset(request, 0, sizeof *request);
+      request->file = file;
+      request->offset = offset;
+      request->requiredSize = size;
+      if (useV4) {
+         memset(conn->data, 'a' + (offset / ioSize) % 26, size);
+         reply = BenchRequest(conn, BENCH_OP_WRITE, sizeof *request, size,
+                              size);
+      } else {
+         memset(request->payload, 'a' + (offset / ioSize) % 26, size);
+         reply = BenchRequest(conn, BENCH_OP_WRITE,
+                              sizeof *request - 1 + size, size, 0);
+      }
+      if (reply == NULL || reply->actualSize != size) {
+         BenchClose(conn, file);
+         return FALSE;
+      }
+   }
+
+   return BenchClose(conn, file);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchReadFile --
+ *
+ *      Reads a whole file in ioSize chunks.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchReadFile(BenchConn *conn,     // IN/OUT
+              const char *name)    // IN
+{
+   HgfsRequestReadV3 *request =
+      (HgfsRequestReadV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsHandle file;
+   uint64 offset = 0;
+
+   if (!BenchOpen(conn, name, FALSE, &file)) {
+      return FALSE;
+   }
+
+   for (;;) {
+      HgfsReplyReadV3 *reply;
+
+      memset(request, 0, sizeof *request);
+      request->file = file;
+      request->offset = offset;
+      request->requiredSize = ioSize;
+
+      reply = BenchRequest(conn, BENCH_OP_READ, sizeof *request, 0,
+                           useV4 ? ioSize : 0);
+      if (reply == NULL) {
+         BenchClose(conn, file);
+         return FALSE;
+      }
+      conn->samples[BENCH_OP_READ].bytes += reply->actualSize;
+      if (reply->actualSize == 0) {
+         break;
+      }
+      offset += reply->actualSize;
+   }
+
+   if (offset != fileSize) {
+      fprintf(stderr, "%s: read %"FMT64"u bytes, expected %u.\n",
+              name, offset, fileSize);
+      BenchClose(conn, file);
+      return FALSE;
+   }
+
+   return BenchClose(conn, file);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchGetattr --
+ *
+ *      Gets the attributes of a file by name.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchGetattr(BenchConn *conn,     // IN/OUT
+             const char *name)    // IN
+{
+   HgfsRequestGetattrV3 *request =
+      (HgfsRequestGetattrV3 *)BENCH_REQ_PAYLOAD(conn);
+   size_t nameLen;
+
+   memset(request, 0, sizeof *request);
+   nameLen = BenchPackName(&request->fileName, name,
+                           sizeof conn->request - benchHeaderSize -
+                           sizeof *request);
+   return BenchRequest(conn, BENCH_OP_GETATTR, sizeof *request + nameLen,
+                       0, 0) != NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCaseGetattr --
+ *
+ *      Gets the attributes of the file of a directory of the case tree,
+ *      by a name that only matches it case-insensitively.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchCaseGetattr(BenchConn *conn,     // IN/OUT
+                 unsigned int dir)    // IN: directory of the case tree
+{
+   HgfsRequestGetattrV3 *request =
+      (HgfsRequestGetattrV3 *)BENCH_REQ_PAYLOAD(conn);
+   char name[64];
+   size_t nameLen;
+
+   snprintf(name, sizeof name, "CASE/DIR%05u/FILE", dir);
+   memset(request, 0, sizeof *request);
+   nameLen = BenchPackName(&request->fileName, name,
+                           sizeof conn->request - benchHeaderSize -
+                           sizeof *request);
+   request->fileName.caseType = HGFS_FILE_NAME_CASE_INSENSITIVE;
+   return BenchRequest(conn, BENCH_OP_CASE_GETATTR, sizeof *request + nameLen,
+                       0, 0) != NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchSearch --
+ *
+ *      Lists the benchmark directory.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchSearch(BenchConn *conn)     // IN/OUT
+{
+   HgfsRequestSearchOpenV3 *openRequest =
+      (HgfsRequestSearchOpenV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsRequestSearchReadV3 *readRequest =
+      (HgfsRequestSearchReadV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsRequestSearchCloseV3 *closeRequest =
+      (HgfsRequestSearchCloseV3 *)BENCH_REQ_PAYLOAD(conn);
+   HgfsReplySearchOpenV3 *openReply;
+   HgfsHandle search;
+   size_t nameLen;
+   uint32 offset;
+   Bool success = TRUE;
+
+   memset(openRequest, 0, sizeof *openRequest);
+   nameLen = BenchPackName(&openRequest->dirName, NULL,
+                           sizeof conn->request - benchHeaderSize -
+                           sizeof *openRequest);
+   openReply = BenchRequest(conn, BENCH_OP_SEARCH_OPEN,
+                            sizeof *openRequest + nameLen, 0, 0);
+   if (openReply == NULL) {
+      return FALSE;
+   }
+   search = openReply->search;
+
+   /* ".", ".." and the files. */
+   for (offset = 0; ; offset++) {
+      HgfsReplySearchReadV3 *readReply;
+      HgfsDirEntry *entry;
+
+      memset(readRequest, 0, sizeof *readRequest);
+      readRequest->search = search;
+      readRequest->offset = offset;
+
+      readReply = BenchRequest(conn, BENCH_OP_SEARCH_READ,
+                               sizeof *readRequest, 0, 0);
+      if (readReply == NULL) {
+         success = FALSE;
+         break;
+      }
+      entry = (HgfsDirEntry *)readReply->payload;
+      if (readReply->count == 0 || entry->fileName.length == 0) {
+         break;
+      }
+   }
+
+   if (success && offset != numFiles + 2 + (numCaseDirs > 0)) {
+      fprintf(stderr, "search: %u entries, expected %u.\n", offset,
+              numFiles + 2 + (numCaseDirs > 0));
+      success = FALSE;
+   }
+
+   /* Close the search even on failure, so that it is not leaked. */
+   memset(closeRequest, 0, sizeof *closeRequest);
+   closeRequest->search = search;
+   if (BenchRequest(conn, BENCH_OP_SEARCH_CLOSE, sizeof *closeRequest,
+                    0, 0) == NULL) {
+      success = FALSE;
+   }
+   return success;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchAgeDir --
+ *
+ *      Sets the access and modification times of a directory to an hour
+ *      ago.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process on failure.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchAgeDir(const char *path)   // IN
+{
+   struct utimbuf times;
+
+   times.actime = times.modtime = time(NULL) - 3600;
+   if (utime(path, &times) != 0) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      exit(1);
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCreateCaseTree --
+ *
+ *      Creates the tree used by the case-insensitive lookups directly (not
+ *      through the server): numCaseDirs directories with one file each,
+ *      under a directory of the benchmark directory. The directories are
+ *      aged, so that the server caches their index.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process on failure.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchCreateCaseTree(void)
+{
+   char path[PATH_MAX];
+   unsigned int i;
+   int fd;
+
+   snprintf(path, sizeof path, "%s/%s", benchDir, BENCH_CASE_DIR);
+   if (mkdir(path, 0755) != 0) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      exit(1);
+   }
+
+   for (i = 0; i < numCaseDirs; i++) {
+      snprintf(path, sizeof path, "%s/%s/dir%05u", benchDir, BENCH_CASE_DIR,
+               i);
+      if (mkdir(path, 0755) != 0) {
+         fprintf(stderr, "%s: %s\n", path, strerror(errno));
+         exit(1);
+      }
+      snprintf(path, sizeof path, "%s/%s/dir%05u/file", benchDir,
+               BENCH_CASE_DIR, i);
+      fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+      if (fd < 0) {
+         fprintf(stderr, "%s: %s\n", path, strerror(errno));
+         exit(1);
+      }
+      close(fd);
+      snprintf(path, sizeof path, "%s/%s/dir%05u", benchDir, BENCH_CASE_DIR,
+               i);
+      BenchAgeDir(path);
+   }
+
+   snprintf(path, sizeof path, "%s/%s", benchDir, BENCH_CASE_DIR);
+   BenchAgeDir(path);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchClient --
+ *
+ *      Client thread: creates its share of the files, then reads, stats
+ *      and lists them for the requested number of iterations, holding its
+ *      share of the -o handles open meanwhile. Then, if
+ *      there is a case tree, looks up its directories case-insensitively
+ *      for the same number of iterations.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      Sets conn->failed on error.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+BenchClient(void *data)   // IN: BenchConn
+{
+   BenchConn *conn = data;
+   HgfsHandle *held;
+   unsigned int numHeld = 0;
+   unsigned int iter;
+   unsigned int i;
+   char name[32];
+
+   held = malloc((numHeldFiles / conn->numConns + 1) * sizeof *held);
+   if (held == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+
+   if (useV4) {
+      conn->failed = !BenchCreateSession(conn);
+   }
+
+   for (i = conn->index; i < numFiles && !conn->failed; i += conn->numConns) {
+      snprintf(name, sizeof name, "file%05u", i);
+      conn->failed = !BenchCreateFile(conn, name);
+   }
+
+   /* Searches check the entry count, so wait for every file to exist. */
+   pthread_barrier_wait(&createBarrier);
+
+   for (i = conn->index; i < numHeldFiles && !conn->failed;
+        i += conn->numConns) {
+      snprintf(name, sizeof name, "file%05u", i % numFiles);
+      conn->failed = !BenchOpen(conn, name, FALSE, &held[numHeld]);
+      numHeld += !conn->failed;
+   }
+
+   for (iter = 0; iter < iterations && !conn->failed; iter++) {
+      for (i = conn->index; i < numFiles && !conn->failed;
+           i += conn->numConns) {
+         snprintf(name, sizeof name, "file%05u", i);
+         conn->failed = !BenchReadFile(conn, name) ||
+                        !BenchGetattr(conn, name);
+      }
+      if (!conn->failed) {
+         conn->failed = !BenchSearch(conn);
+      }
+   }
+
+   for (i = 0; i < numHeld; i++) {
+      conn->failed |= !BenchClose(conn, held[i]);
+   }
+   free(held);
+
+   if (numCaseDirs == 0) {
+      return NULL;
+   }
+
+   /*
+    * The server only caches the index of a directory that has not been
+    * modified for a while, so age the benchmark directory once every file
+    * has been created.
+    */
+   pthread_barrier_wait(&createBarrier);
+   if (conn->index == 0) {
+      BenchAgeDir(benchDir);
+   }
+   pthread_barrier_wait(&createBarrier);
+
+   for (iter = 0; iter < iterations && !conn->failed; iter++) {
+      for (i = conn->index; i < numCaseDirs && !conn->failed;
+           i += conn->numConns) {
+         conn->failed = !BenchCaseGetattr(conn, i) ||
+                        !BenchCaseGetattr(conn, i % BENCH_CASE_HOT_DIRS);
+      }
+   }
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchReport --
+ *
+ *      Merges the samples of all connections and prints one line per op.
+ *      Throughput is computed against the wall clock time of the run, so
+ *      with several threads it is the aggregate rate.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees the samples.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchReport(BenchConn **conns,   // IN
+            uint64 elapsedNS)    // IN: wall clock time of the run
+{
+   double seconds = elapsedNS / 1e9;
+   unsigned int op;
+   unsigned int i;
+
+   printf("%-12s %10s %12s %10s %10s %10s %10s %10s\n", "op", "count",
+          "ops/s", "MB/s", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+   for (op = 0; op < BENCH_OP_MAX; op++) {
+      BenchSamples all = { 0 };
+
+      for (i = 0; i < numThreads; i++) {
+         BenchSamples *samples = &conns[i]->samples[op];
+         size_t j;
+
+         for (j = 0; j < samples->count; j++) {
+            BenchAddSample(&all, samples->ns[j], 0);
+         }
+         all.bytes += samples->bytes;
+         free(samples->ns);
+      }
+
+      if (all.count == 0) {
+         continue;
+      }
+
+      Bench_SortSamples(all.ns, all.count);
+      printf("%-12s %10"FMTSZ"u %12.0f %10.1f", benchOpNames[op], all.count,
+             all.count / seconds, all.bytes / seconds / (1024 * 1024));
+      Bench_PrintPercentiles(all.ns, all.count);
+      printf("\n");
+      free(all.ns);
+   }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog,
+               "[-4] [-f files] [-s fileSize] [-b ioSize] [-n iterations]\n"
+               "          [-t threads] [-c caseDirs] [-o openFiles] "
+               "[-a workers] directory",
+               "Creates the files in directory (which must exist and be "
+               "empty)\n"
+               "through the HGFS server, then reads, stats and lists them.\n"
+               "With -c, also creates caseDirs directories with one file "
+               "each, and\n"
+               "stats the files by names that differ in case.\n"
+               "With -o, keeps openFiles extra handles open meanwhile.\n"
+               "With -4, uses V4 sessions and moves the file data with\n"
+               "READ_FAST_V4 and WRITE_FAST_V4.\n"
+               "With -a, sends all the requests through one dispatcher "
+               "thread, and\n"
+               "runs the asynchronous ones on that many worker threads.\n"
+               "Defaults: %u files of %u bytes, %u byte I/Os, %u "
+               "iterations,\n"
+               "1 thread.\n",
+               BENCH_DEFAULT_FILES, BENCH_DEFAULT_FILE_SIZE,
+               BENCH_DEFAULT_IO_SIZE, BENCH_DEFAULT_ITERATIONS);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   char dir[PATH_MAX];
+   BenchConn **conns;
+   pthread_t *threads;
+   pthread_t dispatcher;
+   pthread_t *workers = NULL;
+   uint64 start;
+   uint64 elapsed;
+   Bool failed = FALSE;
+   unsigned int i;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "4f:s:b:n:t:c:o:a:")) != -1) {
+      switch (opt) {
+      case '4':
+         useV4 = TRUE;
+         benchHeaderSize = sizeof(HgfsHeader);
+         break;
+      case 'f':
+         numFiles = strtoul(optarg, NULL, 0);
+         break;
+      case 's':
+         fileSize = strtoul(optarg, NULL, 0);
+         break;
+      case 'b':
+         ioSize = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         iterations = strtoul(optarg, NULL, 0);
+         break;
+      case 't':
+         numThreads = strtoul(optarg, NULL, 0);
+         break;
+      case 'c':
+         numCaseDirs = strtoul(optarg, NULL, 0);
+         break;
+      case 'o':
+         numHeldFiles = strtoul(optarg, NULL, 0);
+         break;
+      case 'a':
+         useDispatcher = TRUE;
+         numWorkers = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc - 1 || numThreads == 0 || ioSize == 0 ||
+       ioSize > HGFS_LARGE_IO_MAX || (numHeldFiles > 0 && numFiles == 0)) {
+      BenchUsage(argv[0]);
+   }
+   if (realpath(argv[optind], dir) == NULL) {
+      fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+      return 1;
+   }
+   benchDir = dir;
+   if (numCaseDirs > 0) {
+      BenchCreateCaseTree();
+   }
+
+   if (!HgfsServerPolicy_Init(NULL, NULL) ||
+       !HgfsServer_InitState(&serverCbTable, NULL)) {
+      fprintf(stderr, "Could not initialize the HGFS server.\n");
+      return 1;
+   }
+
+   if (useDispatcher) {
+      BenchQueueStart(&dispatchQueue, &dispatcher, 1);
+   }
+   if (numWorkers > 0) {
+      workers = calloc(numWorkers, sizeof *workers);
+      if (workers == NULL) {
+         fprintf(stderr, "Out of memory.\n");
+         return 1;
+      }
+      BenchQueueStart(&workQueue, workers, numWorkers);
+      HgfsServer_SetExecutor(BenchExecutor, &workQueue);
+   }
+
+   conns = calloc(numThreads, sizeof *conns);
+   threads = calloc(numThreads, sizeof *threads);
+   if (conns == NULL || threads == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      return 1;
+   }
+
+   for (i = 0; i < numThreads; i++) {
+      BenchConn *conn = calloc(1, sizeof *conn);
+
+      if (conn == NULL) {
+         fprintf(stderr, "Out of memory.\n");
+         return 1;
+      }
+      conn->index = i;
+      conn->numConns = numThreads;
+      conn->channelCbTable.getReadVa = BenchGetVa;
+      conn->channelCbTable.getWriteVa = BenchGetVa;
+      conn->channelCbTable.putVa = BenchPutVa;
+      conn->channelCbTable.send = BenchSend;
+      pthread_mutex_init(&conn->replyLock, NULL);
+      pthread_cond_init(&conn->replyCond, NULL);
+
+      /* The request and one iov entry per page of the largest I/O. */
+      conn->packet = malloc(offsetof(HgfsPacket, iov) +
+                            (1 + CEILING(HGFS_LARGE_IO_MAX, PAGE_SIZE)) *
+                            sizeof(HgfsVmxIov));
+      if (conn->packet == NULL ||
+          posix_memalign((void **)&conn->data, PAGE_SIZE,
+                         HGFS_LARGE_IO_MAX) != 0) {
+         fprintf(stderr, "Out of memory.\n");
+         return 1;
+      }
+      if (!serverCbTable->connect(conn, &conn->channelCbTable,
+                                  useV4 ? HGFS_CHANNEL_SHARED_MEM : 0,
+                                  &conn->serverSession)) {
+         fprintf(stderr, "Could not connect to the HGFS server.\n");
+         return 1;
+      }
+      conns[i] = conn;
+   }
+
+   pthread_barrier_init(&createBarrier, NULL, numThreads);
+   start = Bench_Now();
+   for (i = 0; i < numThreads; i++) {
+      if (pthread_create(&threads[i], NULL, BenchClient, conns[i]) != 0) {
+         fprintf(stderr, "Could not start client thread.\n");
+         return 1;
+      }
+   }
+   for (i = 0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+      failed |= conns[i]->failed;
+   }
+
+   elapsed = Bench_Now() - start;
+
+   printf("%u files of %u bytes, %u byte I/Os, %u iterations, "
+          "%u thread(s), %u case dirs, %u held open, %s, ", numFiles,
+          fileSize, ioSize, iterations, numThreads, numCaseDirs,
+          numHeldFiles, useV4 ? "V4 fast I/O" : "V3");
+   if (useDispatcher) {
+      printf("dispatcher and %u worker(s), ", numWorkers);
+   }
+   printf("%.3f s\n", elapsed / 1e9);
+   BenchReport(conns, elapsed);
+
+   if (numWorkers > 0) {
+      HgfsServer_SetExecutor(NULL, NULL);
+      BenchQueueStop(&workQueue, workers, numWorkers);
+      free(workers);
+   }
+   if (useDispatcher) {
+      BenchQueueStop(&dispatchQueue, &dispatcher, 1);
+   }
+
+   for (i = 0; i < numThreads; i++) {
+      serverCbTable->disconnect(conns[i]->serverSession);
+      serverCbTable->close(conns[i]->serverSession);
+      pthread_mutex_destroy(&conns[i]->replyLock);
+      pthread_cond_destroy(&conns[i]->replyCond);
+      free(conns[i]->packet);
+      free(conns[i]->data);
+      free(conns[i]);
+   }
+   pthread_barrier_destroy(&createBarrier);
+   free(conns);
+   free(threads);
+
+   HgfsServer_ExitState();
+   HgfsServerPolicy_Cleanup();
+
+   return failed ? 1 : 0;
+}
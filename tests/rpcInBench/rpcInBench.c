@@ -0,0 +1,351 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * rpcInBench.c --
+ *
+ *   Dispatch benchmark for the glib RpcIn loop. The RpcIn library runs
+ *   on a fake Message_Channel (tests/common/fakeMessage.c) whose host side
+ *   has a TCLO request ready at every poll, and dispatches through
+ *   RpcChannel_Dispatch() to a channel with a growing number of registered
+ *   RPCs. Each round times one main loop iteration per message:
+ *
+ *     hit     - messages for registered RPCs
+ *     unknown - messages for names that are not registered
+ *
+ *   The cost per message should not depend on the number of RPCs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vmware.h"
+#include "rpcin.h"
+#include "str.h"
+#include "vmware/tools/guestrpc.h"
+#include "benchUtil.h"
+#include "fakeMessage.h"
+
+#define BENCH_DEFAULT_MESSAGES  10000
+#define BENCH_DEFAULT_ROUNDS    20
+#define BENCH_DEFAULT_RPCS      4096
+
+/* The messages the fake host hands out, in a loop. */
+static char **benchMessages;
+static unsigned int benchNumMessages;
+static unsigned int benchNextMessage;
+
+/* Number of times the registered RPCs were called. */
+static uint64 benchCalls;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchHostReceive --
+ *
+ *      Fake host side of the channel: always has a message.
+ *
+ * Results:
+ *      The next message.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *
+BenchHostReceive(void *clientData)   // IN: Unused
+{
+   const char *msg = benchMessages[benchNextMessage];
+
+   benchNextMessage = (benchNextMessage + 1) % benchNumMessages;
+   return msg;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRpc --
+ *
+ *      The registered RPCs.
+ *
+ * Results:
+ *      TRUE.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static gboolean
+BenchRpc(RpcInData *data)   // IN/OUT
+{
+   benchCalls++;
+   return RPCIN_SETRETVALS(data, "", TRUE);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchError --
+ *
+ *      RpcIn error callback.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchError(void *clientData,      // IN: Unused
+           char const *status)    // IN
+{
+   fprintf(stderr, "RpcIn error: %s\n", status);
+   exit(1);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchSetMessages --
+ *
+ *      Builds the messages of a round: one per RPC name, with a short
+ *      argument, for the first numNames names of the given prefix.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees the previous messages.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchSetMessages(const char *prefix,      // IN
+                 unsigned int numNames)   // IN
+{
+   unsigned int i;
+
+   for (i = 0; i < benchNumMessages; i++) {
+      free(benchMessages[i]);
+   }
+   free(benchMessages);
+
+   benchMessages = calloc(numNames, sizeof *benchMessages);
+   if (benchMessages == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+   for (i = 0; i < numNames; i++) {
+      benchMessages[i] = Str_Asprintf(NULL, "%s.%u 1 2 3", prefix, i);
+   }
+   benchNumMessages = numNames;
+   benchNextMessage = 0;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRun --
+ *
+ *      Runs the rounds of one kind of message and prints one line of
+ *      results.
+ *
+ * Results:
+ *      TRUE if every message was handled as expected.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchRun(GMainContext *ctx,          // IN
+         RpcIn *in,                  // IN
+         const char *name,           // IN
+         unsigned int numRpcs,       // IN: registered RPCs
+         Bool hit,                   // IN: whether the messages hit an RPC
+         unsigned int messages,      // IN: per round
+         unsigned int rounds)        // IN
+{
+   uint64 *ns = calloc(rounds, sizeof *ns);
+   uint64 total = 0;
+   uint64 calls = benchCalls;
+   RpcInStats before;
+   RpcInStats after;
+   unsigned int r;
+   unsigned int i;
+
+   if (ns == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+
+   BenchSetMessages(hit ? "bench.rpc" : "bench.unknown", numRpcs);
+   RpcIn_GetStats(in, &before);
+
+   for (r = 0; r < rounds; r++) {
+      uint64 start = Bench_Now();
+
+      for (i = 0; i < messages; i++) {
+         g_main_context_iteration(ctx, TRUE);
+      }
+      ns[r] = Bench_Now() - start;
+      total += ns[r];
+   }
+
+   RpcIn_GetStats(in, &after);
+
+   Bench_SortSamples(ns, rounds);
+   printf("%-8s %8u %10u %10.1f %10.1f", name, numRpcs, messages,
+          (double) total / rounds / messages,
+          (double) messages * rounds / (total / 1e6));
+   Bench_PrintPercentiles(ns, rounds);
+   printf("\n");
+   free(ns);
+
+   calls = benchCalls - calls;
+   if (after.polls - before.polls != (uint64) messages * rounds ||
+       after.emptyPolls != before.emptyPolls ||
+       calls != (hit ? (uint64) messages * rounds : 0)) {
+      fprintf(stderr, "%s: %"FMT64"u polls, %"FMT64"u empty, %"FMT64"u "
+              "calls.\n", name, after.polls - before.polls,
+              after.emptyPolls - before.emptyPolls, calls);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog, "[-m messages] [-n rounds] [-r rpcs]",
+               "Dispatches %u TCLO messages (by default) through the RpcIn\n"
+               "loop, %u times, with 1, 16, 256... up to %u registered\n"
+               "RPCs. Prints the average time per message, the throughput\n"
+               "(Kmsgs/s) and the percentiles of the time of a round.\n",
+               BENCH_DEFAULT_MESSAGES, BENCH_DEFAULT_ROUNDS,
+               BENCH_DEFAULT_RPCS);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   FakeMessageHost host = { BenchHostReceive, NULL, NULL };
+   unsigned int messages = BENCH_DEFAULT_MESSAGES;
+   unsigned int rounds = BENCH_DEFAULT_ROUNDS;
+   unsigned int maxRpcs = BENCH_DEFAULT_RPCS;
+   RpcChannelCallback *rpcs;
+   unsigned int numRpcs = 0;
+   unsigned int n;
+   GMainContext *ctx;
+   RpcChannel *chan;
+   RpcIn *in;
+   Bool ok = TRUE;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "m:n:r:")) != -1) {
+      switch (opt) {
+      case 'm':
+         messages = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         rounds = strtoul(optarg, NULL, 0);
+         break;
+      case 'r':
+         maxRpcs = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc || messages == 0 || rounds == 0 || maxRpcs == 0) {
+      BenchUsage(argv[0]);
+   }
+
+   rpcs = calloc(maxRpcs, sizeof *rpcs);
+   if (rpcs == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      return 1;
+   }
+
+   FakeMessage_Init(&host);
+   BenchSetMessages("bench.rpc", 1);
+
+   ctx = g_main_context_new();
+   chan = RpcChannel_Create();
+   in = RpcIn_Construct(ctx, RpcChannel_Dispatch, chan);
+   if (in == NULL || !RpcIn_start(in, 0, BenchError, NULL)) {
+      fprintf(stderr, "Cannot start the RpcIn loop.\n");
+      return 1;
+   }
+
+   printf("%-8s %8s %10s %10s %10s %10s %10s %10s %10s\n", "message",
+          "rpcs", "messages", "ns/msg", "Kmsgs/s", "p50(us)", "p90(us)",
+          "p99(us)", "max(us)");
+
+   for (n = 1; n <= maxRpcs; n *= 16) {
+      for (; numRpcs < n; numRpcs++) {
+         rpcs[numRpcs].name = Str_Asprintf(NULL, "bench.rpc.%u", numRpcs);
+         rpcs[numRpcs].callback = BenchRpc;
+         RpcChannel_RegisterCallback(chan, &rpcs[numRpcs]);
+      }
+      ok &= BenchRun(ctx, in, "hit", numRpcs, TRUE, messages, rounds);
+      ok &= BenchRun(ctx, in, "unknown", numRpcs, FALSE, messages, rounds);
+   }
+
+   RpcIn_stop(in);
+   RpcIn_Destruct(in);
+
+   return ok ? 0 : 1;
+}
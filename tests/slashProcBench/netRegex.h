@@ -0,0 +1,42 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/**
+ * @file netRegex.h
+ *
+ *	GRegex based /proc/net parsers, see netRegex.c.
+ */
+
+#ifndef _NETREGEX_H_
+#define _NETREGEX_H_
+
+#include <glib.h>
+#include <net/route.h>
+
+#ifdef HAVE_GLIB_REGEX
+GHashTable *SlashProcNetRegex_GetSnmp(const char *pathToNetSnmp);
+GHashTable *SlashProcNetRegex_GetSnmp6(const char *pathToNetSnmp6);
+
+GPtrArray  *SlashProcNetRegex_GetRoute(const char *pathToNetRoute);
+void        SlashProcNetRegex_FreeRoute(GPtrArray *);
+
+GPtrArray  *SlashProcNetRegex_GetRoute6(const char *pathToNetRoute6);
+void        SlashProcNetRegex_FreeRoute6(GPtrArray *);
+#endif // ifdef HAVE_GLIB_REGEX
+
+#endif // ifndef _NETREGEX_H_
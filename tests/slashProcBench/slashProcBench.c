@@ -0,0 +1,672 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * slashProcBench.c --
+ *
+ *   Benchmark for the lib/slashProc /proc/net parsers. Each parser is run
+ *   repeatedly over a directory of input files (named like their /proc/net
+ *   counterparts: snmp, snmp6, route, ipv6_route) and its average and best
+ *   times are reported. When glib has GRegex, the regex based parsers the
+ *   library used to have (netRegex.c) are timed too, and their results are
+ *   checked against the current parsers'.
+ *
+ *   Without -d, the input is generated in a temporary directory: route
+ *   tables with a configurable number of entries, and SNMP counters
+ *   captured from a Linux guest. "-d /proc/net" benchmarks the live files.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "vmware.h"
+#include "slashProc.h"
+#include "slashProcNetInt.h"
+#include "netRegex.h"
+#include "benchUtil.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_DEFAULT_ROUTES     10000
+
+typedef gpointer (*BenchParseFn)(const char *path);
+typedef void (*BenchFreeFn)(gpointer result);
+typedef guint (*BenchCountFn)(gpointer result);
+typedef Bool (*BenchEqualFn)(gpointer a, gpointer b);
+
+typedef struct BenchParser {
+   const char *file;
+   BenchParseFn parse;
+   BenchFreeFn free;
+   BenchParseFn parseRegex;
+   BenchFreeFn freeRegex;
+   BenchCountFn count;
+   BenchEqualFn equal;
+} BenchParser;
+
+static const char benchSnmp[] =
+   "Ip: Forwarding DefaultTTL InReceives InHdrErrors InAddrErrors "
+   "ForwDatagrams InUnknownProtos InDiscards InDelivers OutRequests "
+   "OutDiscards OutNoRoutes ReasmTimeout ReasmReqds ReasmOKs ReasmFails "
+   "FragOKs FragFails FragCreates\n"
+   "Ip: 2 64 1834772 0 2 0 0 0 1834705 1470235 20 0 0 0 0 0 0 0 0\n"
+   "Icmp: InMsgs InErrors InDestUnreachs InTimeExcds InParmProbs "
+   "InSrcQuenchs InRedirects InEchos InEchoReps InTimestamps InTimestampReps "
+   "InAddrMasks InAddrMaskReps OutMsgs OutErrors OutDestUnreachs "
+   "OutTimeExcds OutParmProbs OutSrcQuenchs OutRedirects OutEchos "
+   "OutEchoReps OutTimestamps OutTimestampReps OutAddrMasks OutAddrMaskReps\n"
+   "Icmp: 105 3 105 0 0 0 0 0 0 0 0 0 0 131 0 131 0 0 0 0 0 0 0 0 0 0\n"
+   "IcmpMsg: InType3 OutType3\n"
+   "IcmpMsg: 105 131\n"
+   "Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens PassiveOpens "
+   "AttemptFails EstabResets CurrEstab InSegs OutSegs RetransSegs InErrs "
+   "OutRsts\n"
+   "Tcp: 1 200 120000 -1 18213 1025 1321 392 6 1715960 1436233 3012 0 5621\n"
+   "Udp: InDatagrams NoPorts InErrors OutDatagrams RcvbufErrors "
+   "SndbufErrors\n"
+   "Udp: 117829 131 0 30969 0 0\n"
+   "UdpLite: InDatagrams NoPorts InErrors OutDatagrams RcvbufErrors "
+   "SndbufErrors\n"
+   "UdpLite: 0 0 0 0 0 0\n";
+
+static const char benchSnmp6[] =
+   "Ip6InReceives                   \t48210\n"
+   "Ip6InHdrErrors                  \t0\n"
+   "Ip6InTooBigErrors               \t0\n"
+   "Ip6InNoRoutes                   \t0\n"
+   "Ip6InAddrErrors                 \t0\n"
+   "Ip6InUnknownProtos              \t0\n"
+   "Ip6InTruncatedPkts              \t0\n"
+   "Ip6InDiscards                   \t0\n"
+   "Ip6InDelivers                   \t47986\n"
+   "Ip6OutForwDatagrams             \t0\n"
+   "Ip6OutRequests                  \t31120\n"
+   "Ip6OutDiscards                  \t0\n"
+   "Ip6OutNoRoutes                  \t12\n"
+   "Ip6ReasmTimeout                 \t0\n"
+   "Ip6ReasmReqds                   \t0\n"
+   "Ip6ReasmOKs                     \t0\n"
+   "Ip6ReasmFails                   \t0\n"
+   "Ip6FragOKs                      \t0\n"
+   "Ip6FragFails                    \t0\n"
+   "Ip6FragCreates                  \t0\n"
+   "Ip6InMcastPkts                  \t1310\n"
+   "Ip6OutMcastPkts                 \t86\n"
+   "Icmp6InMsgs                     \t224\n"
+   "Icmp6InErrors                   \t0\n"
+   "Icmp6OutMsgs                    \t71\n"
+   "Icmp6InDestUnreachs             \t0\n"
+   "Icmp6InPktTooBigs               \t0\n"
+   "Icmp6InTimeExcds                \t0\n"
+   "Icmp6InParmProblems             \t0\n"
+   "Icmp6InEchos                    \t0\n"
+   "Icmp6InEchoReplies              \t0\n"
+   "Icmp6InGroupMembQueries         \t0\n"
+   "Icmp6InRouterAdvertisements     \t224\n"
+   "Icmp6OutRouterSolicits          \t3\n"
+   "Icmp6OutNeighborSolicits        \t12\n"
+   "Icmp6OutGroupMembReductions     \t56\n"
+   "Icmp6InType134                  \t224\n"
+   "Icmp6OutType133                 \t3\n"
+   "Icmp6OutType135                 \t12\n"
+   "Icmp6OutType143                 \t56\n"
+   "Udp6InDatagrams                 \t47762\n"
+   "Udp6NoPorts                     \t0\n"
+   "Udp6InErrors                    \t0\n"
+   "Udp6OutDatagrams                \t31049\n"
+   "UdpLite6InDatagrams             \t0\n"
+   "UdpLite6NoPorts                 \t0\n"
+   "UdpLite6InErrors                \t0\n"
+   "UdpLite6OutDatagrams            \t0\n";
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchWriteFile --
+ *
+ *      Creates dir/name with the given contents.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      Creates a file.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchWriteFile(const char *dir,        // IN
+               const char *name,       // IN
+               const char *contents,   // IN
+               size_t len)             // IN
+{
+   gchar *path = g_build_filename(dir, name, NULL);
+   FILE *f = fopen(path, "w");
+   Bool ok = FALSE;
+
+   if (f != NULL) {
+      ok = fwrite(contents, 1, len, f) == len;
+      ok &= fclose(f) == 0;
+   }
+
+   g_free(path);
+   return ok;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchWriteFixtures --
+ *
+ *      Creates the input files in dir: the SNMP samples above, and IPv4 and
+ *      IPv6 route tables of numRoutes entries spread over a few interfaces.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      Creates files.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchWriteFixtures(const char *dir,        // IN
+                   unsigned int numRoutes) // IN
+{
+   static const char *ifNames[] = { "lo", "eth0", "eth1", "eth2" };
+   GString *route = g_string_new(NULL);
+   GString *route6 = g_string_new(NULL);
+   Bool ok = TRUE;
+   unsigned int i;
+
+   g_string_append(route, "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\t"
+                          "Metric\tMask\t\tMTU\tWindow\tIRTT"
+                          "                                                       "
+                          "\n");
+
+   for (i = 0; i < numRoutes; i++) {
+      const char *ifName = ifNames[i % ARRAYSIZE(ifNames)];
+
+      g_string_append_printf(route, "%s\t%08X\t%08X\t%04X\t%u\t%u\t%u\t%08X"
+                             "\t%u\t%u\t%u"
+                             "                                                "
+                             "               \n",
+                             ifName, 0x10ac + (i << 16), 0x0100000a,
+                             0x3, 0, i % 7, i % 1000, 0xffffffff, 0, 0, 0);
+      g_string_append_printf(route6, "fd00%012x%016x 80 "
+                             "00000000000000000000000000000000 00 "
+                             "fe80000000000000020c29fffe%06x %08x %08x "
+                             "%08x %08x %8s\n",
+                             i, (unsigned int)(i * 2654435761U), i,
+                             i % 1024, 1, i % 13, 0x80003, ifName);
+   }
+
+   ok &= BenchWriteFile(dir, "snmp", benchSnmp, strlen(benchSnmp));
+   ok &= BenchWriteFile(dir, "snmp6", benchSnmp6, strlen(benchSnmp6));
+   ok &= BenchWriteFile(dir, "route", route->str, route->len);
+   ok &= BenchWriteFile(dir, "ipv6_route", route6->str, route6->len);
+
+   g_string_free(route, TRUE);
+   g_string_free(route6, TRUE);
+
+   return ok;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRemoveFixtures --
+ *
+ *      Removes the files created by BenchWriteFixtures, and dir.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Removes files.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchRemoveFixtures(const char *dir)   // IN
+{
+   static const char *files[] = { "snmp", "snmp6", "route", "ipv6_route" };
+   unsigned int i;
+
+   for (i = 0; i < ARRAYSIZE(files); i++) {
+      gchar *path = g_build_filename(dir, files[i], NULL);
+
+      unlink(path);
+      g_free(path);
+   }
+   rmdir(dir);
+}
+
+
+/*
+ * Wrappers giving all the parsers the same signature.
+ */
+
+static gpointer
+BenchGetSnmp(const char *path)
+{
+   SlashProcNetSetPathSnmp(path);
+   return SlashProcNet_GetSnmp();
+}
+
+
+static gpointer
+BenchGetSnmp6(const char *path)
+{
+   SlashProcNetSetPathSnmp6(path);
+   return SlashProcNet_GetSnmp6();
+}
+
+
+static gpointer
+BenchGetRoute(const char *path)
+{
+   SlashProcNetSetPathRoute(path);
+   return SlashProcNet_GetRoute();
+}
+
+
+static gpointer
+BenchGetRoute6(const char *path)
+{
+   SlashProcNetSetPathRoute6(path);
+   return SlashProcNet_GetRoute6();
+}
+
+
+static void
+BenchFreeHash(gpointer result)
+{
+   g_hash_table_destroy(result);
+}
+
+
+static void
+BenchFreeRoute(gpointer result)
+{
+   SlashProcNet_FreeRoute(result);
+}
+
+
+static void
+BenchFreeRoute6(gpointer result)
+{
+   SlashProcNet_FreeRoute6(result);
+}
+
+
+static guint
+BenchCountHash(gpointer result)
+{
+   return g_hash_table_size(result);
+}
+
+
+static guint
+BenchCountArray(gpointer result)
+{
+   return ((GPtrArray *)result)->len;
+}
+
+
+#ifdef HAVE_GLIB_REGEX
+static gpointer
+BenchGetSnmpRegex(const char *path)
+{
+   return SlashProcNetRegex_GetSnmp(path);
+}
+
+
+static gpointer
+BenchGetSnmp6Regex(const char *path)
+{
+   return SlashProcNetRegex_GetSnmp6(path);
+}
+
+
+static gpointer
+BenchGetRouteRegex(const char *path)
+{
+   return SlashProcNetRegex_GetRoute(path);
+}
+
+
+static gpointer
+BenchGetRoute6Regex(const char *path)
+{
+   return SlashProcNetRegex_GetRoute6(path);
+}
+
+
+static void
+BenchFreeRouteRegex(gpointer result)
+{
+   SlashProcNetRegex_FreeRoute(result);
+}
+
+
+static void
+BenchFreeRoute6Regex(gpointer result)
+{
+   SlashProcNetRegex_FreeRoute6(result);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCompareCounter --
+ *
+ *      g_hash_table_foreach callback checking that a counter has the same
+ *      value in another table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Clears *data[1] on mismatch.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchCompareCounter(gpointer key,    // IN
+                    gpointer value,  // IN
+                    gpointer data)   // IN/OUT
+{
+   gpointer *args = data;
+   guint64 *other = g_hash_table_lookup(args[0], key);
+
+   if (other == NULL || *other != *(guint64 *)value) {
+      fprintf(stderr, "Counter %s differs.\n", (const char *)key);
+      *(Bool *)args[1] = FALSE;
+   }
+}
+
+
+static Bool
+BenchEqualHash(gpointer a,
+               gpointer b)
+{
+   Bool equal = g_hash_table_size(a) == g_hash_table_size(b);
+   gpointer args[2] = { b, &equal };
+
+   g_hash_table_foreach(a, BenchCompareCounter, args);
+   return equal;
+}
+
+
+static Bool
+BenchEqualRoute(gpointer a,
+                gpointer b)
+{
+   GPtrArray *arrayA = a;
+   GPtrArray *arrayB = b;
+   guint i;
+
+   if (arrayA->len != arrayB->len) {
+      return FALSE;
+   }
+
+   for (i = 0; i < arrayA->len; i++) {
+      struct rtentry *ra = g_ptr_array_index(arrayA, i);
+      struct rtentry *rb = g_ptr_array_index(arrayB, i);
+
+      if (strcmp(ra->rt_dev, rb->rt_dev) != 0 ||
+          memcmp(&ra->rt_dst, &rb->rt_dst, sizeof ra->rt_dst) != 0 ||
+          memcmp(&ra->rt_gateway, &rb->rt_gateway,
+                 sizeof ra->rt_gateway) != 0 ||
+          memcmp(&ra->rt_genmask, &rb->rt_genmask,
+                 sizeof ra->rt_genmask) != 0 ||
+          ra->rt_flags != rb->rt_flags ||
+          ra->rt_metric != rb->rt_metric ||
+          ra->rt_mtu != rb->rt_mtu ||
+          ra->rt_irtt != rb->rt_irtt) {
+         fprintf(stderr, "Route %u differs.\n", i);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+
+static Bool
+BenchEqualRoute6(gpointer a,
+                 gpointer b)
+{
+   GPtrArray *arrayA = a;
+   GPtrArray *arrayB = b;
+   guint i;
+
+   if (arrayA->len != arrayB->len) {
+      return FALSE;
+   }
+
+   for (i = 0; i < arrayA->len; i++) {
+      if (memcmp(g_ptr_array_index(arrayA, i), g_ptr_array_index(arrayB, i),
+                 sizeof (struct in6_rtmsg)) != 0) {
+         fprintf(stderr, "IPv6 route %u differs.\n", i);
+         return FALSE;
+      }
+   }
+   return TRUE;
+}
+#endif // ifdef HAVE_GLIB_REGEX
+
+
+static const BenchParser benchParsers[] = {
+#ifdef HAVE_GLIB_REGEX
+   { "snmp", BenchGetSnmp, BenchFreeHash, BenchGetSnmpRegex, BenchFreeHash,
+     BenchCountHash, BenchEqualHash },
+   { "snmp6", BenchGetSnmp6, BenchFreeHash, BenchGetSnmp6Regex, BenchFreeHash,
+     BenchCountHash, BenchEqualHash },
+   { "route", BenchGetRoute, BenchFreeRoute, BenchGetRouteRegex,
+     BenchFreeRouteRegex, BenchCountArray, BenchEqualRoute },
+   { "ipv6_route", BenchGetRoute6, BenchFreeRoute6, BenchGetRoute6Regex,
+     BenchFreeRoute6Regex, BenchCountArray, BenchEqualRoute6 },
+#else
+   { "snmp", BenchGetSnmp, BenchFreeHash, NULL, NULL, BenchCountHash, NULL },
+   { "snmp6", BenchGetSnmp6, BenchFreeHash, NULL, NULL, BenchCountHash, NULL },
+   { "route", BenchGetRoute, BenchFreeRoute, NULL, NULL, BenchCountArray,
+     NULL },
+   { "ipv6_route", BenchGetRoute6, BenchFreeRoute6, NULL, NULL,
+     BenchCountArray, NULL },
+#endif
+};
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchTime --
+ *
+ *      Times iterations of a parser and prints one line of results.
+ *
+ * Results:
+ *      TRUE if all the iterations succeeded.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+BenchTime(const char *file,          // IN
+          const char *variant,       // IN
+          const char *path,          // IN
+          BenchParseFn parse,        // IN
+          BenchFreeFn freeResult,    // IN
+          BenchCountFn count,        // IN
+          unsigned int iterations)   // IN
+{
+   uint64 total = 0;
+   uint64 best = 0;
+   guint entries = 0;
+   unsigned int i;
+
+   for (i = 0; i < iterations; i++) {
+      uint64 start = Bench_Now();
+      uint64 ns;
+      gpointer result = parse(path);
+
+      ns = Bench_Now() - start;
+      if (result == NULL) {
+         fprintf(stderr, "%s (%s): parse failed.\n", file, variant);
+         return FALSE;
+      }
+      entries = count(result);
+      freeResult(result);
+
+      total += ns;
+      if (i == 0 || ns < best) {
+         best = ns;
+      }
+   }
+
+   printf("%-12s %-8s %8u %12.1f %12.1f\n", file, variant, entries,
+          total / 1e3 / iterations, best / 1e3);
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog, "[-n iterations] [-r routes | -d dir]",
+               "  -n  Runs of each parser (default %u).\n"
+               "  -r  Routes in the generated route tables (default %u).\n"
+               "  -d  Parse the files in dir instead of generated ones,\n"
+               "      e.g. /proc/net.\n",
+               BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_ROUTES);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   unsigned int iterations = BENCH_DEFAULT_ITERATIONS;
+   unsigned int numRoutes = BENCH_DEFAULT_ROUTES;
+   const char *dir = NULL;
+   gchar *tmpDir = NULL;
+   Bool ok = TRUE;
+   unsigned int i;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "d:n:r:")) != -1) {
+      switch (opt) {
+      case 'd':
+         dir = optarg;
+         break;
+      case 'n':
+         iterations = strtoul(optarg, NULL, 0);
+         break;
+      case 'r':
+         numRoutes = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc || iterations == 0) {
+      BenchUsage(argv[0]);
+   }
+
+   if (dir == NULL) {
+      tmpDir = g_build_filename(g_get_tmp_dir(), "slashProcBench.XXXXXX", NULL);
+      if (mkdtemp(tmpDir) == NULL || !BenchWriteFixtures(tmpDir, numRoutes)) {
+         fprintf(stderr, "Failed to create the input files in %s.\n", tmpDir);
+         return 1;
+      }
+      dir = tmpDir;
+   }
+
+   printf("%-12s %-8s %8s %12s %12s\n", "file", "parser", "entries",
+          "avg(us)", "best(us)");
+
+   for (i = 0; i < ARRAYSIZE(benchParsers); i++) {
+      const BenchParser *parser = &benchParsers[i];
+      gchar *path = g_build_filename(dir, parser->file, NULL);
+
+      ok &= BenchTime(parser->file, "tokens", path, parser->parse,
+                      parser->free, parser->count, iterations);
+
+      if (parser->parseRegex != NULL) {
+         gpointer result;
+         gpointer resultRegex;
+
+         ok &= BenchTime(parser->file, "regex", path, parser->parseRegex,
+                         parser->freeRegex, parser->count, iterations);
+
+         result = parser->parse(path);
+         resultRegex = parser->parseRegex(path);
+         if (result != NULL && resultRegex != NULL &&
+             !parser->equal(result, resultRegex)) {
+            fprintf(stderr, "%s: parsers disagree.\n", parser->file);
+            ok = FALSE;
+         }
+         if (result != NULL) {
+            parser->free(result);
+         }
+         if (resultRegex != NULL) {
+            parser->freeRegex(resultRegex);
+         }
+      }
+
+      g_free(path);
+   }
+
+   if (tmpDir != NULL) {
+      BenchRemoveFixtures(tmpDir);
+      g_free(tmpDir);
+   }
+
+   return ok ? 0 : 1;
+}
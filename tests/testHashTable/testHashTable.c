@@ -0,0 +1,494 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * testHashTable.c --
+ *
+ *      Tests for lib/misc/hashTable.c:
+ *
+ *      - a non-atomic table is grown from a single bucket, with
+ *        case-insensitive keys, deletes and lookups across the rehashes;
+ *      - several threads race to allocate an atomic table with
+ *        HashTable_AllocOnce and insert the same keys into it while other
+ *        threads look them up, so inserts and lookups overlap with every
+ *        growth step;
+ *      - copied keys and client data are freed exactly once by each of
+ *        the calls that drop them.
+ *
+ *      The program exits with a non-zero status if any check fails. Run
+ *      it under valgrind to also catch leaked keys.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "vmware.h"
+#include "vm_atomic.h"
+#include "hashTable.h"
+#include "str.h"
+
+#define TEST_GROW_KEYS       100000
+#define TEST_ATOMIC_KEYS     50000
+#define TEST_ATOMIC_WRITERS  4
+#define TEST_ATOMIC_READERS  2
+#define TEST_FREE_KEYS       64
+
+#define TEST_CHECK(cond)                                             \
+   do {                                                              \
+      if (!(cond)) {                                                 \
+         fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                 __FILE__, __LINE__, #cond);                         \
+         Atomic_Inc(&testFailures);                                  \
+      }                                                              \
+   } while (0)
+
+static Atomic_uint32 testFailures;
+
+/* State shared by the threads of TestAtomic. */
+static Atomic_Ptr atomicTable;
+static Atomic_uint32 atomicProgress[TEST_ATOMIC_WRITERS];
+static Atomic_uint32 atomicWritersDone;
+static void *atomicResults[TEST_ATOMIC_WRITERS][TEST_ATOMIC_KEYS];
+
+/* Number of client data freed by TestFreeValue. */
+static Atomic_uint32 freedValues;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestFreeValue --
+ *
+ *      Free function of the tables in TestKeyFreeing and TestAtomic.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees the value and counts it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestFreeValue(void *clientData)  // IN:
+{
+   free(clientData);
+   Atomic_Inc(&freedValues);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestNewValue --
+ *
+ *      Allocate a client data holding 'n'.
+ *
+ * Results:
+ *      The value, to be freed with TestFreeValue.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+TestNewValue(uint32 n)  // IN:
+{
+   uint32 *value = malloc(sizeof *value);
+
+   if (value == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+   *value = n;
+
+   return value;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestCountEntry --
+ *
+ *      HashTable_ForEach callback counting the entries.
+ *
+ * Results:
+ *      0, to keep iterating.
+ *
+ * Side effects:
+ *      Increments *clientData.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+TestCountEntry(const char *key,    // IN: unused
+               void *value,        // IN: unused
+               void *clientData)   // IN/OUT: the count
+{
+   (*(size_t *) clientData)++;
+
+   return 0;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestGrow --
+ *
+ *      Grow a case-insensitive table from one bucket, then delete half of
+ *      its keys. Every lookup is done with a differently cased key.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Counts failed checks.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestGrow(void)
+{
+   HashTable *ht = HashTable_Alloc(1, HASH_ISTRING_KEY | HASH_FLAG_COPYKEY,
+                                   NULL);
+   char key[32];
+   size_t count = 0;
+   uint32 i;
+
+   for (i = 0; i < TEST_GROW_KEYS; i++) {
+      void *value;
+
+      Str_Sprintf(key, sizeof key, "Key%u", i);
+      TEST_CHECK(HashTable_Insert(ht, key, (void *) (uintptr_t) (i + 1)));
+
+      Str_Sprintf(key, sizeof key, "kEY%u", i / 2);
+      TEST_CHECK(HashTable_Lookup(ht, key, &value) &&
+                 value == (void *) (uintptr_t) (i / 2 + 1));
+   }
+   TEST_CHECK(HashTable_GetNumElements(ht) == TEST_GROW_KEYS);
+
+   for (i = 0; i < TEST_GROW_KEYS; i++) {
+      Str_Sprintf(key, sizeof key, "KEY%u", i);
+      TEST_CHECK(!HashTable_Insert(ht, key, NULL));
+   }
+
+   for (i = 0; i < TEST_GROW_KEYS; i += 2) {
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      TEST_CHECK(HashTable_Delete(ht, key));
+      TEST_CHECK(!HashTable_Delete(ht, key));
+   }
+   TEST_CHECK(HashTable_GetNumElements(ht) == TEST_GROW_KEYS / 2);
+
+   for (i = 0; i < TEST_GROW_KEYS; i++) {
+      void *value;
+
+      Str_Sprintf(key, sizeof key, "KeY%u", i);
+      if (i % 2 == 0) {
+         TEST_CHECK(!HashTable_Lookup(ht, key, NULL));
+      } else {
+         TEST_CHECK(HashTable_Lookup(ht, key, &value) &&
+                    value == (void *) (uintptr_t) (i + 1));
+      }
+   }
+
+   HashTable_ForEach(ht, TestCountEntry, &count);
+   TEST_CHECK(count == TEST_GROW_KEYS / 2);
+
+   HashTable_Free(ht);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestAtomicWriter --
+ *
+ *      Thread inserting all of TestAtomic's keys: even writers go up,
+ *      odd ones down, so they collide on every key. The key buffer is
+ *      reused, so the table must copy the keys.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      Records the value it got for each key in atomicResults.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+TestAtomicWriter(void *data)  // IN: writer number
+{
+   uint32 writer = (uint32) (uintptr_t) data;
+   HashTable *ht = HashTable_AllocOnce(&atomicTable, 4,
+                                       HASH_STRING_KEY | HASH_FLAG_ATOMIC |
+                                       HASH_FLAG_COPYKEY,
+                                       TestFreeValue);
+   char key[32];
+   uint32 n;
+
+   for (n = 0; n < TEST_ATOMIC_KEYS; n++) {
+      uint32 i = writer % 2 == 0 ? n : TEST_ATOMIC_KEYS - 1 - n;
+      void *value = TestNewValue(writer);
+      void *result;
+
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      result = HashTable_LookupOrInsert(ht, key, value);
+      if (result != value) {
+         free(value);
+      }
+      atomicResults[writer][i] = result;
+
+      /* Writer 0 goes up, so its progress is what TestAtomicReader checks. */
+      Atomic_Write(&atomicProgress[writer], n + 1);
+   }
+   Atomic_Inc(&atomicWritersDone);
+
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestAtomicReader --
+ *
+ *      Thread looking up the keys the writers already inserted, until
+ *      they are all done.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      Counts failed checks.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+TestAtomicReader(void *data)  // IN: unused
+{
+   HashTable *ht = HashTable_AllocOnce(&atomicTable, 4,
+                                       HASH_STRING_KEY | HASH_FLAG_ATOMIC |
+                                       HASH_FLAG_COPYKEY,
+                                       TestFreeValue);
+   char key[32];
+   uint32 seed = 1;
+
+   while (Atomic_Read(&atomicWritersDone) < TEST_ATOMIC_WRITERS) {
+      uint32 inserted = Atomic_Read(&atomicProgress[0]);
+      void *value;
+      uint32 i;
+
+      if (inserted == 0) {
+         sched_yield();
+         continue;
+      }
+
+      /* Writer 0 inserts keys 0..inserted-1; check one of them. */
+      seed = seed * 1103515245 + 12345;
+      i = (seed >> 8) % inserted;
+
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      TEST_CHECK(HashTable_Lookup(ht, key, &value) && value != NULL &&
+                 *(uint32 *) value < TEST_ATOMIC_WRITERS);
+
+      Str_Sprintf(key, sizeof key, "key%u", TEST_ATOMIC_KEYS + i);
+      TEST_CHECK(!HashTable_Lookup(ht, key, NULL));
+   }
+
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestAtomic --
+ *
+ *      Race writers and readers on an atomic table, then check that every
+ *      key was inserted once: all writers must have got the same value
+ *      for a key, and the table must hold each key exactly once.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Counts failed checks.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestAtomic(void)
+{
+   pthread_t writers[TEST_ATOMIC_WRITERS];
+   pthread_t readers[TEST_ATOMIC_READERS];
+   HashTable *ht;
+   size_t count = 0;
+   uint32 freedBefore;
+   uint32 i;
+   uint32 w;
+
+   for (w = 0; w < TEST_ATOMIC_READERS; w++) {
+      pthread_create(&readers[w], NULL, TestAtomicReader, NULL);
+   }
+   for (w = 0; w < TEST_ATOMIC_WRITERS; w++) {
+      pthread_create(&writers[w], NULL, TestAtomicWriter,
+                     (void *) (uintptr_t) w);
+   }
+   for (w = 0; w < TEST_ATOMIC_WRITERS; w++) {
+      pthread_join(writers[w], NULL);
+   }
+   for (w = 0; w < TEST_ATOMIC_READERS; w++) {
+      pthread_join(readers[w], NULL);
+   }
+
+   ht = Atomic_ReadPtr(&atomicTable);
+   TEST_CHECK(ht != NULL);
+   if (ht == NULL) {
+      return;
+   }
+
+   for (i = 0; i < TEST_ATOMIC_KEYS; i++) {
+      char key[32];
+      void *value;
+
+      for (w = 1; w < TEST_ATOMIC_WRITERS; w++) {
+         TEST_CHECK(atomicResults[w][i] == atomicResults[0][i]);
+      }
+
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      TEST_CHECK(HashTable_Lookup(ht, key, &value) &&
+                 value == atomicResults[0][i]);
+   }
+
+   HashTable_ForEach(ht, TestCountEntry, &count);
+   TEST_CHECK(count == TEST_ATOMIC_KEYS);
+
+   /* Replacing a value frees the old one. */
+   freedBefore = Atomic_Read(&freedValues);
+   TEST_CHECK(HashTable_ReplaceOrInsert(ht, "key0", TestNewValue(0)));
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 1);
+
+   HashTable_FreeUnsafe(ht);
+   TEST_CHECK(Atomic_Read(&freedValues) ==
+              freedBefore + 1 + TEST_ATOMIC_KEYS);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestKeyFreeing --
+ *
+ *      Check that each call dropping an entry of a table with copied keys
+ *      frees its value once, except HashTable_LookupAndDelete which hands
+ *      it back to the caller.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Counts failed checks.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestKeyFreeing(void)
+{
+   HashTable *ht = HashTable_Alloc(2, HASH_STRING_KEY | HASH_FLAG_COPYKEY,
+                                   TestFreeValue);
+   uint32 freedBefore = Atomic_Read(&freedValues);
+   char key[32];
+   void *value;
+   uint32 i;
+
+   for (i = 0; i < TEST_FREE_KEYS; i++) {
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      TEST_CHECK(HashTable_Insert(ht, key, TestNewValue(i)));
+   }
+   /* The buffer the keys were built in is gone, the copies must remain. */
+   memset(key, 0, sizeof key);
+
+   /* A rejected insert leaves the value to the caller. */
+   value = TestNewValue(0);
+   TEST_CHECK(!HashTable_Insert(ht, "key0", value));
+   free(value);
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore);
+
+   TEST_CHECK(HashTable_Delete(ht, "key0"));
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 1);
+
+   TEST_CHECK(HashTable_LookupAndDelete(ht, "key1", &value) &&
+              *(uint32 *) value == 1);
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 1);
+   free(value);
+
+   TEST_CHECK(HashTable_ReplaceOrInsert(ht, "key2", TestNewValue(2)));
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 2);
+   TEST_CHECK(!HashTable_ReplaceOrInsert(ht, "key0", TestNewValue(0)));
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 2);
+
+   for (i = 2; i < TEST_FREE_KEYS; i++) {
+      Str_Sprintf(key, sizeof key, "key%u", i);
+      TEST_CHECK(HashTable_Lookup(ht, key, &value) &&
+                 *(uint32 *) value == i);
+   }
+
+   HashTable_Clear(ht);
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 2 + TEST_FREE_KEYS - 1);
+   TEST_CHECK(HashTable_GetNumElements(ht) == 0);
+   TEST_CHECK(!HashTable_Lookup(ht, "key2", NULL));
+
+   TEST_CHECK(HashTable_Insert(ht, "key0", TestNewValue(0)));
+   HashTable_Free(ht);
+   TEST_CHECK(Atomic_Read(&freedValues) == freedBefore + 2 + TEST_FREE_KEYS);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   uint32 failures;
+
+   TestGrow();
+   TestKeyFreeing();
+   TestAtomic();
+
+   failures = Atomic_Read(&testFailures);
+   if (failures != 0) {
+      fprintf(stderr, "%s: %u checks failed.\n", argv[0], failures);
+      return 1;
+   }
+   printf("%s: all tests passed.\n", argv[0]);
+
+   return 0;
+}
@@ -0,0 +1,301 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * testRpcIn.c --
+ *
+ *      Tests for the poll schedule of the glib RpcIn loop (lib/rpcIn).
+ *      The loop runs on the fake Message_Channel of
+ *      tests/common/fakeMessage.c, whose host side hands out a scripted
+ *      number of TCLO requests and then nothing. For each schedule set
+ *      with RpcIn_SetSchedule, the test checks:
+ *
+ *      - every request is dispatched and the poll counters add up;
+ *      - after a request the loop polls again right away, for 'burst'
+ *        more polls;
+ *      - then the time between polls doubles from 10ms (or minDelay)
+ *        up to maxDelay and stays there.
+ *
+ *      The program exits with a non-zero status if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vmware.h"
+#include "rpcin.h"
+#include "fakeMessage.h"
+
+/* Slack allowed on the time between two polls, in ms. */
+#define TEST_EARLY_MS   2
+#define TEST_LATE_MS    30
+
+#define TEST_MAX_POLLS  16
+
+#define TEST_CHECK(cond)                                             \
+   do {                                                              \
+      if (!(cond)) {                                                 \
+         fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                 __FILE__, __LINE__, #cond);                         \
+         testFailures++;                                             \
+      }                                                              \
+   } while (0)
+
+typedef struct TestSchedule {
+   const char *name;
+   unsigned int minDelay;    /* RpcIn_SetSchedule arguments, in .01s */
+   unsigned int maxDelay;
+   unsigned int burst;
+   unsigned int requests;    /* the first polls that get a request */
+   unsigned int polls;       /* polls to observe */
+} TestSchedule;
+
+static const TestSchedule testSchedules[] = {
+   { "backoff",  0, 8, 0, 1, 7 },
+   { "burst",    0, 8, 3, 2, 10 },
+   { "minDelay", 3, 8, 0, 1, 5 },
+   { "flat",     2, 2, 0, 3, 7 },
+};
+
+static unsigned int testFailures;
+
+/* State of the fake host for the current schedule. */
+static unsigned int testPolls;
+static unsigned int testRequests;
+static unsigned int testDispatched;
+static uint64 testPollTimes[TEST_MAX_POLLS];
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestNowMs --
+ *
+ *      Monotonic time stamp.
+ *
+ * Results:
+ *      Current time in ms.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64
+TestNowMs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestHostReceive --
+ *
+ *      Fake host side of the channel: records the time of the poll, and
+ *      hands out a request for the first testRequests polls.
+ *
+ * Results:
+ *      A request, or NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *
+TestHostReceive(void *clientData)   // IN: Unused
+{
+   if (testPolls < TEST_MAX_POLLS) {
+      testPollTimes[testPolls] = TestNowMs();
+   }
+   return testPolls++ < testRequests ? "test.rpc 1 2 3" : NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestDispatch --
+ *
+ *      RpcIn dispatch callback.
+ *
+ * Results:
+ *      TRUE, with an empty result.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static gboolean
+TestDispatch(RpcInData *data)   // IN/OUT
+{
+   TEST_CHECK(strcmp(data->args, "test.rpc 1 2 3") == 0);
+   testDispatched++;
+
+   data->result = "";
+   data->resultLen = 0;
+   data->freeResult = FALSE;
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestError --
+ *
+ *      RpcIn error callback.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Counts a failure.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestError(void *clientData,      // IN: Unused
+          char const *status)    // IN
+{
+   fprintf(stderr, "RpcIn error: %s\n", status);
+   testFailures++;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestRunSchedule --
+ *
+ *      Runs the RpcIn loop with a schedule until it has polled the host
+ *      s->polls times, and checks the time between the polls against the
+ *      delays the schedule calls for.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Counts failures.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestRunSchedule(GMainContext *ctx,        // IN
+                const TestSchedule *s)    // IN
+{
+   unsigned int delay = 0;
+   unsigned int burstLeft = 0;
+   RpcInStats stats;
+   RpcIn *in;
+   unsigned int i;
+
+   ASSERT(s->polls <= TEST_MAX_POLLS);
+
+   testPolls = 0;
+   testRequests = s->requests;
+   testDispatched = 0;
+
+   in = RpcIn_Construct(ctx, TestDispatch, NULL);
+   TEST_CHECK(in != NULL);
+   if (in == NULL || !RpcIn_start(in, s->maxDelay, TestError, NULL)) {
+      fprintf(stderr, "%s: cannot start the RpcIn loop.\n", s->name);
+      testFailures++;
+      return;
+   }
+   RpcIn_SetSchedule(in, s->minDelay, s->maxDelay, s->burst);
+
+   while (testPolls < s->polls) {
+      g_main_context_iteration(ctx, TRUE);
+   }
+
+   RpcIn_GetStats(in, &stats);
+   RpcIn_stop(in);
+   RpcIn_Destruct(in);
+
+   TEST_CHECK(testDispatched == s->requests);
+   TEST_CHECK(stats.polls == s->polls);
+   TEST_CHECK(stats.emptyPolls == s->polls - s->requests);
+
+   /*
+    * The delay before each poll, as RpcInLoop computes it from the
+    * outcome of the previous poll.
+    */
+   for (i = 1; i < s->polls; i++) {
+      uint64 gap = testPollTimes[i] - testPollTimes[i - 1];
+      uint64 expected;
+
+      if (i - 1 < s->requests) {
+         delay = 0;
+         burstLeft = s->burst;
+      } else if (burstLeft > 0) {
+         burstLeft--;
+         delay = s->minDelay;
+      } else if (delay < s->maxDelay) {
+         delay = delay > 0 ? delay * 2 : 1;
+         delay = MAX(delay, s->minDelay);
+         delay = MIN(delay, s->maxDelay);
+      }
+      expected = delay * 10;
+
+      if (gap + TEST_EARLY_MS < expected || gap > expected + TEST_LATE_MS) {
+         fprintf(stderr, "%s: poll %u came %"FMT64"u ms after the previous "
+                 "one, expected %"FMT64"u ms.\n", s->name, i, gap, expected);
+         testFailures++;
+      }
+   }
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   FakeMessageHost host = { TestHostReceive, NULL, NULL };
+   GMainContext *ctx = g_main_context_new();
+   unsigned int i;
+
+   FakeMessage_Init(&host);
+
+   for (i = 0; i < ARRAYSIZE(testSchedules); i++) {
+      TestRunSchedule(ctx, &testSchedules[i]);
+   }
+
+   g_main_context_unref(ctx);
+
+   if (testFailures != 0) {
+      fprintf(stderr, "%s: %u checks failed.\n", argv[0], testFailures);
+      return 1;
+   }
+   printf("%s: all tests passed.\n", argv[0]);
+
+   return 0;
+}
@@ -0,0 +1,254 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * testVmtoolsLog.c --
+ *
+ *      Tests for async logging in libvmtools (vmtoolsLog.c). A child
+ *      process configures a file logger with "async=true", logs numbered
+ *      messages from several threads and exits right away, leaving the
+ *      writer thread to drain the queue from its atexit() handler. The
+ *      parent then reads the log file and checks that:
+ *
+ *      - every message was written, and nothing was dropped;
+ *      - the messages of each thread were written in the order they were
+ *        logged.
+ *
+ *      The program exits with a non-zero status if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+
+#include "vmware.h"
+#include "vmware/tools/log.h"
+
+#define TEST_DOMAIN     "testVmtoolsLog"
+#define TEST_THREADS    4
+#define TEST_MESSAGES   5000
+
+#define TEST_CHECK(cond)                                             \
+   do {                                                              \
+      if (!(cond)) {                                                 \
+         fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                 __FILE__, __LINE__, #cond);                         \
+         testFailures++;                                             \
+      }                                                              \
+   } while (0)
+
+static unsigned int testFailures;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestLogger --
+ *
+ *      Logging thread of the child: logs TEST_MESSAGES numbered messages.
+ *      Thread TEST_THREADS is the child's main thread.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+TestLogger(void *data)   // IN: thread index
+{
+   unsigned int thread = (unsigned int) (uintptr_t) data;
+   unsigned int i;
+
+   for (i = 0; i < TEST_MESSAGES; i++) {
+      g_log(TEST_DOMAIN, G_LOG_LEVEL_MESSAGE, "thread %u message %u\n",
+            thread, i);
+   }
+
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestChild --
+ *
+ *      Body of the child process: sets up async logging to 'path', runs
+ *      the logging threads, logs one more sequence from the main thread
+ *      and exits without stopping the writer, so that the queue is
+ *      usually not empty yet.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static NORETURN void
+TestChild(const char *path)   // IN: log file
+{
+   pthread_t threads[TEST_THREADS];
+   GKeyFile *cfg = g_key_file_new();
+   unsigned int i;
+
+   if (!g_thread_supported()) {
+      g_thread_init(NULL);
+   }
+
+   /*
+    * A queue large enough that nothing is dropped. Core dumps are disabled
+    * so that the only messages in the file are the test's.
+    */
+   g_key_file_set_boolean(cfg, "logging", "log", TRUE);
+   g_key_file_set_boolean(cfg, "logging", "enableCoreDump", FALSE);
+   g_key_file_set_boolean(cfg, "logging", "async", TRUE);
+   g_key_file_set_integer(cfg, "logging", "asyncBufferSize", 64 * 1024);
+   g_key_file_set_string(cfg, "logging", TEST_DOMAIN ".level", "message");
+   g_key_file_set_string(cfg, "logging", TEST_DOMAIN ".handler", "file");
+   g_key_file_set_string(cfg, "logging", TEST_DOMAIN ".data", path);
+   g_key_file_set_integer(cfg, "logging", TEST_DOMAIN ".maxLogSize", 0);
+   VMTools_ConfigLogging(TEST_DOMAIN, cfg, FALSE, TRUE);
+   g_key_file_free(cfg);
+
+   for (i = 0; i < TEST_THREADS; i++) {
+      if (pthread_create(&threads[i], NULL, TestLogger,
+                         (void *) (uintptr_t) i) != 0) {
+         fprintf(stderr, "Could not start logging thread.\n");
+         _exit(1);
+      }
+   }
+   for (i = 0; i < TEST_THREADS; i++) {
+      pthread_join(threads[i], NULL);
+   }
+
+   /* The last sequence is logged right before exiting. */
+   TestLogger((void *) (uintptr_t) TEST_THREADS);
+
+   exit(0);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * TestCheckLog --
+ *
+ *      Reads the log file written by the child and checks that each
+ *      thread's messages are all there, in order.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Increments testFailures for each failed check.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+TestCheckLog(const char *path)   // IN: log file
+{
+   unsigned int next[TEST_THREADS + 1] = { 0 };
+   unsigned int outOfOrder = 0;
+   unsigned int other = 0;
+   char line[256];
+   unsigned int i;
+   FILE *f = fopen(path, "r");
+
+   TEST_CHECK(f != NULL);
+   if (f == NULL) {
+      return;
+   }
+
+   while (fgets(line, sizeof line, f) != NULL) {
+      const char *msg = strstr(line, "] thread ");
+      unsigned int thread;
+      unsigned int seq;
+
+      if (msg == NULL ||
+          sscanf(msg, "] thread %u message %u", &thread, &seq) != 2 ||
+          thread > TEST_THREADS) {
+         other++;
+         continue;
+      }
+      if (seq != next[thread]) {
+         outOfOrder++;
+      }
+      next[thread] = seq + 1;
+   }
+   fclose(f);
+
+   TEST_CHECK(outOfOrder == 0);
+   TEST_CHECK(other == 0);
+   for (i = 0; i <= TEST_THREADS; i++) {
+      TEST_CHECK(next[i] == TEST_MESSAGES);
+   }
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   char dir[] = "/tmp/testVmtoolsLog.XXXXXX";
+   char *path;
+   int status;
+   pid_t pid;
+
+   if (mkdtemp(dir) == NULL) {
+      perror("mkdtemp");
+      return 1;
+   }
+   path = g_strdup_printf("%s/async.log", dir);
+
+   pid = fork();
+   if (pid == 0) {
+      TestChild(path);
+   }
+
+   TEST_CHECK(pid > 0);
+   if (pid > 0) {
+      TEST_CHECK(waitpid(pid, &status, 0) == pid);
+      TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      TestCheckLog(path);
+   }
+
+   unlink(path);
+   rmdir(dir);
+   g_free(path);
+
+   if (testFailures != 0) {
+      fprintf(stderr, "%s: %u checks failed.\n", argv[0], testFailures);
+      return 1;
+   }
+   printf("%s: all tests passed.\n", argv[0]);
+
+   return 0;
+}
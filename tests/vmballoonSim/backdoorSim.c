@@ -0,0 +1,441 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * backdoorSim.c --
+ *
+ *      Simulated monitor side of the balloon backdoor. Replaces the
+ *      lib/backdoor implementation of Backdoor_InOut(), so the balloon core
+ *      can be linked unmodified into a userspace program. See
+ *      vmballoonSim.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backdoor.h"
+#include "vmballoonSim.h"
+
+typedef struct SimHost {
+   SimHostConfig config;
+   unsigned long numPages;
+   uint8 *locked;             /* One byte per PPN, starting at SIM_BASE_PPN. */
+   unsigned long numLocked;
+   uint32 target;
+   uint32 capabilities;       /* Accepted at the last START. */
+   Bool started;
+   Bool resetPending;
+   uint32 guestType;
+   SimHostStats stats;
+} SimHost;
+
+static SimHost simHost;
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHost_Init --
+ *
+ *      Sets up the host side for a guest with numPages pages.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Bool
+SimHost_Init(unsigned long numPages,          // IN
+             const SimHostConfig *config)     // IN
+{
+   memset(&simHost, 0, sizeof simHost);
+   simHost.config = *config;
+   simHost.numPages = numPages;
+   simHost.locked = calloc(numPages, 1);
+
+   return simHost.locked != NULL;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHost_Cleanup --
+ *
+ *      Frees the host side state.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+SimHost_Cleanup(void)
+{
+   free(simHost.locked);
+   memset(&simHost, 0, sizeof simHost);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHost_SetTarget --
+ *
+ *      Sets the balloon target returned to the guest.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+SimHost_SetTarget(uint32 target)   // IN
+{
+   simHost.target = target;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHost_Reset --
+ *
+ *      Simulates a reset of the monitor's balloon state (e.g. after the
+ *      VM was resumed elsewhere): all locked pages are forgotten and every
+ *      command fails with BALLOON_ERROR_RESET until the next START.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+SimHost_Reset(void)
+{
+   memset(simHost.locked, 0, simHost.numPages);
+   simHost.numLocked = 0;
+   simHost.resetPending = TRUE;
+   simHost.stats.resets++;
+}
+
+
+/*
+ * Accessors for the harness.
+ */
+
+Bool
+SimHost_IsResetPending(void)
+{
+   return simHost.resetPending;
+}
+
+
+Bool
+SimHost_IsLocked(unsigned long ppn)   // IN
+{
+   return ppn >= SIM_BASE_PPN && ppn - SIM_BASE_PPN < simHost.numPages &&
+          simHost.locked[ppn - SIM_BASE_PPN];
+}
+
+
+unsigned long
+SimHost_LockedPages(void)
+{
+   return simHost.numLocked;
+}
+
+
+const SimHostStats *
+SimHost_GetStats(void)
+{
+   return &simHost.stats;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHostLock --
+ *
+ *      Handles BALLOON_BDOOR_CMD_LOCK and BALLOON_BDOOR_CMD_UNLOCK.
+ *
+ * Results:
+ *      Backdoor status.
+ *
+ * Side effects:
+ *      Updates the set of locked pages.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SimHostLock(size_t ppn,     // IN
+            Bool lock)      // IN
+{
+   unsigned long idx = ppn - SIM_BASE_PPN;
+
+   if (ppn < SIM_BASE_PPN || idx >= simHost.numPages) {
+      return BALLOON_ERROR_PPN_INVALID;
+   }
+
+   if (lock) {
+      if (simHost.locked[idx]) {
+         return BALLOON_ERROR_PPN_LOCKED;
+      }
+      if (Sim_Chance(simHost.config.lockFailPermille)) {
+         return simHost.config.lockError;
+      }
+      if (simHost.numLocked >= simHost.target) {
+         return BALLOON_ERROR_PPN_NOTNEEDED;
+      }
+      simHost.locked[idx] = 1;
+      simHost.numLocked++;
+      simHost.stats.lockedPages++;
+   } else {
+      if (!simHost.locked[idx]) {
+         return BALLOON_ERROR_PPN_UNLOCKED;
+      }
+      if (Sim_Chance(simHost.config.unlockFailPermille)) {
+         return simHost.config.unlockError;
+      }
+      simHost.locked[idx] = 0;
+      simHost.numLocked--;
+      simHost.stats.unlockedPages++;
+   }
+
+   return BALLOON_SUCCESS;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHostLockLarge --
+ *
+ *      Locks or unlocks the 2MB page starting at ppn, all or nothing.
+ *
+ * Results:
+ *      Backdoor status.
+ *
+ * Side effects:
+ *      Updates the set of locked pages.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SimHostLockLarge(size_t ppn,     // IN
+                 Bool lock)      // IN
+{
+   unsigned long idx = ppn - SIM_BASE_PPN;
+   unsigned long i;
+
+   if (ppn < SIM_BASE_PPN || ppn % BALLOON_2M_PAGES != 0 ||
+       idx + BALLOON_2M_PAGES > simHost.numPages) {
+      return BALLOON_ERROR_PPN_INVALID;
+   }
+
+   for (i = idx; i < idx + BALLOON_2M_PAGES; i++) {
+      if (simHost.locked[i] != !lock) {
+         return lock ? BALLOON_ERROR_PPN_LOCKED : BALLOON_ERROR_PPN_UNLOCKED;
+      }
+   }
+
+   if (lock) {
+      if (Sim_Chance(simHost.config.lockFailPermille)) {
+         return simHost.config.lockError;
+      }
+      if (simHost.numLocked + BALLOON_2M_PAGES > simHost.target) {
+         return BALLOON_ERROR_PPN_NOTNEEDED;
+      }
+      simHost.numLocked += BALLOON_2M_PAGES;
+      simHost.stats.lockedPages += BALLOON_2M_PAGES;
+   } else {
+      if (Sim_Chance(simHost.config.unlockFailPermille)) {
+         return simHost.config.unlockError;
+      }
+      simHost.numLocked -= BALLOON_2M_PAGES;
+      simHost.stats.unlockedPages += BALLOON_2M_PAGES;
+   }
+   memset(simHost.locked + idx, lock, BALLOON_2M_PAGES);
+
+   return BALLOON_SUCCESS;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimHostLockBatched --
+ *
+ *      Handles BALLOON_BDOOR_CMD_BATCHED_LOCK,
+ *      BALLOON_BDOOR_CMD_BATCHED_UNLOCK and their 2MB variants.
+ *
+ * Results:
+ *      Backdoor status; the status of each page is in its batch entry.
+ *
+ * Side effects:
+ *      Updates the set of locked pages.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SimHostLockBatched(size_t batchPPN,    // IN
+                   uint32 nPages,      // IN
+                   Bool lock,          // IN
+                   Bool large)         // IN
+{
+   uint32 cap = large ? BALLOON_BATCHED_2M_CMDS : BALLOON_BATCHED_CMDS;
+   BalloonBatchPage *batchPage;
+   uint16 i;
+
+   if ((simHost.capabilities & cap) == 0) {
+      return BALLOON_ERROR_CMD_INVALID;
+   }
+
+   batchPage = SimOS_PPNToAddr(batchPPN);
+   if (batchPage == NULL || nPages > BALLOON_BATCH_MAX_PAGES) {
+      return BALLOON_ERROR_PPN_INVALID;
+   }
+
+   for (i = 0; i < nPages; i++) {
+      size_t ppn = Balloon_BatchGetPA(batchPage, i) >> BALLOON_BATCH_PAGE_SHIFT;
+
+      Balloon_BatchSetStatus(batchPage, i, large ? SimHostLockLarge(ppn, lock)
+                                                 : SimHostLock(ppn, lock));
+   }
+   simHost.stats.batchedPages += large ? nPages * BALLOON_2M_PAGES : nPages;
+
+   return BALLOON_SUCCESS;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Backdoor_InOut --
+ *
+ *      Handles a balloon backdoor call.
+ *
+ * Results:
+ *      Status in ax, balloon target in bx, capabilities in cx after
+ *      START.
+ *
+ * Side effects:
+ *      Aborts the process on a call for another backdoor port.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Backdoor_InOut(Backdoor_proto *bp)   // IN/OUT
+{
+   uint32 cmd = bp->in.cx.halfs.low;
+   size_t arg = bp->in.size;
+   uint32 arg2 = bp->in.si.word;
+   uint32 target = simHost.target;
+   int status;
+
+   if (bp->in.ax.word != BALLOON_BDOOR_MAGIC ||
+       bp->in.dx.halfs.low != BALLOON_BDOOR_PORT ||
+       cmd >= SIM_BDOOR_CMDS) {
+      fprintf(stderr, "backdoorSim: unexpected backdoor call "
+              "(magic %#x, port %#x, cmd %u).\n", bp->in.ax.word,
+              bp->in.dx.halfs.low, cmd);
+      abort();
+   }
+
+   simHost.stats.calls[cmd]++;
+
+   if (cmd == BALLOON_BDOOR_CMD_START) {
+      memset(simHost.locked, 0, simHost.numPages);
+      simHost.numLocked = 0;
+      simHost.resetPending = FALSE;
+      simHost.started = TRUE;
+      simHost.capabilities = arg & simHost.config.capabilities;
+      status = simHost.config.capabilities != 0 ?
+               BALLOON_SUCCESS_WITH_CAPABILITIES : BALLOON_SUCCESS;
+   } else if (simHost.resetPending || !simHost.started) {
+      status = BALLOON_ERROR_RESET;
+   } else {
+      switch (cmd) {
+      case BALLOON_BDOOR_CMD_TARGET:
+         /* The guest passes the largest balloon it can support, if known. */
+         if (arg != BALLOON_MAX_SIZE_USE_CONFIG && target > arg) {
+            target = arg;
+         }
+         status = BALLOON_SUCCESS;
+         break;
+      case BALLOON_BDOOR_CMD_LOCK:
+         status = SimHostLock(arg, TRUE);
+         break;
+      case BALLOON_BDOOR_CMD_UNLOCK:
+         status = SimHostLock(arg, FALSE);
+         break;
+      case BALLOON_BDOOR_CMD_BATCHED_LOCK:
+         status = SimHostLockBatched(arg, arg2, TRUE, FALSE);
+         break;
+      case BALLOON_BDOOR_CMD_BATCHED_UNLOCK:
+         status = SimHostLockBatched(arg, arg2, FALSE, FALSE);
+         break;
+      case BALLOON_BDOOR_CMD_BATCHED_2M_LOCK:
+         status = SimHostLockBatched(arg, arg2, TRUE, TRUE);
+         break;
+      case BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK:
+         status = SimHostLockBatched(arg, arg2, FALSE, TRUE);
+         break;
+      case BALLOON_BDOOR_CMD_GUEST_ID:
+         simHost.guestType = arg;
+         status = BALLOON_SUCCESS;
+         break;
+      default:
+         status = BALLOON_ERROR_CMD_INVALID;
+         break;
+      }
+   }
+
+   if (status != BALLOON_SUCCESS &&
+       status != BALLOON_SUCCESS_WITH_CAPABILITIES) {
+      simHost.stats.errors[cmd]++;
+   }
+
+   bp->out.ax.word = status;
+   bp->out.bx.word = target;
+   if (status == BALLOON_SUCCESS_WITH_CAPABILITIES) {
+      bp->out.cx.word = simHost.capabilities;
+   }
+}
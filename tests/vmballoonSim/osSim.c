@@ -0,0 +1,753 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * osSim.c --
+ *
+ *      Userspace implementation of the vmmemctl os.h interface, backed by
+ *      an mmap()ed pool of pages. The pool is managed in 2MB blocks, each
+ *      with a stack of its free pages, so that free blocks can be handed
+ *      out as large pages. See vmballoonSim.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "vm_basic_defs.h"
+#include "os.h"
+#include "vmballoonSim.h"
+
+typedef struct SimOS {
+   SimOSConfig config;
+   char *pool;
+   unsigned long numBlocks;
+   uint16 *blockStack;        /* Per block stack of free page offsets. */
+   uint16 *blockFree;         /* Number of free pages per block. */
+   unsigned long smallBlock;  /* Block small pages are taken from. */
+   unsigned long largeHint;   /* Where to look for a free block first. */
+   unsigned long numFree;
+   uint8 *allocated;          /* One byte per page, to catch bad frees. */
+   unsigned long numMapped;
+   SimOSStats stats;
+} SimOS;
+
+#define SIM_PAGE_FREE         0
+#define SIM_PAGE_SMALL        1
+#define SIM_PAGE_LARGE        2
+
+static SimOS simOS;
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSPanic --
+ *
+ *      Reports a misuse of the os.h interface by the balloon core.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Aborts the process.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SimOSPanic(const char *what,     // IN
+           PageHandle handle)    // IN
+{
+   fprintf(stderr, "osSim: %s (handle %#lx).\n", what, (unsigned long)handle);
+   abort();
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSPageIndex --
+ *
+ *      Validates a page handle.
+ *
+ * Results:
+ *      Index of the page in the pool.
+ *
+ * Side effects:
+ *      Aborts the process if the handle is not a page of the pool.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+SimOSPageIndex(PageHandle handle)   // IN
+{
+   uintptr_t offset = handle - (uintptr_t)simOS.pool;
+
+   if (handle < (uintptr_t)simOS.pool ||
+       offset >= simOS.config.poolPages * (uintptr_t)SIM_PAGE_SIZE ||
+       offset % SIM_PAGE_SIZE != 0) {
+      SimOSPanic("invalid page handle", handle);
+   }
+   return offset / SIM_PAGE_SIZE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSBlockPages --
+ *
+ *      Size of a block; only the last one can be short.
+ *
+ * Results:
+ *      Number of pages of the block.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+SimOSBlockPages(unsigned long block)   // IN
+{
+   return MIN(SIM_BLOCK_PAGES,
+              simOS.config.poolPages - block * SIM_BLOCK_PAGES);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSBlockReset --
+ *
+ *      Marks all the pages of a block free.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SimOSBlockReset(unsigned long block)   // IN
+{
+   uint16 *stack = simOS.blockStack + block * SIM_BLOCK_PAGES;
+   unsigned long n = SimOSBlockPages(block);
+   unsigned long i;
+
+   /* Pages come off the stack in ascending order. */
+   for (i = 0; i < n; i++) {
+      stack[i] = n - 1 - i;
+   }
+   simOS.blockFree[block] = n;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSPageTake --
+ *
+ *      Takes a page from the free pages of a block.
+ *
+ * Results:
+ *      Index of the page.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+SimOSPageTake(unsigned long block)   // IN
+{
+   uint16 *stack = simOS.blockStack + block * SIM_BLOCK_PAGES;
+   unsigned long idx = block * SIM_BLOCK_PAGES +
+                       stack[--simOS.blockFree[block]];
+
+   simOS.allocated[idx] = SIM_PAGE_SMALL;
+   simOS.numFree--;
+   return idx;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSSmallBlock --
+ *
+ *      Picks the block to take the next small page from. Like a buddy
+ *      allocator, prefers partially used blocks, so that free blocks are
+ *      kept for large pages.
+ *
+ * Results:
+ *      Block index; numBlocks if there is no free page.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+SimOSSmallBlock(void)
+{
+   unsigned long freeBlock = simOS.numBlocks;
+   unsigned long b;
+
+   if (simOS.smallBlock < simOS.numBlocks &&
+       simOS.blockFree[simOS.smallBlock] > 0) {
+      return simOS.smallBlock;
+   }
+
+   for (b = 0; b < simOS.numBlocks; b++) {
+      if (simOS.blockFree[b] == 0) {
+         continue;
+      }
+      if (simOS.blockFree[b] < SimOSBlockPages(b)) {
+         break;
+      }
+      if (freeBlock == simOS.numBlocks) {
+         freeBlock = b;
+      }
+   }
+
+   simOS.smallBlock = b < simOS.numBlocks ? b : freeBlock;
+   return simOS.smallBlock;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_Init --
+ *
+ *      Sets up the page pool and takes the workload pages out of it.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      Maps poolPages pages of (untouched) anonymous memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Bool
+SimOS_Init(const SimOSConfig *config)   // IN
+{
+   unsigned long i;
+
+   memset(&simOS, 0, sizeof simOS);
+   simOS.config = *config;
+
+   if (config->workloadPages > config->poolPages ||
+       config->poolPages > MAX_UINT32) {
+      return FALSE;
+   }
+
+   simOS.pool = mmap(NULL, config->poolPages * (size_t)SIM_PAGE_SIZE,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (simOS.pool == MAP_FAILED) {
+      simOS.pool = NULL;
+      return FALSE;
+   }
+
+   simOS.numBlocks = (config->poolPages + SIM_BLOCK_PAGES - 1) /
+                     SIM_BLOCK_PAGES;
+   simOS.blockStack = malloc(simOS.numBlocks * SIM_BLOCK_PAGES *
+                             sizeof *simOS.blockStack);
+   simOS.blockFree = malloc(simOS.numBlocks * sizeof *simOS.blockFree);
+   simOS.allocated = calloc(config->poolPages, 1);
+   if (simOS.blockStack == NULL || simOS.blockFree == NULL ||
+       simOS.allocated == NULL) {
+      SimOS_Cleanup();
+      return FALSE;
+   }
+
+   for (i = 0; i < simOS.numBlocks; i++) {
+      SimOSBlockReset(i);
+   }
+   simOS.numFree = config->poolPages;
+
+   for (i = 0; i < config->workloadPages; i++) {
+      if (config->fragmented) {
+         /* Deal the workload out over the blocks, one page at a time. */
+         unsigned long b = i % simOS.numBlocks;
+
+         while (simOS.blockFree[b] == 0) {
+            b = (b + 1) % simOS.numBlocks;
+         }
+         SimOSPageTake(b);
+      } else {
+         SimOSPageTake(SimOSSmallBlock());
+      }
+   }
+
+   return TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_Cleanup --
+ *
+ *      Releases the page pool.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+SimOS_Cleanup(void)
+{
+   if (simOS.pool != NULL) {
+      munmap(simOS.pool, simOS.config.poolPages * (size_t)SIM_PAGE_SIZE);
+   }
+   free(simOS.blockStack);
+   free(simOS.blockFree);
+   free(simOS.allocated);
+   memset(&simOS, 0, sizeof simOS);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_UsedPages --
+ *
+ *      Number of pages of the pool currently allocated, workload included.
+ *
+ * Results:
+ *      See above.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+unsigned long
+SimOS_UsedPages(void)
+{
+   return simOS.config.poolPages - simOS.numFree;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_GetStats --
+ *
+ *      Returns the counters of the simulated OS.
+ *
+ * Results:
+ *      See above.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const SimOSStats *
+SimOS_GetStats(void)
+{
+   return &simOS.stats;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_MappedPages --
+ *
+ *      Number of pages currently mapped with OS_MapPageHandle().
+ *
+ * Results:
+ *      See above.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+unsigned long
+SimOS_MappedPages(void)
+{
+   return simOS.numMapped;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOS_PPNToAddr --
+ *
+ *      Gives the host access to a guest page, e.g. the batch page.
+ *
+ * Results:
+ *      Address of the page, NULL if the PPN is not an allocated page.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void *
+SimOS_PPNToAddr(unsigned long ppn)   // IN
+{
+   unsigned long idx = ppn - SIM_BASE_PPN;
+
+   if (ppn < SIM_BASE_PPN || idx >= simOS.config.poolPages ||
+       simOS.allocated[idx] == SIM_PAGE_FREE) {
+      return NULL;
+   }
+   return simOS.pool + idx * (size_t)SIM_PAGE_SIZE;
+}
+
+
+/*
+ * os.h interface.
+ */
+
+void
+OS_MemZero(void *ptr,     // OUT
+           size_t size)   // IN
+{
+   memset(ptr, 0, size);
+}
+
+
+void
+OS_MemCopy(void *dest,         // OUT
+           const void *src,    // IN
+           size_t size)        // IN
+{
+   memcpy(dest, src, size);
+}
+
+
+void *
+OS_Malloc(size_t size)   // IN
+{
+   simOS.stats.malloc++;
+   return malloc(size);
+}
+
+
+void
+OS_Free(void *ptr,     // IN
+        size_t size)   // IN
+{
+   free(ptr);
+}
+
+
+void
+OS_Yield(void)
+{
+   simOS.stats.yield++;
+}
+
+
+unsigned long
+OS_ReservedPageGetLimit(void)
+{
+   return simOS.config.poolPages;
+}
+
+
+unsigned long
+OS_ReservedPageGetPPN(PageHandle handle)   // IN
+{
+   return SimOSPageIndex(handle) + SIM_BASE_PPN;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SimOSAllocFails --
+ *
+ *      Applies the memory pressure watermarks and the random failures of
+ *      the configuration to an allocation of "pages" pages.
+ *
+ * Results:
+ *      TRUE if the allocation must fail.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Bool
+SimOSAllocFails(int canSleep,            // IN
+                unsigned long pages)     // IN
+{
+   BalloonPageAllocType type = canSleep ? BALLOON_PAGE_ALLOC_CANSLEEP
+                                        : BALLOON_PAGE_ALLOC_NOSLEEP;
+   unsigned long floor = canSleep ? simOS.config.minFree
+                                  : simOS.config.lowWater;
+
+   return simOS.numFree < floor + pages ||
+          Sim_Chance(simOS.config.failPermille[type]);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_ReservedPageAlloc --
+ *
+ *      Allocates a page from the pool, subject to the memory pressure
+ *      watermarks and the random failures of the configuration.
+ *
+ * Results:
+ *      Page handle, or PAGE_HANDLE_INVALID.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+PageHandle
+OS_ReservedPageAlloc(int canSleep)   // IN
+{
+   BalloonPageAllocType type = canSleep ? BALLOON_PAGE_ALLOC_CANSLEEP
+                                        : BALLOON_PAGE_ALLOC_NOSLEEP;
+   unsigned long idx;
+
+   simOS.stats.alloc[type]++;
+   if (SimOSAllocFails(canSleep, 1)) {
+      simOS.stats.allocFail[type]++;
+      return PAGE_HANDLE_INVALID;
+   }
+
+   idx = SimOSPageTake(SimOSSmallBlock());
+   return (PageHandle)(simOS.pool + idx * (size_t)SIM_PAGE_SIZE);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_ReservedPageFree --
+ *
+ *      Returns a page to the pool.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Aborts the process if the page is not allocated, or if the host
+ *      still has it locked (i.e. the guest would reuse memory that was
+ *      given away).
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+OS_ReservedPageFree(PageHandle handle)   // IN
+{
+   unsigned long idx = SimOSPageIndex(handle);
+   unsigned long block = idx / SIM_BLOCK_PAGES;
+
+   if (simOS.allocated[idx] != SIM_PAGE_SMALL) {
+      SimOSPanic("freeing a page that is not allocated", handle);
+   }
+   if (SimHost_IsLocked(idx + SIM_BASE_PPN)) {
+      SimOSPanic("freeing a page locked by the host", handle);
+   }
+
+   simOS.allocated[idx] = SIM_PAGE_FREE;
+   simOS.blockStack[block * SIM_BLOCK_PAGES + simOS.blockFree[block]++] =
+      idx % SIM_BLOCK_PAGES;
+   simOS.numFree++;
+   simOS.stats.free++;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageSupported --
+ *
+ *      The simulated OS can always reserve blocks of the pool.
+ *
+ * Results:
+ *      TRUE
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Bool
+OS_ReservedLargePageSupported(void)
+{
+   return TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageAlloc --
+ *
+ *      Allocates a free block of the pool, if there is one, subject to
+ *      the same conditions as OS_ReservedPageAlloc().
+ *
+ * Results:
+ *      Page handle, or PAGE_HANDLE_INVALID.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+PageHandle
+OS_ReservedLargePageAlloc(int canSleep)   // IN
+{
+   unsigned long i;
+
+   simOS.stats.largeAlloc++;
+   if (!SimOSAllocFails(canSleep, SIM_BLOCK_PAGES)) {
+      for (i = 0; i < simOS.numBlocks; i++) {
+         unsigned long b = (simOS.largeHint + i) % simOS.numBlocks;
+         unsigned long idx = b * SIM_BLOCK_PAGES;
+
+         if (simOS.blockFree[b] != SIM_BLOCK_PAGES) {
+            continue;
+         }
+
+         simOS.blockFree[b] = 0;
+         memset(simOS.allocated + idx, SIM_PAGE_LARGE, SIM_BLOCK_PAGES);
+         simOS.numFree -= SIM_BLOCK_PAGES;
+         simOS.largeHint = b + 1;
+         return (PageHandle)(simOS.pool + idx * (size_t)SIM_PAGE_SIZE);
+      }
+   }
+
+   simOS.stats.largeAllocFail++;
+   return PAGE_HANDLE_INVALID;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_ReservedLargePageFree --
+ *
+ *      Returns a block to the pool.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Aborts the process on the same errors as OS_ReservedPageFree().
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+OS_ReservedLargePageFree(PageHandle handle)   // IN
+{
+   unsigned long idx = SimOSPageIndex(handle);
+   unsigned long i;
+
+   if (idx % SIM_BLOCK_PAGES != 0 ||
+       simOS.allocated[idx] != SIM_PAGE_LARGE) {
+      SimOSPanic("freeing a large page that is not allocated", handle);
+   }
+   for (i = idx; i < idx + SIM_BLOCK_PAGES; i++) {
+      if (SimHost_IsLocked(i + SIM_BASE_PPN)) {
+         SimOSPanic("freeing a large page locked by the host", handle);
+      }
+   }
+
+   memset(simOS.allocated + idx, SIM_PAGE_FREE, SIM_BLOCK_PAGES);
+   SimOSBlockReset(idx / SIM_BLOCK_PAGES);
+   simOS.numFree += SIM_BLOCK_PAGES;
+   simOS.stats.largeFree++;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OS_MapPageHandle --
+ *
+ *      Page handles already are addresses; only keeps count of the
+ *      mappings so that the harness can account for the pages.
+ *
+ * Results:
+ *      Mapping of the page.
+ *
+ * Side effects:
+ *      Aborts the process if the page is not allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Mapping
+OS_MapPageHandle(PageHandle handle)   // IN
+{
+   if (simOS.allocated[SimOSPageIndex(handle)] == SIM_PAGE_FREE) {
+      SimOSPanic("mapping a free page", handle);
+   }
+
+   simOS.numMapped++;
+   simOS.stats.map++;
+   return (Mapping)handle;
+}
+
+
+void *
+OS_Mapping2Addr(Mapping mapping)   // IN
+{
+   return (void *)mapping;
+}
+
+
+void
+OS_UnmapPage(Mapping mapping)   // IN
+{
+   simOS.numMapped--;
+}
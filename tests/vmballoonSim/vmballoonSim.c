@@ -0,0 +1,654 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * vmballoonSim.c --
+ *
+ *   Simulation harness and benchmark for the OS independent balloon core
+ *   (modules/shared/vmmemctl/vmballoon.c). The core is linked unmodified
+ *   against a simulated guest OS (osSim.c) and a simulated monitor
+ *   (backdoorSim.c), and driven one Balloon_QueryAndExecute() call per
+ *   simulated second, like the kernel drivers' timers do.
+ *
+ *   Each scenario configures memory pressure and error injection and runs
+ *   a script of balloon targets. The script is a comma separated list of
+ *   steps:
+ *
+ *     <pages>        set the target and run until the balloon reaches it
+ *     <pages>/<n>    set the target and run for exactly n ticks
+ *     reset          make the monitor reset the balloon
+ *
+ *   Every scenario runs once per balloon protocol: "basic" against a
+ *   monitor that only knows the per-page lock and unlock commands,
+ *   "batched" against one that accepts BALLOON_BATCHED_CMDS, and
+ *   "batch-2m" against one that also accepts 2MB pages.
+ *
+ *   After every tick the harness checks that the guest and the monitor
+ *   agree on the balloon size and that no page leaked. It reports how
+ *   many ticks (i.e. seconds) the script took, the pages the monitor
+ *   locked (inflated) and unlocked (deflated), the inflate and deflate
+ *   throughput of the core in pages per second of CPU time, backdoor calls
+ *   per page, and the lowest allocation and free rates the core adapted
+ *   to. With -v, the state of the balloon is printed after every tick.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "vm_basic_defs.h"
+#include "vmballoonSim.h"
+#include "benchUtil.h"
+
+/* Give up on a step if the target is not reached in this many ticks. */
+#define SIM_STEP_MAX_TICKS       3600
+
+#define SIM_DEFAULT_POOL_PAGES   262144   /* 1GB guest */
+
+typedef struct SimScenario {
+   const char *name;
+   const char *description;
+   const char *script;
+   SimOSConfig os;
+   SimHostConfig host;
+} SimScenario;
+
+typedef struct SimProtocol {
+   const char *name;
+   uint32 capabilities;
+} SimProtocol;
+
+typedef struct SimResult {
+   unsigned int ticks;
+   unsigned long inflated;
+   uint64 inflateNs;
+   unsigned long deflated;
+   uint64 deflateNs;
+   uint32 minRateAlloc;
+   uint32 minRateFree;
+} SimResult;
+
+static const SimScenario simScenarios[] = {
+   {
+      "cycle",
+      "inflate to 200000 pages and back, no memory pressure",
+      "200000,0",
+      { SIM_DEFAULT_POOL_PAGES, 0, 0, 0, { 0, 0 } },
+      { 0, 0, 0, 0 },
+   },
+   {
+      "pressure",
+      "target above free memory: NOSLEEP allocations fail below 16384 "
+      "free pages, CANSLEEP ones below 4096",
+      "200000/60,0",
+      { SIM_DEFAULT_POOL_PAGES, 131072, 16384, 4096, { 0, 0 } },
+      { 0, 0, 0, 0 },
+   },
+   {
+      "flaky",
+      "random allocation failures (2% NOSLEEP, 0.5% CANSLEEP), 1% of "
+      "locks fail with PPN_PINNED and 0.5% of unlocks with BUSY",
+      "200000,0",
+      { SIM_DEFAULT_POOL_PAGES, 0, 0, 0, { 20, 5 } },
+      { 10, BALLOON_ERROR_PPN_PINNED, 5, BALLOON_ERROR_BUSY },
+   },
+   {
+      "reset",
+      "monitor resets the balloon while inflated",
+      "150000,reset,150000,0",
+      { SIM_DEFAULT_POOL_PAGES, 0, 0, 0, { 0, 0 } },
+      { 0, 0, 0, 0 },
+   },
+   {
+      "fragmented",
+      "one used page in every 2MB block of the guest, so no large page "
+      "can be allocated",
+      "200000,0",
+      { SIM_DEFAULT_POOL_PAGES, SIM_DEFAULT_POOL_PAGES / SIM_BLOCK_PAGES,
+        0, 0, { 0, 0 }, TRUE },
+      { 0, 0, 0, 0 },
+   },
+};
+
+static const SimProtocol simProtocols[] = {
+   { "basic",   0 },
+   { "batched", BALLOON_BASIC_CMDS | BALLOON_BATCHED_CMDS },
+   { "batch-2m", BALLOON_BASIC_CMDS | BALLOON_BATCHED_CMDS |
+                 BALLOON_BATCHED_2M_CMDS },
+};
+
+static Bool simVerbose = FALSE;
+static uint32 simRandom = 1;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Sim_Seed --
+ *
+ *      Seeds the random number generator used for failure injection.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+void
+Sim_Seed(uint32 seed)   // IN
+{
+   simRandom = seed != 0 ? seed : 1;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * Sim_Chance --
+ *
+ *      Draws a random event (xorshift32).
+ *
+ * Results:
+ *      TRUE with a probability of permille / 1000.
+ *
+ * Side effects:
+ *      Advances the random number generator.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+Bool
+Sim_Chance(uint32 permille)   // IN
+{
+   if (permille == 0) {
+      return FALSE;
+   }
+
+   simRandom ^= simRandom << 13;
+   simRandom ^= simRandom >> 17;
+   simRandom ^= simRandom << 5;
+
+   return simRandom % 1000 < permille;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SimTick --
+ *
+ *      Runs one timer tick of the balloon and checks the invariants.
+ *
+ *      Inflated and deflated pages are counted from the pages the monitor
+ *      locked and unlocked during the tick, not from the change in the
+ *      balloon size, which would net out e.g. a reset followed by
+ *      re-inflation. When a tick does both, its time is split between
+ *      inflation and deflation in proportion to the pages.
+ *
+ * Results:
+ *      TRUE if the guest and host state are consistent.
+ *
+ * Side effects:
+ *      Updates the result counters.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+SimTick(const SimScenario *sc,   // IN
+        uint32 target,           // IN
+        SimResult *res)          // IN/OUT
+{
+   const BalloonStats *stats;
+   const SimHostStats *host = SimHost_GetStats();
+   unsigned long locked = host->lockedPages;
+   unsigned long unlocked = host->unlockedPages;
+   uint64 start;
+   uint64 ns;
+
+   start = Bench_Now();
+   Balloon_QueryAndExecute();
+   ns = Bench_Now() - start;
+
+   stats = Balloon_GetStats();
+   locked = host->lockedPages - locked;
+   unlocked = host->unlockedPages - unlocked;
+   res->ticks++;
+   res->inflated += locked;
+   res->deflated += unlocked;
+   if (locked + unlocked > 0) {
+      uint64 inflateNs = ns * locked / (locked + unlocked);
+
+      res->inflateNs += inflateNs;
+      res->deflateNs += ns - inflateNs;
+   }
+   res->minRateAlloc = MIN(res->minRateAlloc, stats->rateAlloc);
+   res->minRateFree = MIN(res->minRateFree, stats->rateFree);
+
+   if (simVerbose) {
+      const SimOSStats *os = SimOS_GetStats();
+
+      printf("  tick %5u target %8u pages %8u rateAlloc %5u rateFree %5u "
+             "allocFail %lu/%lu lockFail %u unlockFail %u\n",
+             res->ticks, target, stats->nPages, stats->rateAlloc,
+             stats->rateFree, os->allocFail[BALLOON_PAGE_ALLOC_NOSLEEP],
+             os->allocFail[BALLOON_PAGE_ALLOC_CANSLEEP], stats->lockFail,
+             stats->unlockFail);
+   }
+
+   if (!SimHost_IsResetPending() && SimHost_LockedPages() != stats->nPages) {
+      fprintf(stderr, "%s: tick %u: guest has %u pages, host %lu.\n",
+              sc->name, res->ticks, stats->nPages, SimHost_LockedPages());
+      return FALSE;
+   }
+   /* The batch page, if any, is the only mapped page. */
+   if (SimOS_UsedPages() !=
+       sc->os.workloadPages + stats->nPages + SimOS_MappedPages()) {
+      fprintf(stderr, "%s: tick %u: %lu pages in use, expected %lu.\n",
+              sc->name, res->ticks, SimOS_UsedPages(),
+              sc->os.workloadPages + stats->nPages + SimOS_MappedPages());
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SimRunScript --
+ *
+ *      Runs the steps of a scenario's script.
+ *
+ * Results:
+ *      TRUE if all the steps completed and the invariants held.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+SimRunScript(const SimScenario *sc,   // IN
+             SimResult *res)          // OUT
+{
+   const char *p = sc->script;
+
+   while (*p != '\0') {
+      unsigned long target;
+      unsigned long ticks = 0;
+      unsigned long i;
+      char *end;
+
+      if (strncmp(p, "reset", 5) == 0) {
+         SimHost_Reset();
+         end = (char *)p + 5;
+      } else {
+         target = strtoul(p, &end, 10);
+         if (end == p) {
+            fprintf(stderr, "%s: bad script step '%s'.\n", sc->name, p);
+            return FALSE;
+         }
+         if (*end == '/') {
+            p = end + 1;
+            ticks = strtoul(p, &end, 10);
+            if (end == p || ticks == 0) {
+               fprintf(stderr, "%s: bad script step '%s'.\n", sc->name, p);
+               return FALSE;
+            }
+         }
+
+         SimHost_SetTarget(target);
+         for (i = 0; ticks == 0 || i < ticks; i++) {
+            if (ticks == 0 && i == SIM_STEP_MAX_TICKS) {
+               fprintf(stderr, "%s: target %lu not reached in %u ticks.\n",
+                       sc->name, target, SIM_STEP_MAX_TICKS);
+               return FALSE;
+            }
+            if (!SimTick(sc, target, res)) {
+               return FALSE;
+            }
+            if (ticks == 0 && !SimHost_IsResetPending() &&
+                Balloon_GetStats()->nPages == target) {
+               break;
+            }
+         }
+      }
+
+      if (*end == ',') {
+         end++;
+      } else if (*end != '\0') {
+         fprintf(stderr, "%s: bad script step '%s'.\n", sc->name, p);
+         return FALSE;
+      }
+      p = end;
+   }
+
+   return TRUE;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SimRate --
+ *
+ *      Pages per second.
+ *
+ * Results:
+ *      See above; 0 if nothing was measured.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static double
+SimRate(unsigned long pages,   // IN
+        uint64 ns)             // IN
+{
+   return ns == 0 ? 0 : pages * 1e9 / ns;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SimRunScenario --
+ *
+ *      Sets up the simulators, runs a scenario and prints its results.
+ *      Meant to be run in a child process, since the balloon core keeps
+ *      its state in globals that cannot be fully reset.
+ *
+ * Results:
+ *      TRUE on success.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Bool
+SimRunScenario(const SimScenario *sc,        // IN
+               const SimProtocol *proto)     // IN
+{
+   SimHostConfig hostConfig = sc->host;
+   SimResult res;
+   const BalloonStats *stats;
+   const SimHostStats *host;
+   unsigned long calls;
+   Bool ok;
+
+   memset(&res, 0, sizeof res);
+   res.minRateAlloc = MAX_UINT32;
+   res.minRateFree = MAX_UINT32;
+
+   hostConfig.capabilities = proto->capabilities;
+   if (!SimOS_Init(&sc->os) ||
+       !SimHost_Init(sc->os.poolPages, &hostConfig)) {
+      fprintf(stderr, "%s: cannot set up the simulation.\n", sc->name);
+      return FALSE;
+   }
+
+   if (simVerbose) {
+      printf("%s/%s: %s\n", sc->name, proto->name, sc->description);
+   }
+
+   Balloon_Init(BALLOON_GUEST_LINUX);
+   ok = SimRunScript(sc, &res);
+
+   stats = Balloon_GetStats();
+   host = SimHost_GetStats();
+   calls = host->calls[BALLOON_BDOOR_CMD_LOCK] +
+           host->calls[BALLOON_BDOOR_CMD_UNLOCK] +
+           host->calls[BALLOON_BDOOR_CMD_BATCHED_LOCK] +
+           host->calls[BALLOON_BDOOR_CMD_BATCHED_UNLOCK] +
+           host->calls[BALLOON_BDOOR_CMD_BATCHED_2M_LOCK] +
+           host->calls[BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK];
+
+   printf("%-10s %-8s %6u %9lu %12.0f %9lu %12.0f %10.3f %9u %9u\n",
+          sc->name, proto->name, res.ticks,
+          res.inflated, SimRate(res.inflated, res.inflateNs),
+          res.deflated, SimRate(res.deflated, res.deflateNs),
+          res.inflated + res.deflated == 0 ? 0.0 :
+             (double)calls / (res.inflated + res.deflated),
+          res.minRateAlloc, res.minRateFree);
+
+   if (simVerbose) {
+      const SimOSStats *os = SimOS_GetStats();
+
+      printf("  backdoor: start %lu target %lu lock %lu (%lu failed) "
+             "unlock %lu (%lu failed) resets %lu\n",
+             host->calls[BALLOON_BDOOR_CMD_START],
+             host->calls[BALLOON_BDOOR_CMD_TARGET],
+             host->calls[BALLOON_BDOOR_CMD_LOCK],
+             host->errors[BALLOON_BDOOR_CMD_LOCK],
+             host->calls[BALLOON_BDOOR_CMD_UNLOCK],
+             host->errors[BALLOON_BDOOR_CMD_UNLOCK], host->resets);
+      printf("  batched: lock %lu (%lu failed) unlock %lu (%lu failed) "
+             "pages %lu\n",
+             host->calls[BALLOON_BDOOR_CMD_BATCHED_LOCK],
+             host->errors[BALLOON_BDOOR_CMD_BATCHED_LOCK],
+             host->calls[BALLOON_BDOOR_CMD_BATCHED_UNLOCK],
+             host->errors[BALLOON_BDOOR_CMD_BATCHED_UNLOCK],
+             host->batchedPages);
+      printf("  2m: lock %lu (%lu failed) unlock %lu (%lu failed) "
+             "alloc %lu (failed %lu) free %lu; current %u\n",
+             host->calls[BALLOON_BDOOR_CMD_BATCHED_2M_LOCK],
+             host->errors[BALLOON_BDOOR_CMD_BATCHED_2M_LOCK],
+             host->calls[BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK],
+             host->errors[BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK],
+             os->largeAlloc, os->largeAllocFail, os->largeFree,
+             stats->nLargePages);
+      printf("  os: alloc %lu/%lu (failed %lu/%lu) free %lu yield %lu "
+             "malloc %lu; error pages %u\n",
+             os->alloc[BALLOON_PAGE_ALLOC_NOSLEEP],
+             os->alloc[BALLOON_PAGE_ALLOC_CANSLEEP],
+             os->allocFail[BALLOON_PAGE_ALLOC_NOSLEEP],
+             os->allocFail[BALLOON_PAGE_ALLOC_CANSLEEP],
+             os->free, os->yield, os->malloc, stats->primErrorPageAlloc);
+   }
+
+   Balloon_Cleanup();
+   if (ok && SimOS_UsedPages() != sc->os.workloadPages) {
+      fprintf(stderr, "%s: %lu pages leaked.\n", sc->name,
+              SimOS_UsedPages() - sc->os.workloadPages);
+      ok = FALSE;
+   }
+
+   SimHost_Cleanup();
+   SimOS_Cleanup();
+   return ok;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SimUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+SimUsage(const char *prog)   // IN
+{
+   size_t i;
+
+   fprintf(stderr,
+           "Usage: %s [-v] [-x seed] [-s scenario] [-S script] "
+           "[-p protocol] [-m pages] [-w pages]\n"
+           "\n"
+           "Runs the balloon core against a simulated guest and monitor.\n"
+           "  -s  run only the given scenario\n"
+           "  -S  run a custom script (with the settings of -s, or cycle)\n"
+           "  -p  run only with the given protocol (basic, batched or\n"
+           "      batch-2m)\n"
+           "  -m  guest memory in pages (default %u)\n"
+           "  -w  pages used by the guest workload\n"
+           "  -x  seed for failure injection\n"
+           "  -v  print the balloon state after every tick\n"
+           "\n"
+           "Scenarios:\n",
+           prog, SIM_DEFAULT_POOL_PAGES);
+   for (i = 0; i < ARRAYSIZE(simScenarios); i++) {
+      fprintf(stderr, "  %-10s %s (%s)\n", simScenarios[i].name,
+              simScenarios[i].description, simScenarios[i].script);
+   }
+   exit(1);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   const char *name = NULL;
+   const char *script = NULL;
+   const char *protoName = NULL;
+   unsigned long poolPages = 0;
+   unsigned long workloadPages = 0;
+   Bool haveWorkload = FALSE;
+   Bool ok = TRUE;
+   size_t first = 0;
+   size_t last = ARRAYSIZE(simScenarios);
+   size_t firstProto = 0;
+   size_t lastProto = ARRAYSIZE(simProtocols);
+   size_t i, j;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "m:p:s:S:vw:x:")) != -1) {
+      switch (opt) {
+      case 'm':
+         poolPages = strtoul(optarg, NULL, 0);
+         break;
+      case 'p':
+         protoName = optarg;
+         break;
+      case 's':
+         name = optarg;
+         break;
+      case 'S':
+         script = optarg;
+         break;
+      case 'v':
+         simVerbose = TRUE;
+         break;
+      case 'w':
+         workloadPages = strtoul(optarg, NULL, 0);
+         haveWorkload = TRUE;
+         break;
+      case 'x':
+         Sim_Seed(strtoul(optarg, NULL, 0));
+         break;
+      default:
+         SimUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc) {
+      SimUsage(argv[0]);
+   }
+
+   /* A custom script runs once, with the settings of the named scenario. */
+   if (script != NULL && name == NULL) {
+      name = simScenarios[0].name;
+   }
+   if (name != NULL) {
+      for (first = 0; first < ARRAYSIZE(simScenarios); first++) {
+         if (strcmp(name, simScenarios[first].name) == 0) {
+            break;
+         }
+      }
+      if (first == ARRAYSIZE(simScenarios)) {
+         SimUsage(argv[0]);
+      }
+      last = first + 1;
+   }
+
+   if (protoName != NULL) {
+      for (firstProto = 0; firstProto < ARRAYSIZE(simProtocols);
+           firstProto++) {
+         if (strcmp(protoName, simProtocols[firstProto].name) == 0) {
+            break;
+         }
+      }
+      if (firstProto == ARRAYSIZE(simProtocols)) {
+         SimUsage(argv[0]);
+      }
+      lastProto = firstProto + 1;
+   }
+
+   printf("%-10s %-8s %6s %9s %12s %9s %12s %10s %9s %9s\n", "scenario",
+          "protocol", "ticks", "inflated", "infl(pg/s)", "deflated", "defl(pg/s)",
+          "bdoor/pg", "minAlloc", "minFree");
+
+   for (i = first; i < last; i++) {
+      SimScenario sc = simScenarios[i];
+      int status;
+      pid_t pid;
+
+      if (script != NULL) {
+         sc.name = "custom";
+         sc.script = script;
+      }
+      if (poolPages != 0) {
+         sc.os.poolPages = poolPages;
+      }
+      if (haveWorkload) {
+         sc.os.workloadPages = workloadPages;
+      }
+
+      for (j = firstProto; j < lastProto; j++) {
+         fflush(stdout);
+         pid = fork();
+         if (pid < 0) {
+            perror("fork");
+            return 1;
+         } else if (pid == 0) {
+            exit(SimRunScenario(&sc, &simProtocols[j]) ? 0 : 1);
+         }
+
+         if (waitpid(pid, &status, 0) != pid ||
+             !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "%s/%s: FAILED\n", sc.name,
+                    simProtocols[j].name);
+            ok = FALSE;
+         }
+      }
+   }
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * vmballoonSim.h --
+ *
+ *      Interfaces of the simulated guest OS (osSim.c) and of the simulated
+ *      balloon backdoor (backdoorSim.c) the vmballoon core runs against in
+ *      the simulation harness.
+ */
+
+#ifndef _VMBALLOONSIM_H_
+#define _VMBALLOONSIM_H_
+
+#include "vm_basic_types.h"
+#include "balloon_def.h"
+#include "vmballoon.h"
+
+#define SIM_PAGE_SIZE         4096
+#define SIM_BASE_PPN          0x200   /* 2MB aligned, for large pages. */
+#define SIM_BLOCK_PAGES       BALLOON_2M_PAGES
+
+/*
+ * Simulated guest OS.
+ *
+ * The page pool is an mmap()ed region that is only touched through
+ * mappings (i.e. by the batch page); page handles are the addresses of its
+ * pages and PPNs are their index plus SIM_BASE_PPN. "workload" pages are
+ * taken out of the pool up front to stand for memory used by the rest of
+ * the guest; if "fragmented" is set, they are spread over the 2MB blocks of
+ * the pool so that none is left free for large pages. Memory pressure is
+ * modelled with two watermarks: NOSLEEP allocations fail once the number
+ * of free pages drops to lowWater, CANSLEEP ones (which would wait for the
+ * guest to swap) only once it drops to minFree. On top of that, any
+ * allocation can be made to fail at random. Small pages are taken from
+ * partially used blocks first, so that free blocks are kept for large
+ * pages.
+ */
+
+typedef struct SimOSConfig {
+   unsigned long poolPages;
+   unsigned long workloadPages;
+   unsigned long lowWater;
+   unsigned long minFree;
+   uint32 failPermille[BALLOON_PAGE_ALLOC_TYPES_NR];
+   Bool fragmented;
+} SimOSConfig;
+
+typedef struct SimOSStats {
+   unsigned long alloc[BALLOON_PAGE_ALLOC_TYPES_NR];
+   unsigned long allocFail[BALLOON_PAGE_ALLOC_TYPES_NR];
+   unsigned long free;
+   unsigned long yield;
+   unsigned long malloc;
+   unsigned long map;
+   unsigned long largeAlloc;
+   unsigned long largeAllocFail;
+   unsigned long largeFree;
+} SimOSStats;
+
+Bool SimOS_Init(const SimOSConfig *config);
+void SimOS_Cleanup(void);
+unsigned long SimOS_UsedPages(void);
+const SimOSStats *SimOS_GetStats(void);
+unsigned long SimOS_MappedPages(void);
+void *SimOS_PPNToAddr(unsigned long ppn);
+
+/*
+ * Simulated balloon backdoor.
+ *
+ * Implements Backdoor_InOut() for the balloon port, keeping track of the
+ * locked PPNs the way the monitor does. The target is set by the harness;
+ * lock and unlock calls can be made to fail at random with a given error
+ * code, and a reset can be requested, in which case the host forgets all
+ * locked pages and fails every command with BALLOON_ERROR_RESET until the
+ * guest sends BALLOON_BDOOR_CMD_START again.
+ *
+ * The host accepts the capabilities of the configuration that the guest
+ * asks for; with none, it behaves like a monitor that predates
+ * capabilities and only knows the per-page commands.
+ */
+
+#define SIM_BDOOR_CMDS        (BALLOON_BDOOR_CMD_BATCHED_2M_UNLOCK + 1)
+
+typedef struct SimHostConfig {
+   uint32 lockFailPermille;
+   int lockError;
+   uint32 unlockFailPermille;
+   int unlockError;
+   uint32 capabilities;
+} SimHostConfig;
+
+typedef struct SimHostStats {
+   unsigned long calls[SIM_BDOOR_CMDS];
+   unsigned long errors[SIM_BDOOR_CMDS];
+   unsigned long resets;
+   unsigned long batchedPages;
+   unsigned long lockedPages;     /* Successfully locked, in small pages. */
+   unsigned long unlockedPages;   /* Successfully unlocked, in small pages. */
+} SimHostStats;
+
+Bool SimHost_Init(unsigned long numPages, const SimHostConfig *config);
+void SimHost_Cleanup(void);
+void SimHost_SetTarget(uint32 target);
+void SimHost_Reset(void);
+Bool SimHost_IsResetPending(void);
+Bool SimHost_IsLocked(unsigned long ppn);
+unsigned long SimHost_LockedPages(void);
+const SimHostStats *SimHost_GetStats(void);
+
+/* Shared by both simulators; deterministic for a given seed. */
+void Sim_Seed(uint32 seed);
+Bool Sim_Chance(uint32 permille);
+
+#endif /* _VMBALLOONSIM_H_ */
@@ -0,0 +1,355 @@
+/*********************************************************
+ * Copyright (C) 2010 VMware, Inc. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation version 2.1 and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA.
+ *
+ *********************************************************/
+
+/*
+ * vmtoolsLogBench.c --
+ *
+ *   Throughput benchmark for libvmtools logging (vmtoolsLog.c) to a file,
+ *   with and without "async=true". Every round configures logging, starts
+ *   the threads, which each log the same number of messages with g_log(),
+ *   and then switches logging off again, which waits for the async writer
+ *   to empty its queue and closes the file. For each mode it prints:
+ *
+ *     us/msg   - average time spent in g_log() by the logging threads
+ *     Kmsg/s   - messages logged per second, until the last thread is done
+ *     Kwr/s    - messages written per second, until the file is closed
+ *     dropped  - messages that did not make it to the file (async only;
+ *                see "asyncBufferSize")
+ *
+ *   and the percentiles of the time of a single g_log() call.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "vmware.h"
+#include "vmware/tools/log.h"
+#include "benchUtil.h"
+
+#define BENCH_DEFAULT_THREADS   4
+#define BENCH_DEFAULT_MESSAGES  20000
+#define BENCH_DEFAULT_ROUNDS    5
+#define BENCH_DEFAULT_BUFSIZE   1024
+
+#define BENCH_DOMAIN            "vmtoolsLogBench"
+
+typedef struct BenchThread {
+   pthread_t thread;
+   unsigned int index;
+   uint64 *ns;               /* time of each g_log() call */
+} BenchThread;
+
+static char *benchLogPath;
+static unsigned int benchNumMessages;
+static pthread_barrier_t startBarrier;
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchConfigLogging --
+ *
+ *      Configures logging of the benchmark domain to benchLogPath.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Starts the async log writer if 'async' is TRUE.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchConfigLogging(Bool async,          // IN
+                   unsigned int bufSize)  // IN: asyncBufferSize, in KB
+{
+   GKeyFile *cfg = g_key_file_new();
+
+   g_key_file_set_boolean(cfg, "logging", "log", TRUE);
+   g_key_file_set_boolean(cfg, "logging", "enableCoreDump", FALSE);
+   g_key_file_set_boolean(cfg, "logging", "async", async);
+   g_key_file_set_integer(cfg, "logging", "asyncBufferSize", bufSize);
+   g_key_file_set_string(cfg, "logging", BENCH_DOMAIN ".level", "message");
+   g_key_file_set_string(cfg, "logging", BENCH_DOMAIN ".handler", "file");
+   g_key_file_set_string(cfg, "logging", BENCH_DOMAIN ".data", benchLogPath);
+   g_key_file_set_integer(cfg, "logging", BENCH_DOMAIN ".maxLogSize", 0);
+   VMTools_ConfigLogging(BENCH_DOMAIN, cfg, FALSE, TRUE);
+   g_key_file_free(cfg);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchLogger --
+ *
+ *      Logging thread: logs benchNumMessages messages, about the size of a
+ *      typical tools log line, and times each call.
+ *
+ * Results:
+ *      NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void *
+BenchLogger(void *data)   // IN: BenchThread
+{
+   BenchThread *t = data;
+   unsigned int i;
+
+   pthread_barrier_wait(&startBarrier);
+
+   for (i = 0; i < benchNumMessages; i++) {
+      uint64 start = Bench_Now();
+
+      g_log(BENCH_DOMAIN, G_LOG_LEVEL_MESSAGE,
+            "%s: thread %u message %u, state %d, result %d\n",
+            __FUNCTION__, t->index, i, (int) (i % 7), (int) (i % 3));
+      t->ns[i] = Bench_Now() - start;
+   }
+
+   return NULL;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchCountMessages --
+ *
+ *      Counts the benchmark's messages in the log file.
+ *
+ * Results:
+ *      The number of messages.
+ *
+ * Side effects:
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64
+BenchCountMessages(void)
+{
+   char line[256];
+   uint64 count = 0;
+   FILE *f = fopen(benchLogPath, "r");
+
+   if (f == NULL) {
+      return 0;
+   }
+   while (fgets(line, sizeof line, f) != NULL) {
+      if (strstr(line, "BenchLogger: thread ") != NULL) {
+         count++;
+      }
+   }
+   fclose(f);
+
+   return count;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchRun --
+ *
+ *      Runs the rounds for one mode and prints one line of results.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Overwrites benchLogPath.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchRun(const char *name,           // IN
+         Bool async,                 // IN
+         unsigned int bufSize,       // IN: asyncBufferSize, in KB
+         unsigned int numThreads,    // IN
+         unsigned int rounds)        // IN
+{
+   size_t perRound = (size_t) numThreads * benchNumMessages;
+   uint64 *ns = calloc(perRound * rounds, sizeof *ns);
+   BenchThread *threads = calloc(numThreads, sizeof *threads);
+   uint64 logged = 0;
+   uint64 written = 0;
+   uint64 dropped = 0;
+   unsigned int r;
+   unsigned int i;
+
+   if (ns == NULL || threads == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+   }
+
+   for (r = 0; r < rounds; r++) {
+      uint64 start;
+
+      unlink(benchLogPath);
+      BenchConfigLogging(async, bufSize);
+
+      pthread_barrier_init(&startBarrier, NULL, numThreads + 1);
+      for (i = 0; i < numThreads; i++) {
+         threads[i].index = i;
+         threads[i].ns = ns + r * perRound + i * benchNumMessages;
+         if (pthread_create(&threads[i].thread, NULL, BenchLogger,
+                            &threads[i]) != 0) {
+            fprintf(stderr, "Could not start logging thread.\n");
+            exit(1);
+         }
+      }
+
+      pthread_barrier_wait(&startBarrier);
+      start = Bench_Now();
+      for (i = 0; i < numThreads; i++) {
+         pthread_join(threads[i].thread, NULL);
+      }
+      logged += Bench_Now() - start;
+
+      /*
+       * Turns logging off, which waits for the async writer and closes the
+       * file. With logging off, the writer's note about dropped messages
+       * doesn't reopen the file.
+       */
+      VMTools_ConfigLogging(BENCH_DOMAIN, NULL, FALSE, TRUE);
+      written += Bench_Now() - start;
+      pthread_barrier_destroy(&startBarrier);
+
+      dropped += perRound - BenchCountMessages();
+   }
+
+   Bench_SortSamples(ns, perRound * rounds);
+   printf("%-6s %8u %10u %10.2f %10.1f %10.1f %10"FMT64"u", name,
+          numThreads, benchNumMessages,
+          (double) logged * numThreads / (perRound * rounds) / 1e3,
+          (double) perRound * rounds / (logged / 1e6),
+          (double) perRound * rounds / (written / 1e6),
+          dropped);
+   Bench_PrintPercentiles(ns, perRound * rounds);
+   printf("\n");
+
+   free(threads);
+   free(ns);
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BenchUsage --
+ *
+ *      Prints usage and exits.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Exits the process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+BenchUsage(const char *prog)   // IN
+{
+   Bench_Usage(prog, "[-t threads] [-m messages] [-n rounds] [-b bufSize] "
+               "directory",
+               "Logs %u messages (by default) from each of %u threads to a\n"
+               "file in the given directory, %u times, first synchronously,\n"
+               "then through the async log writer with a queue of %u KB.\n"
+               "Prints the average time per g_log() call, the throughput\n"
+               "and the percentiles of the time of a g_log() call.\n",
+               BENCH_DEFAULT_MESSAGES, BENCH_DEFAULT_THREADS,
+               BENCH_DEFAULT_ROUNDS, BENCH_DEFAULT_BUFSIZE);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+   unsigned int numThreads = BENCH_DEFAULT_THREADS;
+   unsigned int rounds = BENCH_DEFAULT_ROUNDS;
+   unsigned int bufSize = BENCH_DEFAULT_BUFSIZE;
+   char dir[PATH_MAX];
+   int opt;
+
+   benchNumMessages = BENCH_DEFAULT_MESSAGES;
+
+   while ((opt = getopt(argc, argv, "t:m:n:b:")) != -1) {
+      switch (opt) {
+      case 't':
+         numThreads = strtoul(optarg, NULL, 0);
+         break;
+      case 'm':
+         benchNumMessages = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         rounds = strtoul(optarg, NULL, 0);
+         break;
+      case 'b':
+         bufSize = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         BenchUsage(argv[0]);
+      }
+   }
+
+   if (optind != argc - 1 || numThreads == 0 || benchNumMessages == 0 ||
+       rounds == 0 || bufSize == 0) {
+      BenchUsage(argv[0]);
+   }
+
+   if (realpath(argv[optind], dir) == NULL) {
+      fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+      return 1;
+   }
+   benchLogPath = g_strdup_printf("%s/vmtoolsLogBench.log", dir);
+
+   if (!g_thread_supported()) {
+      g_thread_init(NULL);
+   }
+
+   printf("%-6s %8s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "mode",
+          "threads", "messages", "us/msg", "Kmsg/s", "Kwr/s", "dropped",
+          "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+   BenchRun("sync", FALSE, bufSize, numThreads, rounds);
+   BenchRun("async", TRUE, bufSize, numThreads, rounds);
+
+   unlink(benchLogPath);
+   g_free(benchLogPath);
+
+   return 0;
+}